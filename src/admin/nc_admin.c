@@ -34,6 +34,11 @@ const size_t RRA_SERVICE_KEY_LEN = sizeof(RRA_SERVICE_KEY) - 1;
 
 const char *ALLOWED_PROPERTIES[] = {
     "ttl",
+    "write_mode",
+    "negative_ttl",
+    "grace",
+    "write_behind",
+    "max_siblings",
     /* should be finished with empty line */
     ""
 };
@@ -287,11 +292,31 @@ nc_admin_check_args(int need, const char *arg1, const char *arg2,
             /* validate prop values */
             if (value) {
                 int64_t ttl;
-                if (nc_c_strequ(prop, "ttl")) {
-                    struct string str = {nc_strlen(value), (uint8_t *)value};
+                if (nc_c_strequ(prop, "ttl") ||
+                    nc_c_strequ(prop, "negative_ttl") ||
+                    nc_c_strequ(prop, "grace") ||
+                    nc_c_strequ(prop, "write_behind")) {
+                    struct string str = {(uint32_t)nc_strlen(value), (uint8_t *)value};
                     if (!nc_read_ttl_value(&str, &ttl)) {
-                        nc_admin_print("Invalid ttl value, specify quantity "
-                                       "and units, ie '15s' for 15 seconds");
+                        nc_admin_print("Invalid %s value, specify quantity "
+                                       "and units, ie '15s' for 15 seconds",
+                                       prop);
+                        return false;
+                    }
+                }
+                if (nc_c_strequ(prop, "max_siblings") &&
+                    nc_atoi(value, nc_strlen(value)) < 0) {
+                    nc_admin_print("Invalid max_siblings value, specify a "
+                                   "number of siblings, or 0 to not collapse "
+                                   "them");
+                    return false;
+                }
+                if (nc_c_strequ(prop, "write_mode")) {
+                    struct string str = {(uint32_t)nc_strlen(value), (uint8_t *)value};
+                    int mode;
+                    if (!server_read_write_mode(&str, &mode)) {
+                        nc_admin_print("Invalid write_mode value, use one of "
+                                       "'read_before_write', 'lww' or 'immutable'");
                         return false;
                     }
                 }
@@ -331,7 +356,7 @@ nc_admin_check_bucket(const char *str)
     struct string datatype;
     struct string bucket;
     char *res = NULL;
-    uint32_t str_len = nc_strlen(str);
+    uint32_t str_len = (uint32_t)nc_strlen(str);
     if (nc_parse_datatype_bucket((uint8_t *)str, str_len, &datatype, &bucket)) {
         if (str_len == bucket.len) {
             nc_admin_print("Using '%.*s' datatype for bucket '%.*s'",
@@ -342,7 +367,7 @@ nc_admin_check_bucket(const char *str)
         if (res) {
             int l = sprintf(res, "%.*s:%.*s", datatype.len,
                             datatype.data, bucket.len, bucket.data);
-            ASSERT(l == datatype.len + bucket.len + 1);
+            ASSERT((uint32_t)l == datatype.len + bucket.len + 1);
         }
         string_deinit(&datatype);
         string_deinit(&bucket);
@@ -90,6 +90,43 @@ nc_admin_poll_default_bp(struct bucket_prop *bp, struct server_pool *pool)
     bp->datatype.len = 0;
     bp->datatype.data = NULL;
     bp->ttl_ms = pool->server_ttl_ms;
+    bp->write_mode = WRITE_MODE_READ_BEFORE_WRITE;
+    bp->negative_ttl_ms = 0;
+    bp->grace_ms = 0;
+    bp->write_behind_ms = 0;
+    bp->max_siblings = 0;
+    bp->collapse_window_ms = 0;
+    bp->ncollapse = 0;
+}
+
+/*
+ * Parse the value of the bucket property name into its field of bp
+ */
+static bool
+nc_admin_poll_bucket_prop(const char *name, ProtobufCBinaryData *data,
+                          struct bucket_prop *bp)
+{
+    struct string value;
+
+    value.data = data->data;
+    value.len = (uint32_t)data->len;
+
+    if (nc_c_strequ(name, "ttl")) {
+        return nc_read_ttl_value(&value, &bp->ttl_ms);
+    } else if (nc_c_strequ(name, "write_mode")) {
+        return server_read_write_mode(&value, &bp->write_mode);
+    } else if (nc_c_strequ(name, "negative_ttl")) {
+        return nc_read_ttl_value(&value, &bp->negative_ttl_ms);
+    } else if (nc_c_strequ(name, "grace")) {
+        return nc_read_ttl_value(&value, &bp->grace_ms);
+    } else if (nc_c_strequ(name, "write_behind")) {
+        return nc_read_ttl_value(&value, &bp->write_behind_ms);
+    } else if (nc_c_strequ(name, "max_siblings")) {
+        bp->max_siblings = nc_atoi(value.data, value.len);
+        return bp->max_siblings >= 0;
+    }
+
+    return true;
 }
 
 static bool
@@ -102,23 +139,16 @@ nc_admin_poll_bucket_props(int sock, uint8_t *bucket, struct bucket_prop *bp)
         if (prop == NULL) {
             return false;
         }
-        if (prop->n_content > 0) {
-            if (prop->content[0]->value.len > 0) {
-                if (nc_c_strequ(ALLOWED_PROPERTIES[i], "ttl")) {
-                    struct string value;
-                    value.data = prop->content[0]->value.data;
-                    value.len = prop->content[0]->value.len;
-                    if (!nc_read_ttl_value(&value, &bp->ttl_ms)) {
-                        nc_free(prop);
-                        return false;
-                    }
-                }
-            }
+        if (prop->n_content > 0 && prop->content[0]->value.len > 0 &&
+            !nc_admin_poll_bucket_prop(ALLOWED_PROPERTIES[i],
+                                       &prop->content[0]->value, bp)) {
+            nc_free(prop);
+            return false;
         }
         nc_free(prop);
         i++;
     }
-    uint32_t bucketlen = nc_strlen(bucket);
+    uint32_t bucketlen = (uint32_t)nc_strlen(bucket);
     if (!nc_parse_datatype_bucket(bucket, bucketlen, &bp->datatype,
                                   &bp->bucket)) {
         return false;
@@ -145,7 +175,8 @@ nc_admin_poll_buckets(int sock, struct array *bucket_props,
         nc_free(bl);
         return true;
     }
-    array_init(bucket_props, bl->value->n_set_value, sizeof(struct bucket_prop));
+    array_init(bucket_props, (uint32_t)bl->value->n_set_value,
+               sizeof(struct bucket_prop));
     for (i = 0; i < bl->value->n_set_value; i++) {
         uint8_t bucket[bl->value->set_value[i].len + 1];
         sprintf((char *)bucket, "%.*s", (int)bl->value->set_value[i].len,
@@ -240,9 +271,9 @@ nc_admin_poll_start(struct context *ctx)
 
     service_key = nc_alloc(RRA_COUNTER_DATATYPE_LEN + RRA_SERVICE_BUCKET_LEN
                            + RRA_SERVICE_KEY_LEN + 3);
-    service_key_len = sprintf((char *)service_key, "%s:%s:%s",
-                              RRA_COUNTER_DATATYPE, RRA_SERVICE_BUCKET,
-                              RRA_SERVICE_KEY);
+    service_key_len = (uint8_t)sprintf((char *)service_key, "%s:%s:%s",
+                                       RRA_COUNTER_DATATYPE, RRA_SERVICE_BUCKET,
+                                       RRA_SERVICE_KEY);
     array_init(&update_items, array_n(&ctx->pool), sizeof(struct update_item));
 
     pthread_mutex_trylock(&poll_mutex);
@@ -0,0 +1,158 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nc_core.h>
+#include <nc_arena.h>
+
+static struct arena_chdr used_chunkq; /* chunks in use, current first */
+static struct arena_chdr free_chunkq; /* free chunks */
+static uint32_t nfree_chunkq;         /* # free chunks */
+
+static void *arena_pb_alloc(void *allocator_data, size_t size);
+static void arena_pb_free(void *allocator_data, void *pointer);
+
+static ProtobufCAllocator arena_allocator = {
+    arena_pb_alloc,
+    arena_pb_free,
+    NULL
+};
+
+void
+arena_init(void)
+{
+    STAILQ_INIT(&used_chunkq);
+    STAILQ_INIT(&free_chunkq);
+    nfree_chunkq = 0;
+}
+
+void
+arena_deinit(void)
+{
+    struct arena_chunk *chunk;
+
+    arena_reset();
+
+    while (!STAILQ_EMPTY(&free_chunkq)) {
+        chunk = STAILQ_FIRST(&free_chunkq);
+        STAILQ_REMOVE_HEAD(&free_chunkq, next);
+        nfree_chunkq--;
+        nc_free(chunk);
+    }
+    ASSERT(nfree_chunkq == 0);
+}
+
+static struct arena_chunk *
+arena_chunk_get(size_t size)
+{
+    struct arena_chunk *chunk;
+
+    if (size <= ARENA_CHUNK_SIZE && !STAILQ_EMPTY(&free_chunkq)) {
+        chunk = STAILQ_FIRST(&free_chunkq);
+        STAILQ_REMOVE_HEAD(&free_chunkq, next);
+        nfree_chunkq--;
+    } else {
+        if (size < ARENA_CHUNK_SIZE) {
+            size = ARENA_CHUNK_SIZE;
+        }
+
+        chunk = nc_alloc(offsetof(struct arena_chunk, data) + size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->size = size;
+    }
+
+    /* keep allocating from the current chunk after an oversized one */
+    chunk->used = 0;
+    if (chunk->size > ARENA_CHUNK_SIZE) {
+        STAILQ_INSERT_TAIL(&used_chunkq, chunk, next);
+    } else {
+        STAILQ_INSERT_HEAD(&used_chunkq, chunk, next);
+    }
+
+    return chunk;
+}
+
+/**.......................................................................
+ * Allocate size bytes, aligned to the platform word, which stay valid
+ * until the next arena_reset
+ */
+void *
+arena_alloc(size_t size)
+{
+    struct arena_chunk *chunk;
+    void *p;
+
+    size = NC_ALIGN(size, NC_ALIGNMENT);
+
+    chunk = STAILQ_FIRST(&used_chunkq);
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        chunk = arena_chunk_get(size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+
+    p = chunk->data + chunk->used;
+    chunk->used += size;
+
+    return p;
+}
+
+/**.......................................................................
+ * Release everything allocated from the arena at once
+ */
+void
+arena_reset(void)
+{
+    struct arena_chunk *chunk;
+
+    while (!STAILQ_EMPTY(&used_chunkq)) {
+        chunk = STAILQ_FIRST(&used_chunkq);
+        STAILQ_REMOVE_HEAD(&used_chunkq, next);
+
+        if (chunk->size > ARENA_CHUNK_SIZE || nfree_chunkq >= ARENA_MAX_FREE) {
+            nc_free(chunk);
+            continue;
+        }
+
+        STAILQ_INSERT_HEAD(&free_chunkq, chunk, next);
+        nfree_chunkq++;
+    }
+}
+
+static void *
+arena_pb_alloc(void *allocator_data, size_t size)
+{
+    return arena_alloc(size);
+}
+
+static void
+arena_pb_free(void *allocator_data, void *pointer)
+{
+    /* released by arena_reset */
+}
+
+/**.......................................................................
+ * Return a protobuf-c allocator backed by the arena, for messages
+ * unpacked and freed within an event
+ */
+ProtobufCAllocator *
+arena_pb_allocator(void)
+{
+    return &arena_allocator;
+}
@@ -0,0 +1,54 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NC_ARENA_H_
+#define _NC_ARENA_H_
+
+#include <nc_core.h>
+
+/*
+ * The arena holds the temporaries of the Riak encode and decode paths:
+ * the structures protobuf-c unpacks into, and the type, bucket, key and
+ * value copied out of Redis requests.  Allocations are carved out of
+ * chunks and are not freed one by one; the arena is reset in bulk at
+ * the end of each event loop iteration, so nothing allocated from it
+ * may be kept past the event that allocated it.
+ *
+ * Chunks are kept for reuse across iterations, up to ARENA_MAX_FREE
+ * of them; an allocation larger than a chunk gets a chunk of its own,
+ * which is released on reset.
+ */
+
+#define ARENA_CHUNK_SIZE    16384
+#define ARENA_MAX_FREE      16
+
+struct arena_chunk {
+    STAILQ_ENTRY(arena_chunk) next;    /* next chunk */
+    size_t                    size;    /* data size (const) */
+    size_t                    used;    /* # data bytes in use */
+    uint8_t                   data[1]; /* data */
+};
+
+STAILQ_HEAD(arena_chdr, arena_chunk);
+
+void arena_init(void);
+void arena_deinit(void);
+void *arena_alloc(size_t size);
+void arena_reset(void);
+ProtobufCAllocator *arena_pb_allocator(void);
+
+#endif
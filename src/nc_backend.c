@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include <sys/uio.h>
 
@@ -34,8 +35,49 @@ bool forward_response(struct context *ctx, struct conn* c_conn, struct conn* s_c
 bool swallow_response(struct context *ctx, struct conn* c_conn, struct conn* s_conn,
                       struct msg* pmsg, struct msg* msg);
 
+/* max # hidden writes joined into one request to a frontend server */
+#define BACKEND_WRITE_BATCH_MAX 64
+
+typedef int64_t (*backend_bucket_prop_t)(struct server_pool *pool,
+                                         uint8_t *datatype, uint32_t datatypelen,
+                                         uint8_t *bucket, uint32_t bucketlen);
+
+static bool backend_fill_mget(struct context *ctx, struct conn *s_conn,
+                              struct msg* pmsg, struct msg* msg);
+static void backend_fill_complete(struct msg* pmsg);
+static void backend_fill_waited(struct msg* sub, struct msg* rsp);
+static void backend_fill_resend(struct context *ctx, struct msg* sub,
+                                struct msg* msg);
+static bool backend_fill_sets(struct context *ctx, struct conn *s_conn,
+                              struct msg* pmsg, struct msg* msg);
+static void backend_sets_complete(struct msg* pmsg);
+static bool backend_set_op(struct msg* msg);
+static bool backend_refresh_rsp(struct context *ctx, struct conn *s_conn,
+                                struct msg* msg);
+static bool backend_refresh_done(struct context *ctx, struct conn *s_conn,
+                                 struct msg* msg);
+static bool backend_counter_done(struct context *ctx, struct conn *s_conn,
+                                 struct msg* msg);
+static bool backend_set_done(struct context *ctx, struct conn *s_conn,
+                             struct msg* msg);
+static void backend_latency_sample(struct server* server, struct msg* pmsg);
+static bool backend_hedge_won(struct context *ctx, struct conn *s_conn,
+                              struct msg* msg);
+static void backend_outq_stats_move(struct context *ctx, struct conn* from,
+                                    struct conn* to, struct msg* msg);
+static void backend_fill_read(struct context *ctx, struct msg* pmsg);
+static bool backend_nil_lookup(struct context *ctx, struct conn *s_conn,
+                               struct msg* pmsg);
+static bool backend_nil_looked_up(struct context *ctx, struct conn *s_conn,
+                                  struct msg* msg);
+static bool backend_resend(struct context *ctx, struct msg* msg,
+                           bool frontend);
+static int64_t backend_key_prop(struct server_pool* pool, uint8_t* key,
+                                uint32_t keylen, backend_bucket_prop_t get);
+
 rstatus_t add_set_msg(struct context *ctx, struct conn* c_conn, struct msg* msg);
 rstatus_t add_pexpire_msg(struct context *ctx, struct conn* c_conn, struct msg* msg);
+rstatus_t add_nil_marker_msg(struct context *ctx, struct conn* c_conn, struct msg* msg);
 
 void init_backend_resend_q(struct msg* msg);
 void insert_in_backend_resend_q(struct msg* msg, struct server* server);
@@ -44,6 +86,7 @@ struct backend_enqueue_post_msg_param {
     struct context *ctx;
     struct conn *c_conn;
     struct conn *s_conn;
+    struct msg *pmsg;
 };
 rstatus_t backend_enqueue_post_msg(void *elem /*struct msg *msg*/,
         void *data /*struct backend_enqueue_post_msg_param *prm*/);
@@ -86,8 +129,38 @@ backend_process_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
 bool
 resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
 {
+    struct server* server = (struct server*)s_conn->owner;
+
     rsp_get_peer(ctx, s_conn, msg);
 
+    if (backend_resend(ctx, msg, !server->backend)) {
+        return true;
+    }
+
+    /*
+     * For the original response to be forwarded instead, we need to add
+     * the original (peer) request back to the frontend server's omsgq --
+     * ie, restore the state we were in when the original response was
+     * received.  Note that we need to insert it at the head of the
+     * omsg_q (the position it was in when we entered this function), not
+     * at the tail.
+     */
+    TAILQ_INSERT_HEAD(&s_conn->omsg_q, msg->peer, s_tqe);
+    return false;
+}
+
+/**.......................................................................
+ * Resend the peer of msg, the request msg has just answered, to the
+ * backend pool.  frontend is true if msg is the response of a frontend
+ * server, to a cache miss.
+ *
+ * Returns true if the request was resent, or is to be answered from a
+ * read already in flight, and msg was put; false if resending failed,
+ * leaving the request undone, without a peer
+ */
+static bool
+backend_resend(struct context *ctx, struct msg* msg, bool frontend)
+{
     /*
      * Get a pointer to the client connection that originated the peer,
      * and set the peer message as its next message to send.
@@ -95,6 +168,12 @@ resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
     struct conn* c_conn = msg->peer->owner;
     struct msg* pmsg = msg->peer;
 
+    /*
+     * With pipelined clients, the client may be in the middle of
+     * receiving its next request; hand that back to recv_done() as the
+     * next message so that it is restored once the peer is re-sent
+     */
+    struct msg* rmsg = c_conn->rmsg;
     c_conn->rmsg = pmsg;
 
     /*
@@ -102,7 +181,7 @@ resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
      * pointer to the start of the first mbuf
      */
 
-    pmsg->done = 0;
+    req_mark_undone(pmsg);
     pmsg->peer = NULL;
 
     msg_reset_pos(pmsg);
@@ -114,9 +193,16 @@ resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
      * will already have been initialized)
      */
 
-    struct server* server = (struct server*)s_conn->owner;
-
-    if (!server->backend) {
+    if (frontend) {
+        /*
+         * A request for the same key may already be in flight to the
+         * backend, in which case this one is answered from its response
+         */
+        if (backend_miss_join(ctx, pmsg)) {
+            c_conn->rmsg = rmsg;
+            msg_put(msg);
+            return true;
+        }
         init_backend_resend_q(msg);
     }
 
@@ -127,6 +213,7 @@ resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
      */
 
     if (TAILQ_EMPTY(&c_conn->omsg_q)) {
+        c_conn->rmsg = rmsg;
         return true;
     }
 
@@ -139,7 +226,7 @@ resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
      * order in which it was received
      */
 
-    c_conn->recv_done(ctx, c_conn, pmsg, NULL, true, false);
+    c_conn->recv_done(ctx, c_conn, pmsg, rmsg, true, false);
 
     /*
      * Return the original message to the free msg pool, but only if it
@@ -157,19 +244,13 @@ resend_to_backend(struct context *ctx, struct conn *s_conn, struct msg* msg)
      * pmsg->error and pmsg->err to indicate the type of error.  For
      * now, we just reset the error flag as if nothing happened)
      *
-     * For this to work, we need to add the original (peer) request back
-     * to the frontend server's omsgq -- ie, restore the state we were
-     * in when the original response was received.  Note that we need to
-     * insert it at the head of the omsg_q (the position it was in when
-     * we entered this function), not at the tail.
-     *
      * If however the message was successfully intercepted, we return
      * the message to the pool by calling msg_put()
      */
 
     if (pmsg->error) {
         pmsg->error = 0;
-        TAILQ_INSERT_HEAD(&s_conn->omsg_q, pmsg, s_tqe);
+        backend_miss_done(pmsg, msg);
         return false;
     } else {
         msg_put(msg);
@@ -225,7 +306,7 @@ swallow_response(struct context *ctx, struct conn* c_conn, struct conn* s_conn,
         s_conn->swallow_msg(s_conn, pmsg, msg);
         s_conn->dequeue_outq(ctx, s_conn, pmsg);
 
-        pmsg->done = 1;
+        req_mark_done(pmsg);
 
         log_debug(LOG_INFO,
                   "swallow rsp %"PRIu64" len %"PRIu32" of req " "%"PRIu64" on s %d",
@@ -240,6 +321,31 @@ swallow_response(struct context *ctx, struct conn* c_conn, struct conn* s_conn,
     return false;
 }
 
+/**.......................................................................
+ * Cache the value a frontend server answered a GET with in the L1 cache
+ */
+static void
+backend_l1_frontend_fill(struct msg* pmsg, struct msg* msg)
+{
+    struct server_pool* pool = pmsg->owner->owner;
+    struct msg_pos val = msg_pos_init();
+    struct keypos* kpos;
+    size_t vlen = 0;
+
+    if (!l1_cache_enabled(pool->l1_cache) || msg->type != MSG_RSP_REDIS_BULK ||
+        msg_nil(msg) || array_n(pmsg->keys) == 0) {
+        return;
+    }
+
+    if (redis_get_next_string(msg, NULL, &val, &vlen) != NC_OK) {
+        return;
+    }
+
+    kpos = array_get(pmsg->keys, 0);
+    backend_l1_fill(pmsg->owner, pmsg, kpos->start,
+                    (uint32_t)(kpos->end - kpos->start), &val, (uint32_t)vlen);
+}
+
 /**.......................................................................
  * Backend processing of a response from a frontend server.
  *
@@ -255,9 +361,38 @@ bool
 process_frontend_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
 {
     struct msg* pmsg = TAILQ_FIRST(&msg->owner->omsg_q);
+
+    /*
+     * A batch of hidden writes (see backend_frontend_write) is done with
+     * on the reply to its last write
+     */
+    if (pmsg->nbatch > 1) {
+        pmsg->nbatch--;
+        rsp_put(msg);
+        return true;
+    }
+
+    /* a lookup of not-found markers goes on with the read it was for */
+    if (pmsg->nil_owner != NULL) {
+        return backend_nil_looked_up(ctx, s_conn, msg);
+    }
+
     switch (pmsg->type) {
 
     case MSG_REQ_REDIS_GET:
+        backend_l1_frontend_fill(pmsg, msg);
+        /* no break */
+
+    case MSG_REQ_REDIS_EXISTS:
+        /* a key known to be missing from the backend is not read through */
+        if (msg_nil(msg) && backend_nil_lookup(ctx, s_conn, pmsg)) {
+            server_ok(ctx, s_conn);
+            s_conn->dequeue_outq(ctx, s_conn, pmsg);
+            pmsg->fill_rsp = msg;
+            return true;
+        }
+        /* no break */
+
     case MSG_REQ_REDIS_SMEMBERS:
     case MSG_REQ_REDIS_SISMEMBER:
     case MSG_REQ_REDIS_SCARD:
@@ -266,62 +401,28 @@ process_frontend_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
         }
         break;
 
+    case MSG_REQ_REDIS_PTTL:
+        if (pmsg->refresh) {
+            return backend_refresh_rsp(ctx, s_conn, msg);
+        }
+        break;
+
+    case MSG_REQ_REDIS_MGET:
+        if (pmsg->frag_id != 0 && msg->type == MSG_RSP_REDIS_MULTIBULK) {
+            return backend_fill_mget(ctx, s_conn, pmsg, msg);
+        }
+        break;
+
     case MSG_REQ_REDIS_SDIFF:
     case MSG_REQ_REDIS_SINTER:
     case MSG_REQ_REDIS_SUNION:
     case MSG_REQ_REDIS_SDIFFSTORE:
     case MSG_REQ_REDIS_SINTERSTORE:
     case MSG_REQ_REDIS_SUNIONSTORE:
-        if (pmsg->nsubs == 0 && msg_nil(msg)) {
-            switch(pmsg->type) {
-            case MSG_REQ_REDIS_SDIFF:
-                riak_sync_key(ctx, pmsg, MSG_REQ_RIAK_SDIFF, false);
-                break;
-            case MSG_REQ_REDIS_SINTER:
-                riak_sync_key(ctx, pmsg, MSG_REQ_RIAK_SINTER, false);
-                break;
-            case MSG_REQ_REDIS_SUNION:
-                riak_sync_key(ctx, pmsg, MSG_REQ_RIAK_SUNION, false);
-                break;
-            case MSG_REQ_REDIS_SDIFFSTORE:
-                riak_sync_key(ctx, pmsg, MSG_REQ_RIAK_SDIFFSTORE, true);
-                break;
-            case MSG_REQ_REDIS_SINTERSTORE:
-                riak_sync_key(ctx, pmsg, MSG_REQ_RIAK_SINTERSTORE, true);
-                break;
-            case MSG_REQ_REDIS_SUNIONSTORE:
-                riak_sync_key(ctx, pmsg, MSG_REQ_RIAK_SUNIONSTORE, true);
-                break;
-            default:
-                NOT_REACHED();
-            }
-        } else if (pmsg->nsubs == 0) {
-                uint32_t res;
-                switch(pmsg->type) {
-                case MSG_REQ_REDIS_SDIFFSTORE:
-                case MSG_REQ_REDIS_SINTERSTORE:
-                case MSG_REQ_REDIS_SUNIONSTORE:
-                    riak_synced_key(ctx, pmsg, msg, &res);
-                    msg_rewind(msg);
-                    msg_prepend_format(msg, ":%d\r\n", res);
-                    /* no break */
-                default:
-                    forward_response(ctx, pmsg->owner, s_conn, pmsg, msg);
-                }
-
-//                struct msg *nmsg = TAILQ_FIRST(&s_conn->omsg_q);
-//                while (nmsg) {
-//                    msg_put(nmsg);
-//                    TAILQ_REMOVE(&s_conn->omsg_q, nmsg, s_tqe);
-//                    nmsg = TAILQ_FIRST(&s_conn->omsg_q);
-//                    if (nmsg->s_tqe.tqe_next == NULL)
-//                        break;
-//                }
-
-        } else {
-            pmsg->nsubs--;
+        if (msg_nil(msg)) {
+            return backend_fill_sets(ctx, s_conn, pmsg, msg);
         }
-        return true;
+        break;
 
     default:
         break;
@@ -338,8 +439,7 @@ backend_enqueue_post_msg(void *elem /*struct msg *msg*/,
         (struct backend_enqueue_post_msg_param*)data;
     struct context *ctx = prm->ctx;
     struct conn *s_conn = prm->s_conn;
-    struct conn *c_conn = prm->c_conn;
-    struct msg* msgp = TAILQ_FIRST(&c_conn->omsg_q);
+    struct msg* msgp = prm->pmsg;
     rstatus_t status = NC_OK;
     ProtobufCBinaryData vclock;
     ASSERT(msgp != NULL);
@@ -352,13 +452,25 @@ backend_enqueue_post_msg(void *elem /*struct msg *msg*/,
     }
     msg_copy_vclock(msg, (protobuf_c_boolean)1, vclock);
 
-    s_conn->dequeue_outq(ctx, s_conn, msgp);
-    c_conn->dequeue_outq(ctx, c_conn, msgp);
-
     msg->noreply = 0;
     s_conn->req_remap(s_conn, msg);
 
-    c_conn->enqueue_outq(ctx, c_conn, msg);
+    /*
+     * The post message takes the place of the read-before-write request
+     * in the client's omsg_q, which may hold later requests already, so
+     * that its response is released to the client in request order.  A
+     * request nobody waits for, as it is hidden or its client is gone,
+     * has no place to hand over and its post message is swallowed too.
+     */
+    if (msgp->swallow) {
+        msg->swallow = 1;
+    } else {
+        req_client_insert_omsgq(prm->c_conn, msgp, msg);
+    }
+
+    /* it stands in for a fragment, eg. a key of an MSET, as well */
+    msg->frag_id = msgp->frag_id;
+    msg->frag_owner = msgp->frag_owner;
     s_conn->enqueue_inq(ctx, s_conn, msg);
 
     return status;
@@ -381,6 +493,51 @@ backend_event_add_post_msg(struct backend_enqueue_post_msg_param *prm)
     return status;
 }
 
+/**.......................................................................
+ * Complete the reply to a read streamed to its client, on the read's
+ * response (see riak_cut_through): the reply, its value streamed, is
+ * framed and answers the read in place of the response, and the fill of
+ * the key, streamed along, is written to the frontend
+ */
+static bool
+backend_cut_through_done(struct context *ctx, struct conn *s_conn,
+                         struct msg* msg)
+{
+    struct msg* pmsg = TAILQ_FIRST(&s_conn->omsg_q);
+    struct riak_cut* cut = pmsg->riak_cut;
+    struct conn* c_conn = pmsg->owner;
+
+    if (swallow_response(ctx, c_conn, s_conn, pmsg, msg)) {
+        return true;
+    }
+
+    rsp_get_peer(ctx, s_conn, msg);
+
+    if (cut->fill != NULL) {
+        add_set_msg_done(ctx, c_conn, (char*)cut->key.data, cut->fill);
+        cut->fill = NULL;
+    }
+
+    /* a reply cut short closes the client, see rsp_send_next */
+    if (msg_copy_char(cut->rsp, CRLF, CRLF_LEN) != NC_OK) {
+        pmsg->error = 1;
+        pmsg->err = errno;
+    } else {
+        pmsg->peer = cut->rsp;
+        cut->rsp = NULL;
+        msg->peer = NULL;
+        rsp_put(msg);
+        backend_cut_through_put(pmsg);
+    }
+
+    if (req_done(c_conn, TAILQ_FIRST(&c_conn->omsg_q)) &&
+        event_add_out(ctx->evb, c_conn) != NC_OK) {
+        c_conn->err = errno;
+    }
+
+    return true;
+}
+
 /**.......................................................................
  * Process a response received from a backend server.
  */
@@ -389,8 +546,64 @@ process_backend_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
 {
     struct msg* pmsg = TAILQ_FIRST(&s_conn->omsg_q);
     ASSERT(pmsg != NULL);
+
+    backend_latency_sample(s_conn->owner, pmsg);
+
+    if (pmsg->riak_cut != NULL) {
+        return backend_cut_through_done(ctx, s_conn, msg);
+    }
+
+    /*
+     * A hedge answered with a value before the read it hedges takes the
+     * read's place, so the read is answered here; otherwise the hedge is
+     * swallowed
+     */
+    if (pmsg->hedge_copy) {
+        if (!backend_hedge_won(ctx, s_conn, msg)) {
+            return false;
+        }
+        pmsg = TAILQ_FIRST(&s_conn->omsg_q);
+    }
+
     struct conn* c_conn = pmsg->owner;
 
+    if (pmsg->refresh) {
+        return backend_refresh_done(ctx, s_conn, msg);
+    }
+
+    if (pmsg->counter_batch) {
+        return backend_counter_done(ctx, s_conn, msg);
+    }
+
+    if (pmsg->set_batch) {
+        return backend_set_done(ctx, s_conn, msg);
+    }
+
+    /*
+     * A read of a key missing from an mget fragment is kept for the
+     * fragment only if it found a value; otherwise it is resent to the
+     * next backend server as a GET miss is, or done with.  A read of a
+     * set of a set operation is kept whatever it found
+     */
+    if (pmsg->fill_owner != NULL) {
+        rsp_get_peer(ctx, s_conn, msg);
+        if (backend_set_op(pmsg->fill_owner) ||
+            (msg->type == MSG_RSP_REDIS_BULK && !msg_nil(msg))) {
+            backend_miss_done(pmsg, msg);
+            backend_fill_done(pmsg);
+        } else if (msg->type == MSG_RSP_REDIS_BULK &&
+                   !backend_resend_q_empty(pmsg)) {
+            backend_fill_resend(ctx, pmsg, msg);
+        } else {
+            backend_miss_done(pmsg, msg);
+            if (msg->type == MSG_RSP_REDIS_BULK && !pmsg->fill_owner->swallow) {
+                add_nil_marker_msg(ctx, c_conn, msg);
+            }
+            req_put(pmsg);
+        }
+        return true;
+    }
+
     switch (msg->type) {
     case MSG_RSP_REDIS_BULK:
         if (pmsg->read_before_write) {
@@ -400,18 +613,25 @@ process_backend_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
             prmp.ctx = ctx;
             prmp.c_conn = c_conn;
             prmp.s_conn = s_conn;
+            prmp.pmsg = pmsg;
 
             array_each(pmsg->msgs_post, backend_enqueue_post_msg, &prmp);
-            backend_event_add_post_msg(&prmp);
+            s_conn->dequeue_outq(ctx, s_conn, pmsg);
+            if (!pmsg->swallow) {
+                c_conn->dequeue_outq(ctx, c_conn, pmsg);
+                backend_event_add_post_msg(&prmp);
+            }
 
             pmsg->swallow = 1;
-            pmsg->done = 1;
+            req_mark_done(pmsg);
 
            /* further processing needed, so return false  */
            return false;
         } else if (!msg_nil(msg)) {
-            forward_response(ctx, c_conn, s_conn, pmsg, msg);
-            add_set_msg(ctx, c_conn, msg);
+            backend_miss_done(pmsg, msg);
+            if (forward_response(ctx, c_conn, s_conn, pmsg, msg)) {
+                add_set_msg(ctx, c_conn, msg);
+            }
         } else {
             if (!backend_resend_q_empty(pmsg)) {
                 swallow_response(ctx, c_conn, s_conn, pmsg, msg);
@@ -419,7 +639,10 @@ process_backend_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
                     return false;
                 }
             } else {
-                forward_response(ctx, c_conn, s_conn, pmsg, msg);
+                backend_miss_done(pmsg, msg);
+                if (forward_response(ctx, c_conn, s_conn, pmsg, msg)) {
+                    add_nil_marker_msg(ctx, c_conn, msg);
+                }
             }
         }
         break;
@@ -489,6 +712,23 @@ add_set_msg(struct context *ctx, struct conn* c_conn, struct msg* msg)
     return NC_ERROR;
 }
 
+/**.......................................................................
+ * Function to add a not-found marker to the server's queue, extracting
+ * key name from the passed (nil) message
+ */
+rstatus_t
+add_nil_marker_msg(struct context *ctx, struct conn* c_conn, struct msg* msg)
+{
+    ASSERT(msg != NULL);
+    ASSERT(msg->peer != NULL);
+
+    if (msg->peer->type == MSG_REQ_RIAK_GET && msg_nil(msg)) {
+        return add_nil_marker_msg_riak(ctx, c_conn, msg);
+    }
+
+    return NC_OK;
+}
+
 /**.......................................................................
  * Function add PEXPIRE message to the server's queue, extracting key
  * name from the passed message
@@ -507,61 +747,99 @@ add_pexpire_msg(struct context *ctx, struct conn* c_conn, struct msg* msg)
 }
 
 /**.......................................................................
- * Function to add a PEXPIRE message to the server's queue, with explicit
- * keyname and expiration time
+ * Append a RESP header, ie "$<n>\r\n" or "*<n>\r\n", to a message, with
+ * the number formatted in place rather than through sprintf
  */
-rstatus_t
-add_pexpire_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
-                    uint32_t keynamelen, uint32_t timeout)
+static rstatus_t
+backend_resp_hdr(struct msg* msg, uint8_t type, uint64_t n)
+{
+    uint8_t buf[1 + NC_UINT64_MAXLEN + CRLF_LEN];
+    uint8_t* p = buf + sizeof(buf);
+
+    *--p = LF;
+    *--p = CR;
+    do {
+        *--p = (uint8_t)('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    *--p = type;
+
+    return msg_copy(msg, p, (size_t)(buf + sizeof(buf) - p));
+}
+
+/**.......................................................................
+ * Append a RESP bulk string to a message
+ */
+static rstatus_t
+backend_resp_bulk(struct msg* msg, const void* data, uint32_t len)
 {
-    const char pexipire_begin_proto[] = "*3\r\n$7\r\npexpire\r\n$%u\r\n";
-    const char pexipire_finish_proto[] = "\r\n$%u\r\n%u\r\n";
-    uint32_t ntime_dig = ndig(timeout);
     rstatus_t status;
-    struct conn* s_conn = server_pool_conn_frontend(ctx, c_conn->owner,
-                                                    (uint8_t*)keyname,
-                                                    keynamelen,
-                                                    NULL);
 
-    char pexipire_begin[sizeof(pexipire_begin_proto) - 2 + ndig(keynamelen)];
-    const uint32_t pexipire_begin_len = (uint32_t)sprintf(pexipire_begin,
-                                                          pexipire_begin_proto,
-                                                          keynamelen);
-    ASSERT(pexipire_begin_len == sizeof(pexipire_begin) - 1);
-    UNUSED(pexipire_begin_len);
+    if ((status = backend_resp_hdr(msg, '$', len)) != NC_OK ||
+        (status = msg_copy(msg, (uint8_t*)data, len)) != NC_OK) {
+        return status;
+    }
 
-    char pexipire_finish[sizeof(pexipire_finish_proto) - 4 + ndig(ntime_dig)
-                         + ntime_dig];
-    const uint32_t pexipire_finish_len = (uint32_t)sprintf(
-            pexipire_finish, pexipire_finish_proto, ntime_dig, timeout);
-    ASSERT(pexipire_finish_len == sizeof(pexipire_finish) - 1);
-    UNUSED(pexipire_finish_len);
+    return msg_copy_char(msg, CRLF, CRLF_LEN);
+}
 
-    struct msg* msg = msg_get(c_conn, true);
-    if (msg == NULL) {
-        c_conn->err = errno;
-        return NC_ENOMEM;
-    }
+/**.......................................................................
+ * Append a number to a message, as a RESP bulk string
+ */
+static rstatus_t
+backend_resp_uint(struct msg* msg, uint64_t n)
+{
+    uint8_t buf[NC_UINT64_MAXLEN];
+    uint8_t* p = buf + sizeof(buf);
 
-    if ((status = msg_copy_char(msg, pexipire_begin, sizeof(pexipire_begin) - 1)) != NC_OK) {
-        msg_put(msg);
-        return status;
-    }
+    do {
+        *--p = (uint8_t)('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
 
-    if ((status = msg_copy_char(msg, keyname, keynamelen)) != NC_OK) {
-        msg_put(msg);
-        return status;
-    }
+    return backend_resp_bulk(msg, p, (uint32_t)(buf + sizeof(buf) - p));
+}
 
-    if ((status = msg_copy_char(msg, pexipire_finish,
-                                sizeof(pexipire_finish) - 1))
-        != NC_OK) {
+/**.......................................................................
+ * Queue a hidden write, whose replies nobody waits for, on a frontend
+ * server connection.
+ *
+ * A write queued behind another one which is still waiting to be sent
+ * is joined to it, so that the cache fills and expirations of an event
+ * loop tick go out to each frontend server as one pipelined request,
+ * which takes a single place in the connection's queues.  The replies
+ * to a batch of writes are swallowed by process_frontend_rsp, all but
+ * the last one.
+ */
+static void
+backend_frontend_write(struct context *ctx, struct conn* s_conn,
+                       struct msg* msg)
+{
+    struct msg* bmsg = TAILQ_LAST(&s_conn->imsg_q, msg_tqh);
+    struct mbuf* mbuf;
+
+    ASSERT(msg->swallow);
+
+    if (bmsg != NULL && bmsg->nbatch > 0 &&
+        bmsg->nbatch < BACKEND_WRITE_BATCH_MAX) {
+        while ((mbuf = STAILQ_FIRST(&msg->mhdr)) != NULL) {
+            mbuf_remove(&msg->mhdr, mbuf);
+            mbuf_insert(&bmsg->mhdr, mbuf);
+        }
+        bmsg->mlen += msg->mlen;
+        bmsg->nbatch++;
+
+        /* bmsg was accounted for as it was when queued */
+        stats_server_incr_by(ctx, s_conn->owner, in_queue_bytes, msg->mlen);
+        stats_pool_incr(ctx, ((struct server*)s_conn->owner)->owner,
+                        frontend_batched);
+
+        msg->mlen = 0;
         msg_put(msg);
-        return status;
+        return;
     }
 
-    msg->swallow = 1;
-    msg->type = MSG_REQ_HIDDEN;
+    msg->nbatch = 1;
 
     if (TAILQ_EMPTY(&s_conn->imsg_q)) {
         event_add_out(ctx->evb, s_conn);
@@ -569,147 +847,492 @@ add_pexpire_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
 
     s_conn->enqueue_inq(ctx, s_conn, msg);
     s_conn->need_auth = 0;
-
-    return NC_OK;
 }
 
 /**.......................................................................
- * Function to add a SET message to the server's queue, with explicit
- * keyname and keyval pos
+ * Function to add a PEXPIRE message to the server's queue, with explicit
+ * keyname and expiration time
  */
 rstatus_t
-add_set_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
-                struct msg_pos* keyval_start_pos, uint32_t keyvallen)
+add_pexpire_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
+                    uint32_t keynamelen, uint32_t timeout)
 {
-    uint32_t keynamelen = (uint32_t)strlen(keyname);
+    static const char pexpire[] = "*3\r\n$7\r\npexpire\r\n";
     struct conn* s_conn = server_pool_conn_frontend(ctx, c_conn->owner,
                                                     (uint8_t*)keyname,
-                                                    keynamelen, NULL);
-
-    ASSERT(!s_conn->client && !s_conn->proxy);
-
-    struct server* server = (struct server*)s_conn->owner;
-    struct server_pool* pool = (struct server_pool*)server->owner;
-
-    /* TTL portion */
-    uint32_t ttlfmtlen = 1;
-    uint32_t ttlndig = 0;
-    bool use_ttl = false;
-    uint32_t ttl_ms = 0;
-
-    ProtobufCBinaryData datatype;
-    ProtobufCBinaryData bucket;
-    ProtobufCBinaryData key;
-    nc_split_key_string((uint8_t*) keyname, keynamelen, &datatype, &bucket, &key);
-    int64_t sl_ttl_ms = server_pool_bucket_ttl(pool,
-                                               datatype.data,
-                                               (uint32_t)datatype.len,
-                                               bucket.data,
-                                               (uint32_t)bucket.len);
+                                                    keynamelen,
+                                                    NULL);
+    struct msg* msg;
+    rstatus_t status;
 
-    if (sl_ttl_ms > 0) {
-        use_ttl = true;
-        ttl_ms = (uint32_t)sl_ttl_ms;
-        ttlndig = ndig(ttl_ms); /* Number of digits in ttl_ms (length of the number we will write) */
-        ttlfmtlen = ndig(ttlndig) + 1; /* Number of digits in ttlndig (length of the formatted ttlndig) */
+    msg = msg_get(c_conn, true);
+    if (msg == NULL) {
+        c_conn->err = errno;
+        return NC_ENOMEM;
     }
 
-    uint32_t ttlstrlen = ttlfmtlen + ttlndig + 12;
-    char ttlstr[ttlstrlen + 1];
-
-    if (use_ttl) {
-        sprintf(ttlstr, "$2\r\npx\r\n$%d\r\n%u\r\n", ttlndig, ttl_ms);
+    if ((status = msg_copy_char(msg, (char*)pexpire, sizeof(pexpire) - 1)) != NC_OK ||
+        (status = backend_resp_bulk(msg, keyname, keynamelen)) != NC_OK ||
+        (status = backend_resp_uint(msg, timeout)) != NC_OK) {
+        msg_put(msg);
+        return status;
     }
 
-    ASSERT(strlen(ttlstr) == ttlstrlen);
+    msg->swallow = 1;
+    msg->type = MSG_REQ_HIDDEN;
+
+    backend_frontend_write(ctx, s_conn, msg);
 
-    /* Key portion */
-    uint32_t keynamendig = ndig(keynamelen);
-    uint32_t keynamefmtlen = keynamendig + 1;
-    uint32_t keynamestrlen = keynamefmtlen + keynamelen + 4;
-    char keynamestr[keynamestrlen + 1];
-    sprintf(keynamestr, "$%d\r\n%s\r\n", keynamelen, keyname);
+    /* the value the proxy holds goes with the frontend one */
+    l1_cache_del(((struct server_pool*)c_conn->owner)->l1_cache,
+                 (uint8_t*)keyname, keynamelen);
 
-    ASSERT(strlen(keynamestr) == keynamestrlen);
+    return NC_OK;
+}
 
-    /* Value portion */
-    uint32_t keyvalndig = ndig(keyvallen);
-    uint32_t keyvalfmtlen = keyvalndig + 1;
-    uint32_t keyvalstrlen = keyvalfmtlen + 2;
-    char keyvalstr[keyvalstrlen + 1];
+/*
+ * Sets of more members than this are written to a frontend server in
+ * chunks of as many members
+ */
+#define BACKEND_SET_FILL_CHUNK  1024
 
-    sprintf(keyvalstr, "$%d\r\n", keyvallen);
+/* suffix of the scratch key a large set is written to */
+#define BACKEND_SET_FILL_SUFFIX "\0nc_fill:"
 
-    ASSERT(strlen(keyvalstr) == keyvalstrlen);
+/**.......................................................................
+ * Queue a hidden command of two arguments on the frontend server of a
+ * set fill
+ */
+static rstatus_t
+backend_set_fill_cmd(struct backend_set_fill* fill, const char* cmd,
+                     const uint8_t* arg1, uint32_t arg1len,
+                     const uint8_t* arg2, uint32_t arg2len)
+{
+    struct msg* msg;
+    rstatus_t status;
 
-    struct msg* msg = msg_get(c_conn, true);
+    msg = msg_get(fill->c_conn, true);
     if (msg == NULL) {
-        c_conn->err = errno;
+        fill->c_conn->err = errno;
         return NC_ENOMEM;
     }
 
-    rstatus_t status = NC_OK;
-    if (use_ttl) {
-        if ((status = msg_copy_char(msg, "*5\r\n$3\r\nset\r\n",
-                                    strlen("*5\r\n$3\r\nset\r\n")))
-            != NC_OK) {
-            msg_put(msg);
-            return status;
-        }
-    } else {
-        if ((status = msg_copy_char(msg, "*3\r\n$3\r\nset\r\n",
-                                    strlen("*3\r\n$3\r\nset\r\n")))
-            != NC_OK) {
-            msg_put(msg);
-            return status;
-        }
-    }
-
-    if ((status = msg_copy_char(msg, keynamestr, strlen(keynamestr))) != NC_OK) {
-        msg_put(msg);
-        return status;
-    }
-
-    if ((status = msg_copy_char(msg, keyvalstr, strlen(keyvalstr))) != NC_OK) {
-        msg_put(msg);
-        return status;
-    }
-
-    if ((status = msg_copy_from_pos(msg, keyval_start_pos, keyvallen)) != NC_OK) {
-        msg_put(msg);
-        return status;
-    }
-
-    if ((status = msg_copy_char(msg, "\r\n", 2)) != NC_OK) {
+    if ((status = backend_resp_hdr(msg, '*', 3)) != NC_OK ||
+        (status = backend_resp_bulk(msg, cmd, (uint32_t)strlen(cmd))) != NC_OK ||
+        (status = backend_resp_bulk(msg, arg1, arg1len)) != NC_OK ||
+        (status = backend_resp_bulk(msg, arg2, arg2len)) != NC_OK) {
         msg_put(msg);
         return status;
     }
 
-    if (use_ttl) {
-        if ((status = msg_copy_char(msg, ttlstr, strlen(ttlstr))) != NC_OK) {
-            msg_put(msg);
-            return status;
-        }
-    }
-
     msg->swallow = 1;
+    msg->type = MSG_REQ_HIDDEN;
 
-    if (TAILQ_EMPTY(&s_conn->imsg_q)) {
-        status = event_add_out(ctx->evb, s_conn);
-    }
-
-    s_conn->enqueue_inq(ctx, s_conn, msg);
-    s_conn->need_auth = 0;
+    backend_frontend_write(fill->ctx, fill->s_conn, msg);
 
     return NC_OK;
 }
 
 /**.......................................................................
- * Forward a server response back to the client that originated the
- * request.
+ * Start writing a set of nval members, read from the backend, to the
+ * frontend server of its key, to expire in ttl msec.
  *
- * Returns true if the response was forwarded
- *         false if the response was swallowed instead
+ * The members are added one by one with backend_set_fill_add, and
+ * written out a chunk of BACKEND_SET_FILL_CHUNK members per SADD, so
+ * that no more than a chunk of them is held at a time.  A set of more
+ * than one chunk is written to a scratch key on the same server, which
+ * expires with the set and is renamed to the key once complete, so that
+ * the set is never seen half written.
+ */
+void
+backend_set_fill_init(struct backend_set_fill* fill, struct context *ctx,
+                      struct conn* c_conn, uint8_t* key, uint32_t keylen,
+                      uint32_t nval, int64_t ttl)
+{
+    static uint64_t nfill;    /* # sets filled through a scratch key */
+    const size_t suffixlen = sizeof(BACKEND_SET_FILL_SUFFIX) - 1;
+
+    fill->ctx = ctx;
+    fill->c_conn = c_conn;
+    fill->s_conn = NULL;
+    fill->key = key;
+    fill->keylen = keylen;
+    fill->dst = key;
+    fill->dstlen = keylen;
+    fill->ttl = ttl;
+    fill->msg = NULL;
+    fill->left = nval;
+    fill->nmsg = 0;
+    fill->nchunk = 0;
+
+    if (nval == 0) {
+        return;
+    }
+
+    if (nval > BACKEND_SET_FILL_CHUNK) {
+        fill->dst = arena_alloc(keylen + suffixlen + NC_UINT64_MAXLEN);
+        if (fill->dst == NULL) {
+            return;
+        }
+        nc_memcpy(fill->dst, key, keylen);
+        nc_memcpy(fill->dst + keylen, BACKEND_SET_FILL_SUFFIX, suffixlen);
+        fill->dstlen = keylen + (uint32_t)suffixlen +
+                       (uint32_t)nc_snprintf(fill->dst + keylen + suffixlen,
+                                             NC_UINT64_MAXLEN, "%"PRIu64,
+                                             ++nfill);
+    }
+
+    fill->s_conn = server_pool_conn_frontend(ctx, c_conn->owner, key, keylen,
+                                             NULL);
+}
+
+/**.......................................................................
+ * Add the next member to a set fill.  A fill which fails is given up,
+ * and the set is left to the next read.
+ */
+void
+backend_set_fill_add(struct backend_set_fill* fill,
+                     const ProtobufCBinaryData* member)
+{
+    static const char sadd[] = "$4\r\nsadd\r\n";
+    struct msg* msg = fill->msg;
+    uint8_t ttl[1 + NC_UINT64_MAXLEN];
+    int ttllen;
+
+    if (fill->s_conn == NULL || fill->left == 0) {
+        return;
+    }
+
+    if (msg == NULL) {
+        fill->nmsg = MIN(fill->left, BACKEND_SET_FILL_CHUNK);
+
+        msg = msg_get(fill->c_conn, true);
+        if (msg == NULL) {
+            fill->c_conn->err = errno;
+            fill->s_conn = NULL;
+            return;
+        }
+        fill->msg = msg;
+
+        if (backend_resp_hdr(msg, '*', 2 + fill->nmsg) != NC_OK ||
+            msg_copy_char(msg, (char*)sadd, sizeof(sadd) - 1) != NC_OK ||
+            backend_resp_bulk(msg, fill->dst, fill->dstlen) != NC_OK) {
+            goto error;
+        }
+    }
+
+    if (backend_resp_bulk(msg, member->data, (uint32_t)member->len) != NC_OK) {
+        goto error;
+    }
+    fill->left--;
+
+    if (--fill->nmsg > 0) {
+        return;
+    }
+
+    msg->swallow = 1;
+    msg->type = MSG_REQ_HIDDEN;
+    backend_frontend_write(fill->ctx, fill->s_conn, msg);
+    fill->msg = NULL;
+
+    /* the scratch key of a fill which does not complete expires */
+    if (fill->dst != fill->key && fill->nchunk++ == 0) {
+        ttllen = nc_snprintf(ttl, sizeof(ttl), "%"PRId64, fill->ttl);
+        if (backend_set_fill_cmd(fill, "pexpire", fill->dst, fill->dstlen,
+                                 ttl, (uint32_t)ttllen) != NC_OK) {
+            fill->s_conn = NULL;
+        }
+    }
+    return;
+
+error:
+    msg_put(msg);
+    fill->msg = NULL;
+    fill->s_conn = NULL;
+}
+
+/**.......................................................................
+ * Complete a set fill once all of its members are added, renaming its
+ * scratch key to the key, and setting the expiry of the set
+ */
+void
+backend_set_fill_done(struct backend_set_fill* fill)
+{
+    if (fill->msg != NULL) {
+        msg_put(fill->msg);
+        fill->msg = NULL;
+    }
+
+    if (fill->s_conn == NULL || fill->left > 0) {
+        return;
+    }
+
+    if (fill->dst != fill->key &&
+        backend_set_fill_cmd(fill, "rename", fill->dst, fill->dstlen,
+                             fill->key, fill->keylen) != NC_OK) {
+        return;
+    }
+
+    add_pexpire_msg_key(fill->ctx, fill->c_conn, (char*)fill->key,
+                        fill->keylen, (uint32_t)fill->ttl);
+}
+
+/**.......................................................................
+ * Return the expiry in msec of a key's bucket, and the frontend server
+ * connection of the key
+ */
+static int64_t
+add_set_msg_ttl(struct context *ctx, struct conn* c_conn, char* keyname,
+                uint32_t keynamelen, struct conn** s_conn)
+{
+    *s_conn = server_pool_conn_frontend(ctx, c_conn->owner,
+                                        (uint8_t*)keyname, keynamelen, NULL);
+
+    ASSERT(!(*s_conn)->client && !(*s_conn)->proxy);
+
+    struct server* server = (struct server*)(*s_conn)->owner;
+    struct server_pool* pool = (struct server_pool*)server->owner;
+
+    ProtobufCBinaryData datatype;
+    ProtobufCBinaryData bucket;
+    ProtobufCBinaryData key;
+    nc_split_key_string((uint8_t*) keyname, keynamelen, &datatype, &bucket, &key);
+    return server_pool_bucket_ttl(pool,
+                                  datatype.data,
+                                  (uint32_t)datatype.len,
+                                  bucket.data,
+                                  (uint32_t)bucket.len);
+}
+
+/**.......................................................................
+ * Start a SET message of a key, up to the header of a value of keyvallen
+ * bytes, for the caller to copy the value to and finish with
+ * add_set_msg_done
+ */
+rstatus_t
+add_set_msg_start(struct context *ctx, struct conn* c_conn, char* keyname,
+                  uint32_t keyvallen, struct msg** pmsg)
+{
+    static const char set_px[] = "*5\r\n$3\r\nset\r\n";
+    static const char set[] = "*3\r\n$3\r\nset\r\n";
+    uint32_t keynamelen = (uint32_t)strlen(keyname);
+    struct conn* s_conn;
+    int64_t ttl_ms = add_set_msg_ttl(ctx, c_conn, keyname, keynamelen, &s_conn);
+
+    struct msg* msg = msg_get(c_conn, true);
+    if (msg == NULL) {
+        c_conn->err = errno;
+        return NC_ENOMEM;
+    }
+
+    rstatus_t status = NC_OK;
+    if (ttl_ms > 0) {
+        status = msg_copy_char(msg, (char*)set_px, sizeof(set_px) - 1);
+    } else {
+        status = msg_copy_char(msg, (char*)set, sizeof(set) - 1);
+    }
+
+    if (status != NC_OK ||
+        (status = backend_resp_bulk(msg, keyname, keynamelen)) != NC_OK ||
+        (status = backend_resp_hdr(msg, '$', keyvallen)) != NC_OK) {
+        msg_put(msg);
+        return status;
+    }
+
+    *pmsg = msg;
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Finish a SET message started by add_set_msg_start, its value copied,
+ * and add it to the server's queue
+ */
+rstatus_t
+add_set_msg_done(struct context *ctx, struct conn* c_conn, char* keyname,
+                 struct msg* msg)
+{
+    static const char px[] = "$2\r\npx\r\n";
+    uint32_t keynamelen = (uint32_t)strlen(keyname);
+    struct conn* s_conn;
+    int64_t ttl_ms = add_set_msg_ttl(ctx, c_conn, keyname, keynamelen, &s_conn);
+    rstatus_t status;
+
+    if ((status = msg_copy_char(msg, CRLF, CRLF_LEN)) != NC_OK) {
+        msg_put(msg);
+        return status;
+    }
+
+    if (ttl_ms > 0) {
+        if ((status = msg_copy_char(msg, (char*)px, sizeof(px) - 1)) != NC_OK ||
+            (status = backend_resp_uint(msg, (uint64_t)ttl_ms)) != NC_OK) {
+            msg_put(msg);
+            return status;
+        }
+    }
+
+    msg->swallow = 1;
+
+    backend_frontend_write(ctx, s_conn, msg);
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Function to add a SET message to the server's queue, with explicit
+ * keyname and keyval pos.  The value is shared with, not copied from,
+ * the message it is read from
+ */
+rstatus_t
+add_set_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
+                struct msg_pos* keyval_start_pos, uint32_t keyvallen)
+{
+    struct msg* msg;
+    rstatus_t status;
+
+    if ((status = add_set_msg_start(ctx, c_conn, keyname, keyvallen, &msg))
+        != NC_OK) {
+        return status;
+    }
+
+    if ((status = msg_share_from_pos(msg, keyval_start_pos, keyvallen)) != NC_OK) {
+        msg_put(msg);
+        return status;
+    }
+
+    return add_set_msg_done(ctx, c_conn, keyname, msg);
+}
+
+/**.......................................................................
+ * Append the frontend key of the not-found marker of a key to a message,
+ * as a RESP bulk string
+ */
+static rstatus_t
+backend_resp_nil_key(struct msg* msg, const void* key, uint32_t keylen)
+{
+    rstatus_t status;
+
+    if ((status = backend_resp_hdr(msg, '$',
+                                   BACKEND_NIL_PREFIX_LEN + keylen)) != NC_OK ||
+        (status = msg_copy_char(msg, BACKEND_NIL_PREFIX,
+                                BACKEND_NIL_PREFIX_LEN)) != NC_OK ||
+        (status = msg_copy(msg, (uint8_t*)key, keylen)) != NC_OK) {
+        return status;
+    }
+
+    return msg_copy_char(msg, CRLF, CRLF_LEN);
+}
+
+/**.......................................................................
+ * Function to add a hidden write of a key's not-found marker to the
+ * queue of the key's frontend server: the marker is set, with explicit
+ * expiration time, or deleted if ttl_ms is 0.  Setting the marker also
+ * deletes any value the frontend still holds for the key, eg. one being
+ * refreshed from the backend
+ */
+static rstatus_t
+backend_nil_marker_write(struct context *ctx, struct conn* c_conn,
+                         char* keyname, uint32_t keynamelen, int64_t ttl_ms)
+{
+    static const char set_px[] = "*5\r\n$3\r\nset\r\n";
+    static const char one[] = "$1\r\n1\r\n";
+    static const char px[] = "$2\r\npx\r\n";
+    static const char del[] = "*2\r\n$3\r\ndel\r\n";
+    rstatus_t status;
+    struct conn* s_conn = server_pool_conn_frontend(ctx, c_conn->owner,
+                                                    (uint8_t*)keyname,
+                                                    keynamelen, NULL);
+    struct msg* msg;
+
+    if (s_conn == NULL) {
+        return NC_ERROR;
+    }
+
+    if (ttl_ms > 0) {
+        msg = msg_get(c_conn, true);
+        if (msg == NULL) {
+            c_conn->err = errno;
+            return NC_ENOMEM;
+        }
+
+        if ((status = msg_copy_char(msg, (char*)del, sizeof(del) - 1)) != NC_OK ||
+            (status = backend_resp_bulk(msg, keyname, keynamelen)) != NC_OK) {
+            msg_put(msg);
+            return status;
+        }
+
+        msg->swallow = 1;
+        msg->type = MSG_REQ_HIDDEN;
+        backend_frontend_write(ctx, s_conn, msg);
+    }
+
+    msg = msg_get(c_conn, true);
+    if (msg == NULL) {
+        c_conn->err = errno;
+        return NC_ENOMEM;
+    }
+
+    if (ttl_ms > 0) {
+        if ((status = msg_copy_char(msg, (char*)set_px, sizeof(set_px) - 1)) != NC_OK ||
+            (status = backend_resp_nil_key(msg, keyname, keynamelen)) != NC_OK ||
+            (status = msg_copy_char(msg, (char*)one, sizeof(one) - 1)) != NC_OK ||
+            (status = msg_copy_char(msg, (char*)px, sizeof(px) - 1)) != NC_OK ||
+            (status = backend_resp_uint(msg, (uint64_t)ttl_ms)) != NC_OK) {
+            msg_put(msg);
+            return status;
+        }
+    } else {
+        if ((status = msg_copy_char(msg, (char*)del, sizeof(del) - 1)) != NC_OK ||
+            (status = backend_resp_nil_key(msg, keyname, keynamelen)) != NC_OK) {
+            msg_put(msg);
+            return status;
+        }
+    }
+
+    msg->swallow = 1;
+    msg->type = MSG_REQ_HIDDEN;
+
+    backend_frontend_write(ctx, s_conn, msg);
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Function to add a SET of the not-found marker of a key to the server's
+ * queue, with explicit keyname and expiration time
+ */
+rstatus_t
+add_nil_marker_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
+                       uint32_t keynamelen, int64_t ttl_ms)
+{
+    ASSERT(ttl_ms > 0);
+
+    return backend_nil_marker_write(ctx, c_conn, keyname, keynamelen, ttl_ms);
+}
+
+/**.......................................................................
+ * Function to add a DEL of the not-found marker of a key to the server's
+ * queue, with explicit keyname, as the key is written; keys of buckets
+ * without a negative_ttl have no marker
+ */
+rstatus_t
+del_nil_marker_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
+                       uint32_t keynamelen)
+{
+    if (backend_key_prop(c_conn->owner, (uint8_t*)keyname, keynamelen,
+                         server_pool_bucket_negative_ttl) <= 0) {
+        return NC_OK;
+    }
+
+    return backend_nil_marker_write(ctx, c_conn, keyname, keynamelen, 0);
+}
+
+/**.......................................................................
+ * Forward a server response back to the client that originated the
+ * request.
+ *
+ * Returns true if the response was forwarded
+ *         false if the response was swallowed instead
  */
 bool
 forward_response(struct context *ctx, struct conn* c_conn, struct conn* s_conn,
@@ -796,3 +1419,2472 @@ get_next_backend_server(struct msg* msg, struct conn* c_conn, uint8_t* key,
 
     return server;
 }
+
+/**.......................................................................
+ * Return the slot of the pool's backend miss queue for a key
+ */
+static struct msg_tqh *
+backend_missq(struct server_pool* pool, uint8_t* key, uint32_t keylen)
+{
+    uint32_t hash = pool->key_hash((char *)key, keylen);
+    return &pool->backend_missq[hash % SERVER_POOL_MISSQ_NSLOT];
+}
+
+/**.......................................................................
+ * Return the request in flight to the backend for a key, if any
+ */
+static struct msg *
+backend_miss_find(struct server_pool* pool, uint8_t* key, uint32_t keylen)
+{
+    struct msg* lmsg;
+
+    TAILQ_FOREACH(lmsg, backend_missq(pool, key, keylen), b_tqe) {
+        if (lmsg->miss_key.len == keylen &&
+            memcmp(lmsg->miss_key.data, key, keylen) == 0) {
+            return lmsg;
+        }
+    }
+
+    return NULL;
+}
+
+/**.......................................................................
+ * Enter a request in the pool's backend miss queue, so that later misses
+ * for its key wait on it
+ */
+static rstatus_t
+backend_miss_add(struct server_pool* pool, struct msg* pmsg, uint8_t* key,
+                 uint32_t keylen)
+{
+    rstatus_t status;
+
+    ASSERT(pmsg->miss_q == NULL);
+
+    /* the key is copied, as remapping the request rewrites its mbufs */
+    status = string_copy(&pmsg->miss_key, key, keylen);
+    if (status != NC_OK) {
+        return status;
+    }
+
+    pmsg->miss_q = backend_missq(pool, key, keylen);
+    TAILQ_INSERT_TAIL(pmsg->miss_q, pmsg, b_tqe);
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Register a cache miss which is about to be resent to the backend.
+ *
+ * If a request for the same key is already in flight to the backend,
+ * the request is queued to be answered from that request's response
+ * instead of being resent, and true is returned.  Otherwise the request
+ * is entered in the pool's backend miss queue so that later misses for
+ * the same key can wait on it, and false is returned.
+ */
+bool
+backend_miss_join(struct context *ctx, struct msg* pmsg)
+{
+    struct server_pool* pool;
+    struct keypos* kpos;
+    struct msg* lmsg;
+    uint32_t keylen;
+
+    ASSERT(pmsg->request && !pmsg->done);
+    ASSERT(pmsg->miss_q == NULL);
+
+    if (pmsg->type != MSG_REQ_REDIS_GET || pmsg->swallow ||
+        array_n(pmsg->keys) == 0) {
+        return false;
+    }
+
+    pool = pmsg->owner->owner;
+    kpos = array_get(pmsg->keys, 0);
+    keylen = (uint32_t)(kpos->end - kpos->start);
+
+    lmsg = backend_miss_find(pool, kpos->start, keylen);
+    if (lmsg != NULL) {
+        TAILQ_INSERT_TAIL(&lmsg->miss_waitq, pmsg, b_tqe);
+        stats_pool_incr(ctx, pool, miss_coalesced);
+
+        log_debug(LOG_VERB, "req %"PRIu64" waits for backend miss of "
+                  "req %"PRIu64"", pmsg->id, lmsg->id);
+        return true;
+    }
+
+    backend_miss_add(pool, pmsg, kpos->start, keylen);
+
+    return false;
+}
+
+/**.......................................................................
+ * Copy a backend response for a request which waited on its cache miss
+ */
+static struct msg *
+backend_miss_rsp(struct msg* rsp)
+{
+    struct msg* msg;
+    struct mbuf* mbuf;
+
+    msg = msg_get(rsp->owner, false);
+    if (msg == NULL) {
+        return NULL;
+    }
+
+    STAILQ_FOREACH(mbuf, &rsp->mhdr, next) {
+        if (msg_copy(msg, mbuf->pos, mbuf_length(mbuf)) != NC_OK) {
+            msg_put(msg);
+            return NULL;
+        }
+    }
+    msg->type = rsp->type;
+
+    return msg;
+}
+
+/**.......................................................................
+ * Remove a request from the pool's backend miss queue once its response
+ * is final, and answer the requests waiting on it with a copy of the
+ * response.  A NULL response completes the waiting requests with the
+ * request's error.
+ *
+ * A no-op for requests not in the backend miss queue.
+ */
+void
+backend_miss_done(struct msg* pmsg, struct msg* rsp)
+{
+    struct msg* wmsg;
+    struct msg* msg;
+    struct conn* c_conn;
+
+    if (pmsg->miss_q == NULL) {
+        return;
+    }
+
+    TAILQ_REMOVE(pmsg->miss_q, pmsg, b_tqe);
+    pmsg->miss_q = NULL;
+    string_deinit(&pmsg->miss_key);
+
+    while (!TAILQ_EMPTY(&pmsg->miss_waitq)) {
+        wmsg = TAILQ_FIRST(&pmsg->miss_waitq);
+        TAILQ_REMOVE(&pmsg->miss_waitq, wmsg, b_tqe);
+
+        ASSERT(wmsg->request && !wmsg->done);
+
+        /* a key missing from an mget fragment, see backend_fill_mget */
+        if (wmsg->fill_owner != NULL) {
+            backend_fill_waited(wmsg, rsp);
+            continue;
+        }
+
+        /* the client closed its connection while waiting */
+        if (wmsg->swallow) {
+            req_put(wmsg);
+            continue;
+        }
+
+        c_conn = wmsg->owner;
+        ASSERT(c_conn->client && !c_conn->proxy);
+
+        msg = (rsp != NULL) ? backend_miss_rsp(rsp) : NULL;
+        if (msg == NULL) {
+            wmsg->error = 1;
+            wmsg->err = (rsp != NULL) ? errno : pmsg->err;
+        } else {
+            msg->peer = wmsg;
+            wmsg->peer = msg;
+        }
+        req_mark_done(wmsg);
+
+        if (req_done(c_conn, TAILQ_FIRST(&c_conn->omsg_q))) {
+            struct context *ctx = conn_to_ctx(c_conn);
+            if (event_add_out(ctx->evb, c_conn) != NC_OK) {
+                c_conn->err = errno;
+            }
+        }
+    }
+}
+
+/**.......................................................................
+ * Build a hidden read of a key, with the one-argument command cmd of
+ * type, to be remapped for the backend
+ */
+static struct msg *
+backend_read_msg(struct conn* c_conn, msg_type_t type, const char* cmd,
+                 uint8_t* key, uint32_t keylen)
+{
+    const char read_proto[] = "*2\r\n$%u\r\n%s\r\n$%u\r\n";
+    uint32_t cmdlen = (uint32_t)strlen(cmd);
+    char read[sizeof(read_proto) + ndig(cmdlen) + cmdlen + ndig(keylen)];
+    uint32_t readlen = (uint32_t)sprintf(read, read_proto, cmdlen, cmd,
+                                         keylen);
+    struct msg* msg;
+
+    msg = msg_get(c_conn, true);
+    if (msg == NULL) {
+        c_conn->err = errno;
+        return NULL;
+    }
+
+    if (msg_copy_char(msg, read, readlen) != NC_OK ||
+        msg_copy(msg, key, keylen) != NC_OK ||
+        msg_copy_char(msg, CRLF, CRLF_LEN) != NC_OK) {
+        msg_put(msg);
+        return NULL;
+    }
+    msg->type = type;
+    msg->pos = STAILQ_FIRST(&msg->mhdr)->pos;
+    msg->l1_seq = l1_cache_seq(((struct server_pool*)c_conn->owner)->l1_cache);
+
+    return msg;
+}
+
+/**.......................................................................
+ * Build a hidden GET of a key, to be remapped for the backend
+ */
+static struct msg *
+backend_get_msg(struct conn* c_conn, uint8_t* key, uint32_t keylen)
+{
+    return backend_read_msg(c_conn, MSG_REQ_REDIS_GET, "get", key, keylen);
+}
+
+/**.......................................................................
+ * Read the keys an mget fragment missed in the frontend server through
+ * from the backend.
+ *
+ * Each missing key is sent to the backend as a GET of its own, routed
+ * to the key's coordinator, so that the reads for all the keys of the
+ * mget go out together.  The fragment is held back, with its frontend
+ * response, until the last of those reads is answered.  Keys with a
+ * not-found marker, looked up first by backend_nil_lookup, are not read,
+ * but answered with nil.
+ *
+ * The reads join the pool's backend miss queue as GET misses do: a key
+ * already in flight to the backend is answered from that read instead,
+ * and later misses of a key wait on the fragment's read.  A read the
+ * backend does not find the key for is resent to the other backend
+ * servers, up to backend_max_resend, see backend_fill_resend.
+ *
+ * Returns true if the frontend response was taken over, false if it
+ * should be forwarded as is
+ */
+static bool
+backend_fill_mget(struct context *ctx, struct conn *s_conn, struct msg* pmsg,
+                  struct msg* msg)
+{
+    uint32_t nkey = array_n(pmsg->keys);
+
+    if (nkey == 0) {
+        return false;
+    }
+
+    pmsg->fill_kind = nc_alloc(nkey);
+    if (pmsg->fill_kind == NULL) {
+        return false;
+    }
+
+    if (redis_multibulk_scan(msg, pmsg->fill_kind, nkey, NULL, 0) <= 0) {
+        nc_free(pmsg->fill_kind);
+        pmsg->fill_kind = NULL;
+        return false;
+    }
+
+    pmsg->fill_msgs = nc_zalloc(nkey * sizeof(*pmsg->fill_msgs));
+    if (pmsg->fill_msgs == NULL) {
+        nc_free(pmsg->fill_kind);
+        pmsg->fill_kind = NULL;
+        return false;
+    }
+
+    /* the fragment leaves the frontend server, but is not done yet */
+    server_ok(ctx, s_conn);
+    s_conn->dequeue_outq(ctx, s_conn, pmsg);
+    pmsg->fill_rsp = msg;
+    pmsg->nsubs = 0;
+
+    if (!backend_nil_lookup(ctx, s_conn, pmsg)) {
+        backend_fill_read(ctx, pmsg);
+    }
+
+    return true;
+}
+
+/**.......................................................................
+ * Send the backend reads of the keys an mget fragment missed in the
+ * frontend server, see backend_fill_mget
+ */
+static void
+backend_fill_read(struct context *ctx, struct msg* pmsg)
+{
+    struct conn* c_conn = pmsg->owner;
+    struct server_pool* pool = c_conn->owner;
+    uint32_t nkey = array_n(pmsg->keys);
+    uint32_t i;
+
+    for (i = 0; i < nkey; i++) {
+        struct keypos* kpos;
+        struct server* server;
+        struct conn* b_conn;
+        struct msg* lmsg;
+        struct msg* sub;
+        uint32_t keylen;
+
+        /* keys known to be missing from the backend are not read */
+        if (pmsg->fill_kind[i] != REDIS_BULK_NIL) {
+            continue;
+        }
+
+        kpos = array_get(pmsg->keys, i);
+        keylen = (uint32_t)(kpos->end - kpos->start);
+
+        /* the key waits on its read already in flight */
+        lmsg = backend_miss_find(pool, kpos->start, keylen);
+        if (lmsg != NULL) {
+            sub = msg_get(c_conn, true);
+            if (sub == NULL) {
+                break;
+            }
+            sub->type = MSG_REQ_REDIS_GET;
+            sub->swallow = 1;
+            sub->fill_owner = pmsg;
+            sub->fill_idx = i;
+            pmsg->nsubs++;
+
+            TAILQ_INSERT_TAIL(&lmsg->miss_waitq, sub, b_tqe);
+            stats_pool_incr(ctx, pool, miss_coalesced);
+            continue;
+        }
+
+        sub = backend_get_msg(c_conn, kpos->start, keylen);
+        if (sub == NULL) {
+            break;
+        }
+
+        server = get_next_backend_server(sub, c_conn, kpos->start, keylen);
+        b_conn = server_pool_conn_backend(ctx, pool, kpos->start, keylen,
+                                          server);
+        if (b_conn == NULL) {
+            msg_put(sub);
+            continue;
+        }
+
+        /* keys the backend cannot serve, eg. without a bucket, stay nil */
+        if (b_conn->req_remap(b_conn, sub) != NC_OK) {
+            msg_put(sub);
+            continue;
+        }
+
+        backend_miss_add(pool, sub, kpos->start, keylen);
+
+        sub->swallow = 1;
+        sub->fill_owner = pmsg;
+        sub->fill_idx = i;
+        pmsg->nsubs++;
+
+        if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+            event_add_out(ctx->evb, b_conn);
+        }
+
+        b_conn->enqueue_inq(ctx, b_conn, sub);
+        b_conn->need_auth = 0;
+
+        stats_pool_incr(ctx, pool, mget_fills);
+    }
+
+    if (pmsg->nsubs == 0) {
+        backend_fill_complete(pmsg);
+    }
+}
+
+/**.......................................................................
+ * Account for a backend read of a key missing from an mget fragment,
+ * completing the fragment once all of its reads are in.  The read is
+ * kept until then if it has a response, ie. found a value.
+ *
+ * A no-op for requests which are not such a read.
+ */
+void
+backend_fill_done(struct msg* sub)
+{
+    struct msg* pmsg = sub->fill_owner;
+
+    if (pmsg == NULL) {
+        return;
+    }
+    sub->fill_owner = NULL;
+
+    if (sub->peer != NULL) {
+        pmsg->fill_msgs[sub->fill_idx] = sub;
+    }
+
+    ASSERT(pmsg->nsubs > 0);
+    if (--pmsg->nsubs == 0) {
+        if (backend_set_op(pmsg)) {
+            backend_sets_complete(pmsg);
+        } else {
+            backend_fill_complete(pmsg);
+        }
+    }
+}
+
+/**.......................................................................
+ * Answer a read of a key missing from an mget fragment which waited on
+ * another read of the key, with rsp, the response to that read, or NULL
+ * if it failed.  As for a read of its own, the key is filled only with
+ * a value found; it stays nil otherwise
+ */
+static void
+backend_fill_waited(struct msg* sub, struct msg* rsp)
+{
+    struct msg* msg = NULL;
+
+    if (rsp != NULL && rsp->type == MSG_RSP_REDIS_BULK && !msg_nil(rsp)) {
+        msg = backend_miss_rsp(rsp);
+    }
+
+    if (msg == NULL) {
+        req_put(sub);
+        return;
+    }
+
+    msg->peer = sub;
+    sub->peer = msg;
+    sub->done = 1;
+
+    backend_fill_done(sub);
+}
+
+/**.......................................................................
+ * Resend a read of a key missing from an mget fragment, which the
+ * backend answered with msg, not found, to the next backend server in
+ * its resend queue, as a GET miss is resent.  The read stays in the
+ * backend miss queue meanwhile
+ */
+static void
+backend_fill_resend(struct context *ctx, struct msg* sub, struct msg* msg)
+{
+    struct conn* c_conn = sub->owner;
+    struct server_pool* pool = c_conn->owner;
+    struct keypos* kpos = array_get(sub->fill_owner->keys, sub->fill_idx);
+    uint32_t keylen = (uint32_t)(kpos->end - kpos->start);
+    struct server* server;
+    struct conn* b_conn;
+
+    server = get_next_backend_server(sub, c_conn, kpos->start, keylen);
+    b_conn = server_pool_conn_backend(ctx, pool, kpos->start, keylen, server);
+    if (b_conn == NULL) {
+        backend_miss_done(sub, msg);
+        req_put(sub);
+        return;
+    }
+
+    sub->peer = NULL;
+    msg->peer = NULL;
+    rsp_put(msg);
+
+    sub->done = 0;
+    msg_reset_pos(sub);
+
+    if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+        event_add_out(ctx->evb, b_conn);
+    }
+
+    b_conn->enqueue_inq(ctx, b_conn, sub);
+    b_conn->need_auth = 0;
+}
+
+/**.......................................................................
+ * Complete an mget fragment whose missing keys have been read from the
+ * backend.
+ *
+ * The values found are written back to the frontend servers in one
+ * batch, and spliced into the fragment's frontend response in place of
+ * its nil bulks, before the response is coalesced as usual.
+ */
+static void
+backend_fill_complete(struct msg* pmsg)
+{
+    struct conn* c_conn = pmsg->owner;
+    struct context* ctx = NULL;
+    struct msg* rsp = pmsg->fill_rsp;
+    struct msg* sub;
+    struct msg* tmp = NULL;
+    struct mbuf* mbuf;
+    uint32_t nkey = array_n(pmsg->keys);
+    uint32_t i;
+
+    ASSERT(rsp != NULL && pmsg->fill_msgs != NULL);
+
+    pmsg->fill_rsp = NULL;
+    pmsg->peer = rsp;
+    rsp->peer = pmsg;
+
+    /* the client's connection is gone if the fragment is swallowed */
+    if (!pmsg->swallow) {
+        ctx = conn_to_ctx(c_conn);
+
+        for (i = 0; i < nkey; i++) {
+            sub = pmsg->fill_msgs[i];
+            if (sub != NULL) {
+                add_set_msg(ctx, c_conn, sub->peer);
+            }
+        }
+
+        rsp->pre_coalesce(rsp);
+
+        tmp = msg_get(c_conn, false);
+        if (tmp == NULL) {
+            pmsg->error = 1;
+            pmsg->err = errno;
+        }
+    }
+
+    if (tmp != NULL) {
+        while ((mbuf = STAILQ_FIRST(&rsp->mhdr)) != NULL) {
+            mbuf_remove(&rsp->mhdr, mbuf);
+            mbuf_insert(&tmp->mhdr, mbuf);
+        }
+        tmp->mlen = rsp->mlen;
+        rsp->mlen = 0;
+
+        for (i = 0; i < nkey; i++) {
+            rstatus_t status;
+
+            sub = pmsg->fill_msgs[i];
+            if (sub != NULL) {
+                status = redis_copy_bulk(NULL, tmp);
+                if (status == NC_OK) {
+                    status = redis_copy_bulk(rsp, sub->peer);
+                }
+            } else {
+                status = redis_copy_bulk(rsp, tmp);
+            }
+
+            if (status != NC_OK) {
+                pmsg->error = 1;
+                pmsg->err = EINVAL;
+                break;
+            }
+        }
+
+        rsp_put(tmp);
+    }
+
+    for (i = 0; i < nkey; i++) {
+        if (pmsg->fill_msgs[i] != NULL) {
+            req_put(pmsg->fill_msgs[i]);
+        }
+    }
+    nc_free(pmsg->fill_msgs);
+    pmsg->fill_msgs = NULL;
+    nc_free(pmsg->fill_kind);
+    pmsg->fill_kind = NULL;
+
+    req_mark_done(pmsg);
+
+    if (pmsg->swallow) {
+        req_put(pmsg);
+        return;
+    }
+
+    if (req_done(c_conn, TAILQ_FIRST(&c_conn->omsg_q))) {
+        if (event_add_out(ctx->evb, c_conn) != NC_OK) {
+            c_conn->err = errno;
+        }
+    }
+}
+
+/**.......................................................................
+ * Return true if msg is a set operation, SDIFF, SINTER or SUNION, or
+ * one of their STORE variants
+ */
+static bool
+backend_set_op(struct msg* msg)
+{
+    switch (msg->type) {
+    case MSG_REQ_REDIS_SDIFF:
+    case MSG_REQ_REDIS_SINTER:
+    case MSG_REQ_REDIS_SUNION:
+    case MSG_REQ_REDIS_SDIFFSTORE:
+    case MSG_REQ_REDIS_SINTERSTORE:
+    case MSG_REQ_REDIS_SUNIONSTORE:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**.......................................................................
+ * Return true if the set operation msg stores its result in its first key
+ */
+static bool
+backend_set_store(struct msg* msg)
+{
+    return msg->type == MSG_REQ_REDIS_SDIFFSTORE ||
+           msg->type == MSG_REQ_REDIS_SINTERSTORE ||
+           msg->type == MSG_REQ_REDIS_SUNIONSTORE;
+}
+
+/**.......................................................................
+ * Read the sets of a set operation which missed in the frontend server
+ * through from the backend, to compute the operation in the proxy.
+ *
+ * Each set is read with an SMEMBERS of its own, routed to the set's
+ * coordinator, so that the reads for all the sets go out together, and
+ * each read caches its set in the frontend servers as usual.  The
+ * operation is held back, with its frontend response, until the last
+ * of those reads is answered.
+ *
+ * Returns true if the frontend response was taken over, false if it
+ * should be forwarded as is, eg. as a set has no bucket to be read from
+ */
+static bool
+backend_fill_sets(struct context *ctx, struct conn *s_conn, struct msg* pmsg,
+                  struct msg* msg)
+{
+    struct conn* c_conn = pmsg->owner;
+    struct server_pool* pool = c_conn->owner;
+    uint32_t first = backend_set_store(pmsg) ? 1 : 0;
+    uint32_t nkey = pmsg->narg - 1;
+    struct msg_pos pos = msg_pos_init();
+    size_t len;
+    uint32_t i;
+
+    struct msg** subs;
+    struct conn** conns;
+
+    if (pmsg->narg < 2 + first) {
+        return false;
+    }
+
+    subs = arena_alloc(nkey * sizeof(*subs));
+    conns = arena_alloc(nkey * sizeof(*conns));
+    if (subs == NULL || conns == NULL) {
+        return false;
+    }
+
+    /* skip the command label */
+    if (redis_get_next_string(pmsg, NULL, &pos, &len) != NC_OK) {
+        return false;
+    }
+    msg_offset_from(&pos, (uint32_t)len, &pos);
+
+    for (i = 0; i < nkey; i++) {
+        uint8_t* key;
+
+        subs[i] = NULL;
+        conns[i] = NULL;
+
+        if (redis_get_next_string(pmsg, &pos, &pos, &len) != NC_OK) {
+            break;
+        }
+
+        key = arena_alloc(len);
+        if (key == NULL ||
+            msg_extract_from_pos_char((char*)key, &pos, len) != NC_OK) {
+            break;
+        }
+        msg_offset_from(&pos, (uint32_t)len, &pos);
+
+        /* the destination of a STORE is not read */
+        if (i < first) {
+            continue;
+        }
+
+        conns[i] = server_pool_conn_backend(ctx, pool, key, (uint32_t)len,
+                                            NULL);
+        if (conns[i] == NULL) {
+            break;
+        }
+
+        subs[i] = backend_read_msg(c_conn, MSG_REQ_REDIS_SMEMBERS, "smembers",
+                                   key, (uint32_t)len);
+        if (subs[i] == NULL) {
+            break;
+        }
+
+        if (conns[i]->req_remap(conns[i], subs[i]) != NC_OK) {
+            msg_put(subs[i]);
+            subs[i] = NULL;
+            break;
+        }
+    }
+
+    if (i == nkey) {
+        pmsg->fill_msgs = nc_zalloc(nkey * sizeof(*pmsg->fill_msgs));
+    }
+
+    if (i < nkey || pmsg->fill_msgs == NULL) {
+        while (i-- > first) {
+            msg_put(subs[i]);
+        }
+        return false;
+    }
+
+    /* the operation leaves the frontend server, but is not done yet */
+    server_ok(ctx, s_conn);
+    s_conn->dequeue_outq(ctx, s_conn, pmsg);
+    pmsg->fill_rsp = msg;
+    pmsg->nsubs = nkey - first;
+
+    for (i = first; i < nkey; i++) {
+        struct conn* b_conn = conns[i];
+        struct msg* sub = subs[i];
+
+        sub->swallow = 1;
+        sub->fill_owner = pmsg;
+        sub->fill_idx = i;
+
+        if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+            event_add_out(ctx->evb, b_conn);
+        }
+
+        b_conn->enqueue_inq(ctx, b_conn, sub);
+        b_conn->need_auth = 0;
+    }
+
+    stats_pool_incr(ctx, pool, set_op_fills);
+
+    return true;
+}
+
+/**.......................................................................
+ * Order set members by their bytes, for qsort
+ */
+static int
+backend_member_cmp(const void *m1, const void *m2)
+{
+    const ProtobufCBinaryData* a = m1;
+    const ProtobufCBinaryData* b = m2;
+    int cmp;
+
+    cmp = memcmp(a->data, b->data, MIN(a->len, b->len));
+    if (cmp != 0 || a->len == b->len) {
+        return cmp;
+    }
+
+    return a->len < b->len ? -1 : 1;
+}
+
+/**.......................................................................
+ * Compute the set operation of type on the nset sets, sorting them, into
+ * res, which has room for the members of all the sets, and return the
+ * number of members of the result.
+ *
+ * The union is sorted as a whole and rid of duplicates; the difference
+ * and intersection are merged from the first set with each of the
+ * others in turn, in place.
+ */
+static uint32_t
+backend_sets_merge(msg_type_t type, ProtobufCBinaryData** sets,
+                   uint32_t* nmember, uint32_t nset, ProtobufCBinaryData* res)
+{
+    bool inter = (type == MSG_REQ_REDIS_SINTER ||
+                  type == MSG_REQ_REDIS_SINTERSTORE);
+    uint32_t nres, i, j, k, n;
+    int cmp;
+
+    if (type == MSG_REQ_REDIS_SUNION || type == MSG_REQ_REDIS_SUNIONSTORE) {
+        for (nres = 0, i = 0; i < nset; i++) {
+            nc_memcpy(res + nres, sets[i], nmember[i] * sizeof(*res));
+            nres += nmember[i];
+        }
+        qsort(res, nres, sizeof(*res), backend_member_cmp);
+
+        for (k = 0, j = 0; j < nres; j++) {
+            if (k == 0 || backend_member_cmp(&res[k - 1], &res[j]) != 0) {
+                res[k++] = res[j];
+            }
+        }
+        return k;
+    }
+
+    for (i = 0; i < nset; i++) {
+        qsort(sets[i], nmember[i], sizeof(*sets[i]), backend_member_cmp);
+    }
+
+    nc_memcpy(res, sets[0], nmember[0] * sizeof(*res));
+    nres = nmember[0];
+
+    for (i = 1; i < nset; i++) {
+        for (j = 0, k = 0, n = 0; j < nres; ) {
+            cmp = (n < nmember[i]) ? backend_member_cmp(&res[j], &sets[i][n]) : -1;
+            if (cmp > 0) {
+                n++;
+                continue;
+            }
+
+            /* res[j] is a member of set i if they compare equal */
+            if ((cmp == 0) == inter) {
+                res[k++] = res[j];
+            }
+            if (cmp == 0) {
+                n++;
+            }
+            j++;
+        }
+        nres = k;
+    }
+
+    return nres;
+}
+
+/**.......................................................................
+ * Write the members of a set into response rsp, as a multi-bulk
+ */
+static rstatus_t
+backend_reply_members(struct msg* rsp, ProtobufCBinaryData* members,
+                      uint32_t nmember)
+{
+    char hdr[1 + NC_UINT32_MAXLEN + CRLF_LEN + 1];
+    rstatus_t status;
+    uint32_t i;
+    int n;
+
+    n = nc_snprintf(hdr, sizeof(hdr), "*%"PRIu32"\r\n", nmember);
+    if ((status = msg_copy_char(rsp, hdr, (size_t)n)) != NC_OK) {
+        return status;
+    }
+
+    for (i = 0; i < nmember; i++) {
+        n = nc_snprintf(hdr, sizeof(hdr), "$%"PRIu32"\r\n",
+                        (uint32_t)members[i].len);
+        if ((status = msg_copy_char(rsp, hdr, (size_t)n)) != NC_OK ||
+            (status = msg_copy(rsp, members[i].data, members[i].len)) != NC_OK ||
+            (status = msg_copy_char(rsp, CRLF, CRLF_LEN)) != NC_OK) {
+            return status;
+        }
+    }
+
+    rsp->type = MSG_RSP_REDIS_MULTIBULK;
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Complete a set operation whose sets have been read from the backend.
+ *
+ * The operation is computed on the members read, and its frontend
+ * response rewritten with the result.  The result of a STORE variant is
+ * written to its destination in the frontend and the backend servers,
+ * and answered with its size.
+ */
+static void
+backend_sets_complete(struct msg* pmsg)
+{
+    struct conn* c_conn = pmsg->owner;
+    struct context* ctx = NULL;
+    struct msg* rsp = pmsg->fill_rsp;
+    uint32_t first = backend_set_store(pmsg) ? 1 : 0;
+    uint32_t nkey = pmsg->narg - 1;
+    ProtobufCBinaryData** sets;
+    ProtobufCBinaryData* res = NULL;
+    uint32_t* nmember;
+    uint32_t total = 0, nres, i = first;
+    rstatus_t status = NC_OK;
+    struct msg* sub;
+    int n;
+
+    ASSERT(rsp != NULL && pmsg->fill_msgs != NULL);
+
+    pmsg->fill_rsp = NULL;
+    pmsg->peer = rsp;
+    rsp->peer = pmsg;
+
+    sets = arena_alloc(nkey * sizeof(*sets));
+    nmember = arena_alloc(nkey * sizeof(*nmember));
+    if (sets == NULL || nmember == NULL) {
+        status = NC_ENOMEM;
+    }
+
+    /* a set whose read went unanswered fails the operation */
+    for (; status == NC_OK && i < nkey; i++) {
+        sub = pmsg->fill_msgs[i];
+        n = (sub == NULL) ? -1 : redis_multibulk_values(sub->peer, &sets[i]);
+        if (n < 0) {
+            status = NC_ERROR;
+            break;
+        }
+        nmember[i] = (uint32_t)n;
+        total += nmember[i];
+    }
+
+    /* the client's connection is gone if the operation is swallowed */
+    if (!pmsg->swallow) {
+        ctx = conn_to_ctx(c_conn);
+    }
+
+    if (status == NC_OK && ctx != NULL) {
+        res = arena_alloc(MAX(total, 1) * sizeof(*res));
+        if (res == NULL) {
+            status = NC_ENOMEM;
+        }
+    }
+
+    if (status == NC_OK && ctx != NULL) {
+        nres = backend_sets_merge(pmsg->type, sets + first, nmember + first,
+                                  nkey - first, res);
+
+        msg_rewind(rsp);
+        rsp->mlen = 0;
+
+        if (first) {
+            riak_store_set(ctx, pmsg, res, nres);
+            status = msg_prepend_format(rsp, ":%"PRIu32"\r\n", nres);
+            rsp->type = MSG_RSP_REDIS_INTEGER;
+        } else {
+            status = backend_reply_members(rsp, res, nres);
+        }
+    }
+
+    if (status != NC_OK) {
+        pmsg->error = 1;
+        pmsg->err = (status == NC_ENOMEM) ? ENOMEM : EINVAL;
+    }
+
+    while (i-- > first) {
+        if (sets[i] != NULL) {
+            nc_free(sets[i]);
+        }
+    }
+
+    for (i = 0; i < nkey; i++) {
+        if (pmsg->fill_msgs[i] != NULL) {
+            req_put(pmsg->fill_msgs[i]);
+        }
+    }
+    nc_free(pmsg->fill_msgs);
+    pmsg->fill_msgs = NULL;
+
+    req_mark_done(pmsg);
+
+    if (pmsg->swallow) {
+        req_put(pmsg);
+        return;
+    }
+
+    if (req_done(c_conn, TAILQ_FIRST(&c_conn->omsg_q))) {
+        if (event_add_out(ctx->evb, c_conn) != NC_OK) {
+            c_conn->err = errno;
+        }
+    }
+}
+
+/**.......................................................................
+ * Return a property of the bucket of a "datatype:bucket:key" key, as
+ * looked up by get, eg. server_pool_bucket_grace
+ */
+static int64_t
+backend_key_prop(struct server_pool* pool, uint8_t* key, uint32_t keylen,
+                 backend_bucket_prop_t get)
+{
+    ProtobufCBinaryData datatype;
+    ProtobufCBinaryData bucket;
+    ProtobufCBinaryData bkey;
+    char keyname[keylen + 1];
+
+    /* the key is split in place, which needs a NUL-terminated copy */
+    nc_memcpy(keyname, key, keylen);
+    keyname[keylen] = '\0';
+
+    nc_split_key_string((uint8_t*)keyname, keylen, &datatype, &bucket, &bkey);
+
+    return get(pool, datatype.data, (uint32_t)datatype.len, bucket.data,
+               (uint32_t)bucket.len);
+}
+
+/**.......................................................................
+ * Follow a GET of a key of a bucket with a grace period by a hidden
+ * PTTL of the key on the same frontend server, so that a hit on a key
+ * which is about to expire can refresh it from the backend (see
+ * backend_refresh_rsp).  Being pipelined behind the GET, the PTTL adds
+ * no round trip to the client's request.
+ */
+void
+backend_refresh_probe(struct context *ctx, struct conn* c_conn,
+                      struct conn* s_conn, struct msg* msg)
+{
+    const char pttl_proto[] = "*2\r\n$4\r\npttl\r\n$%u\r\n";
+    struct server_pool* pool = c_conn->owner;
+    struct keypos* kpos;
+    struct msg* probe;
+    uint32_t keylen;
+
+    if (msg->type != MSG_REQ_REDIS_GET || msg->swallow ||
+        conn_nbackend(c_conn) == 0 || array_n(msg->keys) == 0) {
+        return;
+    }
+
+    kpos = array_get(msg->keys, 0);
+    keylen = (uint32_t)(kpos->end - kpos->start);
+
+    if (backend_key_prop(pool, kpos->start, keylen,
+                         server_pool_bucket_grace) <= 0) {
+        return;
+    }
+
+    char pttl[sizeof(pttl_proto) - 2 + ndig(keylen)];
+    uint32_t pttllen = (uint32_t)sprintf(pttl, pttl_proto, keylen);
+
+    probe = msg_get(c_conn, true);
+    if (probe == NULL) {
+        c_conn->err = errno;
+        return;
+    }
+
+    if (msg_copy_char(probe, pttl, pttllen) != NC_OK ||
+        msg_copy(probe, kpos->start, keylen) != NC_OK ||
+        msg_copy_char(probe, CRLF, CRLF_LEN) != NC_OK) {
+        msg_put(probe);
+        return;
+    }
+    probe->type = MSG_REQ_REDIS_PTTL;
+    probe->swallow = 1;
+    probe->refresh = 1;
+
+    /* the GET ahead of it has already scheduled the server for writing */
+    s_conn->enqueue_inq(ctx, s_conn, probe);
+}
+
+/**.......................................................................
+ * Return true if a client request names a key of the proxy's own, such
+ * as the key of a not-found marker, which clients may neither read nor
+ * write
+ */
+bool
+backend_key_reserved(struct conn* c_conn, struct msg* msg)
+{
+    struct keypos* kpos;
+    uint32_t i;
+
+    if (msg->keys == NULL || conn_nbackend(c_conn) == 0) {
+        return false;
+    }
+
+    for (i = 0; i < array_n(msg->keys); i++) {
+        kpos = array_get(msg->keys, i);
+        if (kpos->end - kpos->start >= (ssize_t)BACKEND_NIL_PREFIX_LEN &&
+            memcmp(kpos->start, BACKEND_NIL_PREFIX, BACKEND_NIL_PREFIX_LEN) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**.......................................................................
+ * Look up the not-found markers of the keys a frontend read missed in
+ * the frontend server, before they are read through from the backend:
+ * the key of a GET or EXISTS, or the keys an mget fragment missed, see
+ * backend_fill_mget.  The markers are read with a hidden MGET of their
+ * keys on the read's frontend server, which holds the markers of its
+ * keys, and the read goes on once it is answered (see
+ * backend_nil_looked_up).
+ *
+ * Returns true if the markers are being looked up, false if the read
+ * goes on now, eg. as none of its keys' buckets has a negative_ttl
+ */
+static bool
+backend_nil_lookup(struct context *ctx, struct conn *s_conn, struct msg* pmsg)
+{
+    struct conn* c_conn = pmsg->owner;
+    struct server_pool* pool = c_conn->owner;
+    bool mget = (pmsg->type == MSG_REQ_REDIS_MGET);
+    uint32_t nkey = mget ? array_n(pmsg->keys) : 1;
+    uint32_t i, n = 0;
+    bool negative = false;
+    struct keypos* kpos;
+    struct msg* lmsg;
+
+    if (pmsg->swallow || array_n(pmsg->keys) == 0) {
+        return false;
+    }
+
+    for (i = 0; i < nkey; i++) {
+        if (mget && pmsg->fill_kind[i] != REDIS_BULK_NIL) {
+            continue;
+        }
+
+        kpos = array_get(pmsg->keys, i);
+        if (backend_key_prop(pool, kpos->start,
+                             (uint32_t)(kpos->end - kpos->start),
+                             server_pool_bucket_negative_ttl) > 0) {
+            negative = true;
+        }
+        n++;
+    }
+
+    if (!negative) {
+        return false;
+    }
+
+    lmsg = msg_get(c_conn, true);
+    if (lmsg == NULL) {
+        c_conn->err = errno;
+        return false;
+    }
+
+    if (backend_resp_hdr(lmsg, '*', n + 1) != NC_OK ||
+        msg_copy_char(lmsg, "$4\r\nmget\r\n", 10) != NC_OK) {
+        msg_put(lmsg);
+        return false;
+    }
+
+    for (i = 0; i < nkey; i++) {
+        if (mget && pmsg->fill_kind[i] != REDIS_BULK_NIL) {
+            continue;
+        }
+
+        kpos = array_get(pmsg->keys, i);
+        if (backend_resp_nil_key(lmsg, kpos->start,
+                                 (uint32_t)(kpos->end - kpos->start)) != NC_OK) {
+            msg_put(lmsg);
+            return false;
+        }
+    }
+
+    lmsg->type = MSG_REQ_REDIS_MGET;
+    lmsg->swallow = 1;
+    lmsg->nil_owner = pmsg;
+
+    if (TAILQ_EMPTY(&s_conn->imsg_q)) {
+        event_add_out(ctx->evb, s_conn);
+    }
+
+    s_conn->enqueue_inq(ctx, s_conn, lmsg);
+    s_conn->need_auth = 0;
+
+    return true;
+}
+
+/**.......................................................................
+ * Answer a GET or EXISTS whose not-found marker was looked up with rsp,
+ * the response the frontend server answered it with
+ */
+static void
+backend_nil_reply(struct msg* pmsg, struct msg* rsp)
+{
+    struct conn* c_conn = pmsg->owner;
+
+    pmsg->peer = rsp;
+    rsp->peer = pmsg;
+    req_mark_done(pmsg);
+
+    /* the client closed its connection while waiting */
+    if (pmsg->swallow) {
+        req_put(pmsg);
+        return;
+    }
+
+    if (req_done(c_conn, TAILQ_FIRST(&c_conn->omsg_q))) {
+        struct context *ctx = conn_to_ctx(c_conn);
+        if (event_add_out(ctx->evb, c_conn) != NC_OK) {
+            c_conn->err = errno;
+        }
+    }
+}
+
+/**.......................................................................
+ * Go on with the frontend read whose not-found markers msg, the response
+ * to the hidden MGET sent by backend_nil_lookup, answers.
+ *
+ * A GET or EXISTS of a key with a marker is answered with the frontend
+ * server's response, as the key is known to be missing from the backend
+ * too; otherwise it is read through as any miss.  The keys of an mget
+ * fragment with a marker are left nil, and the others read through.  A
+ * lookup which failed finds no markers.
+ */
+static bool
+backend_nil_looked_up(struct context *ctx, struct conn *s_conn,
+                      struct msg* msg)
+{
+    struct msg* lmsg;
+    struct msg* pmsg;
+    struct msg* rsp;
+    uint8_t* marked = NULL;
+    uint32_t i, j, n;
+
+    rsp_get_peer(ctx, s_conn, msg);
+    lmsg = msg->peer;
+    pmsg = lmsg->nil_owner;
+    lmsg->nil_owner = NULL;
+
+    if (pmsg->type != MSG_REQ_REDIS_MGET) {
+        n = 1;
+    } else {
+        for (i = 0, n = 0; i < array_n(pmsg->keys); i++) {
+            n += (pmsg->fill_kind[i] == REDIS_BULK_NIL);
+        }
+    }
+
+    if (msg->type == MSG_RSP_REDIS_MULTIBULK) {
+        marked = nc_alloc(n);
+        if (marked != NULL && redis_multibulk_scan(msg, marked, n, NULL, 0) < 0) {
+            nc_free(marked);
+            marked = NULL;
+        }
+    }
+
+    req_put(lmsg);
+
+    if (pmsg->type != MSG_REQ_REDIS_MGET) {
+        rsp = pmsg->fill_rsp;
+        pmsg->fill_rsp = NULL;
+
+        if (marked != NULL && marked[0] == REDIS_BULK_VALUE) {
+            stats_pool_incr(ctx, pmsg->owner->owner, nil_marker_hits);
+            backend_nil_reply(pmsg, rsp);
+        } else if (pmsg->swallow) {
+            rsp_put(rsp);
+            req_put(pmsg);
+        } else {
+            pmsg->peer = rsp;
+            rsp->peer = pmsg;
+            if (!backend_resend(ctx, rsp, true)) {
+                backend_nil_reply(pmsg, rsp);
+            }
+        }
+    } else {
+        for (i = 0, j = 0; marked != NULL && i < array_n(pmsg->keys); i++) {
+            if (pmsg->fill_kind[i] != REDIS_BULK_NIL) {
+                continue;
+            }
+            if (marked[j++] == REDIS_BULK_VALUE) {
+                pmsg->fill_kind[i] = REDIS_BULK_MATCH;
+                stats_pool_incr(ctx, pmsg->owner->owner, nil_marker_hits);
+            }
+        }
+
+        if (pmsg->swallow) {
+            backend_fill_complete(pmsg);
+        } else {
+            backend_fill_read(ctx, pmsg);
+        }
+    }
+
+    nc_free(marked);
+    return true;
+}
+
+/**.......................................................................
+ * Let the frontend read whose not-found markers a hidden MGET looked up
+ * go on as the MGET is put unanswered, eg. as its server connection is
+ * closed, as though no markers were found but without reading through:
+ * it is answered with its frontend response
+ */
+void
+backend_nil_lookup_put(struct msg* msg)
+{
+    struct msg* pmsg = msg->nil_owner;
+    struct msg* rsp;
+
+    if (pmsg == NULL) {
+        return;
+    }
+    msg->nil_owner = NULL;
+
+    if (pmsg->type != MSG_REQ_REDIS_MGET) {
+        rsp = pmsg->fill_rsp;
+        pmsg->fill_rsp = NULL;
+        backend_nil_reply(pmsg, rsp);
+    } else {
+        backend_fill_complete(pmsg);
+    }
+}
+
+/**.......................................................................
+ * Decide whether a cached key with remaining_ms left to live should be
+ * refreshed now.
+ *
+ * This is the XFetch rule of "Optimal Probabilistic Cache Stampede
+ * Prevention" (Vattani et al.): refresh if
+ *
+ *   remaining_ms <= -grace_ms * log(u),  u uniform in (0, 1]
+ *
+ * ie. with probability exp(-remaining_ms / grace_ms).  Refreshes of a
+ * hot key are spread out ahead of its expiry rather than all of its
+ * readers missing together once it expires.
+ */
+static bool
+backend_refresh_due(uint32_t remaining_ms, int64_t grace_ms)
+{
+    double u = ((double)random() + 1.0) / ((double)RAND_MAX + 1.0);
+
+    return (double)remaining_ms <= -(double)grace_ms * log(u);
+}
+
+/**.......................................................................
+ * Send a hidden GET of a cached key to the backend, to refresh the key
+ * in the frontend server with the backend's value.
+ *
+ * A conditional read is sent with the vclock cached for the key, if any,
+ * so the backend returns the value only if it changed since (see
+ * backend_refresh_done).  The read is entered in the pool's backend miss
+ * queue, so misses of the key while it is in flight wait on it rather
+ * than go to the backend too.
+ *
+ * Returns the read, or NULL if it could not be sent
+ */
+static struct msg *
+backend_refresh(struct context *ctx, struct conn* c_conn, uint8_t* key,
+                uint32_t keylen, bool conditional)
+{
+    struct server_pool* pool = c_conn->owner;
+    struct conn* b_conn;
+    struct msg* sub;
+
+    b_conn = server_pool_conn_backend(ctx, pool, key, keylen, NULL);
+    if (b_conn == NULL) {
+        return NULL;
+    }
+
+    sub = backend_get_msg(c_conn, key, keylen);
+    if (sub == NULL) {
+        return NULL;
+    }
+
+    /* the encoder makes a refresh conditional on the cached vclock */
+    sub->refresh = conditional ? 1 : 0;
+
+    if (b_conn->req_remap(b_conn, sub) != NC_OK ||
+        backend_miss_add(pool, sub, key, keylen) != NC_OK) {
+        msg_put(sub);
+        return NULL;
+    }
+
+    sub->swallow = 1;
+    sub->refresh = 1;
+
+    if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+        event_add_out(ctx->evb, b_conn);
+    }
+
+    b_conn->enqueue_inq(ctx, b_conn, sub);
+    b_conn->need_auth = 0;
+
+    stats_pool_incr(ctx, pool, refreshes);
+
+    return sub;
+}
+
+/**.......................................................................
+ * Process the frontend response to a PTTL sent by backend_refresh_probe,
+ * refreshing the key from the backend if it is due (see
+ * backend_refresh_due).  Keys without a TTL or no longer cached are
+ * left alone; the latter are read through by the GET ahead of the PTTL.
+ */
+static bool
+backend_refresh_rsp(struct context *ctx, struct conn *s_conn, struct msg* msg)
+{
+    struct server* server = s_conn->owner;
+    struct server_pool* pool = server->owner;
+    struct msg_pos keyname_start_pos = msg_pos_init();
+    size_t keynamelen = 0;
+    struct msg* pmsg;
+    struct conn* c_conn;
+    struct mbuf* mbuf;
+    int64_t grace_ms;
+
+    rsp_get_peer(ctx, s_conn, msg);
+    pmsg = msg->peer;
+    c_conn = pmsg->owner;
+    mbuf = STAILQ_FIRST(&msg->mhdr);
+
+    /*
+     * The integer parser drops the sign of a reply, so -1 (no TTL) and
+     * -2 (no key) are told apart by the raw reply.  A client which
+     * closed its connection since no longer belongs to the pool.
+     */
+    if (msg->type != MSG_RSP_REDIS_INTEGER || mbuf_length(mbuf) < 2 ||
+        mbuf->pos[1] == '-' || c_conn->owner != pool) {
+        req_put(pmsg);
+        return true;
+    }
+
+    if (redis_get_next_string(pmsg, NULL, &keyname_start_pos,
+                              &keynamelen) != NC_OK ||
+        redis_get_next_string(pmsg, &keyname_start_pos, &keyname_start_pos,
+                              &keynamelen) != NC_OK) {
+        req_put(pmsg);
+        return true;
+    }
+
+    uint8_t keyname[keynamelen + 1];
+
+    if (msg_extract_from_pos_char((char *)keyname, &keyname_start_pos,
+                                  keynamelen) == NC_OK) {
+        grace_ms = backend_key_prop(pool, keyname, (uint32_t)keynamelen,
+                                    server_pool_bucket_grace);
+        if (grace_ms > 0 && backend_refresh_due(msg->integer, grace_ms) &&
+            backend_miss_find(pool, keyname, (uint32_t)keynamelen) == NULL) {
+            backend_refresh(ctx, c_conn, keyname, (uint32_t)keynamelen, true);
+        }
+    }
+
+    req_put(pmsg);
+    return true;
+}
+
+/**.......................................................................
+ * Process the backend response to a GET sent by backend_refresh, writing
+ * the value, or not-found marker, back to the frontend server with a
+ * fresh TTL and answering any misses which waited on the read.
+ *
+ * A key found unchanged by a conditional read only has its TTL renewed.
+ * The misses which waited on it need the value itself, so they are
+ * handed over to an unconditional read of the key
+ */
+static bool
+backend_refresh_done(struct context *ctx, struct conn *s_conn, struct msg* msg)
+{
+    struct server* server = s_conn->owner;
+    struct server_pool* pool = server->owner;
+    struct msg* pmsg;
+    struct msg* sub;
+    struct conn* c_conn;
+    struct string* key;
+    int64_t ttl_ms;
+
+    rsp_get_peer(ctx, s_conn, msg);
+    pmsg = msg->peer;
+    c_conn = pmsg->owner;
+
+    if (msg->riak_rsp.unchanged && pmsg->miss_q != NULL) {
+        key = &pmsg->miss_key;
+        stats_pool_incr(ctx, pool, refresh_unchanged);
+
+        ttl_ms = backend_key_prop(pool, key->data, key->len,
+                                  server_pool_bucket_ttl);
+        if (ttl_ms > 0) {
+            add_pexpire_msg_key(ctx, pool->p_conn, (char *)key->data,
+                                key->len, (uint32_t)ttl_ms);
+        }
+
+        if (!TAILQ_EMPTY(&pmsg->miss_waitq)) {
+            sub = backend_refresh(ctx, pool->p_conn, key->data, key->len,
+                                  false);
+            if (sub != NULL) {
+                TAILQ_CONCAT(&sub->miss_waitq, &pmsg->miss_waitq, b_tqe);
+            }
+        }
+
+        backend_miss_done(pmsg, NULL);
+    } else if (msg->type == MSG_RSP_REDIS_BULK) {
+        backend_miss_done(pmsg, msg);
+
+        if (c_conn->owner == pool) {
+            if (!msg_nil(msg)) {
+                add_set_msg(ctx, c_conn, msg);
+            } else {
+                add_nil_marker_msg(ctx, c_conn, msg);
+            }
+        }
+    }
+
+    req_put(pmsg);
+    return true;
+}
+
+static int
+backend_latency_cmp(const void *t1, const void *t2)
+{
+    uint32_t l1 = *(const uint32_t *)t1;
+    uint32_t l2 = *(const uint32_t *)t2;
+
+    return (l1 > l2) - (l1 < l2);
+}
+
+/**.......................................................................
+ * Account for the latency of a backend read answered by a server, and
+ * recompute the server's hedge delay, the configured percentile of its
+ * recent read latencies, every few reads.  No delay is known before a
+ * full window of reads has been seen.
+ */
+static void
+backend_latency_sample(struct server* server, struct msg* pmsg)
+{
+    struct server_pool* pool = server->owner;
+    uint32_t latency[SERVER_NLATENCY];
+    int64_t now;
+
+    if (pool->backend_opt.hedge_percentile == 0 || pmsg->send_ts == 0 ||
+        pmsg->type != MSG_REQ_RIAK_GET) {
+        return;
+    }
+
+    now = nc_usec_now();
+    if (now < pmsg->send_ts) {
+        return;
+    }
+
+    server->latency[server->nlatency % SERVER_NLATENCY] =
+        (uint32_t)MIN(now - pmsg->send_ts, UINT32_MAX);
+    server->nlatency++;
+
+    if (server->nlatency < SERVER_NLATENCY ||
+        server->nlatency % (SERVER_NLATENCY / 8) != 0) {
+        return;
+    }
+
+    nc_memcpy(latency, server->latency, sizeof(latency));
+    qsort(latency, SERVER_NLATENCY, sizeof(latency[0]), backend_latency_cmp);
+
+    server->hedge_delay =
+        latency[SERVER_NLATENCY * pool->backend_opt.hedge_percentile / 100];
+}
+
+/**.......................................................................
+ * Time a request sent to a backend server, and schedule it to be hedged
+ * if it is a read of a cache miss which outlasts the server's hedge
+ * delay (see backend_hedge).
+ *
+ * Only the client's own reads with another backend server left to try
+ * are hedged; reads sent on the proxy's behalf are left alone.
+ */
+void
+backend_hedge_schedule(struct context *ctx, struct conn* s_conn,
+                       struct msg* msg)
+{
+    struct server* server = s_conn->owner;
+    struct server_pool* pool = server->owner;
+    int delay;
+
+    if (!server->backend) {
+        return;
+    }
+
+    msg->send_ts = nc_usec_now();
+
+    if (pool->backend_opt.hedge_percentile == 0 || server->hedge_delay == 0 ||
+        msg->type != MSG_REQ_RIAK_GET || msg->swallow || msg->hedge_copy ||
+        msg->miss_q == NULL || msg->hedge != NULL ||
+        backend_resend_q_empty(msg)) {
+        return;
+    }
+
+    delay = (int)((server->hedge_delay + 999) / 1000);
+    msg_hedge_insert(msg, s_conn, delay);
+}
+
+/**.......................................................................
+ * Hedge a backend read which has outlasted its server's hedge delay:
+ * send the same read to the next server in its resend queue.  Whichever
+ * of the two is first answered with a value answers the client, and
+ * the other is swallowed (see backend_hedge_won).
+ */
+void
+backend_hedge(struct context *ctx, struct msg* pmsg)
+{
+    struct conn* s_conn = pmsg->hedge_rbe.data;
+    struct conn* c_conn = pmsg->owner;
+    struct server_pool* pool;
+    struct server* server;
+    struct conn* b_conn;
+    struct msg* hedge;
+
+    msg_hedge_delete(pmsg);
+
+    /* the client closed its connection since */
+    if (pmsg->swallow || backend_resend_q_empty(pmsg)) {
+        return;
+    }
+
+    pool = c_conn->owner;
+    server = get_next_backend_server(pmsg, c_conn, pmsg->miss_key.data,
+                                     pmsg->miss_key.len);
+    b_conn = server_pool_conn_backend(ctx, pool, pmsg->miss_key.data,
+                                      pmsg->miss_key.len, server);
+    if (b_conn == NULL) {
+        return;
+    }
+
+    hedge = backend_get_msg(c_conn, pmsg->miss_key.data, pmsg->miss_key.len);
+    if (hedge == NULL) {
+        return;
+    }
+
+    if (b_conn->req_remap(b_conn, hedge) != NC_OK) {
+        msg_put(hedge);
+        return;
+    }
+
+    hedge->swallow = 1;
+    hedge->hedge_copy = 1;
+    hedge->hedge = pmsg;
+    hedge->hedge_conn = s_conn;
+    pmsg->hedge = hedge;
+
+    if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+        event_add_out(ctx->evb, b_conn);
+    }
+
+    b_conn->enqueue_inq(ctx, b_conn, hedge);
+    b_conn->need_auth = 0;
+
+    log_debug(LOG_VERB, "req %"PRIu64" on s %d hedged by req %"PRIu64" on "
+              "s %d", pmsg->id, s_conn->sd, hedge->id, b_conn->sd);
+
+    stats_pool_incr(ctx, pool, backend_hedges);
+}
+
+/**.......................................................................
+ * Move the out_queue stats of a msg moved from the outq of one server
+ * connection to that of another, as req_server_dequeue_omsgq and
+ * req_server_enqueue_omsgq would
+ */
+static void
+backend_outq_stats_move(struct context *ctx, struct conn* from,
+                        struct conn* to, struct msg* msg)
+{
+    if (msg->read_before_write) {
+        return;
+    }
+
+    stats_server_decr(ctx, from->owner, out_queue);
+    stats_server_decr_by(ctx, from->owner, out_queue_bytes, msg->mlen);
+    stats_server_incr(ctx, to->owner, out_queue);
+    stats_server_incr_by(ctx, to->owner, out_queue_bytes, msg->mlen);
+}
+
+/**.......................................................................
+ * Decide the race of a hedge, at the head of the server's outq, with
+ * the read it hedges, on the hedge's response.
+ *
+ * A hedge answered with a value while the read is still waiting wins:
+ * the two trade places, and out_queue stats, in their servers' outqs, so
+ * that the read now heads this server's outq and is answered by the
+ * response, while the hedge, swallowed, waits for the other server's
+ * response in its place.
+ *
+ * Returns true if the hedge won
+ */
+static bool
+backend_hedge_won(struct context *ctx, struct conn *s_conn, struct msg* msg)
+{
+    struct msg* hedge = TAILQ_FIRST(&s_conn->omsg_q);
+    struct msg* pmsg = hedge->hedge;
+    struct conn* h_conn = hedge->hedge_conn;
+
+    if (pmsg == NULL) {
+        return false;
+    }
+
+    backend_hedge_done(hedge);
+
+    if (msg->type != MSG_RSP_REDIS_BULK || msg_nil(msg)) {
+        return false;
+    }
+
+    msg_tmo_delete(pmsg);
+    msg_tmo_delete(hedge);
+
+    TAILQ_REMOVE(&s_conn->omsg_q, hedge, s_tqe);
+    TAILQ_INSERT_BEFORE(pmsg, hedge, s_tqe);
+    TAILQ_REMOVE(&h_conn->omsg_q, pmsg, s_tqe);
+    TAILQ_INSERT_HEAD(&s_conn->omsg_q, pmsg, s_tqe);
+
+    backend_outq_stats_move(ctx, s_conn, h_conn, hedge);
+    backend_outq_stats_move(ctx, h_conn, s_conn, pmsg);
+
+    msg_tmo_insert(hedge, h_conn);
+
+    /* the hedge was not sent to that server, so its latency is not sampled */
+    hedge->send_ts = 0;
+
+    log_debug(LOG_VERB, "req %"PRIu64" on s %d answered by its hedge on "
+              "s %d", pmsg->id, h_conn->sd, s_conn->sd);
+
+    stats_pool_incr(ctx, ((struct server*)s_conn->owner)->owner,
+                    backend_hedge_wins);
+
+    return true;
+}
+
+/**.......................................................................
+ * End the race of a hedged read and its hedge, once either of them is
+ * answered or abandoned.
+ *
+ * A no-op for requests which are not hedged
+ */
+void
+backend_hedge_done(struct msg* msg)
+{
+    msg_hedge_delete(msg);
+
+    if (msg->hedge != NULL) {
+        msg->hedge->hedge = NULL;
+        msg->hedge->hedge_conn = NULL;
+        msg->hedge = NULL;
+        msg->hedge_conn = NULL;
+    }
+}
+
+/**.......................................................................
+ * Release the state of a read streamed to its client, along with what
+ * was streamed of its reply and of the fill of its key.
+ *
+ * A no-op for reads which are not streamed
+ */
+void
+backend_cut_through_put(struct msg* msg)
+{
+    struct riak_cut* cut = msg->riak_cut;
+
+    if (cut == NULL) {
+        return;
+    }
+    msg->riak_cut = NULL;
+
+    if (cut->rsp != NULL) {
+        cut->rsp->peer = NULL;
+        rsp_put(cut->rsp);
+    }
+
+    if (cut->fill != NULL) {
+        msg_put(cut->fill);
+    }
+
+    string_deinit(&cut->key);
+    nc_free(cut);
+}
+
+/**.......................................................................
+ * Queue a client's SET of a key of a bucket with a write_behind delay,
+ * to be written to the backend once the delay is up (see
+ * backend_write_behind_drain), rather than written through.  The SET is
+ * answered by the frontend server alone, so a read of the key sees it at
+ * once.  A later SET of a queued key replaces the queued one; any other
+ * write of a queued key drops it, so that it cannot overwrite the later
+ * write once it is flushed.
+ *
+ * Returns true if the SET was queued, false if the request is to be
+ * written through
+ */
+bool
+backend_write_behind(struct context *ctx, struct conn* c_conn, struct msg* msg)
+{
+    struct server_pool* pool = c_conn->owner;
+    struct write_behind* wb = pool->write_behind;
+    struct keypos* kpos;
+    struct msg* wmsg;
+    uint32_t i, keylen;
+    int64_t delay;
+    bool coalesced;
+
+    if (!write_behind_enabled(wb) || array_n(msg->keys) == 0) {
+        return false;
+    }
+
+    kpos = array_get(msg->keys, 0);
+    keylen = (uint32_t)(kpos->end - kpos->start);
+
+    delay = 0;
+    if (msg->type == MSG_REQ_REDIS_SET && !msg->read_before_write &&
+        !msg->has_vclock && pool->p_conn != NULL) {
+        delay = backend_key_prop(pool, kpos->start, keylen,
+                                 server_pool_bucket_write_behind);
+    }
+
+    if (delay <= 0) {
+        for (i = 0; i < array_n(msg->keys); i++) {
+            kpos = array_get(msg->keys, i);
+            write_behind_del(wb, kpos->start,
+                             (uint32_t)(kpos->end - kpos->start));
+        }
+        return false;
+    }
+
+    /*
+     * The queued copy belongs to the pool rather than to the client, which
+     * may well be gone by the time it is written
+     */
+    wmsg = msg_content_clone(msg);
+    if (wmsg == NULL) {
+        write_behind_del(wb, kpos->start, keylen);
+        return false;
+    }
+    wmsg->parser(wmsg);
+    wmsg->noreply = 0;
+    wmsg->owner = pool->p_conn;
+
+    switch (write_behind_put(wb, kpos->start, keylen, wmsg,
+                             nc_msec_now() + delay, &coalesced)) {
+    case NC_OK:
+        if (coalesced) {
+            stats_pool_incr(ctx, pool, write_behind_merged);
+        } else {
+            stats_pool_incr(ctx, pool, write_behind_queued);
+        }
+        return true;
+
+    case NC_ERROR:
+        stats_pool_incr(ctx, pool, write_behind_full);
+        break;
+
+    default:
+        break;
+    }
+
+    msg_put(wmsg);
+    return false;
+}
+
+/**.......................................................................
+ * Write a SET taken off the write-behind queue to the backend, as a
+ * hidden request of the pool, and give the key the TTL of its bucket on
+ * its frontend server, where it was written without one
+ */
+static void
+backend_write_behind_send(struct context *ctx, struct server_pool* pool,
+                          struct string* key, struct msg* msg)
+{
+    struct conn* b_conn;
+    int64_t ttl_ms;
+
+    b_conn = server_pool_conn_backend(ctx, pool, key->data, key->len, NULL);
+    if (b_conn == NULL || b_conn->req_remap(b_conn, msg) != NC_OK) {
+        log_warn("write-behind of '%.*s' to the backend failed", key->len,
+                 key->data);
+        msg_put(msg);
+    } else {
+        msg->swallow = 1;
+
+        if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+            event_add_out(ctx->evb, b_conn);
+        }
+
+        b_conn->enqueue_inq(ctx, b_conn, msg);
+        b_conn->need_auth = 0;
+    }
+
+    ttl_ms = backend_key_prop(pool, key->data, key->len,
+                              server_pool_bucket_ttl);
+    if (ttl_ms > 0) {
+        add_pexpire_msg_key(ctx, pool->p_conn, (char *)key->data, key->len,
+                            (uint32_t)ttl_ms);
+    }
+}
+
+/**.......................................................................
+ * Write the queued SETs of a pool which are due to the backend.
+ *
+ * Returns the time (in msec) until the next queued SET is due, -1 if
+ * the queue is empty
+ */
+int
+backend_write_behind_drain(struct context *ctx, struct server_pool* pool)
+{
+    struct write_behind* wb = pool->write_behind;
+    struct string key;
+    struct msg* msg;
+    int64_t now, due, queued;
+
+    now = nc_msec_now();
+
+    while ((due = write_behind_next(wb)) >= 0 && due <= now) {
+        msg = write_behind_pop(wb, &key, &queued);
+
+        stats_pool_decr(ctx, pool, write_behind_queued);
+        stats_pool_incr(ctx, pool, write_behind_writes);
+        stats_pool_incr_by(ctx, pool, write_behind_lag_ms, now - queued);
+
+        backend_write_behind_send(ctx, pool, &key, msg);
+        string_deinit(&key);
+    }
+
+    if (due < 0) {
+        return -1;
+    }
+
+    return (int)(due - now);
+}
+
+/**.......................................................................
+ * Return the slot of the pool's backend update batch queue for a key
+ */
+static struct msg_tqh *
+backend_batchq(struct server_pool* pool, uint8_t* key, uint32_t keylen)
+{
+    uint32_t hash = pool->key_hash((char *)key, keylen);
+    return &pool->backend_batchq[hash % SERVER_POOL_MISSQ_NSLOT];
+}
+
+/**.......................................................................
+ * Return true for the requests which update a counter
+ */
+static bool
+backend_counter_req(struct msg* msg)
+{
+    switch (msg->type) {
+    case MSG_REQ_REDIS_INCR:
+    case MSG_REQ_REDIS_INCRBY:
+    case MSG_REQ_REDIS_DECR:
+    case MSG_REQ_REDIS_DECRBY:
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+/**.......................................................................
+ * Return true for the requests which update a set
+ */
+static bool
+backend_set_req(struct msg* msg)
+{
+    return msg->type == MSG_REQ_REDIS_SADD || msg->type == MSG_REQ_REDIS_SREM;
+}
+
+/**.......................................................................
+ * Return true for the updates which may be batched, of a counter or of a
+ * set
+ */
+bool
+backend_batchable_req(struct msg* msg)
+{
+    return backend_counter_req(msg) || backend_set_req(msg);
+}
+
+/**.......................................................................
+ * Return true if a client's update cannot be batched as it is queued
+ * behind an earlier request of its client, other than a batchable
+ * update, which it could overtake: a batch is written without waiting
+ * for the requests ahead of the updates in it (see req_blocked).  The
+ * client counts those requests as they are queued and done.
+ */
+static bool
+backend_batch_blocked(struct conn* c_conn)
+{
+    return c_conn->nunbatchable > 0;
+}
+
+/**.......................................................................
+ * Return the latest batch of updates of a key which is still to be sent,
+ * of counter updates or of set updates, if any
+ */
+static struct msg *
+backend_batch_find(struct server_pool* pool, uint8_t* key, uint32_t keylen,
+                   bool counter)
+{
+    struct msg* lmsg;
+
+    TAILQ_FOREACH_REVERSE(lmsg, backend_batchq(pool, key, keylen), msg_tqh,
+                          b_tqe) {
+        if (lmsg->batch_due != 0 && lmsg->counter_batch == counter &&
+            lmsg->miss_key.len == keylen &&
+            memcmp(lmsg->miss_key.data, key, keylen) == 0) {
+            return lmsg;
+        }
+    }
+
+    return NULL;
+}
+
+/**.......................................................................
+ * Start a batch of updates of a key, a hidden request of the pool which
+ * the batched requests wait on, due at the given time
+ */
+static struct msg *
+backend_batch_new(struct server_pool* pool, uint8_t* key, uint32_t keylen,
+                  int64_t due)
+{
+    struct msg* lmsg;
+
+    lmsg = msg_get(pool->p_conn, true);
+    if (lmsg == NULL) {
+        return NULL;
+    }
+
+    if (string_copy(&lmsg->miss_key, key, keylen) != NC_OK) {
+        msg_put(lmsg);
+        return NULL;
+    }
+
+    lmsg->batch_due = due;
+    lmsg->miss_q = backend_batchq(pool, key, keylen);
+    TAILQ_INSERT_TAIL(lmsg->miss_q, lmsg, b_tqe);
+
+    return lmsg;
+}
+
+/**.......................................................................
+ * Batch a client's update of a counter, a key of a bucket type, with
+ * the other updates of the counter made within the pool's counter
+ * window: the first update of the window starts a batch, which is
+ * written to the backend as a single update by the sum of the batched
+ * increments once the window is up (see backend_counter_drain).  The
+ * batched updates are answered from the counter value the backend
+ * returns for it (see backend_counter_done).
+ *
+ * An update queued behind an earlier request of its client, which may
+ * be of the same counter, is not batched, so that it cannot overtake it.
+ *
+ * Returns true if the update was batched, false if it is to be written
+ * through on its own
+ */
+bool
+backend_counter_batch(struct context *ctx, struct conn* c_conn,
+                      struct msg* msg)
+{
+    struct server_pool* pool = c_conn->owner;
+    struct keypos* kpos;
+    struct msg* lmsg;
+    uint32_t keylen;
+    int64_t delta;
+    uint8_t* sep;
+
+    if (pool->backend_opt.counter_window <= 0 || pool->p_conn == NULL ||
+        !backend_counter_req(msg) || msg->noreply || msg->swallow ||
+        msg->frag_id != 0 || array_n(msg->keys) == 0) {
+        return false;
+    }
+
+    kpos = array_get(msg->keys, 0);
+    keylen = (uint32_t)(kpos->end - kpos->start);
+
+    /* counters are keyed by "datatype:bucket:key" */
+    sep = nc_strchr(kpos->start, kpos->end, ':');
+    if (sep == NULL || nc_strchr(sep + 1, kpos->end, ':') == NULL ||
+        riak_incr_delta(msg, &delta) != NC_OK ||
+        backend_batch_blocked(c_conn)) {
+        return false;
+    }
+
+    lmsg = backend_batch_find(pool, kpos->start, keylen, true);
+    if (lmsg == NULL) {
+        lmsg = backend_batch_new(pool, kpos->start, keylen,
+                                 nc_msec_now() +
+                                 pool->backend_opt.counter_window);
+        if (lmsg == NULL) {
+            return false;
+        }
+
+        lmsg->counter_batch = 1;
+        TAILQ_INSERT_TAIL(&pool->backend_counter_dueq, lmsg, m_tqe);
+
+        stats_pool_incr(ctx, pool, counter_batches);
+    } else {
+        stats_pool_incr(ctx, pool, counter_batched);
+    }
+
+    TAILQ_INSERT_TAIL(&lmsg->miss_waitq, msg, b_tqe);
+
+    log_debug(LOG_VERB, "req %"PRIu64" batched in counter update "
+              "req %"PRIu64"", msg->id, lmsg->id);
+
+    return true;
+}
+
+/**.......................................................................
+ * Write a batch of counter updates to the backend, as a hidden INCRBY
+ * of the pool by the sum of the batched increments.  A batch which
+ * cannot be written fails its updates.
+ */
+static void
+backend_counter_send(struct context *ctx, struct server_pool* pool,
+                     struct msg* lmsg)
+{
+    const char incrby[] = "*3\r\n$6\r\nincrby\r\n";
+    struct string* key = &lmsg->miss_key;
+    char sum[1 + NC_UINT64_MAXLEN];
+    struct conn* b_conn;
+    struct msg* wmsg;
+    int64_t total, delta;
+    int sumlen;
+
+    total = 0;
+    TAILQ_FOREACH(wmsg, &lmsg->miss_waitq, b_tqe) {
+        if (riak_incr_delta(wmsg, &delta) != NC_OK ||
+            (delta > 0 && total > INT64_MAX - delta) ||
+            (delta < 0 && total < INT64_MIN - delta)) {
+            log_warn("batched update of counter '%.*s' is out of range",
+                     key->len, key->data);
+            msg_put(lmsg);
+            return;
+        }
+        total += delta;
+    }
+    sumlen = nc_snprintf(sum, sizeof(sum), "%"PRId64"", total);
+
+    if (msg_copy_char(lmsg, (char *)incrby, sizeof(incrby) - 1) != NC_OK ||
+        backend_resp_bulk(lmsg, key->data, key->len) != NC_OK ||
+        backend_resp_bulk(lmsg, sum, (uint32_t)sumlen) != NC_OK) {
+        msg_put(lmsg);
+        return;
+    }
+    lmsg->type = MSG_REQ_REDIS_INCRBY;
+    lmsg->pos = STAILQ_FIRST(&lmsg->mhdr)->pos;
+
+    b_conn = server_pool_conn_backend(ctx, pool, key->data, key->len, NULL);
+    if (b_conn == NULL || b_conn->req_remap(b_conn, lmsg) != NC_OK) {
+        log_warn("batched update of counter '%.*s' to the backend failed",
+                 key->len, key->data);
+        msg_put(lmsg);
+        return;
+    }
+
+    lmsg->swallow = 1;
+
+    if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+        event_add_out(ctx->evb, b_conn);
+    }
+
+    b_conn->enqueue_inq(ctx, b_conn, lmsg);
+    b_conn->need_auth = 0;
+}
+
+/**.......................................................................
+ * Write the batches of counter updates of a pool whose window is up to
+ * the backend.
+ *
+ * Returns the time (in msec) until the next batch is due, -1 if there
+ * is none
+ */
+int
+backend_counter_drain(struct context *ctx, struct server_pool* pool)
+{
+    struct msg* lmsg;
+    int64_t now;
+
+    now = nc_msec_now();
+
+    while ((lmsg = TAILQ_FIRST(&pool->backend_counter_dueq)) != NULL &&
+           lmsg->batch_due <= now) {
+        TAILQ_REMOVE(&pool->backend_counter_dueq, lmsg, m_tqe);
+        lmsg->batch_due = 0;
+
+        backend_counter_send(ctx, pool, lmsg);
+    }
+
+    if (lmsg == NULL) {
+        return -1;
+    }
+
+    return (int)(lmsg->batch_due - now);
+}
+
+/**.......................................................................
+ * Answer a batched update with an integer reply
+ */
+static void
+backend_batch_reply(struct msg* wmsg, int64_t value)
+{
+    struct conn* c_conn = wmsg->owner;
+    char num[2 + NC_UINT64_MAXLEN + CRLF_LEN];
+    struct msg* msg;
+    int len;
+
+    len = nc_snprintf(num, sizeof(num), ":%"PRId64"\r\n", value);
+
+    msg = msg_get(c_conn, false);
+    if (msg == NULL || msg_copy_char(msg, num, (size_t)len) != NC_OK) {
+        if (msg != NULL) {
+            msg_put(msg);
+        }
+        wmsg->error = 1;
+        wmsg->err = errno;
+    } else {
+        msg->type = MSG_RSP_REDIS_INTEGER;
+        msg->peer = wmsg;
+        wmsg->peer = msg;
+    }
+    req_mark_done(wmsg);
+
+    if (req_done(c_conn, TAILQ_FIRST(&c_conn->omsg_q))) {
+        struct context *ctx = conn_to_ctx(c_conn);
+        if (event_add_out(ctx->evb, c_conn) != NC_OK) {
+            c_conn->err = errno;
+        }
+    }
+}
+
+/**.......................................................................
+ * Process the backend response to a batch of counter updates sent by
+ * backend_counter_send.  Each batched update is answered with the value
+ * the counter had once it was applied, as though the updates had been
+ * written one by one: the last with the value the backend returned, the
+ * ones before it with that value less the increments after them.  A
+ * batch which failed fails its updates, with the backend's error.
+ */
+static bool
+backend_counter_done(struct context *ctx, struct conn *s_conn,
+                     struct msg* msg)
+{
+    struct msg* pmsg;
+    struct msg* wmsg;
+    int64_t value, delta;
+
+    rsp_get_peer(ctx, s_conn, msg);
+    pmsg = msg->peer;
+
+    if (msg->type != MSG_RSP_REDIS_INTEGER ||
+        !msg->riak_rsp.has_counter_value) {
+        backend_miss_done(pmsg, msg);
+        req_put(pmsg);
+        return true;
+    }
+
+    value = msg->riak_rsp.counter_value;
+
+    while ((wmsg = TAILQ_LAST(&pmsg->miss_waitq, msg_tqh)) != NULL) {
+        TAILQ_REMOVE(&pmsg->miss_waitq, wmsg, b_tqe);
+
+        ASSERT(wmsg->request && !wmsg->done);
+
+        delta = 0;
+        riak_incr_delta(wmsg, &delta);
+
+        /* the client closed its connection while waiting */
+        if (wmsg->swallow) {
+            req_put(wmsg);
+        } else {
+            backend_batch_reply(wmsg, value);
+        }
+
+        value -= delta;
+    }
+
+    backend_miss_done(pmsg, NULL);
+    req_put(pmsg);
+    return true;
+}
+
+/**.......................................................................
+ * Batch a client's SADD or SREM of a set, a key with a bucket, with the
+ * other updates of the set made within the same event loop tick: the
+ * first update of the tick starts a batch, which is written to the
+ * backend as a single update with all of the batched adds and removes
+ * at the end of the tick (see backend_set_drain).
+ *
+ * Riak applies the adds of an update before its removes, so an SADD
+ * behind an SREM starts a batch of its own, to be written after it.
+ *
+ * Returns true if the update was batched, false if it is to be written
+ * through on its own
+ */
+bool
+backend_set_batch(struct context *ctx, struct conn* c_conn, struct msg* msg)
+{
+    struct server_pool* pool = c_conn->owner;
+    struct keypos* kpos;
+    struct msg* lmsg;
+    uint32_t keylen;
+
+    if (pool->p_conn == NULL || !backend_set_req(msg) || msg->narg < 3 ||
+        msg->noreply || msg->swallow || msg->frag_id != 0 ||
+        array_n(msg->keys) == 0) {
+        return false;
+    }
+
+    kpos = array_get(msg->keys, 0);
+    keylen = (uint32_t)(kpos->end - kpos->start);
+
+    if (nc_strchr(kpos->start, kpos->end, ':') == NULL ||
+        backend_batch_blocked(c_conn)) {
+        return false;
+    }
+
+    lmsg = backend_batch_find(pool, kpos->start, keylen, false);
+    if (lmsg == NULL || (msg->type == MSG_REQ_REDIS_SADD &&
+        TAILQ_LAST(&lmsg->miss_waitq, msg_tqh)->type == MSG_REQ_REDIS_SREM)) {
+        lmsg = backend_batch_new(pool, kpos->start, keylen, nc_msec_now());
+        if (lmsg == NULL) {
+            return false;
+        }
+
+        lmsg->set_batch = 1;
+        TAILQ_INSERT_TAIL(&pool->backend_set_dueq, lmsg, m_tqe);
+    }
+
+    TAILQ_INSERT_TAIL(&lmsg->miss_waitq, msg, b_tqe);
+
+    log_debug(LOG_VERB, "req %"PRIu64" batched in set update "
+              "req %"PRIu64"", msg->id, lmsg->id);
+
+    return true;
+}
+
+/**.......................................................................
+ * Write the updates of a batch on their own after all, in order, as
+ * though they had not been batched
+ */
+static void
+backend_batch_unbatch(struct context *ctx, struct msg* lmsg)
+{
+    struct msg* wmsg;
+
+    while ((wmsg = TAILQ_FIRST(&lmsg->miss_waitq)) != NULL) {
+        TAILQ_REMOVE(&lmsg->miss_waitq, wmsg, b_tqe);
+
+        ASSERT(wmsg->request && !wmsg->done);
+
+        /* the client closed its connection while waiting */
+        if (wmsg->swallow) {
+            req_put(wmsg);
+            continue;
+        }
+
+        req_forward(ctx, wmsg->owner, wmsg, true, false);
+    }
+}
+
+/**.......................................................................
+ * Write the batches of set updates of a pool made during this tick to
+ * the backend.  A batch of a single update, or one which cannot be
+ * encoded as one update, is written as its updates.
+ */
+void
+backend_set_drain(struct context *ctx, struct server_pool* pool)
+{
+    struct string* key;
+    struct msg* lmsg;
+    struct msg* wmsg;
+    struct conn* b_conn;
+    uint32_t nbatched;
+
+    while ((lmsg = TAILQ_FIRST(&pool->backend_set_dueq)) != NULL) {
+        TAILQ_REMOVE(&pool->backend_set_dueq, lmsg, m_tqe);
+        lmsg->batch_due = 0;
+        key = &lmsg->miss_key;
+
+        nbatched = 0;
+        TAILQ_FOREACH(wmsg, &lmsg->miss_waitq, b_tqe) {
+            nbatched++;
+        }
+
+        lmsg->type = MSG_REQ_REDIS_SADD;
+
+        b_conn = NULL;
+        if (nbatched > 1) {
+            b_conn = server_pool_conn_backend(ctx, pool, key->data, key->len,
+                                              NULL);
+        }
+
+        if (b_conn == NULL || b_conn->req_remap(b_conn, lmsg) != NC_OK) {
+            backend_batch_unbatch(ctx, lmsg);
+            msg_put(lmsg);
+            continue;
+        }
+
+        lmsg->swallow = 1;
+
+        if (TAILQ_EMPTY(&b_conn->imsg_q)) {
+            event_add_out(ctx->evb, b_conn);
+        }
+
+        b_conn->enqueue_inq(ctx, b_conn, lmsg);
+        b_conn->need_auth = 0;
+
+        stats_pool_incr(ctx, pool, set_batches);
+        stats_pool_incr_by(ctx, pool, set_batched, nbatched - 1);
+    }
+}
+
+/**.......................................................................
+ * Process the backend response to a batch of set updates sent by
+ * backend_set_drain, answering each batched SADD and SREM as it would
+ * have been answered on its own.  A batch fails as a whole, for
+ * instance when one of its SREMs removes a member which is not in the
+ * set, and then its updates are written one by one instead.
+ */
+static bool
+backend_set_done(struct context *ctx, struct conn *s_conn, struct msg* msg)
+{
+    struct msg* pmsg;
+    struct msg* wmsg;
+
+    rsp_get_peer(ctx, s_conn, msg);
+    pmsg = msg->peer;
+
+    if (msg->type != MSG_RSP_REDIS_STATUS) {
+        log_debug(LOG_VERB, "batched set update req %"PRIu64" failed, "
+                  "writing its updates one by one", pmsg->id);
+        backend_batch_unbatch(ctx, pmsg);
+    }
+
+    while ((wmsg = TAILQ_FIRST(&pmsg->miss_waitq)) != NULL) {
+        TAILQ_REMOVE(&pmsg->miss_waitq, wmsg, b_tqe);
+
+        ASSERT(wmsg->request && !wmsg->done);
+
+        /* the client closed its connection while waiting */
+        if (wmsg->swallow) {
+            req_put(wmsg);
+            continue;
+        }
+
+        backend_batch_reply(wmsg, wmsg->narg - 2);
+    }
+
+    backend_miss_done(pmsg, NULL);
+    req_put(pmsg);
+    return true;
+}
+
+/**.......................................................................
+ * Invalidate the values the L1 cache holds of the keys of a client
+ * request, unless it is a read, which leaves its keys as they are
+ */
+void
+backend_l1_invalidate(struct conn* c_conn, struct msg* msg)
+{
+    struct server_pool* pool = c_conn->owner;
+    struct keypos* kpos;
+    uint32_t i;
+
+    if (!l1_cache_enabled(pool->l1_cache)) {
+        return;
+    }
+
+    switch (msg->type) {
+    case MSG_REQ_REDIS_GET:
+    case MSG_REQ_REDIS_MGET:
+    case MSG_REQ_REDIS_EXISTS:
+    case MSG_REQ_REDIS_TTL:
+    case MSG_REQ_REDIS_PTTL:
+    case MSG_REQ_REDIS_STRLEN:
+    case MSG_REQ_REDIS_GETRANGE:
+    case MSG_REQ_REDIS_TYPE:
+    case MSG_REQ_REDIS_DUMP:
+    case MSG_REQ_REDIS_SMEMBERS:
+    case MSG_REQ_REDIS_SISMEMBER:
+    case MSG_REQ_REDIS_SCARD:
+    case MSG_REQ_REDIS_SRANDMEMBER:
+    case MSG_REQ_REDIS_SDIFF:
+    case MSG_REQ_REDIS_SINTER:
+    case MSG_REQ_REDIS_SUNION:
+        return;
+
+    default:
+        break;
+    }
+
+    for (i = 0; i < array_n(msg->keys); i++) {
+        kpos = array_get(msg->keys, i);
+        l1_cache_del(pool->l1_cache, kpos->start,
+                     (uint32_t)(kpos->end - kpos->start));
+    }
+}
+
+/**.......................................................................
+ * Cache the value of a GET of a key in the L1 cache, read from a
+ * frontend server or filled from the backend, with the ttl of its
+ * bucket
+ */
+void
+backend_l1_fill(struct conn* c_conn, struct msg* pmsg, uint8_t* key,
+                uint32_t keylen, struct msg_pos* val, uint32_t vlen)
+{
+    struct server_pool* pool = c_conn->owner;
+
+    if (!l1_cache_enabled(pool->l1_cache)) {
+        return;
+    }
+
+    l1_cache_put(pool->l1_cache, key, keylen, val, vlen,
+                 backend_key_prop(pool, key, keylen, server_pool_bucket_ttl),
+                 pmsg->l1_seq);
+}
@@ -20,11 +20,69 @@
 
 #include <nc_core.h>
 
+/*
+ * Prefix of the frontend key of the not-found marker of a key known to
+ * be missing from the backend, written for buckets with a negative_ttl.
+ * The marker is kept on the frontend server of the key, under a key of
+ * the proxy's own which client requests cannot name (see
+ * backend_key_reserved)
+ */
+#define BACKEND_NIL_PREFIX      "\0nc_nil:"
+#define BACKEND_NIL_PREFIX_LEN  (sizeof(BACKEND_NIL_PREFIX) - 1)
+
+/*
+ * Write of a set to a frontend server as a cache fill, member by member,
+ * see backend_set_fill_init
+ */
+struct backend_set_fill {
+    struct context *ctx;
+    struct conn    *c_conn;       /* client connection the fill is made on */
+    struct conn    *s_conn;       /* frontend server of the key, NULL once failed */
+    uint8_t        *key;          /* key of the set */
+    uint32_t       keylen;        /* key length */
+    uint8_t        *dst;          /* key the members are added to, key or a scratch key */
+    uint32_t       dstlen;        /* dst length */
+    int64_t        ttl;           /* expiry of the set in msec */
+    struct msg     *msg;          /* SADD being filled */
+    uint32_t       left;          /* # members left to add */
+    uint32_t       nmsg;          /* # members left to add to msg */
+    uint32_t       nchunk;        /* # SADDs written */
+};
+
 typedef bool (*msg_backend_t)(struct context *ctx, struct conn *c_conn, struct msg* msg);
 typedef bool (*msg_backend_parser_t)(struct context *ctx, struct conn *c_conn, struct msg* msg);
 
 bool backend_process(struct context *ctx, struct conn *s_conn, struct msg* msg);
 struct server* get_next_backend_server(struct msg* msg, struct conn* c_conn, uint8_t* key, uint32_t keylen);
 bool backend_resend_q_empty(struct msg* msg);
+bool backend_key_reserved(struct conn* c_conn, struct msg* msg);
+bool backend_miss_join(struct context *ctx, struct msg* pmsg);
+void backend_miss_done(struct msg* pmsg, struct msg* rsp);
+void backend_fill_done(struct msg* sub);
+void backend_refresh_probe(struct context *ctx, struct conn* c_conn,
+                           struct conn* s_conn, struct msg* msg);
+void backend_nil_lookup_put(struct msg* msg);
+void backend_hedge_schedule(struct context *ctx, struct conn* s_conn,
+                            struct msg* msg);
+void backend_hedge(struct context *ctx, struct msg* pmsg);
+void backend_hedge_done(struct msg* msg);
+void backend_cut_through_put(struct msg* msg);
+bool backend_write_behind(struct context *ctx, struct conn* c_conn,
+                          struct msg* msg);
+int backend_write_behind_drain(struct context *ctx, struct server_pool* pool);
+bool backend_batchable_req(struct msg* msg);
+bool backend_counter_batch(struct context *ctx, struct conn* c_conn,
+                           struct msg* msg);
+int backend_counter_drain(struct context *ctx, struct server_pool* pool);
+bool backend_set_batch(struct context *ctx, struct conn* c_conn,
+                       struct msg* msg);
+void backend_set_drain(struct context *ctx, struct server_pool* pool);
+void backend_set_fill_init(struct backend_set_fill* fill, struct context *ctx,
+                           struct conn* c_conn, uint8_t* key, uint32_t keylen,
+                           uint32_t nval, int64_t ttl);
+void backend_set_fill_add(struct backend_set_fill* fill,
+                          const ProtobufCBinaryData* member);
+void backend_set_fill_done(struct backend_set_fill* fill);
+void backend_l1_invalidate(struct conn* c_conn, struct msg* msg);
 
 #endif
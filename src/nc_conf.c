@@ -109,6 +109,10 @@ static struct command conf_commands[] = {
       conf_set_server_ttl,
       offsetof(struct conf_pool, server_ttl_ms) },
 
+    { string("l1_cache_size"),
+      conf_set_num,
+      offsetof(struct conf_pool, l1_cache_size) },
+
     { string("servers"),
       conf_add_server,
       offsetof(struct conf_pool, server) },
@@ -169,6 +173,26 @@ static struct command conf_commands[] = {
       conf_set_num,
       offsetof(struct conf_pool, backend_riak_deletedvclock) },
 
+    { string("backend_vclock_cache"),
+      conf_set_num,
+      offsetof(struct conf_pool, backend_vclock_cache) },
+
+    { string("backend_hedge_percentile"),
+      conf_set_num,
+      offsetof(struct conf_pool, backend_hedge_percentile) },
+
+    { string("backend_write_behind"),
+      conf_set_num,
+      offsetof(struct conf_pool, backend_write_behind) },
+
+    { string("backend_collapse_rate"),
+      conf_set_num,
+      offsetof(struct conf_pool, backend_collapse_rate) },
+
+    { string("backend_counter_window"),
+      conf_set_num,
+      offsetof(struct conf_pool, backend_counter_window) },
+
     null_command
 };
 
@@ -227,6 +251,9 @@ conf_server_each_transform(void *elem, void *data)
     s->next_retry = 0LL;
     s->failure_count = 0;
 
+    s->nlatency = 0;
+    s->hedge_delay = 0LL;
+
     s->backend = cs->backend;
 
     log_debug(LOG_VERB, "transform to server %"PRIu32" '%.*s'",
@@ -266,6 +293,7 @@ conf_pool_init(struct conf_pool *cp, struct string *name)
     cp->server_retry_timeout = CONF_UNSET_NUM;
     cp->server_failure_limit = CONF_UNSET_NUM;
     cp->server_ttl_ms = CONF_UNSET_NUM;
+    cp->l1_cache_size = CONF_UNSET_NUM;
 
     cp->backend_type = CONN_UNKNOWN;
     cp->backend_max_resend = CONF_UNSET_NUM;
@@ -279,6 +307,11 @@ conf_pool_init(struct conf_pool *cp, struct string *name)
     cp->backend_riak_notfound_ok = CONF_UNSET_NUM;
     cp->backend_riak_deletedvclock = CONF_UNSET_NUM;
     cp->backend_riak_timeout = CONF_UNSET_NUM;
+    cp->backend_vclock_cache = CONF_UNSET_NUM;
+    cp->backend_hedge_percentile = CONF_UNSET_NUM;
+    cp->backend_write_behind = CONF_UNSET_NUM;
+    cp->backend_collapse_rate = CONF_UNSET_NUM;
+    cp->backend_counter_window = CONF_UNSET_NUM;
 
     array_null(&cp->server);
 
@@ -358,6 +391,7 @@ conf_pool_each_transform(void *elem, void *data)
     struct conf_pool *cp = elem;
     struct array *server_pool = data;
     struct server_pool *sp;
+    uint32_t slot;
 
     ASSERT(cp->valid);
 
@@ -371,6 +405,13 @@ conf_pool_each_transform(void *elem, void *data)
     sp->nc_conn_q = 0;
     TAILQ_INIT(&sp->c_conn_q);
 
+    for (slot = 0; slot < SERVER_POOL_MISSQ_NSLOT; slot++) {
+        TAILQ_INIT(&sp->backend_missq[slot]);
+        TAILQ_INIT(&sp->backend_batchq[slot]);
+    }
+    TAILQ_INIT(&sp->backend_counter_dueq);
+    TAILQ_INIT(&sp->backend_set_dueq);
+
     array_null(&sp->frontends.server_arr);
     sp->frontends.owner = sp;
     sp->frontends.ncontinuum = 0;
@@ -413,6 +454,14 @@ conf_pool_each_transform(void *elem, void *data)
     sp->server_retry_timeout = (int64_t)cp->server_retry_timeout * 1000LL;
     sp->server_failure_limit = (uint32_t)cp->server_failure_limit;
     sp->server_ttl_ms = (uint32_t)cp->server_ttl_ms;
+    sp->l1_cache_size = cp->l1_cache_size;
+    sp->l1_cache = NULL;
+    if (cp->l1_cache_size > 0) {
+        sp->l1_cache = l1_cache_create((size_t)cp->l1_cache_size, sp->key_hash);
+        if (sp->l1_cache == NULL) {
+            return NC_ENOMEM;
+        }
+    }
     sp->auto_eject_hosts = cp->auto_eject_hosts ? 1 : 0;
     sp->preconnect = cp->preconnect ? 1 : 0;
 
@@ -439,6 +488,27 @@ conf_pool_each_transform(void *elem, void *data)
     sp->backend_opt.riak_notfound_ok = cp->backend_riak_notfound_ok;
     sp->backend_opt.riak_deletedvclock = cp->backend_riak_deletedvclock;
     sp->backend_opt.riak_timeout = cp->backend_riak_timeout;
+    sp->backend_opt.vclock_cache = cp->backend_vclock_cache;
+    sp->backend_opt.hedge_percentile = cp->backend_hedge_percentile;
+    sp->backend_opt.write_behind = cp->backend_write_behind;
+    sp->backend_opt.collapse_rate = cp->backend_collapse_rate;
+    sp->backend_opt.counter_window = cp->backend_counter_window;
+    sp->vclock_cache = NULL;
+    if (cp->backend_vclock_cache > 0) {
+        sp->vclock_cache = vclock_cache_create((uint32_t)cp->backend_vclock_cache,
+                                               sp->key_hash);
+        if (sp->vclock_cache == NULL) {
+            return NC_ENOMEM;
+        }
+    }
+    sp->write_behind = NULL;
+    if (cp->backend_write_behind > 0) {
+        sp->write_behind = write_behind_create((uint32_t)cp->backend_write_behind,
+                                               sp->key_hash);
+        if (sp->write_behind == NULL) {
+            return NC_ENOMEM;
+        }
+    }
     array_null(&sp->backend_opt.bucket_prop);
     /* move buckets properties */
     uint32_t nbucket_prop = array_n(&cp->bucket_prop);
@@ -453,6 +523,33 @@ conf_pool_each_transform(void *elem, void *data)
             } else {
                 nbp->ttl_ms = bp->ttl_ms;
             }
+            if (bp->write_mode == CONF_UNSET_NUM) {
+                nbp->write_mode = WRITE_MODE_READ_BEFORE_WRITE;
+            } else {
+                nbp->write_mode = bp->write_mode;
+            }
+            if (bp->negative_ttl_ms == CONF_UNSET_NUM) {
+                nbp->negative_ttl_ms = 0;
+            } else {
+                nbp->negative_ttl_ms = bp->negative_ttl_ms;
+            }
+            if (bp->grace_ms == CONF_UNSET_NUM) {
+                nbp->grace_ms = 0;
+            } else {
+                nbp->grace_ms = bp->grace_ms;
+            }
+            if (bp->write_behind_ms == CONF_UNSET_NUM) {
+                nbp->write_behind_ms = 0;
+            } else {
+                nbp->write_behind_ms = bp->write_behind_ms;
+            }
+            if (bp->max_siblings == CONF_UNSET_NUM) {
+                nbp->max_siblings = 0;
+            } else {
+                nbp->max_siblings = bp->max_siblings;
+            }
+            nbp->collapse_window_ms = 0;
+            nbp->ncollapse = 0;
             nbp->datatype = bp->datatype;
             nbp->bucket = bp->bucket;
         }
@@ -534,10 +631,13 @@ conf_dump(struct conf *cf)
         log_debug(LOG_VVERB, "  buckets properties: %"PRIu32"", nbucket_prop);
         for (j = 0; j < nbucket_prop; j++) {
             bp = array_get(&cp->bucket_prop, j);
-            log_debug(LOG_VVERB, "    %.*s:%.*s ttl:%"PRIi64" ms",
+            log_debug(LOG_VVERB, "    %.*s:%.*s ttl:%"PRIi64" ms write_mode:%d "
+                      "negative_ttl:%"PRIi64" ms grace:%"PRIi64" ms "
+                      "write_behind:%"PRIi64" ms max_siblings:%d",
                       bp->datatype.len, bp->datatype.data,
                       bp->bucket.len, bp->bucket.data,
-                      bp->ttl_ms);
+                      bp->ttl_ms, bp->write_mode, bp->negative_ttl_ms,
+                      bp->grace_ms, bp->write_behind_ms, bp->max_siblings);
         }
     }
 }
@@ -1447,6 +1547,10 @@ conf_validate_pool(struct conf *cf, struct conf_pool *cp)
         cp->server_ttl_ms = CONF_DEFAULT_SERVER_TTL_MS;
     }
 
+    if (cp->l1_cache_size == CONF_UNSET_NUM) {
+        cp->l1_cache_size = CONF_DEFAULT_L1_CACHE_SIZE;
+    }
+
     if (cp->backend_type == CONN_UNKNOWN) {
         cp->backend_type = CONF_DEFAULT_BACKEND_TYPE;
     }
@@ -1457,6 +1561,30 @@ conf_validate_pool(struct conf *cf, struct conf_pool *cp)
         cp->backend_max_resend = 1;
     }
 
+    if (cp->backend_vclock_cache == CONF_UNSET_NUM) {
+        cp->backend_vclock_cache = CONF_DEFAULT_BACKEND_VCLOCK_CACHE;
+    }
+
+    if (cp->backend_hedge_percentile == CONF_UNSET_NUM) {
+        cp->backend_hedge_percentile = CONF_DEFAULT_BACKEND_HEDGE_PERCENTILE;
+    } else if (cp->backend_hedge_percentile >= 100) {
+        log_error("conf: directive \"backend_hedge_percentile:\" must be "
+                  "less than 100");
+        return NC_ERROR;
+    }
+
+    if (cp->backend_write_behind == CONF_UNSET_NUM) {
+        cp->backend_write_behind = CONF_DEFAULT_BACKEND_WRITE_BEHIND;
+    }
+
+    if (cp->backend_collapse_rate == CONF_UNSET_NUM) {
+        cp->backend_collapse_rate = CONF_DEFAULT_BACKEND_COLLAPSE_RATE;
+    }
+
+    if (cp->backend_counter_window == CONF_UNSET_NUM) {
+        cp->backend_counter_window = CONF_DEFAULT_BACKEND_COUNTER_WINDOW;
+    }
+
     status = conf_validate_server(cf, cp);
     if (status != NC_OK) {
         return status;
@@ -1868,10 +1996,20 @@ conf_add_bucket_prop(struct conf *cf, struct command *cmd, void *conf)
 {
     typedef enum {
         BPR_NONE,
-        BPR_TTL
+        BPR_TTL,
+        BPR_WRITE_MODE,
+        BPR_NEGATIVE_TTL,
+        BPR_GRACE,
+        BPR_WRITE_BEHIND,
+        BPR_MAX_SIBLINGS
     } BP_READSTATE;
 
     const struct string ttl_str = string("ttl");
+    const struct string write_mode_str = string("write_mode");
+    const struct string negative_ttl_str = string("negative_ttl");
+    const struct string grace_str = string("grace");
+    const struct string write_behind_str = string("write_behind");
+    const struct string max_siblings_str = string("max_siblings");
     struct array *a;
     struct string value;
     struct bucket_prop *field;
@@ -1895,6 +2033,11 @@ conf_add_bucket_prop(struct conf *cf, struct command *cmd, void *conf)
     }
     // Init default values for fields
     field->ttl_ms = CONF_UNSET_NUM;
+    field->write_mode = CONF_UNSET_NUM;
+    field->negative_ttl_ms = CONF_UNSET_NUM;
+    field->grace_ms = CONF_UNSET_NUM;
+    field->write_behind_ms = CONF_UNSET_NUM;
+    field->max_siblings = CONF_UNSET_NUM;
 
     bool done = false;
     bool error = false;
@@ -1915,6 +2058,16 @@ conf_add_bucket_prop(struct conf *cf, struct command *cmd, void *conf)
             case BPR_NONE:
                 if (string_compare(&value, &ttl_str) == 0) {
                     state = BPR_TTL;
+                } else if (string_compare(&value, &write_mode_str) == 0) {
+                    state = BPR_WRITE_MODE;
+                } else if (string_compare(&value, &negative_ttl_str) == 0) {
+                    state = BPR_NEGATIVE_TTL;
+                } else if (string_compare(&value, &grace_str) == 0) {
+                    state = BPR_GRACE;
+                } else if (string_compare(&value, &write_behind_str) == 0) {
+                    state = BPR_WRITE_BEHIND;
+                } else if (string_compare(&value, &max_siblings_str) == 0) {
+                    state = BPR_MAX_SIBLINGS;
                 } else if (value.len) {
                     error = true;
                 }
@@ -1923,6 +2076,27 @@ conf_add_bucket_prop(struct conf *cf, struct command *cmd, void *conf)
                 error = !nc_read_ttl_value(&value, &field->ttl_ms);
                 state = BPR_NONE;
                 break;
+            case BPR_WRITE_MODE:
+                error = !server_read_write_mode(&value, &field->write_mode);
+                state = BPR_NONE;
+                break;
+            case BPR_NEGATIVE_TTL:
+                error = !nc_read_ttl_value(&value, &field->negative_ttl_ms);
+                state = BPR_NONE;
+                break;
+            case BPR_GRACE:
+                error = !nc_read_ttl_value(&value, &field->grace_ms);
+                state = BPR_NONE;
+                break;
+            case BPR_WRITE_BEHIND:
+                error = !nc_read_ttl_value(&value, &field->write_behind_ms);
+                state = BPR_NONE;
+                break;
+            case BPR_MAX_SIBLINGS:
+                field->max_siblings = nc_atoi(value.data, value.len);
+                error = field->max_siblings < 0;
+                state = BPR_NONE;
+                break;
             }
             break;
         default:
@@ -2272,6 +2446,25 @@ conf_write_buckets_props(yaml_emitter_t *emitter, const char *name,
 
         /* write each bucket props */
         conf_write_key_value_time(emitter, "ttl", bp->ttl_ms);
+        if (bp->write_mode != WRITE_MODE_READ_BEFORE_WRITE) {
+            conf_write_key_value_string(emitter, "write_mode",
+                                        &write_mode_strings[bp->write_mode]);
+        }
+        if (bp->negative_ttl_ms > 0) {
+            conf_write_key_value_time(emitter, "negative_ttl",
+                                      bp->negative_ttl_ms);
+        }
+        if (bp->grace_ms > 0) {
+            conf_write_key_value_time(emitter, "grace", bp->grace_ms);
+        }
+        if (bp->write_behind_ms > 0) {
+            conf_write_key_value_time(emitter, "write_behind",
+                                      bp->write_behind_ms);
+        }
+        if (bp->max_siblings > 0) {
+            conf_write_key_value_int(emitter, "max_siblings",
+                                     bp->max_siblings);
+        }
 
         /* close bucket properties list */
         if (!yaml_mapping_end_event_initialize(&event)) {
@@ -2446,6 +2639,10 @@ conf_write_pool(yaml_emitter_t *emitter, struct server_pool *pool)
         res = conf_write_key_value_time(emitter, "server_ttl",
                                         pool->server_ttl_ms);
     }
+    if(res) {
+        res = conf_write_key_value_int(emitter, "l1_cache_size",
+                                       pool->l1_cache_size);
+    }
     if(res) {
         res = conf_write_buckets_props(emitter, "buckets",
                                        &pool->backend_opt.bucket_prop);
@@ -2507,6 +2704,26 @@ conf_write_pool(yaml_emitter_t *emitter, struct server_pool *pool)
         res = conf_write_key_value_int(emitter, "backend_riak_deletedvclock",
                                        pool->backend_opt.riak_deletedvclock);
     }
+    if(res) {
+        res = conf_write_key_value_int(emitter, "backend_vclock_cache",
+                                       pool->backend_opt.vclock_cache);
+    }
+    if(res) {
+        res = conf_write_key_value_int(emitter, "backend_hedge_percentile",
+                                       pool->backend_opt.hedge_percentile);
+    }
+    if(res) {
+        res = conf_write_key_value_int(emitter, "backend_write_behind",
+                                       pool->backend_opt.write_behind);
+    }
+    if(res) {
+        res = conf_write_key_value_int(emitter, "backend_collapse_rate",
+                                       pool->backend_opt.collapse_rate);
+    }
+    if(res) {
+        res = conf_write_key_value_int(emitter, "backend_counter_window",
+                                       pool->backend_opt.counter_window);
+    }
 
     /* close pool record */
     if (!yaml_mapping_end_event_initialize(&event)) {
@@ -56,10 +56,16 @@
 #define CONF_DEFAULT_SERVER_FAILURE_LIMIT    2
 #define CONF_DEFAULT_SERVER_CONNECTIONS      1
 #define CONF_DEFAULT_SERVER_TTL_MS           0              /* Never */
+#define CONF_DEFAULT_L1_CACHE_SIZE           0              /* Disabled */
 #define CONF_DEFAULT_KETAMA_PORT             11211
 
 #define CONF_DEFAULT_BACKEND_TYPE            CONN_RIAK
 #define CONF_DEFAULT_BACKEND_MAX_RESEND      1
+#define CONF_DEFAULT_BACKEND_VCLOCK_CACHE    0
+#define CONF_DEFAULT_BACKEND_HEDGE_PERCENTILE 0
+#define CONF_DEFAULT_BACKEND_WRITE_BEHIND    1024
+#define CONF_DEFAULT_BACKEND_COLLAPSE_RATE   10
+#define CONF_DEFAULT_BACKEND_COUNTER_WINDOW  0
 
 struct conf_listen {
     struct string   pname;   /* listen: as "name:port" */
@@ -112,7 +118,13 @@ struct conf_pool {
     int                backend_riak_notfound_ok;   /* Riak notfound_ok */
     int                backend_riak_deletedvclock; /* Riak deletedvclock */
     int                backend_riak_timeout;       /* Riak timeout */
+    int                backend_vclock_cache;       /* # vclocks cached to skip read-before-write */
+    int                backend_hedge_percentile;   /* latency percentile to hedge reads at */
+    int                backend_write_behind;       /* max # writes queued for write-behind */
+    int                backend_collapse_rate;      /* max # sibling collapses per bucket per sec */
+    int                backend_counter_window;     /* msec counter updates are batched for */
     int64_t            server_ttl_ms;              /* TTL for keys in frontend servers, in msec */
+    int                l1_cache_size;              /* bytes of values cached in the proxy */
     unsigned           valid:1;               /* valid? */
 };
 
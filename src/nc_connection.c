@@ -133,6 +133,10 @@ _conn_get(void)
     TAILQ_INIT(&conn->omsg_q);
     conn->rmsg = NULL;
     conn->smsg = NULL;
+    conn->ordered_first = NULL;
+    conn->nenqueued = 0;
+    conn->nordered = 0;
+    conn->nunbatchable = 0;
 
     /*
      * Callbacks {recv, recv_next, recv_done}, {send, send_next, send_done},
@@ -53,6 +53,10 @@ struct conn {
     struct msg_tqh      omsg_q;        /* outstanding request Q */
     struct msg          *rmsg;         /* current message being rcvd */
     struct msg          *smsg;         /* current message being sent */
+    struct msg          *ordered_first; /* no outstanding ordered request in omsg_q precedes it, for client */
+    uint64_t            nenqueued;     /* # requests enqueued in omsg_q, for client */
+    uint32_t            nordered;      /* # outstanding ordered requests in omsg_q, for client */
+    uint32_t            nunbatchable;  /* # outstanding requests in omsg_q other than batchable updates, for client */
 
     STAILQ_ENTRY(conn)  resend_stqe;   /* link in msg's resend q */
 
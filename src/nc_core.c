@@ -164,6 +164,7 @@ core_start(struct instance *nci)
     struct context *ctx;
 
     mbuf_init(nci);
+    arena_init();
     msg_init();
     conn_init();
 
@@ -175,6 +176,7 @@ core_start(struct instance *nci)
 
     conn_deinit();
     msg_deinit();
+    arena_deinit();
     mbuf_deinit();
 
     return NULL;
@@ -185,6 +187,7 @@ core_stop(struct context *ctx)
 {
     conn_deinit();
     msg_deinit();
+    arena_deinit();
     mbuf_deinit();
     core_ctx_destroy(ctx);
 }
@@ -347,6 +350,75 @@ core_timeout(struct context *ctx)
     }
 }
 
+/**.......................................................................
+ * Hedge the backend reads which have outlasted their hedge delay
+ */
+static void
+core_hedge(struct context *ctx)
+{
+    for (;;) {
+        struct msg *msg;
+        int64_t now, then;
+
+        msg = msg_hedge_min();
+        if (msg == NULL) {
+            return;
+        }
+
+        then = msg->hedge_rbe.key;
+
+        now = nc_msec_now();
+        if (now < then) {
+            int delta = (int)(then - now);
+            ctx->timeout = MIN(delta, ctx->timeout);
+            return;
+        }
+
+        backend_hedge(ctx, msg);
+    }
+}
+
+/**.......................................................................
+ * Write the queued write-behind SETs which are due to the backend
+ */
+static void
+core_write_behind(struct context *ctx)
+{
+    uint32_t i, npool;
+
+    for (i = 0, npool = array_n(&ctx->pool); i < npool; i++) {
+        struct server_pool *pool = array_get(&ctx->pool, i);
+        int delta;
+
+        delta = backend_write_behind_drain(ctx, pool);
+        if (delta >= 0) {
+            ctx->timeout = MIN(delta, ctx->timeout);
+        }
+    }
+}
+
+/**.......................................................................
+ * Write the batches of backend updates which are due to the backend: the
+ * counter updates whose window is up, and the set updates of this tick
+ */
+static void
+core_batches(struct context *ctx)
+{
+    uint32_t i, npool;
+
+    for (i = 0, npool = array_n(&ctx->pool); i < npool; i++) {
+        struct server_pool *pool = array_get(&ctx->pool, i);
+        int delta;
+
+        delta = backend_counter_drain(ctx, pool);
+        if (delta >= 0) {
+            ctx->timeout = MIN(delta, ctx->timeout);
+        }
+
+        backend_set_drain(ctx, pool);
+    }
+}
+
 rstatus_t
 core_core(void *arg, uint32_t events)
 {
@@ -509,6 +581,11 @@ core_loop(struct context *ctx)
     }
 
     core_timeout(ctx);
+    core_hedge(ctx);
+    core_write_behind(ctx);
+    core_batches(ctx);
+
+    arena_reset();
 
     stats_swap(ctx->stats);
 
@@ -115,9 +115,13 @@ struct event_base;
 #include <event/nc_event.h>
 #include <nc_stats.h>
 #include <nc_mbuf.h>
+#include <nc_arena.h>
 #include <nc_message.h>
 #include <nc_connection.h>
 #include <nc_server.h>
+#include <nc_vclock.h>
+#include <nc_write_behind.h>
+#include <nc_l1cache.h>
 
 struct context {
     uint32_t           id;          /* unique context id */
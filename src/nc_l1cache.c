@@ -0,0 +1,249 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nc_core.h>
+#include <nc_l1cache.h>
+
+struct l1_cache *
+l1_cache_create(size_t max_bytes, hash_t key_hash)
+{
+    struct l1_cache *l1;
+    uint32_t i;
+
+    ASSERT(max_bytes > 0);
+
+    l1 = nc_alloc(sizeof(*l1));
+    if (l1 == NULL) {
+        return NULL;
+    }
+
+    l1->nslot = (uint32_t)(max_bytes / L1_CACHE_SLOT_BYTES);
+    if (l1->nslot == 0) {
+        l1->nslot = 1;
+    }
+
+    l1->slot = nc_alloc(sizeof(*l1->slot) * l1->nslot);
+    if (l1->slot == NULL) {
+        nc_free(l1);
+        return NULL;
+    }
+
+    l1->nbytes = 0;
+    l1->max_bytes = max_bytes;
+    l1->nentry = 0;
+    l1->seq = 0;
+    l1->key_hash = key_hash;
+    TAILQ_INIT(&l1->lru_q);
+
+    for (i = 0; i < l1->nslot; i++) {
+        TAILQ_INIT(&l1->slot[i].entry_q);
+        l1->slot[i].seq = 0;
+    }
+
+    return l1;
+}
+
+static void
+l1_entry_free(struct l1_cache *l1, struct l1_entry *le)
+{
+    TAILQ_REMOVE(&l1->slot[le->hash % l1->nslot].entry_q, le, h_tqe);
+    TAILQ_REMOVE(&l1->lru_q, le, l_tqe);
+    l1->nentry--;
+    l1->nbytes -= le->size;
+
+    /* the key and the reply are held in the entry's own memory */
+    nc_free(le);
+}
+
+void
+l1_cache_destroy(struct l1_cache *l1)
+{
+    if (l1 == NULL) {
+        return;
+    }
+
+    while (!TAILQ_EMPTY(&l1->lru_q)) {
+        l1_entry_free(l1, TAILQ_FIRST(&l1->lru_q));
+    }
+    ASSERT(l1->nentry == 0 && l1->nbytes == 0);
+
+    nc_free(l1->slot);
+    nc_free(l1);
+}
+
+bool
+l1_cache_enabled(const struct l1_cache *l1)
+{
+    return l1 != NULL;
+}
+
+/**.......................................................................
+ * Return the sequence number to stamp a read with as it is received, for
+ * l1_cache_put
+ */
+uint64_t
+l1_cache_seq(const struct l1_cache *l1)
+{
+    return l1_cache_enabled(l1) ? l1->seq : 0;
+}
+
+static struct l1_entry *
+l1_cache_lookup(struct l1_cache *l1, uint8_t *key, uint32_t keylen,
+                uint32_t hash)
+{
+    struct l1_entry *le;
+
+    TAILQ_FOREACH(le, &l1->slot[hash % l1->nslot].entry_q, h_tqe) {
+        if (le->hash == hash && le->key.len == keylen &&
+            memcmp(le->key.data, key, keylen) == 0) {
+            return le;
+        }
+    }
+
+    return NULL;
+}
+
+/**.......................................................................
+ * Look up the reply cached for key.  An expired entry is dropped as it
+ * is found.  On a hit, the entry is only valid until the cache is next
+ * updated
+ */
+struct l1_entry *
+l1_cache_get(struct l1_cache *l1, uint8_t *key, uint32_t keylen)
+{
+    struct l1_entry *le;
+
+    if (!l1_cache_enabled(l1) || keylen == 0) {
+        return NULL;
+    }
+
+    le = l1_cache_lookup(l1, key, keylen, l1->key_hash((char *)key, keylen));
+    if (le == NULL) {
+        return NULL;
+    }
+
+    if (le->expire != 0 && le->expire <= nc_msec_now()) {
+        l1_entry_free(l1, le);
+        return NULL;
+    }
+
+    TAILQ_REMOVE(&l1->lru_q, le, l_tqe);
+    TAILQ_INSERT_HEAD(&l1->lru_q, le, l_tqe);
+
+    return le;
+}
+
+/**.......................................................................
+ * Cache the vlen bytes of the value of key at val, as a bulk reply which
+ * expires in ttl_ms, or never for 0.  The value is not cached if the key
+ * was invalidated since seq, when its read was received, or if it is
+ * too large for the budget.  The least recently used entries are evicted
+ * to make room for it
+ */
+void
+l1_cache_put(struct l1_cache *l1, uint8_t *key, uint32_t keylen,
+             struct msg_pos *val, uint32_t vlen, int64_t ttl_ms,
+             uint64_t seq)
+{
+    struct l1_entry *le;
+    struct msg_pos pos;
+    char hdr[1 + NC_UINT32_MAXLEN + CRLF_LEN];
+    uint32_t hash, hdrlen;
+    size_t size;
+    uint8_t *p;
+
+    if (!l1_cache_enabled(l1) || keylen == 0) {
+        return;
+    }
+
+    hash = l1->key_hash((char *)key, keylen);
+
+    /* the key was written while its value was read */
+    if (l1->slot[hash % l1->nslot].seq > seq) {
+        return;
+    }
+
+    le = l1_cache_lookup(l1, key, keylen, hash);
+    if (le != NULL) {
+        l1_entry_free(l1, le);
+    }
+
+    hdrlen = (uint32_t)nc_snprintf(hdr, sizeof(hdr), "$%"PRIu32"\r\n", vlen);
+    size = sizeof(*le) + keylen + hdrlen + vlen + CRLF_LEN;
+    if (size > l1->max_bytes / L1_CACHE_ENTRY_SHARE) {
+        return;
+    }
+
+    le = nc_alloc(size);
+    if (le == NULL) {
+        return;
+    }
+
+    p = (uint8_t *)(le + 1);
+    le->key.data = p;
+    le->key.len = keylen;
+    nc_memcpy(p, key, keylen);
+    p += keylen;
+
+    le->rsp.data = p;
+    le->rsp.len = hdrlen + vlen + (uint32_t)CRLF_LEN;
+    nc_memcpy(p, hdr, hdrlen);
+    p += hdrlen;
+    pos = *val;
+    if (msg_extract_from_pos(p, &pos, vlen) != NC_OK) {
+        nc_free(le);
+        return;
+    }
+    p += vlen;
+    nc_memcpy(p, CRLF, CRLF_LEN);
+
+    le->hash = hash;
+    le->size = (uint32_t)size;
+    le->expire = (ttl_ms > 0) ? nc_msec_now() + ttl_ms : 0;
+
+    while (l1->nbytes + size > l1->max_bytes) {
+        l1_entry_free(l1, TAILQ_LAST(&l1->lru_q, l1_tqh));
+    }
+
+    TAILQ_INSERT_HEAD(&l1->slot[hash % l1->nslot].entry_q, le, h_tqe);
+    TAILQ_INSERT_HEAD(&l1->lru_q, le, l_tqe);
+    l1->nentry++;
+    l1->nbytes += size;
+}
+
+/**.......................................................................
+ * Invalidate key, as it is written: drop its entry, and keep the value
+ * of any read of it already in flight from being cached
+ */
+void
+l1_cache_del(struct l1_cache *l1, uint8_t *key, uint32_t keylen)
+{
+    struct l1_entry *le;
+    uint32_t hash;
+
+    if (!l1_cache_enabled(l1) || keylen == 0) {
+        return;
+    }
+
+    hash = l1->key_hash((char *)key, keylen);
+    l1->slot[hash % l1->nslot].seq = ++l1->seq;
+
+    le = l1_cache_lookup(l1, key, keylen, hash);
+    if (le != NULL) {
+        l1_entry_free(l1, le);
+    }
+}
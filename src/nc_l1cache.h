@@ -0,0 +1,86 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NC_L1CACHE_H_
+#define _NC_L1CACHE_H_
+
+#include <nc_core.h>
+
+/*
+ * The L1 cache holds, in the proxy's own memory, the values of the keys
+ * of a server_pool most recently read by a GET, each as the Redis bulk
+ * reply it is answered with, so that a GET of one of them is answered
+ * without a round trip to a frontend server.  It is filled from the
+ * values of frontend hits and of backend fills, which expire with the
+ * ttl of their bucket, and is invalidated by any write of a key.
+ *
+ * Entries are kept in hash slots and in a LRU queue; the least recently
+ * used entries are evicted to keep the memory of the entries within
+ * max_bytes.  A pool without a L1 cache has a NULL one, which all of the
+ * functions below accept.
+ *
+ * A read in flight while its key is invalidated may have read the value
+ * the write replaced: every invalidation takes the next sequence number,
+ * which its slot remembers, and the value of a read stamped with an older
+ * sequence number than that of its slot is not cached.
+ */
+
+/* # bytes of the budget per hash slot */
+#define L1_CACHE_SLOT_BYTES     1024
+
+/* a value is cached only if its entry takes at most 1/Nth of the budget */
+#define L1_CACHE_ENTRY_SHARE    16
+
+struct l1_entry {
+    TAILQ_ENTRY(l1_entry)     h_tqe;         /* link in hash slot */
+    TAILQ_ENTRY(l1_entry)     l_tqe;         /* link in lru q */
+    uint32_t                  hash;          /* key hash */
+    uint32_t                  size;          /* # bytes held by the entry */
+    int64_t                   expire;        /* expiry time in msec, 0 for never */
+    struct string             key;           /* key, in the entry's memory */
+    struct string             rsp;           /* bulk reply, in the entry's memory */
+};
+
+TAILQ_HEAD(l1_tqh, l1_entry);
+
+struct l1_slot {
+    struct l1_tqh             entry_q;       /* entries of the slot */
+    uint64_t                  seq;           /* seq of its last invalidation */
+};
+
+struct l1_cache {
+    size_t                    nbytes;        /* # bytes held by the entries */
+    size_t                    max_bytes;     /* max # bytes held by the entries */
+    uint32_t                  nentry;        /* # cached entries */
+    uint32_t                  nslot;         /* # hash slots */
+    struct l1_slot            *slot;         /* hash slots */
+    struct l1_tqh             lru_q;         /* entries, most recently used first */
+    uint64_t                  seq;           /* seq of the last invalidation */
+    hash_t                    key_hash;      /* key hasher */
+};
+
+struct l1_cache *l1_cache_create(size_t max_bytes, hash_t key_hash);
+void l1_cache_destroy(struct l1_cache *l1);
+bool l1_cache_enabled(const struct l1_cache *l1);
+uint64_t l1_cache_seq(const struct l1_cache *l1);
+struct l1_entry *l1_cache_get(struct l1_cache *l1, uint8_t *key, uint32_t keylen);
+void l1_cache_put(struct l1_cache *l1, uint8_t *key, uint32_t keylen,
+                  struct msg_pos *val, uint32_t vlen, int64_t ttl_ms,
+                  uint64_t seq);
+void l1_cache_del(struct l1_cache *l1, uint8_t *key, uint32_t keylen);
+
+#endif
@@ -23,6 +23,9 @@
 static uint32_t nfree_mbufq;   /* # free mbuf */
 static struct mhdr free_mbufq; /* free mbuf q */
 
+static uint32_t nfree_sliceq;   /* # free slice */
+static struct mhdr free_sliceq; /* free slice q, of headers alone */
+
 static size_t mbuf_chunk_size; /* mbuf chunk size - header + data (const) */
 static size_t mbuf_offset;     /* mbuf offset in chunk (const) */
 
@@ -95,6 +98,8 @@ mbuf_get(void)
 
     mbuf->pos = mbuf->start;
     mbuf->last = mbuf->start;
+    mbuf->owner = NULL;
+    mbuf->nref = 1;
 
     log_debug(LOG_VVERB, "get mbuf %p", mbuf);
 
@@ -118,24 +123,93 @@ mbuf_free(struct mbuf *mbuf)
 void
 mbuf_put(struct mbuf *mbuf)
 {
+    struct mbuf *owner;
+
     log_debug(LOG_VVERB, "put mbuf %p len %d", mbuf, mbuf->last - mbuf->pos);
 
     ASSERT(STAILQ_NEXT(mbuf, next) == NULL);
     ASSERT(mbuf->magic == MBUF_MAGIC);
 
+    owner = mbuf->owner;
+    if (owner != NULL) {
+        /* a slice is a header alone, its data is released with its owner */
+        mbuf->owner = NULL;
+        nfree_sliceq++;
+        STAILQ_INSERT_HEAD(&free_sliceq, mbuf, next);
+        mbuf = owner;
+    }
+
+    ASSERT(mbuf->nref > 0);
+    if (--mbuf->nref > 0) {
+        return;
+    }
+
     nfree_mbufq++;
     STAILQ_INSERT_HEAD(&free_mbufq, mbuf, next);
 }
 
+/*
+ * Return a slice of the data of mbuf from pos to last, which references
+ * the data in place rather than copying it. The slice is read-only: it
+ * is full, and it is never rewound into the data of its owner.
+ */
+struct mbuf *
+mbuf_slice(struct mbuf *mbuf, uint8_t *pos, uint8_t *last)
+{
+    struct mbuf *slice, *owner;
+
+    ASSERT(mbuf->magic == MBUF_MAGIC);
+    ASSERT(pos >= mbuf->start && pos <= last && last <= mbuf->last);
+
+    if (!STAILQ_EMPTY(&free_sliceq)) {
+        ASSERT(nfree_sliceq > 0);
+
+        slice = STAILQ_FIRST(&free_sliceq);
+        nfree_sliceq--;
+        STAILQ_REMOVE_HEAD(&free_sliceq, next);
+
+        ASSERT(slice->magic == MBUF_MAGIC);
+    } else {
+        slice = nc_alloc(MBUF_HSIZE);
+        if (slice == NULL) {
+            return NULL;
+        }
+        slice->magic = MBUF_MAGIC;
+    }
+
+    /* a slice of a slice references the owner of the data */
+    owner = (mbuf->owner != NULL) ? mbuf->owner : mbuf;
+    owner->nref++;
+
+    STAILQ_NEXT(slice, next) = NULL;
+    slice->start = pos;
+    slice->pos = pos;
+    slice->last = last;
+    slice->end = last;
+    slice->owner = owner;
+    slice->nref = 0;
+
+    log_debug(LOG_VVERB, "slice mbuf %p len %d of mbuf %p", slice,
+              slice->last - slice->pos, owner);
+
+    return slice;
+}
+
 /*
  * Rewind the mbuf by discarding any of the read or unread data that it
  * might hold.
+ *
+ * The data of a shared mbuf is not written over: it is left without
+ * space for new data instead.
  */
 void
 mbuf_rewind(struct mbuf *mbuf)
 {
     mbuf->pos = mbuf->start;
     mbuf->last = mbuf->start;
+    if (mbuf_shared(mbuf)) {
+        mbuf->end = mbuf->start;
+    }
 }
 
 /*
@@ -265,6 +339,9 @@ mbuf_init(struct instance *nci)
     nfree_mbufq = 0;
     STAILQ_INIT(&free_mbufq);
 
+    nfree_sliceq = 0;
+    STAILQ_INIT(&free_sliceq);
+
     mbuf_chunk_size = nci->mbuf_chunk_size;
     mbuf_offset = mbuf_chunk_size - MBUF_HSIZE;
 
@@ -282,4 +359,12 @@ mbuf_deinit(void)
         nfree_mbufq--;
     }
     ASSERT(nfree_mbufq == 0);
+
+    while (!STAILQ_EMPTY(&free_sliceq)) {
+        struct mbuf *mbuf = STAILQ_FIRST(&free_sliceq);
+        mbuf_remove(&free_sliceq, mbuf);
+        nc_free(mbuf);
+        nfree_sliceq--;
+    }
+    ASSERT(nfree_sliceq == 0);
 }
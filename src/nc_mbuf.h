@@ -22,6 +22,11 @@
 
 typedef void (*mbuf_copy_t)(struct mbuf *, void *);
 
+/*
+ * An mbuf either holds its data, or is a slice of the data of another
+ * mbuf, its owner, see mbuf_slice.  The data of an owner is put back in
+ * the free mbuf q only once the owner and all of its slices are put
+ */
 struct mbuf {
     uint32_t           magic;   /* mbuf magic (const) */
     STAILQ_ENTRY(mbuf) next;    /* next mbuf */
@@ -29,6 +34,8 @@ struct mbuf {
     uint8_t            *last;   /* write marker */
     uint8_t            *start;  /* start of buffer (const) */
     uint8_t            *end;    /* end of buffer (const) */
+    struct mbuf        *owner;  /* mbuf holding the data of a slice, or NULL */
+    uint32_t           nref;    /* # references to the data held: mbuf + slices */
 };
 
 STAILQ_HEAD(mhdr, mbuf);
@@ -39,6 +46,12 @@ STAILQ_HEAD(mhdr, mbuf);
 #define MBUF_SIZE       16384
 #define MBUF_HSIZE      sizeof(struct mbuf)
 
+/*
+ * Data at least this long is shared by slicing the mbufs holding it,
+ * rather than copied, see msg_share
+ */
+#define MBUF_SHARE_MIN  1024
+
 static inline bool
 mbuf_empty(struct mbuf *mbuf)
 {
@@ -51,6 +64,15 @@ mbuf_full(struct mbuf *mbuf)
     return mbuf->last == mbuf->end ? true : false;
 }
 
+/*
+ * Data of an mbuf referenced by another is not to be written over
+ */
+static inline bool
+mbuf_shared(struct mbuf *mbuf)
+{
+    return (mbuf->owner != NULL || mbuf->nref > 1) ? true : false;
+}
+
 void mbuf_init(struct instance *nci);
 void mbuf_deinit(void);
 struct mbuf *mbuf_get(void);
@@ -63,5 +85,6 @@ void mbuf_insert(struct mhdr *mhdr, struct mbuf *mbuf);
 void mbuf_remove(struct mhdr *mhdr, struct mbuf *mbuf);
 void mbuf_copy(struct mbuf *mbuf, uint8_t *pos, size_t n);
 struct mbuf *mbuf_split(struct mhdr *h, uint8_t *pos, mbuf_copy_t cb, void *cbarg);
+struct mbuf *mbuf_slice(struct mbuf *mbuf, uint8_t *pos, uint8_t *last);
 
 #endif
@@ -115,6 +115,8 @@ static uint32_t nfree_msgq;      /* # free msg q */
 static struct msg_tqh free_msgq; /* free msg q */
 static struct rbtree tmo_rbt;    /* timeout rbtree */
 static struct rbnode tmo_rbs;    /* timeout rbtree sentinel */
+static struct rbtree hedge_rbt;  /* hedge rbtree */
+static struct rbnode hedge_rbs;  /* hedge rbtree sentinel */
 
 #define CONNECTION_CODEC(ACTION)               \
     ACTION( CONN_NONE,       none        ) \
@@ -205,6 +207,58 @@ msg_tmo_delete(struct msg *msg)
     log_debug(LOG_VERB, "delete msg %"PRIu64" from tmo rbt", msg->id);
 }
 
+struct msg *
+msg_hedge_min(void)
+{
+    struct rbnode *node;
+
+    node = rbtree_min(&hedge_rbt);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    return (struct msg *)((char *)node - offsetof(struct msg, hedge_rbe));
+}
+
+/**.......................................................................
+ * Schedule a backend read waiting on conn to be hedged after delay msec,
+ * unless it has been answered by then
+ */
+void
+msg_hedge_insert(struct msg *msg, struct conn *conn, int delay)
+{
+    struct rbnode *node;
+
+    ASSERT(msg->request);
+
+    node = &msg->hedge_rbe;
+    node->key = nc_msec_now() + delay;
+    node->data = conn;
+
+    rbtree_insert(&hedge_rbt, node);
+
+    log_debug(LOG_VERB, "insert msg %"PRIu64" into hedge rbt with delay of "
+              "%d msec", msg->id, delay);
+}
+
+void
+msg_hedge_delete(struct msg *msg)
+{
+    struct rbnode *node;
+
+    node = &msg->hedge_rbe;
+
+    /* already deleted */
+
+    if (node->data == NULL) {
+        return;
+    }
+
+    rbtree_delete(&hedge_rbt, node);
+
+    log_debug(LOG_VERB, "delete msg %"PRIu64" from hedge rbt", msg->id);
+}
+
 static struct msg *
 _msg_get(void)
 {
@@ -233,16 +287,20 @@ done:
     msg->c_tqe.tqe_prev = NULL;
     msg->m_tqe.tqe_next = NULL;
     msg->m_tqe.tqe_prev = NULL;
+    msg->b_tqe.tqe_next = NULL;
+    msg->b_tqe.tqe_prev = NULL;
 
     msg->id = ++msg_id;
     msg->peer = NULL;
     msg->owner = NULL;
 
     rbtree_node_init(&msg->tmo_rbe);
+    rbtree_node_init(&msg->hedge_rbe);
 
     STAILQ_INIT(&msg->mhdr);
     msg->mlen = 0;
     msg->start_ts = 0;
+    msg->send_ts = 0;
 
     msg->state = 0;
     msg->pos = NULL;
@@ -309,9 +367,39 @@ done:
     msg->has_vclock = 0;
     msg->vclock.data = NULL;
     msg->vclock.len = 0;
+    string_init(&msg->vclock_key);
     msg->read_before_write = 0;
+    msg->refresh = 0;
+    msg->hedge_copy = 0;
+    msg->counter_batch = 0;
+    msg->set_batch = 0;
+    msg->frag_key = 0;
+    msg->cut_through = 0;
+    msg->ordered = 0;
+    msg->unbatchable = 0;
+    msg->nbatch = 0;
     msg->stored_arg.data = NULL;
     msg->stored_arg.len = 0;
+    memset(&msg->riak_rsp, 0, sizeof(msg->riak_rsp));
+
+    msg->miss_q = NULL;
+    string_init(&msg->miss_key);
+    TAILQ_INIT(&msg->miss_waitq);
+    msg->batch_due = 0;
+    msg->l1_seq = 0;
+    msg->c_seq = 0;
+
+    msg->fill_owner = NULL;
+    msg->fill_idx = 0;
+    msg->fill_rsp = NULL;
+    msg->fill_msgs = NULL;
+    msg->fill_kind = NULL;
+    msg->nil_owner = NULL;
+
+    msg->hedge = NULL;
+    msg->hedge_conn = NULL;
+    msg->riak_cut = NULL;
+    msg->dt_stream = NULL;
 
     return msg;
 }
@@ -483,6 +571,25 @@ msg_put(struct msg *msg)
     }
     msg->has_vclock = 0;
     msg->vclock.len = 0;
+    string_deinit(&msg->vclock_key);
+
+    /* release requests still waiting on this one, with an error */
+    backend_miss_done(msg, NULL);
+
+    /* count a backend read of an mget fragment as done, unanswered */
+    backend_fill_done(msg);
+
+    /* a read whose not-found markers were being looked up goes on */
+    backend_nil_lookup_put(msg);
+
+    /* a hedged read and its hedge no longer race each other */
+    backend_hedge_done(msg);
+
+    /* a reply streamed from a backend read goes with the read */
+    backend_cut_through_put(msg);
+
+    /* so do the set members left of a reply released in parts */
+    repack_dt_fetch_put(msg);
 
     nfree_msgq++;
     TAILQ_INSERT_HEAD(&free_msgq, msg, m_tqe);
@@ -525,6 +632,7 @@ msg_init(void)
     nfree_msgq = 0;
     TAILQ_INIT(&free_msgq);
     rbtree_init(&tmo_rbt, &tmo_rbs);
+    rbtree_init(&hedge_rbt, &hedge_rbs);
 }
 
 void
@@ -1018,22 +1126,17 @@ msg_content_clone(struct msg *src)
 {
     rstatus_t status = NC_OK;
     struct mbuf *mbuf = NULL;
-    uint32_t mlen = src->mlen;
-    char *content = nc_alloc(mlen + 1);
-    if (content == NULL) {
-        return NULL;
-    }
+    uint32_t nremaining = src->mlen;
+    size_t n;
     struct msg *psrc = src->peer;
     struct msg *pdest = NULL;
     struct msg *dest = msg_get(src->owner, src->request);
     if (dest == NULL) {
-        nc_free(content);
         return NULL;
     }
     if (psrc != NULL) {
         pdest = msg_get(psrc->owner, psrc->request);
         if (pdest == NULL) {
-            nc_free(content);
             msg_put(dest);
             return NULL;
         }
@@ -1042,32 +1145,58 @@ msg_content_clone(struct msg *src)
     dest->noreply = 1;
     dest->parser = src->parser;
 
-    if ((status = msg_extract_char(src, content, mlen)) != NC_OK) {
-        nc_free(content);
-        msg_put(dest);
-        if (pdest != NULL) {
-            msg_put(pdest);
+    /* the content is shared with src rather than copied, see msg_share */
+    for (mbuf = STAILQ_FIRST(&src->mhdr); mbuf != NULL && nremaining > 0;
+         mbuf = STAILQ_NEXT(mbuf, next)) {
+        n = (size_t)(mbuf->last - mbuf->start);
+        if (n > nremaining) {
+            n = nremaining;
         }
-        return NULL;
-    }
-    content[mlen] = '\0';
 
-    if ((status = msg_copy(dest, (uint8_t *)content, mlen)) != NC_OK) {
-        nc_free(content);
-        msg_put(dest);
-        if (pdest != NULL) {
-            msg_put(pdest);
+        if ((status = msg_share(dest, mbuf, mbuf->start, n)) != NC_OK) {
+            msg_put(dest);
+            if (pdest != NULL) {
+                msg_put(pdest);
+            }
+            return NULL;
         }
-        return NULL;
-    }
-    if (content != NULL) {
-        nc_free(content);
+
+        nremaining -= (uint32_t)n;
     }
+
     mbuf = STAILQ_FIRST(&dest->mhdr);
-    dest->pos = mbuf->pos;
+    if (mbuf != NULL) {
+        dest->pos = mbuf->pos;
+    }
     return dest;
 }
 
+/**.......................................................................
+ * Append n bytes at pos in mbuf to msg.  At least MBUF_SHARE_MIN bytes
+ * are not copied: they are shared with mbuf, by a slice of it appended
+ * to msg, after which msg grows in a new mbuf
+ */
+rstatus_t
+msg_share(struct msg *msg, struct mbuf *mbuf, uint8_t *pos, size_t n)
+{
+    struct mbuf *slice;
+
+    if (n < MBUF_SHARE_MIN) {
+        return msg_copy(msg, pos, n);
+    }
+
+    slice = mbuf_slice(mbuf, pos, pos + n);
+    if (slice == NULL) {
+        return NC_ENOMEM;
+    }
+
+    mbuf_insert(&msg->mhdr, slice);
+    msg->mlen += (uint32_t)n;
+    msg->pos = slice->last;
+
+    return NC_OK;
+}
+
 /**.......................................................................
  * Append an arbitrary amount of content into msg, adding mbufs as
  * necessary
@@ -1588,6 +1717,45 @@ msg_copy_from_pos(struct msg* dest, struct msg_pos* start_pos, size_t n)
     return NC_OK;
 }
 
+/**.......................................................................
+ * Append n bytes from start_pos to the destination message, shared
+ * rather than copied as msg_share
+ */
+rstatus_t
+msg_share_from_pos(struct msg* dest, struct msg_pos* start_pos, size_t n)
+{
+    if (!msg_pos_is_valid(start_pos)) {
+        return NC_ERROR;
+    }
+
+    ASSERT(dest != NULL);
+
+    rstatus_t status = NC_OK;
+
+    struct mbuf* mbuf = 0;
+    uint8_t* start_ptr = 0;
+    size_t nremaining = n;
+    size_t ncopy = 0;
+
+    for (mbuf = start_pos->mbuf; mbuf != NULL && nremaining > 0;
+         mbuf = STAILQ_NEXT(mbuf, next)) {
+        start_ptr = (mbuf == start_pos->mbuf) ? start_pos->ptr : mbuf->start;
+
+        ncopy = (size_t)(mbuf->last - start_ptr);
+        if (ncopy > nremaining) {
+            ncopy = nremaining;
+        }
+
+        if ((status = msg_share(dest, mbuf, start_ptr, ncopy)) != NC_OK) {
+            return status;
+        }
+
+        nremaining -= ncopy;
+    }
+
+    return NC_OK;
+}
+
 /**.......................................................................
  * Copy n bytes from start_pos into the destination buffer
  */
@@ -1721,7 +1889,7 @@ msg_key0(struct msg* req, size_t* bucket_len, size_t* key_len)
 
     *key_len = (size_t)(kpos->end - kpos->start);
 
-    if (req->type == MSG_REQ_RIAK_GET) {
+    if (req->type == MSG_REQ_RIAK_GET || req->type == MSG_REQ_RIAK_EXISTS) {
         *bucket_len = kpos->bucket_len;
     }
 
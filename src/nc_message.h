@@ -192,8 +192,10 @@ typedef enum msg_parse_result {
     ACTION( RSP_REDIS_MULTIBULK )                                                                   \
     ACTION( REQ_RIAK_PING )                                                                         \
     ACTION( REQ_RIAK_GET )                                                                          \
+    ACTION( REQ_RIAK_EXISTS )                                                                       \
     ACTION( REQ_RIAK_SET )                                                                          \
     ACTION( REQ_RIAK_DEL )                                                                          \
+    ACTION( REQ_RIAK_INCR )                                                                         \
     ACTION( REQ_RIAK_SADD )                                                                         \
     ACTION( REQ_RIAK_SREM )                                                                         \
     ACTION( REQ_RIAK_SMEMBERS )                                                                     \
@@ -225,10 +227,72 @@ struct keypos {
     size_t              bucket_len;       /* length of bucket portion of key */
 };
 
+/*
+ * The fields of a Riak response the proxy uses, decoded in place by
+ * riak_parse_rsp as it frames the response, for riak_repack.  Data
+ * referenced in the mbufs of the response is valid until it is
+ * repacked, data split across mbufs is copied to the arena.
+ */
+struct riak_rsp {
+    uint8_t              msgid;           /* message code */
+    uint32_t             len;             /* PB length, message code included */
+    size_t               n_content;       /* GET: # siblings */
+    struct mbuf          *value_mbuf;     /* GET: mbuf the chosen value starts in */
+    uint8_t              *value;          /* GET: chosen value */
+    uint32_t             value_len;       /* GET: chosen value length */
+    ProtobufCBinaryData  content_type;    /* GET: chosen value content type */
+    protobuf_c_boolean   unchanged;       /* GET: unchanged since if_modified vclock? */
+    protobuf_c_boolean   has_vclock;      /* GET, PUT: vclock fields */
+    ProtobufCBinaryData  vclock;          /* GET, PUT: vclock fields */
+    protobuf_c_boolean   has_counter_value; /* DT_UPDATE: counter value fields */
+    int64_t              counter_value;   /* DT_UPDATE: counter value fields */
+    uint32_t             n_set_value;     /* DT_FETCH: # set members */
+    struct mbuf          *set_mbuf;       /* DT_FETCH: mbuf the set value starts in */
+    uint8_t              *set_ptr;        /* DT_FETCH: set value, its members streamed */
+    uint32_t             set_len;         /* DT_FETCH: set value length */
+    uint32_t             errcode;         /* error: error code */
+};
+
+/*
+ * A large Riak GET response streamed to the client as it is received,
+ * rather than once whole.  The value is not copied: as the mbufs of the
+ * response arrive, slices of them are shared with the client reply and
+ * the frontend fill (see msg_share), and they are released from the
+ * response but for the first, which frames it.
+ */
+struct riak_cut {
+    struct msg           *rsp;            /* client reply, streamed so far */
+    struct msg           *fill;           /* frontend SET, streamed so far */
+    struct string        key;             /* key of the fill */
+    struct mbuf          *mbuf;           /* mbuf of the next value byte */
+    uint8_t              *ptr;            /* next value byte */
+    uint32_t             left;            /* # value bytes left to stream */
+    uint32_t             off;             /* offset of ptr in the response */
+    uint32_t             end;             /* offset of the end of the content */
+    uint32_t             released;        /* # response bytes released */
+};
+
+/*
+ * The members of a large set left to repack into the reply to a Riak
+ * DT_FETCH, which is released to the client in parts as it is sent (see
+ * repack_dt_fetch_next) rather than repacked whole.  The mbufs of the
+ * response are released as the members in them are repacked.
+ */
+struct riak_dt_stream {
+    struct mhdr          mhdr;            /* response mbufs of the members left */
+    struct mbuf          *mbuf;           /* mbuf of the next member */
+    uint8_t              *ptr;            /* next member, in the set value */
+    uint32_t             len;             /* # set value bytes left */
+    uint32_t             left;            /* # members left */
+};
+
+TAILQ_HEAD(msg_tqh, msg);
+
 struct msg {
     TAILQ_ENTRY(msg)     c_tqe;           /* link in client q */
     TAILQ_ENTRY(msg)     s_tqe;           /* link in server q */
-    TAILQ_ENTRY(msg)     m_tqe;           /* link in send q / free q */
+    TAILQ_ENTRY(msg)     m_tqe;           /* link in send q / free q / counter due q */
+    TAILQ_ENTRY(msg)     b_tqe;           /* link in backend miss q / wait q */
 
     uint64_t             id;              /* message id */
     struct msg           *peer;           /* message peer */
@@ -236,10 +300,12 @@ struct msg {
     struct conn          *owner;          /* message owner - client | server */
 
     struct rbnode        tmo_rbe;         /* entry in rbtree */
+    struct rbnode        hedge_rbe;       /* entry in hedge rbtree */
 
     struct mhdr          mhdr;            /* message mbuf header */
     uint32_t             mlen;            /* message length */
     int64_t              start_ts;        /* request start timestamp in usec */
+    int64_t              send_ts;         /* backend request sent timestamp in usec */
 
     int                  state;           /* current parser state */
     uint8_t              *pos;            /* parser position marker */
@@ -297,10 +363,42 @@ struct msg {
     unsigned             redis:1;         /* redis? */
     unsigned             riak:1;          /* riak? */
     unsigned             read_before_write:1; /* read before write to get vclock  */
+    unsigned             refresh:1;       /* refresh of a cached key ahead of expiry? */
+    unsigned             hedge_copy:1;    /* hedge of a slow backend read? */
+    unsigned             counter_batch:1; /* batch of counter updates? */
+    unsigned             set_batch:1;     /* batch of set updates? */
+    unsigned             frag_key:1;      /* fragment one key per fragment? */
+    unsigned             cut_through:1;   /* backend read which may stream its response? */
+    unsigned             ordered:1;       /* counted as ordered in its client's omsg_q? */
+    unsigned             unbatchable:1;   /* counted as unbatchable in its client's omsg_q? */
     protobuf_c_boolean   has_vclock;      /* riak vclock fields */
     ProtobufCBinaryData  vclock;          /* riak vclock fields */
+    struct string        vclock_key;      /* vclock cache key, for riak req */
     ProtobufCBinaryData  stored_arg;      /* redis arguments storage for some commands*/
+    struct riak_rsp      riak_rsp;        /* decoded riak response fields, for riak rsp */
     uint32_t             nsubs;           /* number of subcommands for splited commands */
+    uint32_t             nbatch;          /* # hidden writes batched in this one, for frontend req */
+
+    struct msg_tqh       *miss_q;         /* backend miss q, while in flight to the backend for a cache miss */
+    struct string        miss_key;        /* key of the cache miss */
+    struct msg_tqh       miss_waitq;      /* requests waiting for the response to this one */
+    int64_t              batch_due;       /* time a batch of backend updates is due in msec, 0 once sent */
+    uint64_t             l1_seq;          /* l1 cache seq when received, for req */
+    uint64_t             c_seq;           /* position in its client's omsg_q, for req */
+
+    struct msg           *fill_owner;     /* mget fragment this backend read fills */
+    uint32_t             fill_idx;        /* index of the filled key in fill_owner */
+    struct msg           *fill_rsp;       /* frontend response awaiting the backend reads */
+    struct msg           **fill_msgs;     /* completed backend reads, per key */
+    uint8_t              *fill_kind;      /* kind of each key's bulk in fill_rsp */
+
+    struct msg           *nil_owner;      /* frontend read this hidden MGET looks up the not-found markers of */
+
+    struct msg           *hedge;          /* other read of a hedged backend read */
+    struct conn          *hedge_conn;     /* server conn the hedged read waits on, for its hedge */
+
+    struct riak_cut      *riak_cut;       /* response streamed to the client, for riak req */
+    struct riak_dt_stream *dt_stream;     /* set members left to release, for riak rsp */
 };
 
 struct msg_pos {
@@ -310,11 +408,12 @@ struct msg_pos {
     msg_find_result_t result;
 };
 
-TAILQ_HEAD(msg_tqh, msg);
-
 struct msg *msg_tmo_min(void);
 void msg_tmo_insert(struct msg *msg, struct conn *conn);
 void msg_tmo_delete(struct msg *msg);
+struct msg *msg_hedge_min(void);
+void msg_hedge_insert(struct msg *msg, struct conn *conn, int delay);
+void msg_hedge_delete(struct msg *msg);
 
 void msg_init(void);
 void msg_deinit(void);
@@ -338,12 +437,17 @@ struct msg *req_get(struct conn *conn);
 void req_put(struct msg *msg);
 bool req_done(struct conn *conn, struct msg *msg);
 bool req_error(struct conn *conn, struct msg *msg);
+bool req_is_ordered(struct msg *msg);
+void req_mark_done(struct msg *msg);
+void req_mark_undone(struct msg *msg);
+void req_forward(struct context *ctx, struct conn *c_conn, struct msg *msg, bool backend, bool enqueue);
 void req_server_enqueue_imsgq(struct context *ctx, struct conn *conn, struct msg *msg);
 void req_server_enqueue_imsgq_head(struct context *ctx, struct conn *conn, struct msg *msg);
 void req_server_dequeue_imsgq(struct context *ctx, struct conn *conn, struct msg *msg);
 void req_client_enqueue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg);
 void req_server_enqueue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg);
 void req_client_dequeue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg);
+void req_client_insert_omsgq(struct conn *conn, struct msg *before, struct msg *msg);
 void req_server_dequeue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg);
 struct msg *req_recv_next(struct context *ctx, struct conn *conn, bool alloc);
 void req_recv_done(struct context *ctx, struct conn *conn, struct msg *msg, struct msg *nmsg, bool backend, bool enqueue);
@@ -379,6 +483,7 @@ struct msg *msg_content_clone(struct msg *src);
 
 rstatus_t msg_copy(struct msg *msg, uint8_t *pos, size_t n);
 rstatus_t msg_copy_char(struct msg *msg, char* pos, size_t n);
+rstatus_t msg_share(struct msg *msg, struct mbuf *mbuf, uint8_t *pos, size_t n);
 
 rstatus_t msg_extract(struct msg *msg, uint8_t *pos, size_t n);
 rstatus_t msg_extract_char(struct msg *msg, char* pos, size_t n);
@@ -405,6 +510,7 @@ bool msg_pos_is_valid(struct msg_pos* pos);
 rstatus_t msg_copy_between_pos(struct msg* dest, struct msg_pos* start_pos, struct msg_pos* end_pos);
 
 rstatus_t msg_copy_from_pos(struct msg* dest, struct msg_pos* start_pos, size_t n);
+rstatus_t msg_share_from_pos(struct msg* dest, struct msg_pos* start_pos, size_t n);
 
 rstatus_t msg_extract_between_pos(uint8_t*   dest, struct msg_pos* start_pos, struct msg_pos* end_pos);
 rstatus_t msg_extract_between_pos_char(char* dest, struct msg_pos* start_pos, struct msg_pos* end_pos);
@@ -18,8 +18,6 @@
 #include <nc_core.h>
 #include <nc_server.h>
 
-void req_forward(struct context *ctx, struct conn *c_conn, struct msg *msg, bool backend, bool enqueue);
-
 /*
 * Backend processing utilities
 */
@@ -29,9 +27,10 @@ bool should_forward_req_to_backend(struct conn *c_conn, struct msg* msg);
 
 /*
 * Get the next request to send -- returns NULL instead of the next
-* message if we are still waiting for a response to the last request
+* message if it still has to wait for an earlier request of its client
 */
 struct msg* get_next_req_to_send(struct msg* nmsg);
+bool req_blocked(struct conn* c_conn, struct msg* msg);
 
 struct msg *
 req_get(struct conn *conn)
@@ -397,6 +396,37 @@ req_server_dequeue_imsgq(struct context *ctx, struct conn *conn, struct msg *msg
     }
 }
 
+/**.......................................................................
+ * Count a request just queued in its client's omsg_q among the client's
+ * outstanding requests, as ordered (see req_is_ordered) and as an update
+ * which cannot be batched (see backend_batch_blocked), until it is done
+ * (see req_mark_done) or dequeued.
+ *
+ * The client's ordered_first is kept at or before its first outstanding
+ * ordered request, see req_ordered_first
+ */
+static void
+req_client_count(struct conn *conn, struct msg *msg)
+{
+    msg->ordered = req_is_ordered(msg) ? 1 : 0;
+    msg->unbatchable = backend_batchable_req(msg) ? 0 : 1;
+
+    if (msg->done) {
+        return;
+    }
+
+    if (msg->ordered) {
+        conn->nordered++;
+        if (conn->ordered_first == NULL) {
+            conn->ordered_first = msg;
+        }
+    }
+
+    if (msg->unbatchable) {
+        conn->nunbatchable++;
+    }
+}
+
 void
 req_client_enqueue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg)
 {
@@ -404,6 +434,32 @@ req_client_enqueue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg
     ASSERT(conn->client && !conn->proxy);
 
     TAILQ_INSERT_TAIL(&conn->omsg_q, msg, c_tqe);
+
+    msg->c_seq = conn->nenqueued++;
+    req_client_count(conn, msg);
+}
+
+/**.......................................................................
+ * Queue a request in a client's omsg_q in place of another, just ahead of
+ * it, eg. the write which follows a read-before-write
+ */
+void
+req_client_insert_omsgq(struct conn *conn, struct msg *before, struct msg *msg)
+{
+    struct msg *first = conn->ordered_first;
+
+    ASSERT(msg->request);
+    ASSERT(conn->client && !conn->proxy);
+
+    TAILQ_INSERT_BEFORE(before, msg, c_tqe);
+
+    msg->c_seq = before->c_seq;
+    req_client_count(conn, msg);
+
+    if (msg->ordered && !msg->done &&
+        (first == before || (first != NULL && first->c_seq > msg->c_seq))) {
+        conn->ordered_first = msg;
+    }
 }
 
 /**.......................................................................
@@ -419,6 +475,8 @@ req_server_enqueue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg
 
     TAILQ_INSERT_TAIL(&conn->omsg_q, msg, s_tqe);
 
+    backend_hedge_schedule(ctx, conn, msg);
+
     if (!msg->read_before_write) {
         stats_server_incr(ctx, conn->owner, out_queue);
         stats_server_incr_by(ctx, conn->owner, out_queue_bytes, msg->mlen);
@@ -436,7 +494,96 @@ req_client_dequeue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg
     ASSERT(msg->request);
     ASSERT(conn->client && !conn->proxy);
 
+    if (conn->ordered_first == msg) {
+        conn->ordered_first = TAILQ_NEXT(msg, c_tqe);
+    }
+
     TAILQ_REMOVE(&conn->omsg_q, msg, c_tqe);
+
+    if (!msg->done) {
+        if (msg->ordered) {
+            conn->nordered--;
+        }
+        if (msg->unbatchable) {
+            conn->nunbatchable--;
+        }
+    }
+    msg->ordered = 0;
+    msg->unbatchable = 0;
+}
+
+/**.......................................................................
+ * Mark a request done, no longer outstanding in its client's omsg_q
+ */
+void
+req_mark_done(struct msg *msg)
+{
+    struct conn *conn = msg->owner;
+
+    if (!msg->done) {
+        if (msg->ordered) {
+            conn->nordered--;
+        }
+        if (msg->unbatchable) {
+            conn->nunbatchable--;
+        }
+    }
+
+    msg->done = 1;
+}
+
+/**.......................................................................
+ * Mark a request outstanding again, eg. as it is resent
+ */
+void
+req_mark_undone(struct msg *msg)
+{
+    struct conn *conn = msg->owner;
+    struct msg *first;
+
+    if (msg->done) {
+        if (msg->ordered) {
+            conn->nordered++;
+            first = conn->ordered_first;
+            if (first == NULL || first->c_seq > msg->c_seq) {
+                conn->ordered_first = msg;
+            }
+        }
+        if (msg->unbatchable) {
+            conn->nunbatchable++;
+        }
+    }
+
+    msg->done = 0;
+}
+
+/**.......................................................................
+ * Return the first outstanding ordered request of a client, if any.
+ *
+ * No outstanding ordered request precedes the client's ordered_first, so
+ * the search starts there, and moves it forward as the requests it goes
+ * past are done: each request is gone past once, but for the rare one
+ * made outstanding again
+ */
+static struct msg *
+req_ordered_first(struct conn *conn)
+{
+    struct msg *msg;
+
+    if (conn->nordered == 0) {
+        return NULL;
+    }
+
+    for (msg = conn->ordered_first; msg != NULL; msg = TAILQ_NEXT(msg, c_tqe)) {
+        if (msg->ordered && !msg->done) {
+            break;
+        }
+    }
+
+    ASSERT(msg != NULL);
+    conn->ordered_first = msg;
+
+    return msg;
 }
 
 /**.......................................................................
@@ -450,6 +597,7 @@ req_server_dequeue_omsgq(struct context *ctx, struct conn *conn, struct msg *msg
     ASSERT(!conn->client && !conn->proxy);
 
     msg_tmo_delete(msg);
+    backend_hedge_done(msg);
     TAILQ_REMOVE(&conn->omsg_q, msg, s_tqe);
 
     if (!msg->read_before_write) {
@@ -533,6 +681,57 @@ req_make_reply(struct context *ctx, struct conn *conn, struct msg *req)
     return NC_OK;
 }
 
+/*
+ * Answer a GET from the L1 cache of the pool, if it holds the value of
+ * the key, without forwarding it to a frontend server.
+ *
+ * A GET received while a write of its client is outstanding is not
+ * answered from the cache: another client may have cached the value the
+ * write replaces meanwhile, and the GET has to read the write.
+ *
+ * Returns true if the request was answered
+ */
+static bool
+req_l1_reply(struct context *ctx, struct conn *conn, struct msg *msg)
+{
+    struct server_pool *pool = conn->owner;
+    struct l1_entry *le;
+    struct keypos *kpos;
+    rstatus_t status;
+
+    if (msg->type != MSG_REQ_REDIS_GET || !l1_cache_enabled(pool->l1_cache) ||
+        array_n(msg->keys) == 0 || conn->nordered > 0) {
+        return false;
+    }
+
+    kpos = array_get(msg->keys, 0);
+    le = l1_cache_get(pool->l1_cache, kpos->start,
+                      (uint32_t)(kpos->end - kpos->start));
+    if (le == NULL) {
+        return false;
+    }
+
+    status = req_make_reply(ctx, conn, msg);
+    if (status != NC_OK) {
+        return false;
+    }
+
+    status = msg_copy(msg->peer, le->rsp.data, le->rsp.len);
+    if (status != NC_OK) {
+        msg->error = 1;
+        msg->err = errno;
+    }
+
+    stats_pool_incr(ctx, pool, l1_cache_hits);
+
+    status = event_add_out(ctx->evb, conn);
+    if (status != NC_OK) {
+        conn->err = errno;
+    }
+
+    return true;
+}
+
 static bool
 req_filter(struct context *ctx, struct conn *conn, struct msg *msg)
 {
@@ -573,6 +772,11 @@ req_filter(struct context *ctx, struct conn *conn, struct msg *msg)
         msg->noforward = 1;
     }
 
+    /* keys of the proxy's own, answered with an error by redis_reply */
+    if (backend_key_reserved(conn, msg)) {
+        msg->noforward = 1;
+    }
+
     return false;
 }
 
@@ -587,7 +791,7 @@ req_forward_error(struct context *ctx, struct conn *conn, struct msg *msg)
               "c %d failed: %s", msg->id, msg->mlen, msg->type, conn->sd,
               strerror(errno));
 
-    msg->done = 1;
+    req_mark_done(msg);
     msg->error = 1;
     msg->err = errno;
 
@@ -638,6 +842,13 @@ req_forward(struct context *ctx, struct conn *c_conn, struct msg *msg, bool back
     struct server *server = NULL;
     struct server_pool *pool = (struct server_pool *)c_conn->owner;
 
+    if (backend && enqueue && (backend_counter_batch(ctx, c_conn, msg) ||
+                               backend_set_batch(ctx, c_conn, msg))) {
+        /* answered once the batch it joined is written */
+        c_conn->enqueue_outq(ctx, c_conn, msg);
+        return;
+    }
+
     if (backend) {
         do {
             server = get_next_backend_server(msg, c_conn, key, keylen);
@@ -664,6 +875,7 @@ req_forward(struct context *ctx, struct conn *c_conn, struct msg *msg, bool back
         case MSG_REQ_REDIS_SISMEMBER:
         case MSG_REQ_REDIS_SCARD:
         case MSG_REQ_REDIS_GET:
+        case MSG_REQ_REDIS_EXISTS:
             msg->error = 1;
             return;
 
@@ -704,6 +916,10 @@ req_forward(struct context *ctx, struct conn *c_conn, struct msg *msg, bool back
 
     s_conn->enqueue_inq(ctx, s_conn, msg);
 
+    if (!backend) {
+        backend_refresh_probe(ctx, c_conn, s_conn, msg);
+    }
+
     req_forward_stats(ctx, s_conn->owner, msg);
 
     log_debug(LOG_VERB, "forward from c %d to s %d req %"PRIu64" len %"PRIu32
@@ -746,8 +962,17 @@ req_recv_done(struct context *ctx, struct conn *conn, struct msg *msg,
     }
 
     if (backend == false) {
-        if (should_forward_req_to_backend(conn, msg)) {
-            backend = true;
+        msg->l1_seq = l1_cache_seq(((struct server_pool *)conn->owner)->l1_cache);
+        if (!msg->noforward) {
+            backend_l1_invalidate(conn, msg);
+            if (req_l1_reply(ctx, conn, msg)) {
+                return;
+            }
+
+            if (should_forward_req_to_backend(conn, msg) &&
+                !backend_write_behind(ctx, conn, msg)) {
+                backend = true;
+            }
         }
     }
 
@@ -774,6 +999,19 @@ req_recv_done(struct context *ctx, struct conn *conn, struct msg *msg,
 
     pool = conn->owner;
     TAILQ_INIT(&frag_msgq);
+
+    /*
+     * A DEL or MSET is written to the backend a key per fragment, so that
+     * each key goes to its own coordinator, and they are all written at
+     * once rather than one after another on the connection of the first
+     * key.  The fragments are still written only once the requests ahead
+     * of them are done, see req_blocked
+     */
+    if (backend && (msg->type == MSG_REQ_REDIS_DEL ||
+                    msg->type == MSG_REQ_REDIS_MSET)) {
+        msg->frag_key = 1;
+    }
+
     status = msg->fragment(msg, pool->frontends.ncontinuum, &frag_msgq);
     if (status != NC_OK) {
         if (!msg->noreply) {
@@ -868,12 +1106,13 @@ get_next_req_to_send(struct msg* nmsg)
     if (nmsg != NULL) {
         /*
         * See if this message's owner pool has backend servers -- if it
-        * does, and this is a message that might be forwarded to the
-        * backend, we enforce that requests are only sent if they are at
-        * the head of the client's output queue.  This ensures that the
-        * previous request has been responded to before the next request
-        * is sent.  If we don't, then we can get in a situation where the
-        * backend responds to requests out of order.
+        * does, requests are dispatched to the frontend and backend
+        * servers concurrently, and the client's omsg_q acts as the
+        * reorder buffer: rsp_send_next only releases a response once
+        * every request ahead of it is done, so the client still sees
+        * responses in request order.  The exception are requests that
+        * must observe the effect of the requests ahead of them, see
+        * req_blocked().
         */
 
         struct conn* client = nmsg->owner;
@@ -882,20 +1121,13 @@ get_next_req_to_send(struct msg* nmsg)
             unsigned nbackend = sp->backends.server_arr.nelem;
 
             /*
-            * If this is a fragmented message, it won't be the head of the
-            * client omsg_q -- its fragments will be -- so go ahead and send
-            * it anyway (for the time being anyway, we won't be forwarding
-            * fragmented messages to the backend).  Also, if this message
-            * expects no reply, send it, since the reply -- and thus the
-            * order of the reply -- is irrelevant.
+            * If this message expects no reply, send it, since the reply
+            * -- and thus the order of the reply -- is irrelevant.
             */
 
-            if (nbackend > 0 && nmsg->frag_id == 0 && !nmsg->swallow) {
-                struct msg* clientHead = TAILQ_FIRST(&client->omsg_q);
-
-                if (nmsg != clientHead) {
-                    return NULL;
-                }
+            if (nbackend > 0 && !nmsg->swallow && !nmsg->noreply &&
+                req_blocked(client, nmsg)) {
+                return NULL;
             }
         }
     }
@@ -903,6 +1135,98 @@ get_next_req_to_send(struct msg* nmsg)
     return nmsg;
 }
 
+/**.......................................................................
+ * Return true if a request has to wait for earlier requests of its
+ * client before it can be sent.
+ *
+ * An ordered request (see req_is_ordered) is only sent once it is at
+ * the head of the client's omsg_q.  Any other request is sent as soon
+ * as no ordered request ahead of it is outstanding, so that a pipeline
+ * of reads which miss the frontend is served by concurrent backend
+ * requests, but a read never overtakes a preceding write.
+ *
+ * The fragments of a request are sent alongside each other, behind the
+ * request they are fragments of, which is at the head of the omsg_q
+ * until they are all done: ordered fragments are sent once that request
+ * is at the head of the omsg_q, any other once no ordered request ahead
+ * of its own is outstanding.
+ *
+ * The client's outstanding ordered requests are counted as they are
+ * queued and done, so neither takes a walk of the omsg_q.
+ */
+bool
+req_blocked(struct conn* c_conn, struct msg* msg)
+{
+    struct msg *first;
+
+    ASSERT(c_conn->client && !c_conn->proxy);
+
+    if (req_is_ordered(msg)) {
+        if (msg->frag_id != 0 && msg->frag_owner != NULL) {
+            return msg->frag_owner != TAILQ_FIRST(&c_conn->omsg_q);
+        }
+        return msg != TAILQ_FIRST(&c_conn->omsg_q);
+    }
+
+    first = req_ordered_first(c_conn);
+
+    return first != NULL && first->c_seq < msg->c_seq;
+}
+
+/**.......................................................................
+ * Return true if this request may not be reordered with respect to the
+ * other requests of its client: writes, and the multi-key set
+ * operations which drive their own sub-requests to the backend.  A
+ * fragment is ordered as the request it is a fragment of.
+ */
+bool
+req_is_ordered(struct msg* msg)
+{
+    if (msg->read_before_write || msg->has_vclock) {
+        return true;
+    }
+
+    if (msg->frag_owner != NULL && msg->frag_owner != msg &&
+        req_is_ordered(msg->frag_owner)) {
+        return true;
+    }
+
+    switch (msg->type) {
+    case MSG_REQ_REDIS_SET:
+    case MSG_REQ_REDIS_MSET:
+    case MSG_REQ_REDIS_DEL:
+    case MSG_REQ_REDIS_SADD:
+    case MSG_REQ_REDIS_SREM:
+    case MSG_REQ_REDIS_SDIFF:
+    case MSG_REQ_REDIS_SINTER:
+    case MSG_REQ_REDIS_SUNION:
+    case MSG_REQ_REDIS_SDIFFSTORE:
+    case MSG_REQ_REDIS_SINTERSTORE:
+    case MSG_REQ_REDIS_SUNIONSTORE:
+    case MSG_REQ_REDIS_INCR:
+    case MSG_REQ_REDIS_INCRBY:
+    case MSG_REQ_REDIS_DECR:
+    case MSG_REQ_REDIS_DECRBY:
+    case MSG_REQ_RIAK_SET:
+    case MSG_REQ_RIAK_DEL:
+    case MSG_REQ_RIAK_SADD:
+    case MSG_REQ_RIAK_SREM:
+    case MSG_REQ_RIAK_SDIFF:
+    case MSG_REQ_RIAK_SINTER:
+    case MSG_REQ_RIAK_SUNION:
+    case MSG_REQ_RIAK_SDIFFSTORE:
+    case MSG_REQ_RIAK_SINTERSTORE:
+    case MSG_REQ_RIAK_SUNIONSTORE:
+    case MSG_REQ_RIAK_INCR:
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
 void
 req_send_done(struct context *ctx, struct conn *conn, struct msg *msg)
 {
@@ -951,9 +1275,14 @@ should_forward_req_to_backend(struct conn *c_conn, struct msg* msg)
 
     switch(msg->type) {
     case MSG_REQ_REDIS_SET:
+    case MSG_REQ_REDIS_MSET:
     case MSG_REQ_REDIS_DEL:
     case MSG_REQ_REDIS_SADD:
     case MSG_REQ_REDIS_SREM:
+    case MSG_REQ_REDIS_INCR:
+    case MSG_REQ_REDIS_INCRBY:
+    case MSG_REQ_REDIS_DECR:
+    case MSG_REQ_REDIS_DECRBY:
         return true;
 
     default:
@@ -17,6 +17,7 @@
 
 #include <nc_core.h>
 #include <nc_server.h>
+#include <proto/nc_proto.h>
 
 struct msg *
 rsp_get(struct conn *conn)
@@ -214,7 +215,7 @@ rsp_filter(struct context *ctx, struct conn *conn, struct msg *msg)
           }
         } else {
             conn->dequeue_outq(ctx, conn, pmsg);
-            pmsg->done = 1;
+            req_mark_done(pmsg);
         }
 
         log_debug(LOG_INFO, "swallow rsp %"PRIu64" len %"PRIu32" of req "
@@ -258,7 +259,7 @@ rsp_get_peer(struct context *ctx, struct conn *s_conn, struct msg *msg)
     ASSERT(pmsg->request && !pmsg->done);
 
     s_conn->dequeue_outq(ctx, s_conn, pmsg);
-    pmsg->done = 1;
+    req_mark_done(pmsg);
 
     /* establish msg <-> pmsg (response <-> request) link */
     pmsg->peer = msg;
@@ -285,7 +286,7 @@ rsp_forward(struct context *ctx, struct conn *s_conn, struct msg *msg)
     ASSERT(pmsg->request && !pmsg->done);
 
     s_conn->dequeue_outq(ctx, s_conn, pmsg);
-    pmsg->done = 1;
+    req_mark_done(pmsg);
 
     /* establish msg <-> pmsg (response <-> request) link */
     pmsg->peer = msg;
@@ -341,6 +342,53 @@ rsp_recv_done(struct context *ctx, struct conn *conn,
     rsp_forward(ctx, conn, msg);
 }
 
+/*
+ * Send what has been streamed so far of the reply to a backend read
+ * still being received (see riak_cut_through), which heads the client
+ * outq until it is.  The reply is sent as it grows, releasing its mbufs
+ * sent but for the one it grows in; a read which fails once its reply
+ * is under way closes the client, whose reply cannot be retracted.
+ */
+static struct msg *
+rsp_send_cut_through(struct context *ctx, struct conn *conn, struct msg *pmsg)
+{
+    struct msg *msg = pmsg->riak_cut->rsp;
+    struct mbuf *mbuf;
+
+    if (pmsg->done) {
+        ASSERT(pmsg->error);
+        conn->err = pmsg->err != 0 ? pmsg->err : EIO;
+        return NULL;
+    }
+
+    if (msg != NULL && conn->smsg == msg) {
+        /* the reply is already in the send chain */
+        conn->smsg = NULL;
+        return NULL;
+    }
+
+    mbuf = NULL;
+    while (msg != NULL && (mbuf = STAILQ_FIRST(&msg->mhdr)) != NULL &&
+           mbuf_empty(mbuf) && STAILQ_NEXT(mbuf, next) != NULL) {
+        mbuf_remove(&msg->mhdr, mbuf);
+        mbuf_put(mbuf);
+    }
+
+    if (mbuf == NULL || mbuf_empty(mbuf)) {
+        if (event_del_out(ctx->evb, conn) != NC_OK) {
+            conn->err = errno;
+        }
+        return NULL;
+    }
+
+    conn->smsg = msg;
+
+    log_debug(LOG_VVERB, "send next part of rsp %"PRIu64" on c %d", msg->id,
+              conn->sd);
+
+    return msg;
+}
+
 struct msg *
 rsp_send_next(struct context *ctx, struct conn *conn)
 {
@@ -350,6 +398,10 @@ rsp_send_next(struct context *ctx, struct conn *conn)
     ASSERT(conn->client && !conn->proxy);
 
     pmsg = TAILQ_FIRST(&conn->omsg_q);
+    if (pmsg != NULL && pmsg->riak_cut != NULL) {
+        return rsp_send_cut_through(ctx, conn, pmsg);
+    }
+
     if (pmsg == NULL || !req_done(conn, pmsg)) {
         /* nothing is outstanding, initiate close? */
         if (pmsg == NULL && conn->eof) {
@@ -369,6 +421,11 @@ rsp_send_next(struct context *ctx, struct conn *conn)
     if (msg != NULL) {
         ASSERT(!msg->request && msg->peer != NULL);
         ASSERT(req_done(conn, msg->peer));
+        /* the rest of a reply released in parts goes ahead of later ones */
+        if (msg->dt_stream != NULL) {
+            conn->smsg = NULL;
+            return NULL;
+        }
         pmsg = TAILQ_NEXT(msg->peer, c_tqe);
     }
 
@@ -402,6 +459,7 @@ rsp_send_next(struct context *ctx, struct conn *conn)
 void
 rsp_send_done(struct context *ctx, struct conn *conn, struct msg *msg)
 {
+    rstatus_t status;
     struct msg *pmsg; /* peer message (request) */
 
     ASSERT(conn->client && !conn->proxy);
@@ -411,6 +469,23 @@ rsp_send_done(struct context *ctx, struct conn *conn, struct msg *msg)
 
     pmsg = msg->peer;
 
+    /* only a part of a reply streamed was sent, see rsp_send_cut_through */
+    if (pmsg->riak_cut != NULL && pmsg->riak_cut->rsp == msg) {
+        return;
+    }
+
+    /*
+     * A reply released in parts is sent its next part in place; one which
+     * fails once under way closes the client, see rsp_send_cut_through
+     */
+    if (msg->dt_stream != NULL) {
+        status = repack_dt_fetch_next(msg);
+        if (status != NC_OK) {
+            conn->err = (status == NC_ENOMEM) ? ENOMEM : EIO;
+        }
+        return;
+    }
+
     ASSERT(!msg->request && pmsg->request);
     ASSERT(pmsg->peer == msg);
     ASSERT(pmsg->done && !pmsg->swallow);
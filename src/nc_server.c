@@ -22,6 +22,13 @@
 #include <nc_server.h>
 #include <nc_conf.h>
 
+struct string write_mode_strings[] = {
+    string("read_before_write"),
+    string("lww"),
+    string("immutable"),
+    null_string
+};
+
 void
 server_ref(struct conn *conn, void *owner)
 {
@@ -378,9 +385,10 @@ server_close(struct context *ctx, struct conn *conn)
             c_conn = msg->owner;
             ASSERT(c_conn->client && !c_conn->proxy);
 
-            msg->done = 1;
+            req_mark_done(msg);
             msg->error = 1;
             msg->err = conn->err;
+            backend_miss_done(msg, NULL);
 
             if (msg->frag_owner != NULL) {
                 msg->frag_owner->nfrag_done++;
@@ -412,9 +420,10 @@ server_close(struct context *ctx, struct conn *conn)
             c_conn = msg->owner;
             ASSERT(c_conn->client && !c_conn->proxy);
 
-            msg->done = 1;
+            req_mark_done(msg);
             msg->error = 1;
             msg->err = conn->err;
+            backend_miss_done(msg, NULL);
             if (msg->frag_owner != NULL) {
                 msg->frag_owner->nfrag_done++;
             }
@@ -994,6 +1003,13 @@ server_pool_deinit(struct array *server_pool)
         servers_deinit(&sp->frontends);
         servers_deinit(&sp->backends);
         server_pool_bp_deinit(&sp->backend_opt.bucket_prop);
+        vclock_cache_destroy(sp->vclock_cache);
+        sp->vclock_cache = NULL;
+
+        write_behind_destroy(sp->write_behind);
+        sp->write_behind = NULL;
+        l1_cache_destroy(sp->l1_cache);
+        sp->l1_cache = NULL;
 
         log_debug(LOG_DEBUG, "deinit pool %"PRIu32" '%.*s'", sp->idx,
                   sp->name.len, sp->name.data);
@@ -1004,10 +1020,14 @@ server_pool_deinit(struct array *server_pool)
     log_debug(LOG_DEBUG, "deinit %"PRIu32" pools", npool);
 }
 
-int64_t
-server_pool_bucket_ttl(struct server_pool *pool,
-                       uint8_t *datatype, uint32_t datatypelen,
-                       uint8_t *bucket, uint32_t bucketlen)
+/**.......................................................................
+ * Return the properties configured for a datatype:bucket, or NULL if
+ * there are none
+ */
+static struct bucket_prop *
+server_pool_bucket_prop(struct server_pool *pool,
+                        uint8_t *datatype, uint32_t datatypelen,
+                        uint8_t *bucket, uint32_t bucketlen)
 {
     const uint8_t default_datatype[] = "default";
     uint32_t i;
@@ -1023,14 +1043,126 @@ server_pool_bucket_ttl(struct server_pool *pool,
                 if (nc_strncmp(bp->datatype.data, default_datatype,
                         sizeof(default_datatype) - 1)
                     == 0) {
-                    return bp->ttl_ms;
+                    return bp;
                 }
             } else if (datatypelen == bp->datatype.len) {
                 if (nc_strncmp(bp->datatype.data, datatype, datatypelen) == 0) {
-                    return bp->ttl_ms;
+                    return bp;
                 }
             }
         }
     }
-    return pool->server_ttl_ms;
+    return NULL;
+}
+
+int64_t
+server_pool_bucket_ttl(struct server_pool *pool,
+                       uint8_t *datatype, uint32_t datatypelen,
+                       uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    return (bp != NULL) ? bp->ttl_ms : pool->server_ttl_ms;
+}
+
+bucket_write_mode_t
+server_pool_bucket_write_mode(struct server_pool *pool,
+                              uint8_t *datatype, uint32_t datatypelen,
+                              uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    return (bp != NULL) ? (bucket_write_mode_t)bp->write_mode
+                        : WRITE_MODE_READ_BEFORE_WRITE;
+}
+
+int64_t
+server_pool_bucket_negative_ttl(struct server_pool *pool,
+                                uint8_t *datatype, uint32_t datatypelen,
+                                uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    return (bp != NULL) ? bp->negative_ttl_ms : 0;
+}
+
+int64_t
+server_pool_bucket_grace(struct server_pool *pool,
+                         uint8_t *datatype, uint32_t datatypelen,
+                         uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    return (bp != NULL) ? bp->grace_ms : 0;
+}
+
+int64_t
+server_pool_bucket_write_behind(struct server_pool *pool,
+                                uint8_t *datatype, uint32_t datatypelen,
+                                uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    return (bp != NULL) ? bp->write_behind_ms : 0;
+}
+
+int
+server_pool_bucket_max_siblings(struct server_pool *pool,
+                                uint8_t *datatype, uint32_t datatypelen,
+                                uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    return (bp != NULL) ? bp->max_siblings : 0;
+}
+
+/**.......................................................................
+ * Take one of the sibling collapses a bucket is allowed in the current
+ * second, at most backend_collapse_rate of them.
+ *
+ * Returns false if the bucket has used them all up
+ */
+bool
+server_pool_bucket_collapse(struct server_pool *pool,
+                            uint8_t *datatype, uint32_t datatypelen,
+                            uint8_t *bucket, uint32_t bucketlen)
+{
+    struct bucket_prop *bp = server_pool_bucket_prop(pool, datatype, datatypelen,
+                                                     bucket, bucketlen);
+    int64_t now;
+
+    if (bp == NULL) {
+        return false;
+    }
+
+    now = nc_msec_now();
+    if (now - bp->collapse_window_ms >= 1000) {
+        bp->collapse_window_ms = now;
+        bp->ncollapse = 0;
+    }
+
+    if (bp->ncollapse >= (uint32_t)pool->backend_opt.collapse_rate) {
+        return false;
+    }
+    bp->ncollapse++;
+
+    return true;
+}
+
+/**.......................................................................
+ * Parse a bucket write mode name, ie 'lww'
+ */
+bool
+server_read_write_mode(const struct string *value, int *mode)
+{
+    struct string *wm;
+
+    for (wm = write_mode_strings; wm->len != 0; wm++) {
+        if (string_compare(value, wm) == 0) {
+            *mode = (int)(wm - write_mode_strings);
+            return true;
+        }
+    }
+
+    return false;
 }
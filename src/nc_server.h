@@ -61,6 +61,8 @@
 
 typedef uint32_t (*hash_t)(const char *, size_t);
 
+#define SERVER_NLATENCY 128                  /* # recent backend read latencies kept per server */
+
 struct continuum {
     uint32_t index;  /* server index */
     uint32_t value;  /* hash value */
@@ -85,6 +87,10 @@ struct server {
     uint32_t           failure_count; /* # consecutive failures */
 
     bool               backend;       /* is a backend or frontend server? */
+
+    uint32_t           nlatency;      /* # backend read latencies sampled */
+    uint32_t           latency[SERVER_NLATENCY]; /* recent backend read latencies in usec */
+    int64_t            hedge_delay;   /* hedge reads slower than this, in usec, 0 if unknown */
 };
 
 struct servers {
@@ -97,10 +103,25 @@ struct servers {
     int64_t            next_rebuild;         /* next distribution rebuild time in usec */
 };
 
+typedef enum bucket_write_mode {
+    WRITE_MODE_READ_BEFORE_WRITE,            /* GET the vclock before each PUT */
+    WRITE_MODE_LWW,                          /* last-write-wins bucket, PUT directly */
+    WRITE_MODE_IMMUTABLE,                    /* values are never updated, PUT directly */
+} bucket_write_mode_t;
+
+extern struct string write_mode_strings[];
+
 struct bucket_prop {
     struct string       datatype;            /* datatype */
     struct string       bucket;              /* bucket */
     int64_t             ttl_ms;              /* port */
+    int                 write_mode;          /* write mode (bucket_write_mode_t) */
+    int64_t             negative_ttl_ms;     /* ttl of not-found markers, 0 to not cache not-found */
+    int64_t             grace_ms;            /* refresh ahead of expiry, 0 to not refresh */
+    int64_t             write_behind_ms;     /* max delay of write-behind PUTs, 0 to write through */
+    int                 max_siblings;        /* # siblings a read collapses beyond, 0 to not collapse */
+    int64_t             collapse_window_ms;  /* start of the current second of collapses */
+    uint32_t            ncollapse;           /* # collapses in the current second */
 };
 
 struct backend_opt {
@@ -116,9 +137,16 @@ struct backend_opt {
     int                riak_notfound_ok;     /* Riak notfound_ok */
     int                riak_deletedvclock;   /* Riak deletedvclock */
     int                riak_timeout;         /* Riak timeout */
+    int                vclock_cache;         /* # vclocks cached */
+    int                hedge_percentile;     /* latency percentile to hedge reads at, 0 to not hedge */
+    int                write_behind;         /* max # writes queued for write-behind */
+    int                collapse_rate;        /* max # sibling collapses per bucket per sec */
+    int                counter_window;       /* msec counter updates are batched for, 0 to not batch */
     struct array       bucket_prop;          /* buckets properties */
 };
 
+#define SERVER_POOL_MISSQ_NSLOT 256
+
 struct server_pool {
     uint32_t           idx;                  /* pool index */
     struct context     *ctx;                 /* owner context */
@@ -159,6 +187,14 @@ struct server_pool {
                                               * server_ttl_ms == 0
                                               * will be taken to mean
                                               * never */
+    struct msg_tqh     backend_missq[SERVER_POOL_MISSQ_NSLOT]; /* requests in flight to the backend for cache misses */
+    struct msg_tqh     backend_batchq[SERVER_POOL_MISSQ_NSLOT]; /* batches of backend updates, by key */
+    struct msg_tqh     backend_counter_dueq; /* batches of counter updates not yet sent, by due time */
+    struct msg_tqh     backend_set_dueq;     /* batches of set updates not yet sent, of this tick */
+    struct vclock_cache *vclock_cache;       /* recently seen riak vclocks, or NULL */
+    struct write_behind *write_behind;       /* writes queued for riak, or NULL */
+    int                l1_cache_size;        /* bytes of values cached in the proxy */
+    struct l1_cache    *l1_cache;            /* values cached in the proxy, or NULL */
     unsigned           auto_eject_hosts:1;   /* auto_eject_hosts? */
     unsigned           preconnect:1;         /* preconnect? */
     unsigned           redis:1;              /* redis? */
@@ -191,6 +227,25 @@ void server_pool_deinit(struct array *server_pool);
 
 int64_t server_pool_bucket_ttl(struct server_pool *pool, uint8_t *datatype, uint32_t datatypelen,
                                uint8_t *bucket, uint32_t bucketlen);
+bucket_write_mode_t server_pool_bucket_write_mode(struct server_pool *pool, uint8_t *datatype,
+                                                  uint32_t datatypelen, uint8_t *bucket,
+                                                  uint32_t bucketlen);
+int64_t server_pool_bucket_negative_ttl(struct server_pool *pool, uint8_t *datatype,
+                                        uint32_t datatypelen, uint8_t *bucket,
+                                        uint32_t bucketlen);
+int64_t server_pool_bucket_grace(struct server_pool *pool, uint8_t *datatype,
+                                 uint32_t datatypelen, uint8_t *bucket,
+                                 uint32_t bucketlen);
+int64_t server_pool_bucket_write_behind(struct server_pool *pool, uint8_t *datatype,
+                                        uint32_t datatypelen, uint8_t *bucket,
+                                        uint32_t bucketlen);
+int server_pool_bucket_max_siblings(struct server_pool *pool, uint8_t *datatype,
+                                    uint32_t datatypelen, uint8_t *bucket,
+                                    uint32_t bucketlen);
+bool server_pool_bucket_collapse(struct server_pool *pool, uint8_t *datatype,
+                                 uint32_t datatypelen, uint8_t *bucket,
+                                 uint32_t bucketlen);
+bool server_read_write_mode(const struct string *value, int *mode);
 void server_pool_bp_deinit(struct array *bpa);
 
 #endif
@@ -30,6 +30,29 @@
     /* forwarder behavior */                                                                                        \
     ACTION( forward_error,          STATS_COUNTER,      "# times we encountered a forwarding error")                \
     ACTION( fragments,              STATS_COUNTER,      "# fragments created from a multi-vector request")          \
+    ACTION( miss_coalesced,         STATS_COUNTER,      "# cache misses answered by an in-flight backend read")     \
+    ACTION( vclock_cache_hits,      STATS_COUNTER,      "# writes sent on a cached vclock, no read-before-write")   \
+    ACTION( nil_marker_hits,        STATS_COUNTER,      "# cache misses answered by a not-found marker")            \
+    ACTION( mget_fills,             STATS_COUNTER,      "# mget cache misses read through from the backend")        \
+    ACTION( refreshes,              STATS_COUNTER,      "# cached keys refreshed from the backend before expiry")   \
+    ACTION( refresh_unchanged,      STATS_COUNTER,      "# refreshes which found the backend value unchanged")      \
+    ACTION( counter_batches,        STATS_COUNTER,      "# batched counter updates written to the backend")         \
+    ACTION( counter_batched,        STATS_COUNTER,      "# counter updates merged into a batched one")              \
+    ACTION( set_batches,            STATS_COUNTER,      "# batched set updates written to the backend")             \
+    ACTION( set_batched,            STATS_COUNTER,      "# set updates merged into a batched one")                  \
+    ACTION( set_op_fills,           STATS_COUNTER,      "# set operations computed from backend reads")             \
+    ACTION( backend_hedges,         STATS_COUNTER,      "# slow backend reads hedged to another server")            \
+    ACTION( backend_hedge_wins,     STATS_COUNTER,      "# hedged backend reads answered by the hedge")             \
+    ACTION( cut_through_reads,      STATS_COUNTER,      "# large backend reads streamed to the client")             \
+    ACTION( l1_cache_hits,          STATS_COUNTER,      "# GETs answered from the values cached in the proxy")      \
+    ACTION( write_behind_queued,    STATS_GAUGE,        "# writes queued for write-behind to the backend")          \
+    ACTION( write_behind_merged,    STATS_COUNTER,      "# writes merged into a write already queued")              \
+    ACTION( write_behind_full,      STATS_COUNTER,      "# writes written through as the queue was full")           \
+    ACTION( write_behind_writes,    STATS_COUNTER,      "# queued writes written to the backend")                   \
+    ACTION( write_behind_lag_ms,    STATS_COUNTER,      "total msec queued writes waited for the backend")          \
+    ACTION( sibling_collapses,      STATS_COUNTER,      "# reads with siblings collapsed by a write-back")          \
+    ACTION( collapses_limited,      STATS_COUNTER,      "# sibling collapses skipped by the rate limit")            \
+    ACTION( frontend_batched,       STATS_COUNTER,      "# cache fills joined into a pipelined frontend write")     \
 
 #define STATS_SERVER_CODEC(ACTION)                                                                                  \
     /* server behavior */                                                                                           \
@@ -0,0 +1,252 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nc_core.h>
+#include <nc_vclock.h>
+
+struct vclock_cache *
+vclock_cache_create(uint32_t max_entry, hash_t key_hash)
+{
+    struct vclock_cache *vc;
+    uint32_t i;
+
+    ASSERT(max_entry > 0);
+
+    vc = nc_alloc(sizeof(*vc));
+    if (vc == NULL) {
+        return NULL;
+    }
+
+    vc->slot = nc_alloc(sizeof(*vc->slot) * max_entry);
+    if (vc->slot == NULL) {
+        nc_free(vc);
+        return NULL;
+    }
+
+    vc->nentry = 0;
+    vc->max_entry = max_entry;
+    vc->nslot = max_entry;
+    vc->key_hash = key_hash;
+    TAILQ_INIT(&vc->lru_q);
+
+    for (i = 0; i < vc->nslot; i++) {
+        TAILQ_INIT(&vc->slot[i]);
+    }
+
+    return vc;
+}
+
+static void
+vclock_entry_free(struct vclock_cache *vc, struct vclock_entry *ve)
+{
+    TAILQ_REMOVE(&vc->slot[ve->hash % vc->nslot], ve, h_tqe);
+    TAILQ_REMOVE(&vc->lru_q, ve, l_tqe);
+    vc->nentry--;
+
+    string_deinit(&ve->key);
+    if (ve->vclock.data != NULL) {
+        nc_free(ve->vclock.data);
+    }
+    nc_free(ve);
+}
+
+void
+vclock_cache_destroy(struct vclock_cache *vc)
+{
+    if (vc == NULL) {
+        return;
+    }
+
+    while (!TAILQ_EMPTY(&vc->lru_q)) {
+        vclock_entry_free(vc, TAILQ_FIRST(&vc->lru_q));
+    }
+    ASSERT(vc->nentry == 0);
+
+    nc_free(vc->slot);
+    nc_free(vc);
+}
+
+bool
+vclock_cache_enabled(const struct vclock_cache *vc)
+{
+    return vc != NULL;
+}
+
+/**.......................................................................
+ * Build the cache key of a Riak object, "datatype:bucket:key", with
+ * the 'default' datatype made explicit so both spellings of a key
+ * share an entry
+ */
+rstatus_t
+vclock_key_init(struct string *dst, const ProtobufCBinaryData *datatype,
+                const ProtobufCBinaryData *bucket,
+                const ProtobufCBinaryData *key)
+{
+    static const char default_datatype[] = "default";
+    const uint8_t *dt = datatype->data;
+    size_t dtlen = datatype->len;
+    uint8_t *p;
+
+    if (dtlen == 0) {
+        dt = (const uint8_t *)default_datatype;
+        dtlen = sizeof(default_datatype) - 1;
+    }
+
+    string_init(dst);
+    dst->len = (uint32_t)(dtlen + 1 + bucket->len + 1 + key->len);
+    dst->data = nc_alloc(dst->len);
+    if (dst->data == NULL) {
+        dst->len = 0;
+        return NC_ENOMEM;
+    }
+
+    p = dst->data;
+    nc_memcpy(p, dt, dtlen);
+    p += dtlen;
+    *p++ = ':';
+    if (bucket->len > 0) {
+        nc_memcpy(p, bucket->data, bucket->len);
+        p += bucket->len;
+    }
+    *p++ = ':';
+    if (key->len > 0) {
+        nc_memcpy(p, key->data, key->len);
+    }
+
+    return NC_OK;
+}
+
+static struct vclock_entry *
+vclock_cache_lookup(struct vclock_cache *vc, const struct string *key,
+                    uint32_t hash)
+{
+    struct vclock_entry *ve;
+
+    TAILQ_FOREACH(ve, &vc->slot[hash % vc->nslot], h_tqe) {
+        if (ve->hash == hash && string_compare(&ve->key, key) == 0) {
+            return ve;
+        }
+    }
+
+    return NULL;
+}
+
+/**.......................................................................
+ * Look up the vclock cached for key.  On a hit, vclock references the
+ * cached data, which is only valid until the cache is next updated
+ */
+bool
+vclock_cache_get(struct vclock_cache *vc, const struct string *key,
+                 ProtobufCBinaryData *vclock)
+{
+    struct vclock_entry *ve;
+
+    if (!vclock_cache_enabled(vc) || key->len == 0) {
+        return false;
+    }
+
+    ve = vclock_cache_lookup(vc, key,
+                             vc->key_hash((char *)key->data, key->len));
+    if (ve == NULL) {
+        return false;
+    }
+
+    TAILQ_REMOVE(&vc->lru_q, ve, l_tqe);
+    TAILQ_INSERT_HEAD(&vc->lru_q, ve, l_tqe);
+
+    *vclock = ve->vclock;
+    return true;
+}
+
+/**.......................................................................
+ * Remember the vclock of key, recycling the least recently used entry
+ * once the cache is full
+ */
+void
+vclock_cache_put(struct vclock_cache *vc, const struct string *key,
+                 const ProtobufCBinaryData *vclock)
+{
+    struct vclock_entry *ve;
+    uint8_t *data;
+    uint32_t hash;
+
+    if (!vclock_cache_enabled(vc) || key->len == 0) {
+        return;
+    }
+
+    if (vclock->len == 0) {
+        vclock_cache_del(vc, key);
+        return;
+    }
+
+    data = nc_alloc(vclock->len);
+    if (data == NULL) {
+        vclock_cache_del(vc, key);
+        return;
+    }
+    nc_memcpy(data, vclock->data, vclock->len);
+
+    hash = vc->key_hash((char *)key->data, key->len);
+    ve = vclock_cache_lookup(vc, key, hash);
+    if (ve != NULL) {
+        TAILQ_REMOVE(&vc->lru_q, ve, l_tqe);
+        TAILQ_INSERT_HEAD(&vc->lru_q, ve, l_tqe);
+        nc_free(ve->vclock.data);
+        ve->vclock.data = data;
+        ve->vclock.len = vclock->len;
+        return;
+    }
+
+    if (vc->nentry >= vc->max_entry) {
+        vclock_entry_free(vc, TAILQ_LAST(&vc->lru_q, vclock_tqh));
+    }
+
+    ve = nc_alloc(sizeof(*ve));
+    if (ve == NULL) {
+        nc_free(data);
+        return;
+    }
+    string_init(&ve->key);
+    if (string_copy(&ve->key, key->data, key->len) != NC_OK) {
+        nc_free(data);
+        nc_free(ve);
+        return;
+    }
+    ve->hash = hash;
+    ve->vclock.data = data;
+    ve->vclock.len = vclock->len;
+
+    TAILQ_INSERT_HEAD(&vc->slot[hash % vc->nslot], ve, h_tqe);
+    TAILQ_INSERT_HEAD(&vc->lru_q, ve, l_tqe);
+    vc->nentry++;
+}
+
+void
+vclock_cache_del(struct vclock_cache *vc, const struct string *key)
+{
+    struct vclock_entry *ve;
+
+    if (!vclock_cache_enabled(vc) || key->len == 0) {
+        return;
+    }
+
+    ve = vclock_cache_lookup(vc, key,
+                             vc->key_hash((char *)key->data, key->len));
+    if (ve != NULL) {
+        vclock_entry_free(vc, ve);
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NC_VCLOCK_H_
+#define _NC_VCLOCK_H_
+
+#include <nc_core.h>
+
+/*
+ * The vclock cache remembers the Riak vclocks most recently seen by a
+ * server_pool, keyed by "datatype:bucket:key", so that a SET of a key
+ * the proxy has recently read or written can be sent to Riak as a
+ * single PUT instead of a read-before-write GET followed by the PUT.
+ *
+ * Entries are kept in a fixed number of hash slots and in a LRU queue;
+ * once max_entry entries are cached, the least recently used one is
+ * recycled.  A pool without a vclock cache has a NULL one, which all
+ * of the functions below accept.
+ */
+
+struct vclock_entry {
+    TAILQ_ENTRY(vclock_entry) h_tqe;         /* link in hash slot */
+    TAILQ_ENTRY(vclock_entry) l_tqe;         /* link in lru q */
+    uint32_t                  hash;          /* key hash */
+    struct string             key;           /* datatype:bucket:key */
+    ProtobufCBinaryData       vclock;        /* riak vclock */
+};
+
+TAILQ_HEAD(vclock_tqh, vclock_entry);
+
+struct vclock_cache {
+    uint32_t                  nentry;        /* # cached entries */
+    uint32_t                  max_entry;     /* max # cached entries */
+    uint32_t                  nslot;         /* # hash slots */
+    struct vclock_tqh         *slot;         /* hash slots */
+    struct vclock_tqh         lru_q;         /* entries, most recently used first */
+    hash_t                    key_hash;      /* key hasher */
+};
+
+struct vclock_cache *vclock_cache_create(uint32_t max_entry, hash_t key_hash);
+void vclock_cache_destroy(struct vclock_cache *vc);
+bool vclock_cache_enabled(const struct vclock_cache *vc);
+rstatus_t vclock_key_init(struct string *dst, const ProtobufCBinaryData *datatype,
+                          const ProtobufCBinaryData *bucket,
+                          const ProtobufCBinaryData *key);
+bool vclock_cache_get(struct vclock_cache *vc, const struct string *key,
+                      ProtobufCBinaryData *vclock);
+void vclock_cache_put(struct vclock_cache *vc, const struct string *key,
+                      const ProtobufCBinaryData *vclock);
+void vclock_cache_del(struct vclock_cache *vc, const struct string *key);
+
+#endif
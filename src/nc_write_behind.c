@@ -0,0 +1,239 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <nc_core.h>
+#include <nc_write_behind.h>
+
+struct write_behind *
+write_behind_create(uint32_t max_entry, hash_t key_hash)
+{
+    struct write_behind *wb;
+    uint32_t i;
+
+    ASSERT(max_entry > 0);
+
+    wb = nc_alloc(sizeof(*wb));
+    if (wb == NULL) {
+        return NULL;
+    }
+
+    wb->slot = nc_alloc(sizeof(*wb->slot) * max_entry);
+    if (wb->slot == NULL) {
+        nc_free(wb);
+        return NULL;
+    }
+
+    wb->nentry = 0;
+    wb->max_entry = max_entry;
+    wb->nslot = max_entry;
+    wb->key_hash = key_hash;
+    rbtree_init(&wb->due_rbt, &wb->due_rbs);
+
+    for (i = 0; i < wb->nslot; i++) {
+        TAILQ_INIT(&wb->slot[i]);
+    }
+
+    return wb;
+}
+
+/**.......................................................................
+ * Unlink an entry from the queue, and free it, handing its SET back
+ */
+static struct msg *
+write_behind_entry_free(struct write_behind *wb, struct write_behind_entry *we)
+{
+    struct msg *msg = we->msg;
+
+    TAILQ_REMOVE(&wb->slot[we->hash % wb->nslot], we, h_tqe);
+    rbtree_delete(&wb->due_rbt, &we->rbe);
+    wb->nentry--;
+
+    string_deinit(&we->key);
+    nc_free(we);
+
+    return msg;
+}
+
+void
+write_behind_destroy(struct write_behind *wb)
+{
+    struct rbnode *node;
+
+    if (wb == NULL) {
+        return;
+    }
+
+    while ((node = rbtree_min(&wb->due_rbt)) != NULL) {
+        msg_put(write_behind_entry_free(wb, node->data));
+    }
+    ASSERT(wb->nentry == 0);
+
+    nc_free(wb->slot);
+    nc_free(wb);
+}
+
+bool
+write_behind_enabled(const struct write_behind *wb)
+{
+    return wb != NULL;
+}
+
+static struct write_behind_entry *
+write_behind_lookup(struct write_behind *wb, uint8_t *key, uint32_t keylen,
+                    uint32_t hash)
+{
+    struct write_behind_entry *we;
+
+    TAILQ_FOREACH(we, &wb->slot[hash % wb->nslot], h_tqe) {
+        if (we->hash == hash && we->key.len == keylen &&
+            memcmp(we->key.data, key, keylen) == 0) {
+            return we;
+        }
+    }
+
+    return NULL;
+}
+
+/**.......................................................................
+ * Queue the SET msg of key, due at time due (in msec).  If key is queued
+ * already, msg replaces its queued SET, which is released, and coalesced
+ * is set; the entry keeps its due time.
+ *
+ * Returns NC_OK once msg is owned by the queue; otherwise, NC_ERROR if
+ * the queue is full or NC_ENOMEM, msg is left to the caller
+ */
+rstatus_t
+write_behind_put(struct write_behind *wb, uint8_t *key, uint32_t keylen,
+                 struct msg *msg, int64_t due, bool *coalesced)
+{
+    struct write_behind_entry *we;
+    uint32_t hash;
+
+    ASSERT(write_behind_enabled(wb));
+    ASSERT(keylen > 0);
+
+    *coalesced = false;
+
+    hash = wb->key_hash((char *)key, keylen);
+    we = write_behind_lookup(wb, key, keylen, hash);
+    if (we != NULL) {
+        msg_put(we->msg);
+        we->msg = msg;
+        *coalesced = true;
+        return NC_OK;
+    }
+
+    if (wb->nentry >= wb->max_entry) {
+        return NC_ERROR;
+    }
+
+    we = nc_alloc(sizeof(*we));
+    if (we == NULL) {
+        return NC_ENOMEM;
+    }
+    string_init(&we->key);
+    if (string_copy(&we->key, key, keylen) != NC_OK) {
+        nc_free(we);
+        return NC_ENOMEM;
+    }
+    we->hash = hash;
+    we->msg = msg;
+    we->queued = nc_msec_now();
+
+    rbtree_node_init(&we->rbe);
+    we->rbe.key = due;
+    we->rbe.data = we;
+    rbtree_insert(&wb->due_rbt, &we->rbe);
+
+    TAILQ_INSERT_TAIL(&wb->slot[hash % wb->nslot], we, h_tqe);
+    wb->nentry++;
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Drop the queued SET of key, if any, eg. as a later write of key is
+ * written through.  Returns true if a SET was dropped
+ */
+bool
+write_behind_del(struct write_behind *wb, uint8_t *key, uint32_t keylen)
+{
+    struct write_behind_entry *we;
+
+    if (!write_behind_enabled(wb) || wb->nentry == 0 || keylen == 0) {
+        return false;
+    }
+
+    we = write_behind_lookup(wb, key, keylen, wb->key_hash((char *)key, keylen));
+    if (we == NULL) {
+        return false;
+    }
+
+    msg_put(write_behind_entry_free(wb, we));
+    return true;
+}
+
+/**.......................................................................
+ * Return the due time (in msec) of the first entry due, -1 if the queue
+ * is empty
+ */
+int64_t
+write_behind_next(struct write_behind *wb)
+{
+    struct rbnode *node;
+
+    if (!write_behind_enabled(wb)) {
+        return -1;
+    }
+
+    node = rbtree_min(&wb->due_rbt);
+    if (node == NULL) {
+        return -1;
+    }
+
+    return node->key;
+}
+
+/**.......................................................................
+ * Dequeue the first entry due, handing its SET, key and time queued over
+ * to the caller.  Returns NULL if the queue is empty
+ */
+struct msg *
+write_behind_pop(struct write_behind *wb, struct string *key, int64_t *queued)
+{
+    struct write_behind_entry *we;
+    struct rbnode *node;
+
+    if (!write_behind_enabled(wb)) {
+        return NULL;
+    }
+
+    node = rbtree_min(&wb->due_rbt);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    we = node->data;
+
+    /* the key is handed over, not freed */
+    *key = we->key;
+    string_init(&we->key);
+    *queued = we->queued;
+
+    return write_behind_entry_free(wb, we);
+}
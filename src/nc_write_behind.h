@@ -0,0 +1,69 @@
+/*
+ * twemproxy - A fast and lightweight proxy for memcached protocol.
+ * Copyright (C) 2011 Twitter, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _NC_WRITE_BEHIND_H_
+#define _NC_WRITE_BEHIND_H_
+
+#include <nc_core.h>
+
+/*
+ * The write-behind queue holds the SETs of a server_pool's write-behind
+ * buckets, which are acknowledged once written to the frontend, until
+ * they are written to Riak.  A key has at most one entry: a later SET
+ * of a queued key replaces the queued one, so the key is written to Riak
+ * once, with its latest value.
+ *
+ * An entry is due once its first SET has waited for the write_behind
+ * delay of its bucket; entries are kept in a rbtree by due time, and in
+ * a fixed number of hash slots for lookup by key.  At most max_entry
+ * entries are queued.  A pool without write-behind has a NULL queue,
+ * which all of the functions below accept.
+ */
+
+struct write_behind_entry {
+    TAILQ_ENTRY(write_behind_entry) h_tqe;   /* link in hash slot */
+    struct rbnode                   rbe;     /* entry in due rbtree */
+    uint32_t                        hash;    /* key hash */
+    struct string                   key;     /* key, as written by the client */
+    struct msg                      *msg;    /* latest SET of the key */
+    int64_t                         queued;  /* time first queued in msec */
+};
+
+TAILQ_HEAD(write_behind_tqh, write_behind_entry);
+
+struct write_behind {
+    uint32_t                  nentry;        /* # queued entries */
+    uint32_t                  max_entry;     /* max # queued entries */
+    uint32_t                  nslot;         /* # hash slots */
+    struct write_behind_tqh   *slot;         /* hash slots */
+    struct rbtree             due_rbt;       /* entries, by due time */
+    struct rbnode             due_rbs;       /* due rbtree sentinel */
+    hash_t                    key_hash;      /* key hasher */
+};
+
+struct write_behind *write_behind_create(uint32_t max_entry, hash_t key_hash);
+void write_behind_destroy(struct write_behind *wb);
+bool write_behind_enabled(const struct write_behind *wb);
+rstatus_t write_behind_put(struct write_behind *wb, uint8_t *key, uint32_t keylen,
+                           struct msg *msg, int64_t due, bool *coalesced);
+bool write_behind_del(struct write_behind *wb, uint8_t *key, uint32_t keylen);
+int64_t write_behind_next(struct write_behind *wb);
+struct msg *write_behind_pop(struct write_behind *wb, struct string *key,
+                             int64_t *queued);
+
+#endif
@@ -138,6 +138,11 @@
     (str15icmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14) &&       \
      (m[15] == c15 || m[15] == (c15 ^ 0x20)))
 
+/* kinds of the bulks of a multi-bulk reply, see redis_multibulk_scan */
+#define REDIS_BULK_VALUE    0
+#define REDIS_BULK_NIL      1
+#define REDIS_BULK_MATCH    2
+
 void memcache_parse_req(struct msg *r);
 void memcache_parse_rsp(struct msg *r);
 void memcache_pre_coalesce(struct msg *r);
@@ -152,6 +157,10 @@ void redis_parse_req(struct msg *r);
 void redis_parse_rsp(struct msg *r);
 void redis_pre_coalesce(struct msg *r);
 void redis_post_coalesce(struct msg *r);
+rstatus_t redis_copy_bulk(struct msg *dst, struct msg *src);
+int redis_multibulk_scan(struct msg *r, uint8_t *kind, uint32_t nbulk,
+                         const uint8_t *match, uint32_t matchlen);
+int redis_multibulk_values(struct msg *r, ProtobufCBinaryData **values);
 rstatus_t redis_add_auth_packet(struct context *ctx, struct conn *c_conn, struct conn *s_conn);
 rstatus_t redis_fragment(struct msg *r, uint32_t ncontinuum, struct msg_tqh *frag_msgq);
 rstatus_t redis_reply(struct msg *r);
@@ -170,13 +179,16 @@ rstatus_t riak_add_auth_packet(struct context *ctx, struct conn *c_conn, struct
 rstatus_t riak_fragment(struct msg *r, uint32_t ncontinuum, struct msg_tqh *frag_msgq);
 void riak_post_connect(struct context *ctx, struct conn *conn, struct server *server);
 void riak_swallow_msg(struct conn *conn, struct msg *pmsg, struct msg *msg);
-rstatus_t riak_sync_key(struct context *ctx, struct msg* r, msg_type_t type, bool skip_first);
-rstatus_t riak_synced_key(struct context *ctx, struct msg* pmsg, struct msg* amsg, uint32_t *keysfound);
+rstatus_t riak_store_set(struct context *ctx, struct msg* pmsg,
+                         ProtobufCBinaryData *values, uint32_t nval);
 
 struct msg* riak_rsp_recv_next(struct context *ctx, struct conn *conn, bool alloc);
 struct msg* riak_req_send_next(struct context *ctx, struct conn *conn);
 rstatus_t riak_req_remap(struct conn* conn, struct msg* msg);
+rstatus_t riak_incr_delta(struct msg* r, int64_t* delta);
 rstatus_t riak_repack(struct msg* r);
+rstatus_t repack_dt_fetch_next(struct msg* r);
+void repack_dt_fetch_put(struct msg* r);
 rstatus_t redis_repack(struct msg* r);
 rstatus_t memcache_repack(struct msg* r);
 
@@ -184,11 +196,22 @@ rstatus_t add_set_msg_redis(struct context *ctx, struct conn* c_conn, struct msg
 
 rstatus_t add_set_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg);
 rstatus_t add_pexpire_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg);
+rstatus_t add_nil_marker_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg);
 
 rstatus_t add_set_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
                           struct msg_pos* keyval_start_pos, uint32_t keyvallen);
+rstatus_t add_set_msg_start(struct context *ctx, struct conn* c_conn, char* keyname,
+                            uint32_t keyvallen, struct msg** pmsg);
+rstatus_t add_set_msg_done(struct context *ctx, struct conn* c_conn, char* keyname,
+                           struct msg* msg);
 rstatus_t add_pexpire_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
                               uint32_t keynamelen, uint32_t time);
+rstatus_t add_nil_marker_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
+                                 uint32_t keynamelen, int64_t ttl_ms);
+rstatus_t del_nil_marker_msg_key(struct context *ctx, struct conn* c_conn, char* keyname,
+                                 uint32_t keynamelen);
+void backend_l1_fill(struct conn* c_conn, struct msg* pmsg, uint8_t* key,
+                     uint32_t keylen, struct msg_pos* val, uint32_t vlen);
 
 rstatus_t redis_get_next_string(struct msg* msg, struct msg_pos* init_pos, struct msg_pos* start_pos, size_t* len);
 
@@ -25,6 +25,8 @@
 #define REPL_OK     "+OK\r\n"
 #define REPL_PONG   "+PONG\r\n"
 
+#define REPL_RESERVED_KEY "-ERR key reserved by the proxy\r\n"
+
 #define AUTH_INVALID_PASSWORD "-ERR invalid password\r\n"
 #define AUTH_REQUIRE_PASSWORD "-NOAUTH Authentication required\r\n"
 #define AUTH_NO_PASSWORD      "-ERR Client sent AUTH, but no password is set\r\n"
@@ -2084,7 +2086,7 @@ error:
  * if dst == NULL, we just eat the bulk
  *
  * */
-static rstatus_t
+rstatus_t
 redis_copy_bulk(struct msg *dst, struct msg *src)
 {
     struct mbuf *mbuf, *nbuf;
@@ -2153,6 +2155,216 @@ redis_copy_bulk(struct msg *dst, struct msg *src)
     return NC_OK;
 }
 
+/*
+ * return the next byte of a reply being scanned across mbufs, or false
+ * at the end of the reply
+ */
+static bool
+redis_scan_byte(struct mbuf **mbuf, uint8_t **p, uint8_t *ch)
+{
+    while (*p >= (*mbuf)->last) {
+        *mbuf = STAILQ_NEXT(*mbuf, next);
+        if (*mbuf == NULL) {
+            return false;
+        }
+        *p = (*mbuf)->pos;
+    }
+
+    *ch = **p;
+    (*p)++;
+
+    return true;
+}
+
+/*
+ * Classify the nbulk bulks of multi-bulk reply r in kind[], without
+ * consuming the reply: a bulk is either nil ($-1), equal to the match
+ * value, if one is given, or any other value
+ *
+ * Returns the number of bulks which are nil or match, or -1 if the
+ * reply does not hold nbulk bulks
+ */
+int
+redis_multibulk_scan(struct msg *r, uint8_t *kind, uint32_t nbulk,
+                     const uint8_t *match, uint32_t matchlen)
+{
+    struct mbuf *mbuf;
+    uint8_t *p, ch;
+    uint32_t i, len, off, n;
+    bool matched;
+    int nfound = 0;
+
+    ASSERT(r->type == MSG_RSP_REDIS_MULTIBULK);
+
+    mbuf = STAILQ_FIRST(&r->mhdr);
+    if (mbuf == NULL || r->narg_start != mbuf->pos || r->narg_end == NULL) {
+        return -1;
+    }
+    p = r->narg_end + CRLF_LEN;
+
+    for (i = 0; i < nbulk; i++) {
+        if (!redis_scan_byte(&mbuf, &p, &ch) || ch != '$') {
+            return -1;
+        }
+
+        if (!redis_scan_byte(&mbuf, &p, &ch)) {
+            return -1;
+        }
+
+        if (ch == '-') {
+            kind[i] = REDIS_BULK_NIL;
+            nfound++;
+            do {
+                if (!redis_scan_byte(&mbuf, &p, &ch)) {
+                    return -1;
+                }
+            } while (ch != LF);
+            continue;
+        }
+
+        for (len = 0; isdigit(ch); ) {
+            len = len * 10 + (uint32_t)(ch - '0');
+            if (!redis_scan_byte(&mbuf, &p, &ch)) {
+                return -1;
+            }
+        }
+        if (ch != CR || !redis_scan_byte(&mbuf, &p, &ch) || ch != LF) {
+            return -1;
+        }
+
+        /* skip the value and its trailing crlf, comparing it to match */
+        matched = (match != NULL && len == matchlen);
+        for (off = 0, len += CRLF_LEN; len > 0; off += n, len -= n) {
+            while (p >= mbuf->last) {
+                mbuf = STAILQ_NEXT(mbuf, next);
+                if (mbuf == NULL) {
+                    return -1;
+                }
+                p = mbuf->pos;
+            }
+            n = MIN(len, (uint32_t)(mbuf->last - p));
+            if (matched && off < matchlen &&
+                memcmp(p, match + off, MIN(n, matchlen - off)) != 0) {
+                matched = false;
+            }
+            p += n;
+        }
+
+        kind[i] = matched ? REDIS_BULK_MATCH : REDIS_BULK_VALUE;
+        if (matched) {
+            nfound++;
+        }
+    }
+
+    return nfound;
+}
+
+/*
+ * scan the decimal number ending in crlf at p, across mbufs
+ */
+static bool
+redis_scan_number(struct mbuf **mbuf, uint8_t **p, uint32_t *num)
+{
+    uint8_t ch;
+    uint32_t ndigit;
+
+    *num = 0;
+    for (ndigit = 0; ; ndigit++) {
+        if (!redis_scan_byte(mbuf, p, &ch)) {
+            return false;
+        }
+        if (!isdigit(ch)) {
+            break;
+        }
+        if (*num > (UINT32_MAX - 9) / 10) {
+            return false;
+        }
+        *num = *num * 10 + (uint32_t)(ch - '0');
+    }
+
+    return ndigit > 0 && ch == CR && redis_scan_byte(mbuf, p, &ch) && ch == LF;
+}
+
+/*
+ * Copy the bulks of multi-bulk reply r, without consuming the reply,
+ * into one block allocated with nc_alloc, which starts with the array
+ * of the values returned in values, and is released with nc_free
+ *
+ * Returns the number of values, or -1 if the reply is no multi-bulk
+ * of values or memory runs out
+ */
+int
+redis_multibulk_values(struct msg *r, ProtobufCBinaryData **values)
+{
+    struct mbuf *mbuf;
+    ProtobufCBinaryData *v;
+    uint8_t *p, *data, ch;
+    uint32_t i, nbulk, len, n;
+    size_t size = 0;
+
+    *values = NULL;
+
+    STAILQ_FOREACH(mbuf, &r->mhdr, next) {
+        size += mbuf_length(mbuf);
+    }
+
+    mbuf = STAILQ_FIRST(&r->mhdr);
+    if (mbuf == NULL) {
+        return -1;
+    }
+    p = mbuf->pos;
+
+    if (!redis_scan_byte(&mbuf, &p, &ch) || ch != '*' ||
+        !redis_scan_number(&mbuf, &p, &nbulk)) {
+        return -1;
+    }
+
+    /* an empty bulk takes 6 bytes, $0\r\n\r\n */
+    if (nbulk == 0 || nbulk > size / 6) {
+        return nbulk == 0 ? 0 : -1;
+    }
+
+    v = nc_alloc(nbulk * sizeof(*v) + size);
+    if (v == NULL) {
+        return -1;
+    }
+    data = (uint8_t *)(v + nbulk);
+
+    for (i = 0; i < nbulk; i++) {
+        if (!redis_scan_byte(&mbuf, &p, &ch) || ch != '$' ||
+            !redis_scan_number(&mbuf, &p, &len)) {
+            nc_free(v);
+            return -1;
+        }
+
+        v[i].data = data;
+        v[i].len = len;
+
+        for (; len > 0; len -= n, data += n, p += n) {
+            while (p >= mbuf->last) {
+                mbuf = STAILQ_NEXT(mbuf, next);
+                if (mbuf == NULL) {
+                    nc_free(v);
+                    return -1;
+                }
+                p = mbuf->pos;
+            }
+            n = MIN(len, (uint32_t)(mbuf->last - p));
+            nc_memcpy(data, p, n);
+        }
+
+        if (!redis_scan_byte(&mbuf, &p, &ch) || ch != CR ||
+            !redis_scan_byte(&mbuf, &p, &ch) || ch != LF) {
+            nc_free(v);
+            return -1;
+        }
+    }
+
+    *values = v;
+
+    return (int)nbulk;
+}
+
 /*
  * Pre-coalesce handler is invoked when the message is a response to
  * the fragmented multi vector request - 'mget' or 'del' and all the
@@ -2216,7 +2428,7 @@ redis_pre_coalesce(struct msg *r)
         break;
 
     case MSG_RSP_REDIS_STATUS:
-        if (pr->type == MSG_REQ_REDIS_MSET) {       /* MSET segments */
+        if (pr->frag_owner->type == MSG_REQ_REDIS_MSET) { /* MSET segments */
             mbuf = STAILQ_FIRST(&r->mhdr);
             r->mlen -= mbuf_length(mbuf);
             mbuf_rewind(mbuf);
@@ -2287,7 +2499,9 @@ redis_append_key(struct msg *r, uint8_t *key, uint32_t keylen)
  * ncontinuum is the number of backend redis/memcache server
  *
  * the original msg will be fragment into at most ncontinuum fragments.
- * all the keys map to the same backend will group into one fragment.
+ * all the keys map to the same backend will group into one fragment,
+ * unless frag_key is set, in which case each key is a fragment of its own,
+ * and each key of an mset a set.
  *
  * frag_id:
  * a unique fragment id for all fragments of the message vector. including the orig msg.
@@ -2345,6 +2559,10 @@ redis_fragment_argx(struct msg *r, uint32_t ncontinuum, struct msg_tqh *frag_msg
 
     ASSERT(array_n(r->keys) == (r->narg - 1) / key_step);
 
+    if (r->frag_key) {
+        ncontinuum = array_n(r->keys);
+    }
+
     sub_msgs = nc_zalloc(ncontinuum * sizeof(*sub_msgs));
     if (sub_msgs == NULL) {
         return NC_ENOMEM;
@@ -2380,7 +2598,8 @@ redis_fragment_argx(struct msg *r, uint32_t ncontinuum, struct msg_tqh *frag_msg
     for (i = 0; i < array_n(r->keys); i++) {        /* for each key */
         struct msg *sub_msg;
         struct keypos *kpos = array_get(r->keys, i);
-        uint32_t idx = msg_backend_idx(r, kpos->start, kpos->end - kpos->start);
+        uint32_t idx = r->frag_key ? i :
+                       msg_backend_idx(r, kpos->start, kpos->end - kpos->start);
 
         if (sub_msgs[idx] == NULL) {
             sub_msgs[idx] = msg_get(r->owner, r->request);
@@ -2429,6 +2648,9 @@ redis_fragment_argx(struct msg *r, uint32_t ncontinuum, struct msg_tqh *frag_msg
         } else if (r->type == MSG_REQ_REDIS_DEL) {
             status = msg_prepend_format(sub_msg, "*%d\r\n$3\r\ndel\r\n",
                                         sub_msg->narg + 1);
+        } else if (r->type == MSG_REQ_REDIS_MSET && r->frag_key) {
+            status = msg_prepend_format(sub_msg, "*%d\r\n$3\r\nset\r\n",
+                                        sub_msg->narg + 1);
         } else if (r->type == MSG_REQ_REDIS_MSET) {
             status = msg_prepend_format(sub_msg, "*%d\r\n$4\r\nmset\r\n",
                                         sub_msg->narg + 1);
@@ -2441,6 +2663,9 @@ redis_fragment_argx(struct msg *r, uint32_t ncontinuum, struct msg_tqh *frag_msg
         }
 
         sub_msg->type = r->type;
+        if (r->type == MSG_REQ_REDIS_MSET && r->frag_key) {
+            sub_msg->type = MSG_REQ_REDIS_SET;
+        }
         sub_msg->frag_id = r->frag_id;
         sub_msg->frag_owner = r->frag_owner;
 
@@ -2483,6 +2708,10 @@ redis_reply(struct msg *r)
         return msg_append(response, (uint8_t *)AUTH_REQUIRE_PASSWORD, strlen(AUTH_REQUIRE_PASSWORD));
     }
 
+    if (backend_key_reserved(c_conn, r)) {
+        return msg_append(response, (uint8_t *)REPL_RESERVED_KEY, nc_strlen(REPL_RESERVED_KEY));
+    }
+
     switch (r->type) {
     case MSG_REQ_REDIS_PING:
         return msg_append(response, (uint8_t *)REPL_PONG, nc_strlen(REPL_PONG));
@@ -2776,6 +3005,9 @@ add_set_msg_redis(struct context *ctx, struct conn* c_conn, struct msg* msg)
     if ((status = redis_get_next_string(msg, NULL, &keyval_start_pos, &keyvallen)) != NC_OK)
         return status;
 
+    backend_l1_fill(c_conn, msg->peer, (uint8_t*)keyname, (uint32_t)keynamelen,
+                    &keyval_start_pos, (uint32_t)keyvallen);
+
     return add_set_msg_key(ctx, c_conn, keyname, &keyval_start_pos, keyvallen);
 }
 
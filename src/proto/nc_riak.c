@@ -42,6 +42,13 @@ riak_parse_req(struct msg *r)
 void
 riak_parse_rsp(struct msg *r)
 {
+    struct riak_rsp *rsp;
+    struct riak_cut *cut;
+    struct pb_cursor c;
+    struct msg *pmsg;
+    ProtobufCBinaryData errmsg;
+    rstatus_t status = NC_OK;
+
     ASSERT(r != NULL);
 
     r->result = MSG_PARSE_OK;
@@ -59,69 +66,121 @@ riak_parse_rsp(struct msg *r)
         return;
     }
 
+    /*
+     * A large GET response may be streamed to the client as it is
+     * received, in which case the mbufs streamed are released from r
+     * (see riak_cut_through)
+     */
+
+    pmsg = TAILQ_FIRST(&r->owner->omsg_q);
+    cut = NULL;
+    if (pmsg != NULL && msgid == RSP_RIAK_GET &&
+        (pmsg->cut_through || pmsg->riak_cut != NULL)) {
+        if (riak_cut_through(r, pmsg, len) != NC_OK) {
+            r->result = MSG_PARSE_ERROR;
+            return;
+        }
+        cut = pmsg->riak_cut;
+    }
+
     /* 
      * If the mbuf len is less than message len + sizeof(len), we are
      * not done reading
      */
 
-    if (r->mlen < len + 4) {
+    if (r->mlen + ((cut != NULL) ? cut->released : 0) < len + 4) {
         r->result = MSG_PARSE_AGAIN;
         return;
     }
 
     /*
-     * On return from this method, the message position should point to
-     * the beginning of any unparsed data.  This is used in msg_parsed()
-     * to determine if the mbuf should be split i.e., if more than one
-     * message is encoded in the same set of mbufs)
+     * If we get here, we are done reading at least one message -- use
+     * the msgid to determine what the message is, and decode the fields
+     * of it that riak_repack uses in place, in the same walk over the
+     * mbufs that frames it.  Acknowledgements carry nothing we use, and
+     * are framed by their length alone.
      */
 
-    struct msg_pos msg_start = msg_pos_init();
-    msg_pos_init_start(r, &msg_start);
+    rsp = &r->riak_rsp;
+    memset(rsp, 0, sizeof(*rsp));
+    rsp->msgid = msgid;
+    rsp->len = len;
 
-    struct msg_pos msg_end = msg_pos_init();
-    msg_offset_from(&msg_start, len + 4, &msg_end);
+    if (cut != NULL) {
+        /* The value has been streamed: pick up past it */
 
-    r->pos = msg_end.ptr;
+        c.mbuf = cut->mbuf;
+        c.ptr = cut->ptr;
+        c.left = len + 4 - cut->off;
+    } else {
+        c.mbuf = STAILQ_FIRST(&r->mhdr);
+        c.ptr = c.mbuf->start;
+        c.left = len + 4;
+
+        /* Skip the message length and id */
+
+        if (!pb_cursor_skip(&c, 5)) {
+            r->result = MSG_PARSE_ERROR;
+            return;
+        }
+    }
 
-    /*
-     * If we get here, we are done reading at least one message --
-     * use the msgid to determine what the message is, and extract the
-     * PB-formatted response from the message buffer
-     */
     switch (msgid) {
     case RSP_RIAK_GET:
-        /*
-         * if you really need to do something here, just use sample below
-         * {
-         *    RpbGetResp* rpbresp = extract_get_rsp(r, len, &msgid);
-         *    if (rpbresp == NULL) {
-         *        r->result = MSG_PARSE_ERROR;
-         *    } else {
-         *        rpb_get_resp__free_unpacked(rpbresp);
-         *    }
-         * }
-         * break;
-         */
+        if (cut != NULL) {
+            status = extract_cut_through_rsp(&c, cut, rsp);
+        } else {
+            status = extract_get_rsp(&c, rsp);
+        }
+        break;
+
     case RSP_RIAK_PUT:
-    case RSP_RIAK_DT_UPDATE:
+        status = extract_put_rsp(&c, rsp);
+        break;
+
     case RSP_RIAK_DT_FETCH:
+        status = extract_dt_fetch_rsp(&c, rsp);
+        break;
+
+    case RSP_RIAK_DT_UPDATE:
+        status = extract_dt_update_rsp(&c, rsp);
+        break;
+
     case RSP_RIAK_DEL:
-        /* DEL doesn't have response */
         break;
+
     case RSP_RIAK_UNKNOWN:
-    {
+        status = extract_error_rsp(&c, rsp, &errmsg);
+        if (status == NC_OK) {
+            log_debug(LOG_VERB, "riak error %"PRIu32" '%.*s'", rsp->errcode,
+                      (int)errmsg.len, errmsg.data);
+        }
+
         // While removing non-existent values from we will have msgid equal 0
-        struct msg* pmsg = TAILQ_FIRST(&r->owner->omsg_q);
-        if (pmsg->type == MSG_REQ_RIAK_SREM) {
-            break;
+        if (status != NC_OK ||
+            (pmsg->type != MSG_REQ_RIAK_SREM && !pmsg->set_batch)) {
+            status = NC_ERROR;
         }
-    }
-        /* no break */
+        break;
+
     default:
-        r->result = MSG_PARSE_ERROR;
+        status = NC_ERROR;
         break;
     }
+
+    /*
+     * On return from this method, the message position should point to
+     * the beginning of any unparsed data.  This is used in msg_parsed()
+     * to determine if the mbuf should be split i.e., if more than one
+     * message is encoded in the same set of mbufs)
+     */
+
+    if (status != NC_OK || !pb_cursor_skip(&c, c.left)) {
+        r->result = MSG_PARSE_ERROR;
+        return;
+    }
+
+    r->pos = c.ptr;
 }
 
 /**.......................................................................
@@ -221,6 +280,16 @@ riak_pre_coalesce(struct msg *r)
 
         pr->frag_owner->integer = pr->integer;
         break;
+
+    case MSG_RSP_REDIS_STATUS:
+        /* the keys of a redis 'mset' are written as a PUT each */
+        ASSERT(pr->frag_owner->type == MSG_REQ_REDIS_MSET);
+
+        mbuf = STAILQ_FIRST(&r->mhdr);
+        r->mlen -= mbuf_length(mbuf);
+        mbuf_rewind(mbuf);
+        break;
+
     default:
         /*
          * Valid responses for a fragmented request are MSG_RSP_REDIS_INTEGER or,
@@ -294,6 +363,85 @@ riak_req_send_next(struct context *ctx, struct conn *conn)
     return req_send_next(ctx, conn);
 }
 
+/**.......................................................................
+ * Return true if a Redis SET may be written to Riak without a
+ * read-before-write: either its bucket is configured as LWW or
+ * immutable, or the vclock of its key is cached, in which case the
+ * vclock is copied to the request
+ */
+static bool
+riak_req_skip_read_before_write(struct conn* conn, struct msg* msg)
+{
+    ProtobufCBinaryData datatype, bucket, key, vclock;
+    struct msg_pos keyname_start_pos = msg_pos_init();
+    struct string vclock_key;
+    bool skip;
+
+    if (extract_bucket_key_value(msg, &datatype, &bucket, &key, NULL,
+                                 &keyname_start_pos, true) != NC_OK) {
+        return false;
+    }
+
+    struct server* server = (struct server*)(conn->owner);
+    struct server_pool* pool = (struct server_pool*)(server->owner);
+
+    skip = server_pool_bucket_write_mode(pool,
+                                         datatype.data, (uint32_t)datatype.len,
+                                         bucket.data, (uint32_t)bucket.len)
+           != WRITE_MODE_READ_BEFORE_WRITE;
+
+    if (!skip && vclock_cache_enabled(pool->vclock_cache) &&
+        vclock_key_init(&vclock_key, &datatype, &bucket, &key) == NC_OK) {
+        if (vclock_cache_get(pool->vclock_cache, &vclock_key, &vclock)) {
+            msg_copy_vclock(msg, (protobuf_c_boolean)1, vclock);
+            stats_pool_incr(pool->ctx, pool, vclock_cache_hits);
+            skip = true;
+        }
+        string_deinit(&vclock_key);
+    }
+
+    return skip;
+}
+
+/**.......................................................................
+ * Remember the key a Riak GET or PUT request is for, so the vclock in
+ * its response can be cached
+ */
+static void
+riak_req_set_vclock_key(struct msg* r, struct server_pool* pool,
+                        const ProtobufCBinaryData *datatype,
+                        const ProtobufCBinaryData *bucket,
+                        const ProtobufCBinaryData *key)
+{
+    string_deinit(&r->vclock_key);
+    if (vclock_cache_enabled(pool->vclock_cache)) {
+        vclock_key_init(&r->vclock_key, datatype, bucket, key);
+    }
+}
+
+/**.......................................................................
+ * Update the vclock cache from the GET or PUT response r: a response
+ * without a vclock evicts the key
+ */
+static void
+riak_rsp_update_vclock_cache(struct msg* r, protobuf_c_boolean has_vclock,
+                             ProtobufCBinaryData vclock)
+{
+    struct msg* pmsg = TAILQ_FIRST(&r->owner->omsg_q);
+    if (pmsg == NULL || pmsg->vclock_key.len == 0) {
+        return;
+    }
+
+    struct server* server = (struct server*)(r->owner->owner);
+    struct server_pool* pool = (struct server_pool*)(server->owner);
+
+    if (has_vclock) {
+        vclock_cache_put(pool->vclock_cache, &pmsg->vclock_key, &vclock);
+    } else {
+        vclock_cache_del(pool->vclock_cache, &pmsg->vclock_key);
+    }
+}
+
 /**.......................................................................
  * Remap Redis requests to the corresponding Riak requests
  *
@@ -311,6 +459,8 @@ riak_req_remap(struct conn* conn, struct msg* msg)
 
     switch (msg->type) {
     case MSG_REQ_RIAK_GET:
+    case MSG_REQ_RIAK_EXISTS:
+    case MSG_REQ_RIAK_INCR:
         break;
 
     case MSG_REQ_REDIS_GET:
@@ -320,18 +470,24 @@ riak_req_remap(struct conn* conn, struct msg* msg)
 
         break;
 
+    case MSG_REQ_REDIS_EXISTS:
+        if ((status = encode_pb_get_req(msg, conn, MSG_REQ_RIAK_EXISTS)) != NC_OK) {
+            return status;
+        }
+        break;
+
     case MSG_REQ_REDIS_SET:
-        if (msg->has_vclock) {
+        if (msg->has_vclock || riak_req_skip_read_before_write(conn, msg)) {
+            /* buckets configured as last-write-wins (LWW) or immutable
+             * never grow siblings, so the PUT goes out without a vclock;
+             * otherwise a vclock from the pool's vclock cache stands in
+             * for the one the read-before-write would have fetched.
+             */
             if ((status = encode_pb_put_req(msg, conn, MSG_REQ_RIAK_SET)) != NC_OK) {
                 return status;
             }
         } else {
-            /* currently there is no configuration settings that would cause
-             * no read_before_write, but there may be, ie for bucket patterns
-             * or for all requests since Riak can be configured in a
-             * last-write-wins (LWW) manner.
-             *
-             * read_before_write to get the vclock to avoid "sibling explosion".
+            /* read_before_write to get the vclock to avoid "sibling explosion".
              * cloning the SET since it will yield the equivalent key for a GET.
              */
             msgp = msg_content_clone(msg);
@@ -361,6 +517,14 @@ riak_req_remap(struct conn* conn, struct msg* msg)
         break;
 
     case MSG_REQ_REDIS_SADD:
+        if (msg->set_batch) {
+            /* a batch of the SADDs and SREMs of a set */
+            if ((status = encode_pb_set_batch_req(msg, conn, MSG_REQ_RIAK_SADD)) != NC_OK) {
+                return status;
+            }
+            break;
+        }
+
         if ((status = encode_pb_sadd_req(msg, conn, MSG_REQ_RIAK_SADD)) != NC_OK) {
             return status;
         }
@@ -390,6 +554,15 @@ riak_req_remap(struct conn* conn, struct msg* msg)
         }
         break;
 
+    case MSG_REQ_REDIS_INCR:
+    case MSG_REQ_REDIS_INCRBY:
+    case MSG_REQ_REDIS_DECR:
+    case MSG_REQ_REDIS_DECRBY:
+        if ((status = encode_pb_incr_req(msg, conn, MSG_REQ_RIAK_INCR)) != NC_OK) {
+            return status;
+        }
+        break;
+
     default:
         return NC_ERROR;
     }
@@ -400,7 +573,7 @@ riak_req_remap(struct conn* conn, struct msg* msg)
 /**.......................................................................
  * Extract type, bucket, key and value form Redis command.
  * Data in either type.data, bucket.data, or key.data as well as value.data
- * should be freed with nc_free(req.type.data)
+ * is allocated from the arena, and released at the end of the event
  */
 rstatus_t
 extract_bucket_key_value(struct msg *r,
@@ -441,7 +614,7 @@ extract_bucket_key_value(struct msg *r,
             return NC_ERROR;
         }
 
-        data = nc_alloc(keynamelen + 1);
+        data = arena_alloc(keynamelen + 1);
         if (data == NULL) {
             return NC_ENOMEM;
         }
@@ -449,7 +622,7 @@ extract_bucket_key_value(struct msg *r,
         if ((status = msg_extract_from_pos_char((char *)data,
                         keyname_start_pos, keynamelen))
                 != NC_OK) {
-            nc_free(data);
+            return status;
         }
 
         /* extract datatype, bucket and key from line */
@@ -465,96 +638,19 @@ extract_bucket_key_value(struct msg *r,
                                             keyname_start_pos, keyname_start_pos,
                                             &value->len))
                 != NC_OK) {
-            nc_free(data);
             return status;
         }
-        value->data = nc_alloc(value->len + 1);
+        value->data = arena_alloc(value->len + 1);
         if (value->data == NULL) {
-            nc_free(data);
             return NC_ENOMEM;
         }
         if ((status = msg_extract_from_pos_char((char*)value->data,
                                                  keyname_start_pos, value->len))
                 != NC_OK) {
-            nc_free(data);
-            return status;
-        }
-    }
-
-    return NC_OK;
-}
-
-/**.......................................................................
- * Pack the message into our mbufs
- */
-rstatus_t
-pack_message(struct msg *r, msg_type_t type, uint32_t msglen, uint8_t reqid,
-             pb_pack_func func, const void *message, uint32_t bucketlen)
-{
-    rstatus_t status;
-    uint32_t netlen = htonl(msglen + 1);
-
-    /*
-     * Construct the length of the whole message we will send to
-     * riak. This is:
-     *
-     *   size of the msglen integer
-     * + a byte for the message type
-     * + the length of the pb-encoded message
-     */
-
-    uint32_t pbmsglen = sizeof(msglen) + 1 + msglen;
-
-    /*
-     * Insert the message length, request ID and the data payload.
-     *
-     * If the first message mbuf has enough room to contain the message,
-     * just reuse it.  Else we have to allocate a contiguous buffer
-     * large enough to format the PB request before packing it into the
-     * message
-     */
-
-    struct mbuf* mbuf = STAILQ_FIRST(&r->mhdr);
-    if (pbmsglen <= mbuf_size(mbuf)) {
-        mbuf_rewind(mbuf);
-
-        mbuf_copy(mbuf, (uint8_t*)&netlen, sizeof(netlen));
-        mbuf_copy(mbuf, &reqid, 1);
-        func(message, mbuf->last);
-
-        mbuf->last += msglen;
-    } else {
-        uint8_t* buf = nc_alloc(msglen);
-
-        func(message, buf);
-
-        msg_rewind(r);
-
-        if ((status = msg_copy(r, (uint8_t*)&netlen, sizeof(netlen))) != NC_OK) {
-            nc_free(buf);
-            return status;
-        }
-
-        if ((status = msg_copy(r, &reqid, 1)) != NC_OK) {
-            nc_free(buf);
-            return status;
-        }
-
-        if ((status = msg_copy(r, buf, msglen)) != NC_OK) {
-            nc_free(buf);
             return status;
         }
-
-        nc_free(buf);
     }
 
-    /* Set bucketlen, but use existing keylen (-1 to calc it). Also leave key
-     * offset as is. */
-    msg_set_keypos(r, 0, 7, -1, bucketlen);
-
-    r->mlen = pbmsglen;
-    r->type = type;
-
     return NC_OK;
 }
 
@@ -595,9 +691,25 @@ _encode_pb_get_req(struct msg* r, struct conn* s_conn, msg_type_t type,
     }
 
     struct server* server = (struct server*)(s_conn->owner);
-    const struct server_pool* pool = (struct server_pool*)(server->owner);
+    struct server_pool* pool = (struct server_pool*)(server->owner);
     const struct backend_opt* opt = &pool->backend_opt;
 
+    riak_req_set_vclock_key(r, pool, &req.type, &req.bucket, &req.key);
+
+    /*
+     * An existence check needs no value, so only the metadata of the
+     * object is fetched.  A refresh of a key whose vclock is cached asks
+     * for the object only if it changed since (see backend_refresh_done)
+     */
+    if (type == MSG_REQ_RIAK_EXISTS) {
+        req.has_head = true;
+        req.head = true;
+    } else if (r->refresh &&
+               vclock_cache_get(pool->vclock_cache, &r->vclock_key,
+                                &req.if_modified)) {
+        req.has_if_modified = true;
+    }
+
     req.has_r = (opt->riak_r != CONF_UNSET_NUM);
     if (req.has_r) {
         req.r = opt->riak_r;
@@ -645,19 +757,80 @@ _encode_pb_get_req(struct msg* r, struct conn* s_conn, msg_type_t type,
 
     r->read_before_write = read_before_write;
 
+    /*
+     * A read of a bucket which never has siblings may be streamed to its
+     * client, see riak_cut_through
+     */
+    r->cut_through = type == MSG_REQ_RIAK_GET && !read_before_write &&
+                     !r->refresh &&
+                     server_pool_bucket_write_mode(pool,
+                                                   req.type.data,
+                                                   (uint32_t)req.type.len,
+                                                   req.bucket.data,
+                                                   (uint32_t)req.bucket.len)
+                     != WRITE_MODE_READ_BEFORE_WRITE;
+
     int type_and_bucket_len = ((req.type.len > 0) ? req.type.len + 1 : 0)
             + ((req.bucket.len > 0) ? req.bucket.len : 0);
-    status = pack_message(r, type, rpb_get_req__get_packed_size(&req),
-                          REQ_RIAK_GET, (pb_pack_func) rpb_get_req__pack, &req,
-                          type_and_bucket_len);
-    nc_free(req.type.data);
+    status = pack_message(r, type, REQ_RIAK_GET, pb_write_rpb_get_req, &req,
+                          NULL, type_and_bucket_len);
 
     return status;
 }
 
+/**.......................................................................
+ * Return the first and last bytes of a value referenced in place
+ */
+static void
+riak_value_ends(const struct pb_cursor* value, uint8_t* first, uint8_t* last)
+{
+    struct pb_cursor c = *value;
+
+    *first = *last = 0;
+    if (!pb_cursor_read(&c, first, 1)) {
+        return;
+    }
+
+    *last = *first;
+    if (c.left > 0 && pb_cursor_skip(&c, c.left - 1)) {
+        pb_cursor_read(&c, last, 1);
+    }
+}
+
+/**.......................................................................
+ * Set the quorum options of a PUT from the options of the pool
+ */
+static void
+riak_put_req_opts(RpbPutReq* req, const struct backend_opt* opt)
+{
+    req->has_w = (opt->riak_w != CONF_UNSET_NUM);
+    if (req->has_w) {
+        req->w = opt->riak_w;
+    }
+
+    req->has_pw = (opt->riak_pw != CONF_UNSET_NUM);
+    if (req->has_pw) {
+        req->pw = opt->riak_pw;
+    }
+
+    req->has_n_val = (opt->riak_n != CONF_UNSET_NUM);
+    if (req->has_n_val) {
+        req->n_val = opt->riak_n;
+    }
+
+    req->has_sloppy_quorum =
+            (opt->riak_sloppy_quorum != CONF_UNSET_NUM);
+    if (req->has_sloppy_quorum) {
+        req->sloppy_quorum = opt->riak_sloppy_quorum;
+    }
+}
+
 /**.......................................................................
  * Take a Redis SET request, and remap it to a PB message suitable for
  * sending to riak.
+ *
+ * The value is not copied out of the request: it is written to the PUT
+ * from the mbufs of the request by pack_message.
  */
 rstatus_t
 encode_pb_put_req(struct msg* r, struct conn* s_conn, msg_type_t type)
@@ -672,13 +845,25 @@ encode_pb_put_req(struct msg* r, struct conn* s_conn, msg_type_t type)
     RpbContent content = RPB_CONTENT__INIT;
     req.content = &content;
 
+    struct pb_cursor value;
+    size_t valuelen;
+    uint8_t first, last;
+
     struct msg_pos keyname_start_pos = msg_pos_init();
     if ((status = extract_bucket_key_value(r, &req.type, &req.bucket, &req.key,
-                                           &req.content[0].value,
-                                           &keyname_start_pos, false))
+                                           NULL, &keyname_start_pos, false))
+        != NC_OK) {
+        return status;
+    }
+
+    if ((status = redis_get_next_string(r, &keyname_start_pos,
+                                        &keyname_start_pos, &valuelen))
         != NC_OK) {
         return status;
     }
+    value.mbuf = keyname_start_pos.mbuf;
+    value.ptr = keyname_start_pos.ptr;
+    value.left = (uint32_t)valuelen;
 
     if (req.type.len > 0) {
         req.has_type = 1;
@@ -689,38 +874,42 @@ encode_pb_put_req(struct msg* r, struct conn* s_conn, msg_type_t type)
     }
 
     struct server* server = (struct server*)(s_conn->owner);
-    const struct server_pool* pool = (struct server_pool*)(server->owner);
-    const struct backend_opt* opt = &pool->backend_opt;
-
-    req.has_w = (opt->riak_w != CONF_UNSET_NUM);
-    if (req.has_w) {
-        req.w = opt->riak_w;
-    }
-
-    req.has_pw = (opt->riak_pw != CONF_UNSET_NUM);
-    if (req.has_pw) {
-        req.pw = opt->riak_pw;
-    }
-
-    req.has_n_val = (opt->riak_n != CONF_UNSET_NUM);
-    if (req.has_n_val) {
-        req.n_val = opt->riak_n;
+    struct server_pool* pool = (struct server_pool*)(server->owner);
+
+    riak_put_req_opts(&req, &pool->backend_opt);
+
+    /* the key is no longer missing, its not-found marker goes */
+    if (server_pool_bucket_negative_ttl(pool, req.type.data,
+                                        (uint32_t)req.type.len,
+                                        req.bucket.data,
+                                        (uint32_t)req.bucket.len) > 0) {
+        struct conn* c_conn = r->owner;
+        if (req.type.len > 0) {
+            del_nil_marker_msg_key(conn_to_ctx(c_conn), c_conn,
+                                   (char*)req.type.data,
+                                   (uint32_t)(req.type.len + req.bucket.len +
+                                              req.key.len + 2));
+        } else {
+            del_nil_marker_msg_key(conn_to_ctx(c_conn), c_conn,
+                                   (char*)req.bucket.data,
+                                   (uint32_t)(req.bucket.len + req.key.len + 1));
+        }
     }
 
-    req.has_sloppy_quorum =
-            (opt->riak_sloppy_quorum != CONF_UNSET_NUM);
-    if (req.has_sloppy_quorum) {
-        req.sloppy_quorum = opt->riak_sloppy_quorum;
+    /* ask for the new vclock back, to keep the vclock cache current */
+    riak_req_set_vclock_key(r, pool, &req.type, &req.bucket, &req.key);
+    if (r->vclock_key.len > 0) {
+        req.has_return_head = (protobuf_c_boolean)1;
+        req.return_head = (protobuf_c_boolean)1;
     }
 
     if (req.content != NULL) {
+        riak_value_ends(&value, &first, &last);
         req.content[0].has_content_type = (protobuf_c_boolean)1;
-        if ((req.content->value.data[0] == '{') &&
-            (req.content->value.data[req.content->value.len - 1] == '}')) {
+        if ((first == '{') && (last == '}')) {
             req.content[0].content_type.len = 16; /*<< strlen("application/json")*/
             req.content[0].content_type.data = (uint8_t*)"application/json";
-        } else if ((req.content->value.data[0] == '<') &&
-            (req.content->value.data[req.content->value.len - 1] == '>')) {
+        } else if ((first == '<') && (last == '>')) {
             req.content[0].content_type.len = 15; /*<< strlen("application/xml")*/
             req.content[0].content_type.data = (uint8_t*)"application/xml";
         } else {
@@ -737,11 +926,8 @@ encode_pb_put_req(struct msg* r, struct conn* s_conn, msg_type_t type)
 
     int type_and_bucket_len = ((req.type.len > 0) ? req.type.len + 1 : 0)
             + ((req.bucket.len > 0) ? req.bucket.len : 0);
-    status = pack_message(r, type, rpb_put_req__get_packed_size(&req),
-                          REQ_RIAK_PUT, (pb_pack_func) rpb_put_req__pack, &req,
-                          type_and_bucket_len);
-    nc_free(req.type.data);
-    nc_free(req.content->value.data);
+    status = pack_message(r, type, REQ_RIAK_PUT, pb_write_rpb_put_req, &req,
+                          &value, type_and_bucket_len);
     return status;
 }
 
@@ -761,7 +947,7 @@ encode_pb_del_req(struct msg* r, struct conn* s_conn, msg_type_t type)
 
     rstatus_t status;
     struct server* server = (struct server*)(s_conn->owner);
-    const struct server_pool* pool = (struct server_pool*)(server->owner);
+    struct server_pool* pool = (struct server_pool*)(server->owner);
     const struct backend_opt* opt = &pool->backend_opt;
 
     RpbDelReq req = RPB_DEL_REQ__INIT;
@@ -803,9 +989,17 @@ encode_pb_del_req(struct msg* r, struct conn* s_conn, msg_type_t type)
                 req.timeout = opt->riak_timeout;
             }
 
+            if (vclock_cache_enabled(pool->vclock_cache)) {
+                struct string vclock_key;
+                if (vclock_key_init(&vclock_key, &req.type, &req.bucket,
+                                    &req.key) == NC_OK) {
+                    vclock_cache_del(pool->vclock_cache, &vclock_key);
+                    string_deinit(&vclock_key);
+                }
+            }
+
             struct mbuf *mbuf = mbuf_get();
             if (mbuf == NULL) {
-                nc_free(req.type.data);
                 return NC_ENOMEM;
             }
             STAILQ_INSERT_HEAD(&r->mhdr, mbuf, next);
@@ -813,9 +1007,8 @@ encode_pb_del_req(struct msg* r, struct conn* s_conn, msg_type_t type)
             int type_and_bucket_len =
                     ((req.type.len > 0) ? req.type.len + 1 : 0) + (
                             (req.bucket.len > 0) ? req.bucket.len : 0);
-            status = pack_message(r, type, rpb_del_req__get_packed_size(&req),
-                                  REQ_RIAK_DEL, (pb_pack_func)rpb_del_req__pack,
-                                  &req, type_and_bucket_len);
+            status = pack_message(r, type, REQ_RIAK_DEL, pb_write_rpb_del_req,
+                                  &req, NULL, type_and_bucket_len);
             keys_number++;
         } else {
             status = add_pexpire_msg_key(ctx, c_conn, (char*)req.key.data,
@@ -823,10 +1016,6 @@ encode_pb_del_req(struct msg* r, struct conn* s_conn, msg_type_t type)
             r->integer++;
         }
 
-        if (req.type.data != NULL) {
-            nc_free(req.type.data);
-        }
-
         if (status != NC_OK)
             return status;
     }
@@ -849,7 +1038,7 @@ encode_pb_del_req(struct msg* r, struct conn* s_conn, msg_type_t type)
 
         /* remove subresponse of fragmented message */
         r->noreply = 1;
-        r->frag_owner->nfrag_done = r->frag_owner->nfrag;
+        r->frag_owner->nfrag_done++;
 
         status = event_add_out(ctx->evb, conn);
 
@@ -881,7 +1070,7 @@ parse_pb_get_req(struct msg *r, uint32_t* len, uint8_t* msgid, RpbGetReq** req)
 
     uint8_t* pos = mbuf->start + 4 + 1;
 
-    *req = rpb_get_req__unpack(NULL, *len - 1, pos);
+    *req = rpb_get_req__unpack(arena_pb_allocator(), *len - 1, pos);
 }
 
 void
@@ -899,7 +1088,7 @@ parse_pb_del_req(struct mbuf *mbuf, uint32_t* len, uint8_t* msgid,
 
     uint8_t* pos = mbuf->start + 4 + 1;
 
-    *req = rpb_del_req__unpack(NULL, *len - 1, pos);
+    *req = rpb_del_req__unpack(arena_pb_allocator(), *len - 1, pos);
 }
 
 /**.......................................................................
@@ -921,7 +1110,7 @@ parse_pb_put_req(struct msg *r, uint32_t* len, uint8_t* msgid, RpbPutReq** req)
 
     uint8_t* pos = mbuf->start + 4 + 1;
 
-    *req = rpb_put_req__unpack(NULL, *len - 1, pos);
+    *req = rpb_put_req__unpack(arena_pb_allocator(), *len - 1, pos);
 }
 
 /**.......................................................................
@@ -953,7 +1142,7 @@ add_pexpire_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg)
                 (int)req->key.len, req->key.data);
 
         add_pexpire_msg_key(ctx, c_conn, keyname, keynamelen, 0);
-        nc_free(req);
+        rpb_del_req__free_unpacked(req, arena_pb_allocator());
     }
     return NC_OK;
 }
@@ -991,7 +1180,7 @@ add_set_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg)
             (req->bucket.len > 0) ? ":" : "",
             (int)req->key.len, req->key.data);
 
-    nc_free(req);
+    rpb_get_req__free_unpacked(req, arena_pb_allocator());
 
     struct msg_pos keyval_start_pos = msg_pos_init();
     size_t keyvallen = 0;
@@ -1002,162 +1191,1458 @@ add_set_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg)
         != NC_OK)
         return status;
 
+    backend_l1_fill(c_conn, msg->peer, (uint8_t*)keyname, keynamelen,
+                    &keyval_start_pos, (uint32_t)keyvallen);
+
     return add_set_msg_key(ctx, c_conn, keyname, &keyval_start_pos, keyvallen);
 }
 
 /**.......................................................................
- * Extract a PB-encoded response out of the message buffer
+ * Add a not-found marker for the key of a RIAK GET request to the
+ * frontend server's queue, if the key's bucket has a negative_ttl
  */
-bool
-extract_rsp(struct msg* r, uint32_t len, uint8_t* msgid, unpack_func func,
-            void ** rpbresp)
+rstatus_t
+add_nil_marker_msg_riak(struct context *ctx, struct conn* c_conn, struct msg* msg)
 {
-    ASSERT(r != NULL);
+    ASSERT(msg != NULL);
+    ASSERT(msg->peer != NULL);
+    ASSERT(msg->peer->type == MSG_REQ_RIAK_GET);
 
-    uint8_t* buf;
-    uint32_t allocs = 0;
+    uint32_t len;
+    uint8_t msgid;
+    int64_t ttl_ms;
 
-    /*
-     * If the first message in this object fits into a single mbuf, then
-     * we can just read from the first mbuf
-     * Bu if not, we have to allocate a buffer into which we will copy
-     * the message from multiple mbufs, to pass to
-     * rpb_get_resp__unpack below
-     */
-    if (len + 4 > mbuf_data_size() && rpbresp) {
-        allocs = r->mlen;
+    RpbGetReq* req = 0;
+    parse_pb_get_req(msg->peer, &len, &msgid, &req);
+    if (req == NULL) {
+        return NC_ENOMEM;
     }
 
-    if (allocs) {
-        buf = nc_alloc(allocs);
-        if (msg_extract(r, buf, r->mlen) != NC_OK) {
-            if (rpbresp) {
-                *rpbresp = NULL;
-            }
-            return false;
-        }
-    } else {
-        const struct mbuf* mbuf = STAILQ_FIRST(&r->mhdr);
-        buf = mbuf->start;
+    ttl_ms = server_pool_bucket_negative_ttl(c_conn->owner,
+                                             req->type.data,
+                                             (uint32_t)req->type.len,
+                                             req->bucket.data,
+                                             (uint32_t)req->bucket.len);
+    if (ttl_ms <= 0) {
+        rpb_get_req__free_unpacked(req, arena_pb_allocator());
+        return NC_OK;
     }
 
-    /* Skip the message length */
-
-    uint8_t* pos = buf + 4;
-
-    /* Get the message id */
-
-    *msgid = *(pos++);
+    int delimiter_count = ((req->type.len > 0) ? 1 : 0)
+                          + ((req->bucket.len > 0) ? 1 : 0);
+    uint32_t keynamelen = req->type.len + req->bucket.len + req->key.len + delimiter_count;
+    char keyname[keynamelen + 1];
+    sprintf(keyname, "%.*s%s%.*s%s%.*s",
+            (int)req->type.len, req->type.data,
+            (req->type.len > 0) ? ":" : "",
+            (int)req->bucket.len, req->bucket.data,
+            (req->bucket.len > 0) ? ":" : "",
+            (int)req->key.len, req->key.data);
 
-    /* And unpack the PB response from the rest */
+    rpb_get_req__free_unpacked(req, arena_pb_allocator());
 
-    if (rpbresp) {
-        *rpbresp = func(NULL, len - 1, pos);
-        if (allocs) {
-            nc_free(buf);
-        }
-        return (*rpbresp) ? true : false;
-    }
-    return true;
+    return add_nil_marker_msg_key(ctx, c_conn, keyname, keynamelen, ttl_ms);
 }
 
 /**.......................................................................
- * Extract a PB-encoded GET response out of the message buffer
+ * Move a PB cursor to the start of the next mbuf if it is at the end of
+ * the current one, so that it points at the byte it is to read next
  */
-RpbGetResp*
-extract_get_rsp(struct msg* r, uint32_t len, uint8_t* msgid)
+static void
+pb_cursor_align(struct pb_cursor* c)
 {
-    RpbGetResp* rpbresp;
-    if (extract_rsp(r, len, msgid, (unpack_func)rpb_get_resp__unpack,
-                (void*)&rpbresp) == false)
-        return NULL;
-    return rpbresp;
+    while (c->ptr == c->mbuf->last && STAILQ_NEXT(c->mbuf, next) != NULL) {
+        c->mbuf = STAILQ_NEXT(c->mbuf, next);
+        c->ptr = c->mbuf->start;
+    }
 }
 
 /**.......................................................................
- * Extract a PB-encoded PUT response out of the message buffer
+ * Read a byte at a PB cursor
  */
-RpbPutResp*
-extract_put_rsp(struct msg* r, uint32_t len, uint8_t* msgid)
+static bool
+pb_cursor_byte(struct pb_cursor* c, uint8_t* b)
 {
-    RpbPutResp* rpbresp;
-    if (extract_rsp(r, len, msgid, (unpack_func)rpb_put_resp__unpack,
-                (void*)&rpbresp) == false)
-        return NULL;
-    return rpbresp;
-}
+    if (c->left == 0) {
+        return false;
+    }
+
+    pb_cursor_align(c);
+    if (c->ptr == c->mbuf->last) {
+        return false;
+    }
+
+    *b = *c->ptr++;
+    c->left--;
+
+    return true;
+}
+
+/**.......................................................................
+ * Read a varint at a PB cursor
+ */
+bool
+pb_cursor_varint(struct pb_cursor* c, uint64_t* val)
+{
+    unsigned shift;
+    uint8_t b;
+
+    *val = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+        if (!pb_cursor_byte(c, &b)) {
+            return false;
+        }
+        *val |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**.......................................................................
+ * Skip n bytes at a PB cursor
+ */
+bool
+pb_cursor_skip(struct pb_cursor* c, uint64_t n)
+{
+    uint32_t avail;
+
+    if (n > c->left) {
+        return false;
+    }
+    c->left -= (uint32_t)n;
+
+    while (n > 0) {
+        pb_cursor_align(c);
+        avail = (uint32_t)(c->mbuf->last - c->ptr);
+        if (avail == 0) {
+            return false;
+        }
+        if (n < avail) {
+            avail = (uint32_t)n;
+        }
+        c->ptr += avail;
+        n -= avail;
+    }
+
+    return true;
+}
+
+/**.......................................................................
+ * Skip the value of a field, given its tag, at a PB cursor
+ */
+bool
+pb_cursor_skip_field(struct pb_cursor* c, uint64_t tag)
+{
+    uint64_t n;
+
+    switch (tag & 0x7) {
+    case PROTOBUF_C_WIRE_TYPE_VARINT:
+        return pb_cursor_varint(c, &n);
+
+    case PROTOBUF_C_WIRE_TYPE_64BIT:
+        return pb_cursor_skip(c, 8);
+
+    case PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED:
+        return pb_cursor_varint(c, &n) && pb_cursor_skip(c, n);
+
+    case PROTOBUF_C_WIRE_TYPE_32BIT:
+        return pb_cursor_skip(c, 4);
+
+    default:
+        return false;
+    }
+}
+
+/**.......................................................................
+ * Copy n bytes out of the mbufs at a PB cursor
+ */
+bool
+pb_cursor_read(struct pb_cursor* c, uint8_t* dst, uint32_t n)
+{
+    uint32_t avail;
+
+    if (n > c->left) {
+        return false;
+    }
+    c->left -= n;
+
+    while (n > 0) {
+        pb_cursor_align(c);
+        avail = (uint32_t)(c->mbuf->last - c->ptr);
+        if (avail == 0) {
+            return false;
+        }
+        if (n < avail) {
+            avail = n;
+        }
+        nc_memcpy(dst, c->ptr, avail);
+        c->ptr += avail;
+        dst += avail;
+        n -= avail;
+    }
+
+    return true;
+}
+
+/**.......................................................................
+ * Read the length of a length-prefixed field at a PB cursor, leaving the
+ * cursor at the field's first byte and field as a cursor over the field
+ */
+bool
+pb_cursor_field(struct pb_cursor* c, struct pb_cursor* field)
+{
+    uint64_t n;
+
+    if (!pb_cursor_varint(c, &n) || n > c->left) {
+        return false;
+    }
+
+    pb_cursor_align(c);
+    *field = *c;
+    field->left = (uint32_t)n;
+
+    return true;
+}
+
+/**.......................................................................
+ * Reference the bytes left at a PB cursor in place, unless they are split
+ * across mbufs, in which case they are copied to the arena
+ */
+rstatus_t
+pb_cursor_data(const struct pb_cursor* c, ProtobufCBinaryData* data)
+{
+    struct pb_cursor field = *c;
+
+    data->len = field.left;
+    if (field.left == 0) {
+        data->data = NULL;
+    } else if (field.ptr + field.left <= field.mbuf->last) {
+        data->data = field.ptr;
+    } else {
+        data->data = arena_alloc(field.left);
+        if (data->data == NULL) {
+            return NC_ENOMEM;
+        }
+        if (!pb_cursor_read(&field, data->data, field.left)) {
+            return NC_ERROR;
+        }
+    }
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Read a length-prefixed field at a PB cursor, as pb_cursor_data
+ */
+rstatus_t
+pb_cursor_bytes(struct pb_cursor* c, ProtobufCBinaryData* data)
+{
+    struct pb_cursor field;
+
+    if (!pb_cursor_field(c, &field) || !pb_cursor_skip(c, field.left)) {
+        return NC_ERROR;
+    }
+
+    return pb_cursor_data(&field, data);
+}
+
+/*
+ * Values at least this long are spliced into a PUT rather than copied
+ */
+#define RIAK_PB_SPLICE_MIN      1024
+
+static void
+pb_writer_init(struct pb_writer* w, struct msg* msg, struct mbuf* mbuf,
+               struct mhdr* src, struct pb_cursor* value)
+{
+    w->msg = msg;
+    w->mbuf = mbuf;
+    w->src = src;
+    w->value = value;
+    w->len = 0;
+    w->status = NC_OK;
+}
+
+/**.......................................................................
+ * Append n bytes to the mbufs of a PB writer, or just count them
+ */
+static void
+pb_write_raw(struct pb_writer* w, const uint8_t* data, uint32_t n)
+{
+    struct mbuf* mbuf;
+    uint32_t avail;
+
+    w->len += n;
+    if (w->msg == NULL || w->status != NC_OK) {
+        return;
+    }
+
+    while (n > 0) {
+        mbuf = w->mbuf;
+        if (mbuf_full(mbuf)) {
+            mbuf = mbuf_get();
+            if (mbuf == NULL) {
+                w->status = NC_ENOMEM;
+                return;
+            }
+            mbuf_insert(&w->msg->mhdr, mbuf);
+            w->mbuf = mbuf;
+        }
+
+        avail = mbuf_size(mbuf);
+        if (n < avail) {
+            avail = n;
+        }
+        mbuf_copy(mbuf, (uint8_t*)data, avail);
+        data += avail;
+        n -= avail;
+    }
+}
+
+static void
+pb_write_varint(struct pb_writer* w, uint64_t val)
+{
+    uint8_t buf[10];
+    uint32_t n = 0;
+
+    while (val >= 0x80) {
+        buf[n++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    buf[n++] = (uint8_t)val;
+
+    pb_write_raw(w, buf, n);
+}
+
+static void
+pb_write_key(struct pb_writer* w, uint32_t field, ProtobufCWireType type)
+{
+    pb_write_varint(w, ((uint64_t)field << 3) | type);
+}
+
+static void
+pb_write_uint32(struct pb_writer* w, uint32_t field, uint32_t val)
+{
+    pb_write_key(w, field, PROTOBUF_C_WIRE_TYPE_VARINT);
+    pb_write_varint(w, val);
+}
+
+static void
+pb_write_bool(struct pb_writer* w, uint32_t field, protobuf_c_boolean val)
+{
+    pb_write_key(w, field, PROTOBUF_C_WIRE_TYPE_VARINT);
+    pb_write_varint(w, val ? 1 : 0);
+}
+
+static void
+pb_write_sint64(struct pb_writer* w, uint32_t field, int64_t val)
+{
+    pb_write_key(w, field, PROTOBUF_C_WIRE_TYPE_VARINT);
+    pb_write_varint(w, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+static void
+pb_write_bytes(struct pb_writer* w, uint32_t field,
+               const ProtobufCBinaryData* val)
+{
+    pb_write_key(w, field, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED);
+    pb_write_varint(w, val->len);
+    pb_write_raw(w, val->data, (uint32_t)val->len);
+}
+
+/**.......................................................................
+ * Write a length-prefixed sub-message, sized by encoding it once
+ * without writing it
+ */
+static void
+pb_write_message(struct pb_writer* w, uint32_t field, pb_encode_func func,
+                 const void* message)
+{
+    struct pb_writer sub;
+
+    pb_writer_init(&sub, NULL, NULL, NULL, w->value);
+    func(&sub, message);
+
+    pb_write_key(w, field, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED);
+    pb_write_varint(w, sub.len);
+    func(w, message);
+}
+
+/**.......................................................................
+ * Write bytes referenced in place in the source mbufs of a PB writer.
+ *
+ * Short values are copied.  Longer ones are not: the mbufs holding them
+ * are moved from the source to the message being written, the first one
+ * trimmed by moving its start, the last one by moving its last, after
+ * which the writer keeps appending.
+ */
+static void
+pb_write_ref(struct pb_writer* w, uint32_t field, const struct pb_cursor* ref)
+{
+    struct pb_cursor c = *ref;
+    struct mbuf* mbuf;
+    uint32_t avail;
+
+    pb_write_key(w, field, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED);
+    pb_write_varint(w, c.left);
+
+    if (w->msg == NULL || w->status != NC_OK) {
+        w->len += c.left;
+        return;
+    }
+
+    if (c.left < RIAK_PB_SPLICE_MIN || w->src == NULL) {
+        while (c.left > 0) {
+            pb_cursor_align(&c);
+            avail = (uint32_t)(c.mbuf->last - c.ptr);
+            if (avail == 0) {
+                w->status = NC_ERROR;
+                return;
+            }
+            if (c.left < avail) {
+                avail = c.left;
+            }
+            pb_write_raw(w, c.ptr, avail);
+            c.ptr += avail;
+            c.left -= avail;
+        }
+        return;
+    }
+
+    w->len += c.left;
+    while (c.left > 0) {
+        if (c.mbuf == NULL) {
+            w->status = NC_ERROR;
+            return;
+        }
+        pb_cursor_align(&c);
+        mbuf = c.mbuf;
+        avail = (uint32_t)(mbuf->last - c.ptr);
+        if (avail == 0) {
+            w->status = NC_ERROR;
+            return;
+        }
+
+        c.mbuf = STAILQ_NEXT(mbuf, next);
+        mbuf_remove(w->src, mbuf);
+
+        mbuf->start = c.ptr;
+        mbuf->pos = c.ptr;
+        if (c.left < avail) {
+            avail = c.left;
+            mbuf->last = c.ptr + avail;
+        }
+        if (mbuf_shared(mbuf)) {
+            /* the writer appends past shared data in an mbuf of its own */
+            mbuf->end = mbuf->last;
+        }
+        mbuf_insert(&w->msg->mhdr, mbuf);
+        w->mbuf = mbuf;
+
+        c.ptr = (c.mbuf != NULL) ? c.mbuf->start : NULL;
+        c.left -= avail;
+    }
+}
+
+/**.......................................................................
+ * Encoders for the Riak requests sent by the proxy, writing the fields
+ * in field number order as protobuf-c does.  The repeated RpbContent and
+ * DtOp fields the proxy never sets are not supported.
+ */
+void
+pb_write_rpb_get_req(struct pb_writer* w, const void* message)
+{
+    const RpbGetReq* req = message;
+
+    pb_write_bytes(w, 1, &req->bucket);
+    pb_write_bytes(w, 2, &req->key);
+    if (req->has_r) {
+        pb_write_uint32(w, 3, req->r);
+    }
+    if (req->has_pr) {
+        pb_write_uint32(w, 4, req->pr);
+    }
+    if (req->has_basic_quorum) {
+        pb_write_bool(w, 5, req->basic_quorum);
+    }
+    if (req->has_notfound_ok) {
+        pb_write_bool(w, 6, req->notfound_ok);
+    }
+    if (req->has_if_modified) {
+        pb_write_bytes(w, 7, &req->if_modified);
+    }
+    if (req->has_head) {
+        pb_write_bool(w, 8, req->head);
+    }
+    if (req->has_deletedvclock) {
+        pb_write_bool(w, 9, req->deletedvclock);
+    }
+    if (req->has_timeout) {
+        pb_write_uint32(w, 10, req->timeout);
+    }
+    if (req->has_sloppy_quorum) {
+        pb_write_bool(w, 11, req->sloppy_quorum);
+    }
+    if (req->has_n_val) {
+        pb_write_uint32(w, 12, req->n_val);
+    }
+    if (req->has_type) {
+        pb_write_bytes(w, 13, &req->type);
+    }
+}
+
+static void
+pb_write_rpb_content(struct pb_writer* w, const void* message)
+{
+    const RpbContent* content = message;
+
+    ASSERT(content->n_links == 0);
+    ASSERT(content->n_usermeta == 0);
+    ASSERT(content->n_indexes == 0);
+
+    if (w->value != NULL) {
+        pb_write_ref(w, 1, w->value);
+    } else {
+        pb_write_bytes(w, 1, &content->value);
+    }
+    if (content->has_content_type) {
+        pb_write_bytes(w, 2, &content->content_type);
+    }
+    if (content->has_charset) {
+        pb_write_bytes(w, 3, &content->charset);
+    }
+    if (content->has_content_encoding) {
+        pb_write_bytes(w, 4, &content->content_encoding);
+    }
+    if (content->has_vtag) {
+        pb_write_bytes(w, 5, &content->vtag);
+    }
+    if (content->has_last_mod) {
+        pb_write_uint32(w, 7, content->last_mod);
+    }
+    if (content->has_last_mod_usecs) {
+        pb_write_uint32(w, 8, content->last_mod_usecs);
+    }
+    if (content->has_deleted) {
+        pb_write_bool(w, 11, content->deleted);
+    }
+}
+
+void
+pb_write_rpb_put_req(struct pb_writer* w, const void* message)
+{
+    const RpbPutReq* req = message;
+
+    pb_write_bytes(w, 1, &req->bucket);
+    if (req->has_key) {
+        pb_write_bytes(w, 2, &req->key);
+    }
+    if (req->has_vclock) {
+        pb_write_bytes(w, 3, &req->vclock);
+    }
+    pb_write_message(w, 4, pb_write_rpb_content, req->content);
+    if (req->has_w) {
+        pb_write_uint32(w, 5, req->w);
+    }
+    if (req->has_dw) {
+        pb_write_uint32(w, 6, req->dw);
+    }
+    if (req->has_return_body) {
+        pb_write_bool(w, 7, req->return_body);
+    }
+    if (req->has_pw) {
+        pb_write_uint32(w, 8, req->pw);
+    }
+    if (req->has_if_not_modified) {
+        pb_write_bool(w, 9, req->if_not_modified);
+    }
+    if (req->has_if_none_match) {
+        pb_write_bool(w, 10, req->if_none_match);
+    }
+    if (req->has_return_head) {
+        pb_write_bool(w, 11, req->return_head);
+    }
+    if (req->has_timeout) {
+        pb_write_uint32(w, 12, req->timeout);
+    }
+    if (req->has_asis) {
+        pb_write_bool(w, 13, req->asis);
+    }
+    if (req->has_sloppy_quorum) {
+        pb_write_bool(w, 14, req->sloppy_quorum);
+    }
+    if (req->has_n_val) {
+        pb_write_uint32(w, 15, req->n_val);
+    }
+    if (req->has_type) {
+        pb_write_bytes(w, 16, &req->type);
+    }
+}
+
+void
+pb_write_rpb_del_req(struct pb_writer* w, const void* message)
+{
+    const RpbDelReq* req = message;
+
+    pb_write_bytes(w, 1, &req->bucket);
+    pb_write_bytes(w, 2, &req->key);
+    if (req->has_rw) {
+        pb_write_uint32(w, 3, req->rw);
+    }
+    if (req->has_vclock) {
+        pb_write_bytes(w, 4, &req->vclock);
+    }
+    if (req->has_r) {
+        pb_write_uint32(w, 5, req->r);
+    }
+    if (req->has_w) {
+        pb_write_uint32(w, 6, req->w);
+    }
+    if (req->has_pr) {
+        pb_write_uint32(w, 7, req->pr);
+    }
+    if (req->has_pw) {
+        pb_write_uint32(w, 8, req->pw);
+    }
+    if (req->has_dw) {
+        pb_write_uint32(w, 9, req->dw);
+    }
+    if (req->has_timeout) {
+        pb_write_uint32(w, 10, req->timeout);
+    }
+    if (req->has_sloppy_quorum) {
+        pb_write_bool(w, 11, req->sloppy_quorum);
+    }
+    if (req->has_n_val) {
+        pb_write_uint32(w, 12, req->n_val);
+    }
+    if (req->has_type) {
+        pb_write_bytes(w, 13, &req->type);
+    }
+}
+
+void
+pb_write_dt_fetch_req(struct pb_writer* w, const void* message)
+{
+    const DtFetchReq* req = message;
+
+    pb_write_bytes(w, 1, &req->bucket);
+    pb_write_bytes(w, 2, &req->key);
+    pb_write_bytes(w, 3, &req->type);
+    if (req->has_r) {
+        pb_write_uint32(w, 4, req->r);
+    }
+    if (req->has_pr) {
+        pb_write_uint32(w, 5, req->pr);
+    }
+    if (req->has_basic_quorum) {
+        pb_write_bool(w, 6, req->basic_quorum);
+    }
+    if (req->has_notfound_ok) {
+        pb_write_bool(w, 7, req->notfound_ok);
+    }
+    if (req->has_timeout) {
+        pb_write_uint32(w, 8, req->timeout);
+    }
+    if (req->has_sloppy_quorum) {
+        pb_write_bool(w, 9, req->sloppy_quorum);
+    }
+    if (req->has_n_val) {
+        pb_write_uint32(w, 10, req->n_val);
+    }
+    if (req->has_include_context) {
+        pb_write_bool(w, 11, req->include_context);
+    }
+}
+
+static void
+pb_write_counter_op(struct pb_writer* w, const void* message)
+{
+    const CounterOp* op = message;
+
+    if (op->has_increment) {
+        pb_write_sint64(w, 1, op->increment);
+    }
+}
+
+static void
+pb_write_set_op(struct pb_writer* w, const void* message)
+{
+    const SetOp* op = message;
+    size_t i;
+
+    for (i = 0; i < op->n_adds; i++) {
+        pb_write_bytes(w, 1, &op->adds[i]);
+    }
+    for (i = 0; i < op->n_removes; i++) {
+        pb_write_bytes(w, 2, &op->removes[i]);
+    }
+}
+
+static void
+pb_write_dt_op(struct pb_writer* w, const void* message)
+{
+    const DtOp* op = message;
+
+    ASSERT(op->map_op == NULL);
+
+    if (op->counter_op != NULL) {
+        pb_write_message(w, 1, pb_write_counter_op, op->counter_op);
+    }
+    if (op->set_op != NULL) {
+        pb_write_message(w, 2, pb_write_set_op, op->set_op);
+    }
+}
+
+void
+pb_write_dt_update_req(struct pb_writer* w, const void* message)
+{
+    const DtUpdateReq* req = message;
+
+    pb_write_bytes(w, 1, &req->bucket);
+    if (req->has_key) {
+        pb_write_bytes(w, 2, &req->key);
+    }
+    pb_write_bytes(w, 3, &req->type);
+    if (req->has_context) {
+        pb_write_bytes(w, 4, &req->context);
+    }
+    pb_write_message(w, 5, pb_write_dt_op, req->op);
+    if (req->has_w) {
+        pb_write_uint32(w, 6, req->w);
+    }
+    if (req->has_dw) {
+        pb_write_uint32(w, 7, req->dw);
+    }
+    if (req->has_pw) {
+        pb_write_uint32(w, 8, req->pw);
+    }
+    if (req->has_return_body) {
+        pb_write_bool(w, 9, req->return_body);
+    }
+    if (req->has_timeout) {
+        pb_write_uint32(w, 10, req->timeout);
+    }
+    if (req->has_sloppy_quorum) {
+        pb_write_bool(w, 11, req->sloppy_quorum);
+    }
+    if (req->has_n_val) {
+        pb_write_uint32(w, 12, req->n_val);
+    }
+    if (req->has_include_context) {
+        pb_write_bool(w, 13, req->include_context);
+    }
+}
+
+/**.......................................................................
+ * Pack the message into our mbufs
+ *
+ * The message is encoded straight into the mbufs: into the first mbuf of
+ * r, rewound, if it fits there, or else into new mbufs replacing those
+ * of r.  A PUT value given in place, in the mbufs of r, is only ever
+ * written to new mbufs, and spliced into them when long.
+ */
+rstatus_t
+pack_message(struct msg *r, msg_type_t type, uint8_t reqid,
+             pb_encode_func func, const void *message,
+             struct pb_cursor *value, uint32_t bucketlen)
+{
+    struct pb_writer w;
+    struct mhdr src;
+    struct mbuf *mbuf;
+    uint32_t msglen, netlen;
+
+    /*
+     * Construct the length of the whole message we will send to
+     * riak. This is:
+     *
+     *   size of the msglen integer
+     * + a byte for the message type
+     * + the length of the pb-encoded message
+     */
+
+    pb_writer_init(&w, NULL, NULL, NULL, value);
+    func(&w, message);
+    msglen = w.len;
+    netlen = htonl(msglen + 1);
+
+    uint32_t pbmsglen = sizeof(msglen) + 1 + msglen;
+
+    STAILQ_INIT(&src);
+
+    mbuf = STAILQ_FIRST(&r->mhdr);
+    if (value == NULL && mbuf != NULL && !mbuf_shared(mbuf) &&
+        pbmsglen <= (uint32_t)(mbuf->end - mbuf->start)) {
+        mbuf_rewind(mbuf);
+    } else {
+        mbuf = mbuf_get();
+        if (mbuf == NULL) {
+            return NC_ENOMEM;
+        }
+        STAILQ_CONCAT(&src, &r->mhdr);
+        mbuf_insert(&r->mhdr, mbuf);
+    }
+
+    pb_writer_init(&w, r, mbuf, &src, value);
+    pb_write_raw(&w, (uint8_t*)&netlen, sizeof(netlen));
+    pb_write_raw(&w, &reqid, 1);
+    func(&w, message);
+
+    while (!STAILQ_EMPTY(&src)) {
+        mbuf = STAILQ_FIRST(&src);
+        mbuf_remove(&src, mbuf);
+        mbuf_put(mbuf);
+    }
+
+    if (w.status != NC_OK) {
+        return w.status;
+    }
+    ASSERT(w.len == pbmsglen);
+
+    /* Set bucketlen, but use existing keylen (-1 to calc it). Also leave key
+     * offset as is. */
+    msg_set_keypos(r, 0, 7, -1, bucketlen);
+
+    r->mlen = pbmsglen;
+    r->type = type;
+
+    return NC_OK;
+}
+
+/*
+ * Fields of the Riak KV responses decoded by riak_parse_rsp
+ */
+#define RPB_ERROR_RESP_ERRMSG   PB_TAG(1, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define RPB_ERROR_RESP_ERRCODE  PB_TAG(2, PROTOBUF_C_WIRE_TYPE_VARINT)
+#define RPB_GET_RESP_CONTENT    PB_TAG(1, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define RPB_GET_RESP_VCLOCK     PB_TAG(2, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define RPB_GET_RESP_UNCHANGED  PB_TAG(3, PROTOBUF_C_WIRE_TYPE_VARINT)
+#define RPB_PUT_RESP_VCLOCK     PB_TAG(2, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define RPB_CONTENT_VALUE       PB_TAG(1, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define RPB_CONTENT_TYPE        PB_TAG(2, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define RPB_CONTENT_LAST_MOD    PB_TAG(7, PROTOBUF_C_WIRE_TYPE_VARINT)
+#define RPB_CONTENT_LAST_MOD_US PB_TAG(8, PROTOBUF_C_WIRE_TYPE_VARINT)
+
+/**.......................................................................
+ * Decode the value, content type and last modification time of a
+ * RpbContent in place
+ */
+static bool
+extract_get_rsp_content(struct pb_cursor* c, struct pb_cursor* value,
+                        struct pb_cursor* content_type, bool* has_last_mod,
+                        double* last_mod)
+{
+    uint64_t tag, mod = 0, mod_usecs = 0;
+    bool has_mod = false, has_mod_usecs = false;
+
+    value->mbuf = NULL;
+    value->ptr = NULL;
+    value->left = 0;
+    *content_type = *value;
+
+    while (c->left > 0) {
+        if (!pb_cursor_varint(c, &tag)) {
+            return false;
+        }
+
+        switch (tag) {
+        case RPB_CONTENT_VALUE:
+            if (!pb_cursor_field(c, value) || !pb_cursor_skip(c, value->left)) {
+                return false;
+            }
+            break;
+
+        case RPB_CONTENT_TYPE:
+            if (!pb_cursor_field(c, content_type) ||
+                !pb_cursor_skip(c, content_type->left)) {
+                return false;
+            }
+            break;
+
+        case RPB_CONTENT_LAST_MOD:
+            if (!pb_cursor_varint(c, &mod)) {
+                return false;
+            }
+            has_mod = true;
+            break;
+
+        case RPB_CONTENT_LAST_MOD_US:
+            if (!pb_cursor_varint(c, &mod_usecs)) {
+                return false;
+            }
+            has_mod_usecs = true;
+            break;
+
+        default:
+            if (!pb_cursor_skip_field(c, tag)) {
+                return false;
+            }
+            break;
+        }
+    }
+
+    *has_last_mod = has_mod && has_mod_usecs;
+    *last_mod = (double)(uint32_t)mod + (double)(uint32_t)mod_usecs / 1e6;
+
+    return true;
+}
+
+/**.......................................................................
+ * Decode the body of a PB-encoded GET response in place, at a cursor
+ * over the mbufs of the response, without unpacking it.
+ *
+ * The sibling to return to Redis is chosen as the siblings go by: the
+ * last-modified one, or one at random among those modified last at the
+ * same time, or among all of them if they have no last_mod time.  The
+ * chosen value is referenced in the mbufs of the response.
+ */
+rstatus_t
+extract_get_rsp(struct pb_cursor* c, struct riak_rsp* rsp)
+{
+    struct pb_cursor content, value, content_type;
+    uint64_t tag, unchanged;
+    bool by_last_mod = false, has_last_mod;
+    double last_mod, max_last_mod = 0;
+    unsigned nties = 0;
+    bool chosen;
+    rstatus_t status;
+
+    while (c->left > 0) {
+        if (!pb_cursor_varint(c, &tag)) {
+            return NC_ERROR;
+        }
+
+        switch (tag) {
+        case RPB_GET_RESP_CONTENT:
+            if (!pb_cursor_field(c, &content) ||
+                !pb_cursor_skip(c, content.left) ||
+                !extract_get_rsp_content(&content, &value, &content_type,
+                                         &has_last_mod, &last_mod)) {
+                return NC_ERROR;
+            }
+
+            rsp->n_content++;
+            if (rsp->n_content == 1) {
+                by_last_mod = has_last_mod;
+                max_last_mod = last_mod;
+                nties = 1;
+                chosen = true;
+            } else if (by_last_mod && last_mod > max_last_mod) {
+                max_last_mod = last_mod;
+                nties = 1;
+                chosen = true;
+            } else if (by_last_mod) {
+                chosen = last_mod == max_last_mod &&
+                         choose_random_sibling(++nties) == 0;
+            } else {
+                chosen = choose_random_sibling((unsigned)rsp->n_content) == 0;
+            }
+
+            if (chosen) {
+                rsp->value_mbuf = value.mbuf;
+                rsp->value = value.ptr;
+                rsp->value_len = value.left;
+                if (content_type.mbuf == NULL) {
+                    rsp->content_type.data = NULL;
+                    rsp->content_type.len = 0;
+                } else if ((status = pb_cursor_data(&content_type,
+                                                    &rsp->content_type))
+                           != NC_OK) {
+                    return status;
+                }
+            }
+            break;
+
+        case RPB_GET_RESP_VCLOCK:
+            if ((status = pb_cursor_bytes(c, &rsp->vclock)) != NC_OK) {
+                return status;
+            }
+            rsp->has_vclock = 1;
+            break;
+
+        case RPB_GET_RESP_UNCHANGED:
+            if (!pb_cursor_varint(c, &unchanged)) {
+                return NC_ERROR;
+            }
+            rsp->unchanged = (unchanged != 0);
+            break;
+
+        default:
+            if (!pb_cursor_skip_field(c, tag)) {
+                return NC_ERROR;
+            }
+            break;
+        }
+    }
+
+    return NC_OK;
+}
+
+/*
+ * GET responses at least this long are streamed to the client as they
+ * are received, see riak_cut_through.  The first RIAK_PB_CUT_THROUGH_HDR
+ * bytes of a response hold its framing up to the first byte of its value
+ */
+#define RIAK_PB_CUT_THROUGH_MIN (256 * 1024)
+#define RIAK_PB_CUT_THROUGH_HDR 32
+
+/**.......................................................................
+ * Copy the key of a PB-encoded GET request, as "type:bucket:key"
+ */
+static rstatus_t
+riak_get_req_key(struct msg* pmsg, struct string* key)
+{
+    uint32_t len;
+    uint8_t msgid;
+    RpbGetReq* req = 0;
+
+    parse_pb_get_req(pmsg, &len, &msgid, &req);
+    if (req == NULL) {
+        return NC_ERROR;
+    }
+
+    int delimiter_count = ((req->type.len > 0) ? 1 : 0)
+                          + ((req->bucket.len > 0) ? 1 : 0);
+    uint32_t keynamelen = (uint32_t)(req->type.len + req->bucket.len +
+                                     req->key.len) + delimiter_count;
+    char keyname[keynamelen + 1];
+    sprintf(keyname, "%.*s%s%.*s%s%.*s",
+            (int)req->type.len, req->type.data,
+            (req->type.len > 0) ? ":" : "",
+            (int)req->bucket.len, req->bucket.data,
+            (req->bucket.len > 0) ? ":" : "",
+            (int)req->key.len, req->key.data);
+
+    rpb_get_req__free_unpacked(req, arena_pb_allocator());
+
+    return string_copy(key, (uint8_t*)keyname, keynamelen);
+}
+
+/**.......................................................................
+ * Start streaming a GET response to the client, once its framing up to
+ * its value has been received: the client reply and the frontend fill
+ * of the key are started with the bulk header of the value.
+ *
+ * Only a read answering a client alone, next in line for its reply, is
+ * streamed, and only of a bucket which never has siblings, since which
+ * sibling to return is only known once all of them are received.  A
+ * read with requests waiting on it leaves the backend miss queue, later
+ * misses of the key are read anew; a hedged read is no longer hedged.
+ */
+static rstatus_t
+riak_cut_through_start(struct msg* r, struct msg* pmsg, uint32_t len)
+{
+    struct conn* s_conn = r->owner;
+    struct conn* c_conn = pmsg->owner;
+    struct context* ctx = conn_to_ctx(c_conn);
+    struct riak_cut* cut;
+    struct pb_cursor c;
+    uint64_t tag, content_len, value_len;
+    uint32_t content_off;
+    char hdr[1 + NC_UINT32_MAXLEN + CRLF_LEN];
+    int n;
+    rstatus_t status;
+
+    if (r->mlen < RIAK_PB_CUT_THROUGH_HDR) {
+        return NC_OK;
+    }
+
+    /* whatever is decided, it is decided once */
+    pmsg->cut_through = 0;
+
+    if (len + 4 < RIAK_PB_CUT_THROUGH_MIN || r->mlen >= len + 4 ||
+        pmsg->swallow || pmsg->hedge_copy || pmsg->hedge != NULL ||
+        pmsg->frag_id != 0 || pmsg->fill_owner != NULL ||
+        !TAILQ_EMPTY(&pmsg->miss_waitq) ||
+        TAILQ_FIRST(&c_conn->omsg_q) != pmsg) {
+        return NC_OK;
+    }
+
+    /*
+     * The value of the first sibling is the first field of the first
+     * field of the response, as Riak encodes them
+     */
+    c.mbuf = STAILQ_FIRST(&r->mhdr);
+    c.ptr = c.mbuf->start;
+    c.left = r->mlen;
+
+    if (!pb_cursor_skip(&c, 5) ||
+        !pb_cursor_varint(&c, &tag) || tag != RPB_GET_RESP_CONTENT ||
+        !pb_cursor_varint(&c, &content_len)) {
+        return NC_OK;
+    }
+    content_off = r->mlen - c.left;
+
+    if (!pb_cursor_varint(&c, &tag) || tag != RPB_CONTENT_VALUE ||
+        !pb_cursor_varint(&c, &value_len) || value_len == 0 ||
+        content_off + content_len > len + 4 ||
+        r->mlen - c.left + value_len > content_off + content_len) {
+        return NC_OK;
+    }
+
+    pb_cursor_align(&c);
+
+    /* values in spurious quotes are stripped of them, see repack_get_resp */
+    if (c.ptr == c.mbuf->last || *c.ptr == '\"') {
+        return NC_OK;
+    }
+
+    cut = nc_alloc(sizeof(*cut));
+    if (cut == NULL) {
+        return NC_ENOMEM;
+    }
+    cut->rsp = NULL;
+    cut->fill = NULL;
+    string_init(&cut->key);
+    cut->mbuf = c.mbuf;
+    cut->ptr = c.ptr;
+    cut->left = (uint32_t)value_len;
+    cut->off = r->mlen - c.left;
+    cut->end = content_off + (uint32_t)content_len;
+    cut->released = 0;
+    pmsg->riak_cut = cut;
+
+    cut->rsp = msg_get(c_conn, false);
+    if (cut->rsp == NULL) {
+        return NC_ENOMEM;
+    }
+    cut->rsp->peer = pmsg;
+
+    n = nc_snprintf(hdr, sizeof(hdr), "$%"PRIu32"\r\n", cut->left);
+    if ((status = msg_copy_char(cut->rsp, hdr, (size_t)n)) != NC_OK) {
+        return status;
+    }
+
+    /* a failed fill leaves the read to its client */
+    if (riak_get_req_key(pmsg, &cut->key) != NC_OK ||
+        add_set_msg_start(ctx, c_conn, (char*)cut->key.data, cut->left,
+                          &cut->fill) != NC_OK) {
+        cut->fill = NULL;
+    }
+
+    backend_miss_done(pmsg, NULL);
+    backend_hedge_done(pmsg);
+
+    log_debug(LOG_VERB, "cut through rsp %"PRIu64" of req %"PRIu64" on s %d, "
+              "%"PRIu32" value bytes", r->id, pmsg->id, s_conn->sd, cut->left);
+
+    stats_pool_incr(ctx, c_conn->owner, cut_through_reads);
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Stream the value bytes of a GET response received since last time to
+ * the client reply and the frontend fill, and release the mbufs of the
+ * response streamed, but for the first, which frames it.
+ *
+ * The value is shared with the reply and the fill rather than copied
+ * (see msg_share), an mbuf once it is full, so that it is not sliced
+ * into as many parts as it takes reads to fill it
+ */
+static rstatus_t
+riak_cut_through_stream(struct msg* r, struct msg* pmsg)
+{
+    struct riak_cut* cut = pmsg->riak_cut;
+    struct conn* c_conn = pmsg->owner;
+    struct mbuf *mbuf, *nbuf;
+    uint32_t n;
+    bool streamed = false;
+    rstatus_t status;
+
+    while (cut->left > 0) {
+        if (cut->ptr == cut->mbuf->last) {
+            nbuf = STAILQ_NEXT(cut->mbuf, next);
+            if (nbuf == NULL) {
+                break;
+            }
+            cut->mbuf = nbuf;
+            cut->ptr = nbuf->start;
+            continue;
+        }
+
+        n = (uint32_t)(cut->mbuf->last - cut->ptr);
+        if (n > cut->left) {
+            n = cut->left;
+        } else if (!mbuf_full(cut->mbuf)) {
+            break;
+        }
+
+        /* a client gone has its reply dropped with the read */
+        if (!pmsg->swallow) {
+            if ((status = msg_share(cut->rsp, cut->mbuf, cut->ptr, n)) != NC_OK) {
+                return status;
+            }
+            if (cut->fill != NULL &&
+                msg_share(cut->fill, cut->mbuf, cut->ptr, n) != NC_OK) {
+                msg_put(cut->fill);
+                cut->fill = NULL;
+            }
+            streamed = true;
+        }
+
+        cut->ptr += n;
+        cut->off += n;
+        cut->left -= n;
+    }
+
+    mbuf = STAILQ_FIRST(&r->mhdr);
+    while ((nbuf = STAILQ_NEXT(mbuf, next)) != NULL && nbuf != cut->mbuf) {
+        mbuf_remove(&r->mhdr, nbuf);
+        n = (uint32_t)(nbuf->last - nbuf->start);
+        r->mlen -= n;
+        cut->released += n;
+        mbuf_put(nbuf);
+    }
+
+    if (streamed &&
+        event_add_out(conn_to_ctx(c_conn)->evb, c_conn) != NC_OK) {
+        c_conn->err = errno;
+    }
+
+    return NC_OK;
+}
 
 /**.......................................................................
- * Extract a PB-encoded DEL response out of the message buffer
+ * Stream a large GET response to the client as it is received, rather
+ * than once it is whole, if its request allows it.
+ *
+ * The value is streamed as a Redis bulk string, shared with the mbufs
+ * of the response as they arrive (see msg_share) and released from the
+ * response once streamed, so that neither the client nor the memory of
+ * the proxy waits on the whole value.  The frontend fill shares the
+ * same mbufs.  The rest of the response, its vclock, is decoded once it
+ * is received, see extract_cut_through_rsp; the reply is then
+ * completed, see backend_cut_through_done.
  */
-bool
-extract_del_rsp(struct msg* r, uint32_t len, uint8_t* msgid)
+rstatus_t
+riak_cut_through(struct msg* r, struct msg* pmsg, uint32_t len)
 {
-    return extract_rsp(r, len, msgid, NULL, NULL);
+    rstatus_t status;
+
+    if (pmsg->riak_cut == NULL) {
+        if ((status = riak_cut_through_start(r, pmsg, len)) != NC_OK) {
+            return status;
+        }
+        if (pmsg->riak_cut == NULL) {
+            return NC_OK;
+        }
+    }
+
+    return riak_cut_through_stream(r, pmsg);
 }
 
 /**.......................................................................
- * Re-pack a PB-formatted GET response for return to a Redis client
+ * Decode the rest of a GET response streamed to the client, at a cursor
+ * past its value
  */
 rstatus_t
-repack_get_rsp(struct msg* r, RpbGetResp* rpbresp)
+extract_cut_through_rsp(struct pb_cursor* c, struct riak_cut* cut,
+                        struct riak_rsp* rsp)
 {
-    ASSERT(r != NULL);
-    ASSERT(rpbresp != NULL);
+    rstatus_t status;
 
-    rstatus_t status = NC_OK;
+    if (!pb_cursor_skip(c, cut->end - cut->off)) {
+        return NC_ERROR;
+    }
 
-    msg_rewind(r);
-    r->mlen = 0;
+    rsp->n_content = 1;
+    if ((status = extract_get_rsp(c, rsp)) != NC_OK) {
+        return status;
+    }
 
-    /* If this response has content, pack the key val */
+    if (rsp->n_content > 1) {
+        log_warn("cut through rsp of %"PRIu32" bytes has %zu siblings, "
+                 "returned the first", rsp->len, rsp->n_content);
+    }
 
-    if (rpbresp->n_content > 0) {
-        /*
-         * If there are siblings, there will be more than one keyval
-         * present.
-         * 
-         * For now, we return the last-modified sibling presented by Riak,
-         * unless all have the same last_mod time, in which case we select
-         * a sibling at random
-         *
-         * We do this rather than return an array of all values, since
-         * Redis clients expect only a single string in response to a GET
-         * command, and not an array.
-         */
-        unsigned iContent = choose_sibling(rpbresp);
-        uint8_t* data = rpbresp->content[iContent]->value.data;
-        uint32_t datalen = rpbresp->content[iContent]->value.len;
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Decode the body of a PB-encoded PUT response in place, reading only
+ * the vclock, which Riak returns when asked for the head of the object
+ */
+rstatus_t
+extract_put_rsp(struct pb_cursor* c, struct riak_rsp* rsp)
+{
+    uint64_t tag;
+    rstatus_t status;
 
-        /* Strip spurious quotes surrounding the value */
+    while (c->left > 0) {
+        if (!pb_cursor_varint(c, &tag)) {
+            return NC_ERROR;
+        }
 
-        if ((datalen > 1) && (data[0] == '\"')) {
-            datalen -= 2;
-            ++data;
+        if (tag == RPB_PUT_RESP_VCLOCK) {
+            if ((status = pb_cursor_bytes(c, &rsp->vclock)) != NC_OK) {
+                return status;
+            }
+            rsp->has_vclock = 1;
+        } else if (!pb_cursor_skip_field(c, tag)) {
+            return NC_ERROR;
         }
+    }
 
-        uint32_t datalenndig = ndig(datalen);
-        char fmtbuf[datalenndig + 3 + 1];
-        sprintf(fmtbuf, "$%d\r\n", datalen);
+    return NC_OK;
+}
 
-        if ((status = msg_copy_char(r, fmtbuf, strlen(fmtbuf))) != NC_OK) {
-            return status;
+/**.......................................................................
+ * Decode the body of a PB-encoded error response in place
+ */
+rstatus_t
+extract_error_rsp(struct pb_cursor* c, struct riak_rsp* rsp,
+                  ProtobufCBinaryData* errmsg)
+{
+    uint64_t tag, errcode;
+    rstatus_t status;
+
+    errmsg->data = NULL;
+    errmsg->len = 0;
+
+    while (c->left > 0) {
+        if (!pb_cursor_varint(c, &tag)) {
+            return NC_ERROR;
         }
 
-        if ((status = msg_copy(r, data, datalen)) != NC_OK) {
-            return status;
+        switch (tag) {
+        case RPB_ERROR_RESP_ERRMSG:
+            if ((status = pb_cursor_bytes(c, errmsg)) != NC_OK) {
+                return status;
+            }
+            break;
+
+        case RPB_ERROR_RESP_ERRCODE:
+            if (!pb_cursor_varint(c, &errcode)) {
+                return NC_ERROR;
+            }
+            rsp->errcode = (uint32_t)errcode;
+            break;
+
+        default:
+            if (!pb_cursor_skip_field(c, tag)) {
+                return NC_ERROR;
+            }
+            break;
         }
+    }
 
-        if ((status = msg_copy_char(r, CRLF, 2)) != NC_OK) {
-            return status;
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Re-pack a GET response decoded by riak_parse_rsp for return to a Redis
+ * client.
+ *
+ * The chosen value is not copied: the mbufs of r are trimmed down to the
+ * value, which is framed as a Redis bulk string in place, and the rest
+ * are released.  Unlike its other mbufs, the first mbuf of the value is
+ * trimmed by moving its start, since the value need not begin at the
+ * start of the mbuf; mbuf_get resets it once the mbuf is reused.
+ */
+rstatus_t
+repack_get_resp(struct msg* r, struct riak_rsp* rsp)
+{
+    struct mbuf *mbuf, *nbuf;
+    uint8_t* data = rsp->value;
+    uint32_t datalen = rsp->value_len;
+    uint32_t n, avail;
+    char hdr[1 + NC_UINT32_MAXLEN + CRLF_LEN];
+    uint32_t hdrlen;
+
+    ASSERT(r != NULL);
+
+    r->type = MSG_RSP_REDIS_BULK;
+
+    if (rsp->n_content == 0 || rsp->value_mbuf == NULL) {
+        msg_rewind(r);
+        r->mlen = 0;
+        if (rsp->n_content == 0) {
+            return msg_copy_char(r, "$-1\r\n", 5);
+        }
+        return msg_copy_char(r, "$0\r\n\r\n", 6);
+    }
+
+    mbuf = rsp->value_mbuf;
+
+    /* Strip spurious quotes surrounding the value */
+
+    if ((datalen > 1) && (data[0] == '\"')) {
+        datalen -= 2;
+        if (++data == mbuf->last) {
+            mbuf = STAILQ_NEXT(mbuf, next);
+            data = mbuf->start;
         }
+    }
+
+    hdrlen = (uint32_t)nc_snprintf(hdr, sizeof(hdr), "$%"PRIu32"\r\n",
+                                   datalen);
+
+    /* Release the mbufs ahead of the value */
+
+    while ((nbuf = STAILQ_FIRST(&r->mhdr)) != mbuf) {
+        mbuf_remove(&r->mhdr, nbuf);
+        mbuf_put(nbuf);
+    }
+
+    /*
+     * Write the bulk header over the PB fields ahead of the value, if
+     * there is room for it, or else in an mbuf of its own
+     */
+
+    if ((uint32_t)(data - mbuf->start) >= hdrlen) {
+        mbuf->start = data - hdrlen;
+        nc_memcpy(mbuf->start, hdr, hdrlen);
     } else {
-        if ((status = msg_copy_char(r, "$-1\r\n", 5)) != NC_OK) {
-            return status;
+        mbuf->start = data;
+
+        nbuf = mbuf_get();
+        if (nbuf == NULL) {
+            return NC_ENOMEM;
         }
+        mbuf_copy(nbuf, (uint8_t*)hdr, hdrlen);
+        STAILQ_INSERT_HEAD(&r->mhdr, nbuf, next);
     }
+    mbuf->pos = mbuf->start;
 
-    r->type = MSG_RSP_REDIS_BULK;
+    /* Trim the mbufs of the value to it */
+
+    n = datalen;
+    for (;;) {
+        avail = (uint32_t)(mbuf->last - data);
+        if (n <= avail) {
+            mbuf->last = data + n;
+            break;
+        }
+        n -= avail;
+
+        mbuf = STAILQ_NEXT(mbuf, next);
+        ASSERT(mbuf != NULL);
+        mbuf->pos = mbuf->start;
+        data = mbuf->start;
+    }
+
+    /* Release the mbufs behind it, and close it */
+
+    while ((nbuf = STAILQ_NEXT(mbuf, next)) != NULL) {
+        mbuf_remove(&r->mhdr, nbuf);
+        mbuf_put(nbuf);
+    }
+
+    if (mbuf_size(mbuf) < CRLF_LEN) {
+        mbuf = mbuf_get();
+        if (mbuf == NULL) {
+            return NC_ENOMEM;
+        }
+        mbuf_insert(&r->mhdr, mbuf);
+    }
+    mbuf_copy(mbuf, (uint8_t*)CRLF, CRLF_LEN);
+
+    r->mlen = hdrlen + datalen + (uint32_t)CRLF_LEN;
+    r->pos = mbuf->last;
 
     return NC_OK;
 }
@@ -1166,10 +2651,9 @@ repack_get_rsp(struct msg* r, RpbGetResp* rpbresp)
  * Re-pack a PB-formatted PUT response for return to a Redis client
  */
 rstatus_t
-repack_put_resp(struct msg* r, RpbPutResp* rpbresp)
+repack_put_resp(struct msg* r)
 {
     ASSERT(r != NULL);
-    ASSERT(rpbresp != NULL);
 
     rstatus_t status = NC_OK;
 
@@ -1186,23 +2670,44 @@ repack_put_resp(struct msg* r, RpbPutResp* rpbresp)
 }
 
 /**.......................................................................
- * Re-pack a PB-formatted DEL response for return to a Redis client
+ * Re-pack a PB-formatted head-only GET response for return to a Redis
+ * client as the reply to an EXISTS
  */
 rstatus_t
-repack_del_resp(struct msg* r)
+repack_exists_resp(struct msg* r, struct riak_rsp* rsp)
 {
     ASSERT(r != NULL);
+
     rstatus_t status = NC_OK;
 
-    uint8_t msgid;
-    if (extract_del_rsp(r, 0, &msgid) == false) {
-        return NC_ERROR;
+    msg_rewind(r);
+    r->mlen = 0;
+
+    r->integer = (rsp->n_content > 0) ? 1 : 0;
+
+    if ((status = msg_copy_char(r, r->integer ? ":1\r\n" : ":0\r\n", 4))
+        != NC_OK) {
+        return status;
     }
 
+    r->type = MSG_RSP_REDIS_INTEGER;
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Re-pack a PB-formatted DEL response for return to a Redis client
+ */
+rstatus_t
+repack_del_resp(struct msg* r)
+{
+    ASSERT(r != NULL);
+    rstatus_t status = NC_OK;
+
     msg_rewind(r);
     r->mlen = 0;
 
-    if (msgid == RSP_RIAK_DEL) {
+    if (r->riak_rsp.msgid == RSP_RIAK_DEL) {
         r->integer = 1;
     }
 
@@ -1215,6 +2720,117 @@ repack_del_resp(struct msg* r)
     return NC_OK;
 }
 
+/**.......................................................................
+ * Follow a GET response r with more siblings than the max_siblings of
+ * its bucket by a hidden PUT of the sibling chosen to answer it, with the
+ * vclock of the response, so that Riak collapses the siblings into it
+ * and later reads of the key no longer fetch them all.  The PUT goes to
+ * the server which answered the GET, on behalf of the pool, at most
+ * backend_collapse_rate times a second per bucket.
+ *
+ * The PUT is written before the response is repacked, while the value
+ * and vclock are still in its mbufs.
+ */
+static void
+riak_collapse_siblings(struct msg* r, struct riak_rsp* rsp)
+{
+    struct conn* s_conn = r->owner;
+    struct server* server = (struct server*)(s_conn->owner);
+    struct server_pool* pool = (struct server_pool*)(server->owner);
+    struct context* ctx = conn_to_ctx(s_conn);
+    struct msg* pmsg = TAILQ_FIRST(&s_conn->omsg_q);
+    RpbGetReq* get = NULL;
+    RpbPutReq req = RPB_PUT_REQ__INIT;
+    RpbContent content = RPB_CONTENT__INIT;
+    struct pb_cursor value;
+    struct msg* msg;
+    uint32_t len;
+    uint8_t msgid;
+    int max_siblings;
+
+    /* a read before a write is followed by a PUT with its vclock anyway */
+    if (rsp->value_mbuf == NULL || !rsp->has_vclock || pmsg == NULL ||
+        pmsg->read_before_write || pool->p_conn == NULL) {
+        return;
+    }
+
+    parse_pb_get_req(pmsg, &len, &msgid, &get);
+    if (get == NULL) {
+        return;
+    }
+
+    max_siblings = server_pool_bucket_max_siblings(pool, get->type.data,
+                                                   (uint32_t)get->type.len,
+                                                   get->bucket.data,
+                                                   (uint32_t)get->bucket.len);
+    if (max_siblings <= 0 || rsp->n_content <= (size_t)max_siblings) {
+        return;
+    }
+
+    if (!server_pool_bucket_collapse(pool, get->type.data,
+                                     (uint32_t)get->type.len,
+                                     get->bucket.data,
+                                     (uint32_t)get->bucket.len)) {
+        stats_pool_incr(ctx, pool, collapses_limited);
+        return;
+    }
+
+    value.mbuf = rsp->value_mbuf;
+    value.ptr = rsp->value;
+    value.left = rsp->value_len;
+    if (pb_cursor_data(&value, &content.value) != NC_OK) {
+        return;
+    }
+    if (rsp->content_type.len > 0) {
+        content.has_content_type = (protobuf_c_boolean)1;
+        content.content_type = rsp->content_type;
+    }
+
+    req.bucket = get->bucket;
+    req.has_key = (protobuf_c_boolean)1;
+    req.key = get->key;
+    req.has_type = get->has_type;
+    req.type = get->type;
+    req.has_vclock = (protobuf_c_boolean)1;
+    req.vclock = rsp->vclock;
+    req.content = &content;
+    riak_put_req_opts(&req, &pool->backend_opt);
+
+    msg = msg_get(pool->p_conn, true);
+    if (msg == NULL) {
+        return;
+    }
+
+    /* ask for the new vclock back, to keep the vclock cache current */
+    riak_req_set_vclock_key(msg, pool, &req.type, &req.bucket, &req.key);
+    if (msg->vclock_key.len > 0) {
+        req.has_return_head = (protobuf_c_boolean)1;
+        req.return_head = (protobuf_c_boolean)1;
+    }
+
+    if (pack_message(msg, MSG_REQ_RIAK_SET, REQ_RIAK_PUT,
+                     pb_write_rpb_put_req, &req, NULL,
+                     (uint32_t)(((req.type.len > 0) ? req.type.len + 1 : 0) +
+                                req.bucket.len)) != NC_OK) {
+        msg_put(msg);
+        return;
+    }
+    msg->swallow = 1;
+
+    if (TAILQ_EMPTY(&s_conn->imsg_q)) {
+        event_add_out(ctx->evb, s_conn);
+    }
+
+    s_conn->enqueue_inq(ctx, s_conn, msg);
+    s_conn->need_auth = 0;
+
+    stats_pool_incr(ctx, pool, sibling_collapses);
+
+    log_debug(LOG_VERB, "collapse %zu siblings of '%.*s:%.*s'",
+              rsp->n_content, (int)get->bucket.len, get->bucket.data,
+              (int)get->key.len, get->key.data);
+}
+
 /**.......................................................................
  * Repack a message -- for Riak responses, this repacks to the
  * equivalent Redis response
@@ -1225,109 +2841,109 @@ riak_repack(struct msg* r)
     /*
      * This method is only called after riak_parse_rsp has been
      * evaluated, so we know at this point that the mbuf contains a valid
-     * message
+     * message, and the fields of it we use have been decoded
      */
 
-    RpbGetResp* rpb_get_resp = NULL;
-    RpbPutResp* rpb_put_resp = NULL;
-    DtUpdateResp* dt_update_resp = NULL;
-    DtFetchResp* dt_fetch_resp = NULL;
-    uint32_t len = 0;
-    uint8_t msgid = RSP_RIAK_UNKNOWN;
-    if (!get_pb_msglen(r, &len, &msgid)) {
-        r->result = MSG_PARSE_ERROR;
-        return NC_ERROR;
-    }
+    struct riak_rsp* rsp = &r->riak_rsp;
+    struct msg* pmsg;
+    struct mhdr mhdr;
+    struct mbuf* mbuf;
 
-    switch (msgid) {
+    switch (rsp->msgid) {
     case RSP_RIAK_GET:
-        rpb_get_resp = extract_get_rsp(r, len, &msgid);
+        /*
+         * An object found unchanged by a conditional GET comes back
+         * without its vclock: the cached one still holds
+         */
+        if (!rsp->unchanged) {
+            msg_copy_vclock(r, rsp->has_vclock, rsp->vclock);
+            riak_rsp_update_vclock_cache(r, rsp->has_vclock, rsp->vclock);
 
-        if (rpb_get_resp == NULL) {
-            r->result = MSG_PARSE_ERROR;
+            if (r->peer != NULL) {
+                msg_copy_vclock(r->peer, rsp->has_vclock, rsp->vclock);
+            }
+        }
+
+        pmsg = TAILQ_FIRST(&r->owner->omsg_q);
+
+        /* A value streamed to the client is already repacked there */
+        if (pmsg != NULL && pmsg->riak_cut != NULL) {
+            r->type = MSG_RSP_REDIS_BULK;
             break;
         }
 
-        msg_copy_vclock(r, rpb_get_resp->has_vclock, rpb_get_resp->vclock);
+        if (pmsg != NULL && pmsg->type == MSG_REQ_RIAK_EXISTS) {
+            if (repack_exists_resp(r, rsp) != NC_OK) {
+                r->result = MSG_PARSE_ERROR;
+            }
+            break;
+        }
 
-        if (r->peer != NULL) {
-            msg_copy_vclock(r->peer, rpb_get_resp->has_vclock, rpb_get_resp->vclock);
+        if (rsp->n_content > 1) {
+            riak_collapse_siblings(r, rsp);
         }
 
-        if (repack_get_rsp(r, rpb_get_resp) != NC_OK) {
+        if (repack_get_resp(r, rsp) != NC_OK) {
             r->result = MSG_PARSE_ERROR;
         }
-
-        rpb_get_resp__free_unpacked(rpb_get_resp, NULL);
         break;
 
     case RSP_RIAK_PUT:
-        rpb_put_resp = extract_put_rsp(r, len, &msgid);
-
-        if (rpb_put_resp == NULL) {
-            r->result = MSG_PARSE_ERROR;
-            break;
-        }
+        riak_rsp_update_vclock_cache(r, rsp->has_vclock, rsp->vclock);
 
-        if (repack_put_resp(r, rpb_put_resp) != NC_OK) {
+        if (repack_put_resp(r) != NC_OK) {
             r->result = MSG_PARSE_ERROR;
         }
-
-        rpb_put_resp__free_unpacked(rpb_put_resp, NULL);
         break;
 
     case RSP_RIAK_DEL:
-    {
-        if (!extract_del_rsp(r, len, &msgid)) {
-            r->result = MSG_PARSE_ERROR;
-            break;
-        }
-
         if (repack_del_resp(r) != NC_OK) {
             r->result = MSG_PARSE_ERROR;
         }
-    }
         break;
 
     case RSP_RIAK_UNKNOWN:
-    {
-        struct msg* pmsg = TAILQ_FIRST(&r->owner->omsg_q);
+        pmsg = TAILQ_FIRST(&r->owner->omsg_q);
         if (pmsg->type == MSG_REQ_RIAK_SREM) {
-            if (repack_dt_update_resp(r, dt_update_resp) != NC_OK) {
+            if (repack_dt_update_resp(r) != NC_OK) {
                 r->result = MSG_PARSE_ERROR;
             }
         }
-    }
         break;
 
     case RSP_RIAK_DT_UPDATE:
-        dt_update_resp = extract_dt_update_rsp(r, len, &msgid);
-
-        if (dt_update_resp == NULL) {
-            r->result = MSG_PARSE_ERROR;
+        pmsg = TAILQ_FIRST(&r->owner->omsg_q);
+        if (pmsg != NULL && pmsg->type == MSG_REQ_RIAK_INCR) {
+            if (repack_incr_resp(r) != NC_OK) {
+                r->result = MSG_PARSE_ERROR;
+            }
             break;
         }
 
-        if (repack_dt_update_resp(r, dt_update_resp) != NC_OK) {
+        if (repack_dt_update_resp(r) != NC_OK) {
             r->result = MSG_PARSE_ERROR;
         }
-
-        dt_update_resp__free_unpacked(dt_update_resp, NULL);
         break;
 
     case RSP_RIAK_DT_FETCH:
-        dt_fetch_resp = extract_dt_fetch_rsp(r, len, &msgid);
+        /*
+         * The set members are streamed from the mbufs of r: detach those
+         * until the members are repacked into new ones, which releases
+         * them as it goes, and only then rewind what is left and hand it
+         * back to r
+         */
+        STAILQ_INIT(&mhdr);
+        STAILQ_CONCAT(&mhdr, &r->mhdr);
+        r->mlen = 0;
 
-        if (dt_fetch_resp == NULL) {
+        if (repack_dt_fetch_resp(r, &mhdr) != NC_OK) {
             r->result = MSG_PARSE_ERROR;
-            break;
         }
 
-        if (repack_dt_fetch_resp(r, dt_fetch_resp) != NC_OK) {
-            r->result = MSG_PARSE_ERROR;
+        STAILQ_FOREACH(mbuf, &mhdr, next) {
+            mbuf_rewind(mbuf);
         }
-
-        dt_fetch_resp__free_unpacked(dt_fetch_resp, NULL);
+        STAILQ_CONCAT(&r->mhdr, &mhdr);
         break;
 
     default:
@@ -1340,64 +2956,6 @@ riak_repack(struct msg* r)
     return NC_OK;
 }
 
-/**.......................................................................
- * Choose an entry to return to Redis when multiple siblings are present
- */
-unsigned
-choose_sibling(RpbGetResp* rpbresp)
-{
-    if (rpbresp->n_content == 1)
-        return 0;
-
-    /* TODO: delve into vclock or dotted-version vector (dvv), currently using last_mod */
-
-    if (rpbresp->content[0]->has_last_mod && rpbresp->content[0]
-            ->has_last_mod_usecs) {
-        return choose_last_modified_sibling(rpbresp);
-    } else {
-        return choose_random_sibling(rpbresp->n_content);
-    }
-}
-
-/**.......................................................................
- * Return the index of the last modified sibling
- */
-unsigned
-choose_last_modified_sibling(RpbGetResp* rpbresp)
-{
-    unsigned iMaxLastMod = 0;
-    double lastMod = 0, maxLastMod = 0;
-
-    unsigned iSib = 0;
-    unsigned nSib = rpbresp->n_content;
-
-    for (iSib = 0; iSib < nSib; iSib++) {
-
-        RpbContent* content = rpbresp->content[iSib];
-        lastMod = content->last_mod + (double)(content->last_mod_usecs) / 1e6;
-
-        if (iSib == 0 || lastMod > maxLastMod) {
-            maxLastMod = lastMod;
-            iMaxLastMod = iSib;
-        }
-
-    }
-
-    unsigned indices[nSib];
-    unsigned nIdent = 0;
-
-    for (iSib = 0; iSib < nSib; iSib++) {
-        RpbContent* content = rpbresp->content[iSib];
-        lastMod = content->last_mod + (double)(content->last_mod_usecs) / 1e6;
-
-        if (lastMod == maxLastMod) {
-            indices[nIdent++] = iSib;
-        }
-    }
-
-    return nIdent == 1 ? iMaxLastMod : indices[choose_random_sibling(nIdent)];
-}
-
 /**.......................................................................
  * Return a random index
  */
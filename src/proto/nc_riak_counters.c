@@ -0,0 +1,220 @@
+#include <nc_core.h>
+#include <nc_proto.h>
+
+#include <nc_riak_private.h>
+
+/**.......................................................................
+ * Return the increment of a Redis INCR, INCRBY, DECR or DECRBY request,
+ * signed as it applies to the counter
+ */
+rstatus_t
+riak_incr_delta(struct msg* r, int64_t* delta)
+{
+    struct msg_pos pos = msg_pos_init();
+    char num[1 + NC_UINT64_MAXLEN];
+    size_t len = 0, i;
+    uint64_t n = 0, digit;
+    bool negative;
+    rstatus_t status;
+
+    switch (r->type) {
+    case MSG_REQ_REDIS_INCR:
+        *delta = 1;
+        return NC_OK;
+
+    case MSG_REQ_REDIS_DECR:
+        *delta = -1;
+        return NC_OK;
+
+    case MSG_REQ_REDIS_INCRBY:
+    case MSG_REQ_REDIS_DECRBY:
+        break;
+
+    default:
+        return NC_ERROR;
+    }
+
+    /* skip the command label and the key */
+    if ((status = redis_get_next_string(r, NULL, &pos, &len)) != NC_OK ||
+        (status = redis_get_next_string(r, &pos, &pos, &len)) != NC_OK ||
+        (status = redis_get_next_string(r, &pos, &pos, &len)) != NC_OK) {
+        return status;
+    }
+
+    if (len == 0 || len > sizeof(num)) {
+        return NC_ERROR;
+    }
+
+    if ((status = msg_extract_from_pos_char(num, &pos, len)) != NC_OK) {
+        return status;
+    }
+
+    negative = (num[0] == '-');
+    if (negative && len == 1) {
+        return NC_ERROR;
+    }
+
+    for (i = negative ? 1 : 0; i < len; i++) {
+        if (num[i] < '0' || num[i] > '9') {
+            return NC_ERROR;
+        }
+        digit = (uint64_t)(num[i] - '0');
+        if (n > ((uint64_t)INT64_MAX - digit) / 10) {
+            return NC_ERROR;
+        }
+        n = n * 10 + digit;
+    }
+
+    *delta = negative ? -(int64_t)n : (int64_t)n;
+    if (r->type == MSG_REQ_REDIS_DECRBY) {
+        *delta = -*delta;
+    }
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Take a Redis INCR, INCRBY, DECR or DECRBY request of a key of a
+ * counter bucket type, "datatype:bucket:key", and remap it to a PB
+ * message updating the counter, which returns its new value.  Keys
+ * without a bucket type are returned to the frontend.
+ */
+rstatus_t
+encode_pb_incr_req(struct msg* r, struct conn* s_conn, msg_type_t type)
+{
+    ASSERT(r != NULL);
+    ASSERT(s_conn != NULL);
+
+    rstatus_t status;
+
+    DtUpdateReq req = DT_UPDATE_REQ__INIT;
+    DtOp op = DT_OP__INIT;
+    CounterOp counterop = COUNTER_OP__INIT;
+    struct msg_pos keyname_start_pos = msg_pos_init();
+
+    req.has_key = 1;
+    req.op = &op;
+    op.counter_op = &counterop;
+
+    if ((status = riak_incr_delta(r, &counterop.increment)) != NC_OK) {
+        return status;
+    }
+    counterop.has_increment = 1;
+
+    if ((status = extract_bucket_key_value(r, &req.type, &req.bucket, &req.key,
+                                           NULL, &keyname_start_pos, false))
+        != NC_OK) {
+        return status;
+    }
+
+    if (req.type.len <= 0 || req.bucket.len <= 0) {
+        // counters need a bucket type, return it back to frontend
+        return NC_EBADREQ;
+    }
+
+    struct server* server = (struct server*)(s_conn->owner);
+    const struct server_pool* pool = (struct server_pool*)(server->owner);
+    const struct backend_opt* opt = &pool->backend_opt;
+
+    req.has_w = (opt->riak_w != CONF_UNSET_NUM);
+    if (req.has_w) {
+        req.w = (uint32_t)opt->riak_w;
+    }
+
+    req.has_pw = (opt->riak_pw != CONF_UNSET_NUM);
+    if (req.has_pw) {
+        req.pw = (uint32_t)opt->riak_pw;
+    }
+
+    req.has_n_val = (opt->riak_n != CONF_UNSET_NUM);
+    if (req.has_n_val) {
+        req.n_val = (uint32_t)opt->riak_n;
+    }
+
+    req.has_sloppy_quorum =
+            (opt->riak_sloppy_quorum != CONF_UNSET_NUM);
+    if (req.has_sloppy_quorum) {
+        req.sloppy_quorum = opt->riak_sloppy_quorum;
+    }
+
+    req.has_return_body = 1;
+    req.return_body = 1;
+
+    status = pack_message(r, type, REQ_RIAK_DT_UPDATE, pb_write_dt_update_req,
+                          &req, NULL, (uint32_t)req.bucket.len);
+    if (status != NC_OK) {
+        return status;
+    }
+
+    struct conn *c_conn = r->owner;
+    struct context *ctx = conn_to_ctx(c_conn);
+    add_pexpire_msg_key(ctx, c_conn, (char*)req.type.data,
+                        (uint32_t)(req.type.len + req.bucket.len + req.key.len + 2), 0);
+
+    return NC_OK;
+}
+
+/*
+ * Tag of the DtUpdateResp field we decode
+ */
+#define DT_UPDATE_RESP_COUNTER_VALUE PB_TAG(3, PROTOBUF_C_WIRE_TYPE_VARINT)
+
+/**.......................................................................
+ * Decode the body of a PB-encoded DT_UPDATE response in place, reading
+ * only the value of a counter
+ */
+rstatus_t
+extract_dt_update_rsp(struct pb_cursor* c, struct riak_rsp* rsp)
+{
+    uint64_t tag, val;
+
+    while (c->left > 0) {
+        if (!pb_cursor_varint(c, &tag)) {
+            return NC_ERROR;
+        }
+
+        if (tag != DT_UPDATE_RESP_COUNTER_VALUE) {
+            if (!pb_cursor_skip_field(c, tag)) {
+                return NC_ERROR;
+            }
+            continue;
+        }
+
+        if (!pb_cursor_varint(c, &val)) {
+            return NC_ERROR;
+        }
+
+        /* sint64 is zigzag-encoded */
+        rsp->counter_value = (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+        rsp->has_counter_value = 1;
+    }
+
+    return NC_OK;
+}
+
+/**.......................................................................
+ * Re-pack a PB-formatted DT_UPDATE response of a counter for return to a
+ * Redis client, as the counter's new value
+ */
+rstatus_t
+repack_incr_resp(struct msg* r)
+{
+    ASSERT(r != NULL);
+
+    char buf[2 + NC_UINT64_MAXLEN + CRLF_LEN];
+    int n;
+
+    if (!r->riak_rsp.has_counter_value) {
+        return NC_ERROR;
+    }
+
+    msg_rewind(r);
+    r->mlen = 0;
+
+    n = nc_snprintf(buf, sizeof(buf), ":%"PRId64"\r\n",
+                    r->riak_rsp.counter_value);
+
+    r->type = MSG_RSP_REDIS_INTEGER;
+
+    return msg_copy_char(r, buf, (size_t)n);
+}
@@ -27,8 +27,35 @@ typedef enum {
     RSP_RIAK_DT_UPDATE = 83
 } riak_rsp_t;
 
-typedef size_t (*pb_pack_func)(const void *message, uint8_t *out);
-typedef void* (*unpack_func)(ProtobufCAllocator *allocator, size_t len, const uint8_t *data);
+/*
+ * Cursor over a PB-encoded message, read in place from the mbufs of the
+ * msg holding it
+ */
+struct pb_cursor {
+    struct mbuf *mbuf;                /* mbuf of the next byte */
+    uint8_t     *ptr;                 /* next byte */
+    uint32_t    left;                 /* # bytes left in the enclosing message */
+};
+
+/*
+ * Tag of a PB field, given its number and wire type
+ */
+#define PB_TAG(_field, _type)   (((uint64_t)(_field) << 3) | (_type))
+
+/*
+ * Writer of a PB-encoded message, appending to the mbufs of a msg; with
+ * a NULL msg, it only counts the bytes it would write
+ */
+struct pb_writer {
+    struct msg       *msg;            /* msg to append to, or NULL */
+    struct mbuf      *mbuf;           /* mbuf to append to */
+    struct mhdr      *src;            /* mbufs the value may be spliced from */
+    struct pb_cursor *value;          /* RpbContent value, in place, or NULL */
+    uint32_t         len;             /* # bytes written or counted */
+    rstatus_t        status;          /* first error */
+};
+
+typedef void (*pb_encode_func)(struct pb_writer *w, const void *message);
 
 void parse_pb_get_req(struct msg *r, uint32_t* len, uint8_t* msgid, RpbGetReq** req);
 void parse_pb_put_req(struct msg *r, uint32_t* len, uint8_t* msgid, RpbPutReq** req);
@@ -43,23 +70,35 @@ rstatus_t encode_pb_put_req(struct msg* r, struct conn* s_conn, msg_type_t type)
 rstatus_t encode_pb_del_req(struct msg* r, struct conn* s_conn, msg_type_t type);
 rstatus_t encode_pb_sadd_req(struct msg* r, struct conn* s_conn, msg_type_t type);
 rstatus_t encode_pb_srem_req(struct msg* r, struct conn* s_conn, msg_type_t type);
+rstatus_t encode_pb_set_batch_req(struct msg* r, struct conn* s_conn, msg_type_t type);
 rstatus_t encode_pb_smembers_req(struct msg* r, struct conn* s_conn, msg_type_t type);
 rstatus_t encode_pb_sismember_req(struct msg* r, struct conn* s_conn, msg_type_t type);
 rstatus_t encode_pb_scard_req(struct msg* r, struct conn* s_conn, msg_type_t type);
-
-RpbGetResp* extract_get_rsp(struct msg* r, uint32_t len, uint8_t* msgid);
-RpbPutResp* extract_put_rsp(struct msg* r, uint32_t len, uint8_t* msgid);
-bool extract_del_rsp(struct msg* r, uint32_t len, uint8_t* msgid);
-DtUpdateResp* extract_dt_update_rsp(struct msg* r, uint32_t len, uint8_t* msgid);
-DtFetchResp* extract_dt_fetch_rsp(struct msg* r, uint32_t len, uint8_t* msgid);
-
-rstatus_t repack_get_rsp(struct msg* r, RpbGetResp* rpbresp);
-rstatus_t repack_dt_update_resp(struct msg* r, DtUpdateResp* dtresp);
-rstatus_t repack_dt_fetch_resp(struct msg* r, DtFetchResp* dtresp);
-
-
-bool extract_rsp(struct msg* r, uint32_t len, uint8_t* msgid, unpack_func func,
-            void ** rpbresp);
+rstatus_t encode_pb_incr_req(struct msg* r, struct conn* s_conn, msg_type_t type);
+
+rstatus_t extract_get_rsp(struct pb_cursor* c, struct riak_rsp* rsp);
+rstatus_t extract_cut_through_rsp(struct pb_cursor* c, struct riak_cut* cut,
+                                  struct riak_rsp* rsp);
+rstatus_t riak_cut_through(struct msg* r, struct msg* pmsg, uint32_t len);
+rstatus_t extract_put_rsp(struct pb_cursor* c, struct riak_rsp* rsp);
+rstatus_t extract_error_rsp(struct pb_cursor* c, struct riak_rsp* rsp,
+                            ProtobufCBinaryData* errmsg);
+rstatus_t extract_dt_fetch_rsp(struct pb_cursor* c, struct riak_rsp* rsp);
+rstatus_t extract_dt_update_rsp(struct pb_cursor* c, struct riak_rsp* rsp);
+
+rstatus_t repack_get_resp(struct msg* r, struct riak_rsp* rsp);
+rstatus_t repack_exists_resp(struct msg* r, struct riak_rsp* rsp);
+rstatus_t repack_dt_update_resp(struct msg* r);
+rstatus_t repack_incr_resp(struct msg* r);
+rstatus_t repack_dt_fetch_resp(struct msg* r, struct mhdr* src);
+
+bool pb_cursor_varint(struct pb_cursor* c, uint64_t* val);
+bool pb_cursor_skip(struct pb_cursor* c, uint64_t n);
+bool pb_cursor_skip_field(struct pb_cursor* c, uint64_t tag);
+bool pb_cursor_read(struct pb_cursor* c, uint8_t* dst, uint32_t n);
+bool pb_cursor_field(struct pb_cursor* c, struct pb_cursor* field);
+rstatus_t pb_cursor_data(const struct pb_cursor* c, ProtobufCBinaryData* data);
+rstatus_t pb_cursor_bytes(struct pb_cursor* c, ProtobufCBinaryData* data);
 rstatus_t extract_bucket_key_value(struct msg *r,
                                    ProtobufCBinaryData *type,
                                    ProtobufCBinaryData *bucket,
@@ -68,16 +107,20 @@ rstatus_t extract_bucket_key_value(struct msg *r,
                                    struct msg_pos *keyname_start_pos,
                                    bool allow_empty_bucket);
 
-rstatus_t pack_message(struct msg *r, msg_type_t type, uint32_t msglen,
-                       uint8_t reqid, pb_pack_func func, const void *message,
-                       uint32_t bucketlen);
+void pb_write_rpb_get_req(struct pb_writer *w, const void *message);
+void pb_write_rpb_put_req(struct pb_writer *w, const void *message);
+void pb_write_rpb_del_req(struct pb_writer *w, const void *message);
+void pb_write_dt_fetch_req(struct pb_writer *w, const void *message);
+void pb_write_dt_update_req(struct pb_writer *w, const void *message);
+
+rstatus_t pack_message(struct msg *r, msg_type_t type, uint8_t reqid,
+                       pb_encode_func func, const void *message,
+                       struct pb_cursor *value, uint32_t bucketlen);
 
 /*
  * Sibling resolution functions
  */
 
-unsigned choose_sibling(RpbGetResp* rpbresp);
-unsigned choose_last_modified_sibling(RpbGetResp* rpbresp);
 unsigned choose_random_sibling(unsigned nSib);
 
 #endif /* _NC_RIAK_H_ */
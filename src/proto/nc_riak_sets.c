@@ -54,8 +54,6 @@ encode_pb_sadd_req(struct msg* r, struct conn* s_conn, msg_type_t type)
             key = NULL;
             if (req.bucket.len <= 0) {
                 // if no bucket specified, return it back to frontend
-                nc_free(req.type.data);
-                nc_free(values[value_num].data);
                 return NC_EBADREQ;
             }
         }
@@ -88,9 +86,8 @@ encode_pb_sadd_req(struct msg* r, struct conn* s_conn, msg_type_t type)
             req.sloppy_quorum = opt->riak_sloppy_quorum;
         }
 
-        status = pack_message(r, type, dt_update_req__get_packed_size(&req),
-                              REQ_RIAK_DT_UPDATE,
-                              (pb_pack_func)dt_update_req__pack, &req,
+        status = pack_message(r, type, REQ_RIAK_DT_UPDATE,
+                              pb_write_dt_update_req, &req, NULL,
                               req.bucket.len);
     }
     if(status == NC_OK) {
@@ -99,21 +96,158 @@ encode_pb_sadd_req(struct msg* r, struct conn* s_conn, msg_type_t type)
         if (req.type.len > 0) {
             add_pexpire_msg_key(ctx, c_conn, (char*)req.type.data,
                                 req.type.len + req.bucket.len + req.key.len + 2, 0);
+            del_nil_marker_msg_key(ctx, c_conn, (char*)req.type.data,
+                                   (uint32_t)(req.type.len + req.bucket.len +
+                                              req.key.len + 2));
         } else {
             add_pexpire_msg_key(ctx, c_conn, (char*)req.bucket.data,
                                 req.bucket.len + req.key.len + 1, 0);
+            del_nil_marker_msg_key(ctx, c_conn, (char*)req.bucket.data,
+                                   (uint32_t)(req.bucket.len + req.key.len + 1));
         }
         r->integer = value_num;
     }
 
-    nc_free(req.type.data);
-    unsigned int i;
-    for(i = 0; i < value_num; i++) {
-        nc_free(values[i].data);
-    }
     return status;
 }
 
+/**.......................................................................
+ * Return true if a set member is one of the first n values
+ */
+static bool
+set_value_find(const ProtobufCBinaryData *values, size_t n,
+               const ProtobufCBinaryData *value)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (values[i].len == value->len &&
+            memcmp(values[i].data, value->data, value->len) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**.......................................................................
+ * Take a batch of Redis SADD and SREM requests of a set, the requests
+ * waiting on r, and remap r to a single PB message updating the set
+ * with all of their adds and removes.  A member removed more than once
+ * is removed once, since Riak rejects the removal of a member which is
+ * not in the set.
+ */
+rstatus_t
+encode_pb_set_batch_req(struct msg* r, struct conn* s_conn, msg_type_t type)
+{
+    ASSERT(r != NULL);
+    ASSERT(s_conn != NULL);
+
+    rstatus_t status;
+    struct msg* wmsg;
+    uint32_t value_count = 0, i;
+
+    TAILQ_FOREACH(wmsg, &r->miss_waitq, b_tqe) {
+        if (wmsg->narg < 3) {
+            return NC_ERROR;
+        }
+        value_count += wmsg->narg - 2;
+    }
+
+    DtUpdateReq req = DT_UPDATE_REQ__INIT;
+    DtOp op = DT_OP__INIT;
+    SetOp setop = SET_OP__INIT;
+    ProtobufCBinaryData adds[value_count];
+    ProtobufCBinaryData removes[value_count];
+    ProtobufCBinaryData datatype, bucket, key, value;
+
+    req.has_key = 1;
+    req.op = &op;
+    op.set_op = &setop;
+
+    setop.adds = adds;
+    setop.removes = removes;
+
+    TAILQ_FOREACH(wmsg, &r->miss_waitq, b_tqe) {
+        struct msg_pos keyname_start_pos = msg_pos_init();
+
+        for (i = 0; i < wmsg->narg - 2; i++) {
+            status = extract_bucket_key_value(wmsg,
+                                              i == 0 ? &datatype : NULL,
+                                              i == 0 ? &bucket : NULL,
+                                              i == 0 ? &key : NULL,
+                                              &value, &keyname_start_pos,
+                                              true);
+            if (status != NC_OK) {
+                return status;
+            }
+
+            if (wmsg->type == MSG_REQ_REDIS_SADD) {
+                adds[setop.n_adds++] = value;
+            } else if (!set_value_find(removes, setop.n_removes, &value)) {
+                removes[setop.n_removes++] = value;
+            }
+        }
+
+        if (wmsg == TAILQ_FIRST(&r->miss_waitq)) {
+            req.type = datatype;
+            req.bucket = bucket;
+            req.key = key;
+        }
+    }
+
+    if (req.bucket.len <= 0) {
+        // if no bucket specified, return it back to frontend
+        return NC_EBADREQ;
+    }
+
+    struct server* server = (struct server*)(s_conn->owner);
+    const struct server_pool* pool = (struct server_pool*)(server->owner);
+    const struct backend_opt* opt = &pool->backend_opt;
+
+    req.has_w = (opt->riak_w != CONF_UNSET_NUM);
+    if (req.has_w) {
+        req.w = opt->riak_w;
+    }
+
+    req.has_pw = (opt->riak_pw != CONF_UNSET_NUM);
+    if (req.has_pw) {
+        req.pw = opt->riak_pw;
+    }
+
+    req.has_n_val = (opt->riak_n != CONF_UNSET_NUM);
+    if (req.has_n_val) {
+        req.n_val = opt->riak_n;
+    }
+
+    req.has_sloppy_quorum =
+            (opt->riak_sloppy_quorum != CONF_UNSET_NUM);
+    if (req.has_sloppy_quorum) {
+        req.sloppy_quorum = opt->riak_sloppy_quorum;
+    }
+
+    status = pack_message(r, type, REQ_RIAK_DT_UPDATE,
+                          pb_write_dt_update_req, &req, NULL,
+                          (uint32_t)req.bucket.len);
+    if (status != NC_OK) {
+        return status;
+    }
+
+    struct conn *c_conn = r->owner;
+    struct context *ctx = conn_to_ctx(c_conn);
+    if (req.type.len > 0) {
+        add_pexpire_msg_key(ctx, c_conn, (char*)req.type.data,
+                            (uint32_t)(req.type.len + req.bucket.len +
+                                       req.key.len + 2), 0);
+    } else {
+        add_pexpire_msg_key(ctx, c_conn, (char*)req.bucket.data,
+                            (uint32_t)(req.bucket.len + req.key.len + 1), 0);
+    }
+    r->integer = value_count;
+
+    return NC_OK;
+}
+
 /**.......................................................................
  * Take a Redis SREM request, and remap it to a PB message suitable for
  * sending to riak.
@@ -191,8 +325,6 @@ encode_pb_srem_req(struct msg* r, struct conn* s_conn, msg_type_t type)
             key = NULL;
             if (req.bucket.len <= 0) {
                 // if no bucket specified, return it back to frontend
-                nc_free(req.type.data);
-                nc_free(value.data);
                 return NC_EBADREQ;
             }
         }
@@ -200,15 +332,13 @@ encode_pb_srem_req(struct msg* r, struct conn* s_conn, msg_type_t type)
 
         struct mbuf *mbuf = mbuf_get();
         if (mbuf == NULL) {
-            nc_free(req.type.data);
             return NC_ENOMEM;
         }
         STAILQ_INSERT_HEAD(&r->mhdr, mbuf, next);
 
-        status = pack_message(r, type, dt_update_req__get_packed_size(&req),
-                                  REQ_RIAK_DT_UPDATE,
-                                  (pb_pack_func)dt_update_req__pack, &req,
-                                  req.bucket.len);
+        status = pack_message(r, type, REQ_RIAK_DT_UPDATE,
+                              pb_write_dt_update_req, &req, NULL,
+                              req.bucket.len);
         if(status != NC_OK) {
             break;
         }
@@ -234,8 +364,6 @@ encode_pb_srem_req(struct msg* r, struct conn* s_conn, msg_type_t type)
     r->integer = value_num;
     r->nsubs = value_num;
 
-    nc_free(req.type.data);
-    nc_free(value.data);
     return status;
 }
 
@@ -292,9 +420,8 @@ fetch_pb_req(DtFetchReq *req, struct msg* r, struct conn* s_conn, msg_type_t typ
         req->timeout = opt->riak_timeout;
     }
 
-    return pack_message(r, type, dt_fetch_req__get_packed_size(req),
-                        REQ_RIAK_DT_FETCH, (pb_pack_func)dt_fetch_req__pack,
-                        req, req->bucket.len);
+    return pack_message(r, type, REQ_RIAK_DT_FETCH, pb_write_dt_fetch_req,
+                        req, NULL, req->bucket.len);
 }
 
 rstatus_t
@@ -306,23 +433,32 @@ encode_pb_smembers_req(struct msg* r, struct conn* s_conn, msg_type_t type)
     rstatus_t status;
 
     DtFetchReq req = DT_FETCH_REQ__INIT;
+    ProtobufCBinaryData arg;
     struct msg_pos keyname_start_pos = msg_pos_init();
 
     msg_free_stored_arg(r);
 
     status = extract_bucket_key_value(r, &req.type, &req.bucket, &req.key,
-            (type == MSG_REQ_RIAK_SISMEMBER) ? &r->stored_arg : NULL,
+            (type == MSG_REQ_RIAK_SISMEMBER) ? &arg : NULL,
             &keyname_start_pos, false);
     if (status != NC_OK) {
         return status;
     }
 
+    /* the member is kept until the response, past the arena */
+    if (type == MSG_REQ_RIAK_SISMEMBER) {
+        r->stored_arg.data = nc_alloc(arg.len + 1);
+        if (r->stored_arg.data == NULL) {
+            return NC_ENOMEM;
+        }
+        nc_memcpy(r->stored_arg.data, arg.data, arg.len);
+        r->stored_arg.len = arg.len;
+    }
+
     status = fetch_pb_req(&req, r, s_conn, type);
-    status = pack_message(r, type, dt_fetch_req__get_packed_size(&req),
-                          REQ_RIAK_DT_FETCH, (pb_pack_func)dt_fetch_req__pack,
-                          &req, req.bucket.len);
+    status = pack_message(r, type, REQ_RIAK_DT_FETCH, pb_write_dt_fetch_req,
+                          &req, NULL, req.bucket.len);
 
-    nc_free(req.type.data);
     return status;
 }
 
@@ -338,26 +474,90 @@ encode_pb_scard_req(struct msg* r, struct conn* s_conn, msg_type_t type)
     return encode_pb_smembers_req(r, s_conn, type);
 }
 
-DtUpdateResp*
-extract_dt_update_rsp(struct msg* r, uint32_t len, uint8_t* msgid)
+/*
+ * Fields of the Riak data type responses decoded by riak_parse_rsp
+ */
+#define DT_FETCH_RESP_VALUE     PB_TAG(3, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+#define DT_VALUE_SET_VALUE      PB_TAG(2, PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+
+/*
+ * The reply to a SMEMBERS of a set of more members than this is released
+ * to the client in parts of this many members, see repack_dt_fetch_next
+ */
+#define DT_FETCH_PART_MEMBERS   1024
+
+/**.......................................................................
+ * Decode the body of a PB-encoded DT_FETCH response in place, counting
+ * the members of the set, and locating the DtValue they are in, which
+ * is streamed by repack_dt_fetch_resp.
+ */
+rstatus_t
+extract_dt_fetch_rsp(struct pb_cursor* c, struct riak_rsp* rsp)
 {
-    DtUpdateResp* dtresp;
-    extract_rsp(r, len, msgid, (unpack_func)dt_update_resp__unpack,
-                (void*)&dtresp);
-    return dtresp;
+    struct pb_cursor value, members;
+    uint64_t tag;
+
+    while (c->left > 0) {
+        if (!pb_cursor_varint(c, &tag)) {
+            return NC_ERROR;
+        }
+
+        if (tag != DT_FETCH_RESP_VALUE) {
+            if (!pb_cursor_skip_field(c, tag)) {
+                return NC_ERROR;
+            }
+            continue;
+        }
+
+        if (!pb_cursor_field(c, &value) || !pb_cursor_skip(c, value.left)) {
+            return NC_ERROR;
+        }
+
+        rsp->n_set_value = 0;
+        members = value;
+        while (members.left > 0) {
+            if (!pb_cursor_varint(&members, &tag) ||
+                !pb_cursor_skip_field(&members, tag)) {
+                return NC_ERROR;
+            }
+            if (tag == DT_VALUE_SET_VALUE) {
+                rsp->n_set_value++;
+            }
+        }
+
+        rsp->set_mbuf = value.mbuf;
+        rsp->set_ptr = value.ptr;
+        rsp->set_len = value.left;
+    }
+
+    return NC_OK;
 }
 
-DtFetchResp*
-extract_dt_fetch_rsp(struct msg* r, uint32_t len, uint8_t* msgid)
+/**.......................................................................
+ * Read the next member of a set from its DtValue
+ */
+static rstatus_t
+dt_value_next_member(struct pb_cursor* value, ProtobufCBinaryData* member)
 {
-    DtFetchResp* dtresp;
-    extract_rsp(r, len, msgid, (unpack_func)dt_fetch_resp__unpack,
-                (void*)&dtresp);
-    return dtresp;
+    uint64_t tag;
+
+    while (value->left > 0) {
+        if (!pb_cursor_varint(value, &tag)) {
+            return NC_ERROR;
+        }
+        if (tag == DT_VALUE_SET_VALUE) {
+            return pb_cursor_bytes(value, member);
+        }
+        if (!pb_cursor_skip_field(value, tag)) {
+            return NC_ERROR;
+        }
+    }
+
+    return NC_ERROR;
 }
 
 rstatus_t
-repack_dt_update_resp(struct msg* r, DtUpdateResp* dtresp)
+repack_dt_update_resp(struct msg* r)
 {
     ASSERT(r != NULL);
 
@@ -380,91 +580,21 @@ repack_dt_update_resp(struct msg* r, DtUpdateResp* dtresp)
 }
 
 /**.......................................................................
- * Function to copy CRDT values to message
+ * Function to copy a CRDT value to message, as a bulk
  */
-rstatus_t
-copy_values_to_msg(ProtobufCBinaryData *values, uint32_t nval, struct msg *msg)
+static rstatus_t
+copy_value_to_msg(const ProtobufCBinaryData *value, struct msg *msg)
 {
     rstatus_t status;
-    uint32_t i;
     char lenbuf[32]; // this size should be enough for any 32 bits digits
-    for(i = 0; i < nval; i++) {
-        uint32_t lenbuf_len = sprintf(lenbuf, "$%u\r\n", (uint32_t)values[i].len);
-        if ((status = msg_copy_char(msg, lenbuf, lenbuf_len))
-            != NC_OK) {
-            msg_put(msg);
-            return status;
-        }
-
-        if ((status = msg_copy_char(msg, (char*)values[i].data, values[i].len))
-            != NC_OK) {
-            msg_put(msg);
-            return status;
-        }
-
-        if ((status = msg_copy_char(msg, "\r\n",2)) != NC_OK) {
-            msg_put(msg);
-            return status;
-        }
-    }
-    return NC_OK;
-}
-
-/**.......................................................................
- * Function to add a SADD message to the frontend server's queue,
- * with explicit members from DtFetchResp (values and nval)
- */
-rstatus_t
-add_sadd_msg(struct context *ctx, struct conn *c_conn, uint8_t *keyname,
-             uint32_t keynamelen, ProtobufCBinaryData *values, uint32_t nval,
-             msg_type_t type)
-{
-    ASSERT(nval != 0);
-
-    const char sadd_begin_proto[] = "*%u\r\n$4\r\nsadd\r\n$%u\r\n%.*s\r\n";
-    rstatus_t status;
-    struct conn* s_conn = server_pool_conn_frontend(ctx, c_conn->owner,
-                                                    (uint8_t*)keyname,
-                                                    keynamelen,
-                                                    NULL);
-
-    char sadd_begin[sizeof(sadd_begin_proto) - 8 + ndig(2 + nval)
-                    + ndig(keynamelen) + keynamelen];
-    const uint32_t sadd_begin_len = (uint32_t)sprintf(sadd_begin,
-                                                      sadd_begin_proto,
-                                                      2 + nval, keynamelen,
-                                                      keynamelen, keyname);
-    ASSERT(sadd_begin_len == sizeof(sadd_begin) - 1);
+    uint32_t lenbuf_len = sprintf(lenbuf, "$%u\r\n", (uint32_t)value->len);
 
-    struct msg* msg = msg_get(c_conn, true);
-    if (msg == NULL) {
-        c_conn->err = errno;
-        return NC_ENOMEM;
-    }
-
-    if ((status = msg_copy_char(msg, sadd_begin, sizeof(sadd_begin) - 1))
-        != NC_OK) {
-        msg_put(msg);
+    if ((status = msg_copy_char(msg, lenbuf, lenbuf_len)) != NC_OK ||
+        (status = msg_copy(msg, value->data, value->len)) != NC_OK) {
         return status;
     }
 
-    if ((status = copy_values_to_msg(values, nval, msg))
-        != NC_OK) {
-        msg_put(msg);
-        return status;
-    }
-
-    msg->swallow = 1;
-    msg->type = type;
-
-    if (TAILQ_EMPTY(&s_conn->imsg_q)) {
-        event_add_out(ctx->evb, s_conn);
-    }
-
-    s_conn->enqueue_inq(ctx, s_conn, msg);
-    s_conn->need_auth = 0;
-
-    return NC_OK;
+    return msg_copy_char(msg, "\r\n", 2);
 }
 
 /**.......................................................................
@@ -486,36 +616,149 @@ parse_dt_fetch_req(struct msg *r, uint32_t* len, uint8_t* msgid, DtFetchReq** re
 
     uint8_t* pos = mbuf->start + 4 + 1;
 
-    *req = dt_fetch_req__unpack(NULL, *len - 1, pos);
+    *req = dt_fetch_req__unpack(arena_pb_allocator(), *len - 1, pos);
+}
+
+/**.......................................................................
+ * Repack the next part of the members left of a reply released in parts
+ * into r, releasing the mbufs of the response behind them
+ */
+static rstatus_t
+repack_dt_fetch_part(struct msg* r)
+{
+    struct riak_dt_stream* st = r->dt_stream;
+    struct pb_cursor value;
+    ProtobufCBinaryData member;
+    struct mbuf* mbuf;
+    rstatus_t status = NC_OK;
+    uint32_t i;
+
+    value.mbuf = st->mbuf;
+    value.ptr = st->ptr;
+    value.left = st->len;
+
+    for (i = 0; i < DT_FETCH_PART_MEMBERS && st->left > 0; i++) {
+        if ((status = dt_value_next_member(&value, &member)) != NC_OK ||
+            (status = copy_value_to_msg(&member, r)) != NC_OK) {
+            break;
+        }
+        st->left--;
+
+        while ((mbuf = STAILQ_FIRST(&st->mhdr)) != NULL && mbuf != value.mbuf) {
+            mbuf_remove(&st->mhdr, mbuf);
+            mbuf_put(mbuf);
+        }
+    }
+
+    st->mbuf = value.mbuf;
+    st->ptr = value.ptr;
+    st->len = value.left;
+
+    if (status != NC_OK || st->left == 0) {
+        repack_dt_fetch_put(r);
+    }
+
+    return status;
 }
 
 /**.......................................................................
- * Handle backend fetch result.
+ * Repack the next part of a reply released in parts into r, once the
+ * part before it is sent, in the first mbuf of that part
  */
 rstatus_t
-repack_dt_fetch_resp(struct msg* r, DtFetchResp* dtresp)
+repack_dt_fetch_next(struct msg* r)
 {
+    struct mbuf *mbuf, *nbuf;
+
     ASSERT(r != NULL);
-    ASSERT(dtresp != NULL);
+    ASSERT(r->dt_stream != NULL);
 
-    msg_rewind(r);
+    mbuf = STAILQ_FIRST(&r->mhdr);
+    while (mbuf != NULL && (nbuf = STAILQ_NEXT(mbuf, next)) != NULL) {
+        mbuf_remove(&r->mhdr, nbuf);
+        mbuf_put(nbuf);
+    }
+    if (mbuf != NULL) {
+        mbuf_rewind(mbuf);
+    }
     r->mlen = 0;
 
+    return repack_dt_fetch_part(r);
+}
+
+/**.......................................................................
+ * Release the set members left of a reply released in parts.
+ *
+ * A no-op for other messages
+ */
+void
+repack_dt_fetch_put(struct msg* r)
+{
+    struct riak_dt_stream* st = r->dt_stream;
+    struct mbuf* mbuf;
+
+    if (st == NULL) {
+        return;
+    }
+    r->dt_stream = NULL;
+
+    while ((mbuf = STAILQ_FIRST(&st->mhdr)) != NULL) {
+        mbuf_remove(&st->mhdr, mbuf);
+        mbuf_put(mbuf);
+    }
+
+    nc_free(st);
+}
+
+/**.......................................................................
+ * Handle backend fetch result, streaming the members of the set located
+ * by riak_parse_rsp.  The members are decoded one at a time, each
+ * repacked and added to the frontend's copy of the set in turn, and the
+ * mbufs of the response, detached from r into src, are released as soon
+ * as the members in them are done with, so that even a large set is
+ * held about once, rather than as response, reply and fill at once.
+ * The response is still read whole before it is decoded, as the set is
+ * only located once it is complete: peak buffering is that of the whole
+ * response, and only the copies of it are avoided.
+ *
+ * The reply to a SMEMBERS of a large set for a client is not repacked
+ * whole: the response is kept, and the reply released in parts of
+ * DT_FETCH_PART_MEMBERS members, each repacked once the part before it
+ * is sent (see repack_dt_fetch_next), so that no more than a part of
+ * the reply is held at a time.
+ */
+rstatus_t
+repack_dt_fetch_resp(struct msg* r, struct mhdr* src)
+{
+    ASSERT(r != NULL);
+    ASSERT(STAILQ_EMPTY(&r->mhdr));
+
     rstatus_t status = NC_OK;
-    // dtresp->value is NULL if nothing is stored
-    uint32_t values_count = dtresp->value ? dtresp->value->n_set_value : 0;
-    ProtobufCBinaryData *values = dtresp->value ? dtresp->value->set_value
-                                                : NULL;
 
     struct msg* pmsg = TAILQ_FIRST(&r->owner->omsg_q);
+    struct riak_rsp* rsp = &r->riak_rsp;
+    const uint32_t values_count = rsp->n_set_value;
     uint8_t msgid;
     uint32_t len;
     struct conn *c_conn = pmsg->owner;
     struct context *ctx = conn_to_ctx(c_conn);
     struct server* server = r->owner->owner;
     struct server_pool* pool = (struct server_pool*)server->owner;
+    struct backend_set_fill fill;
+    struct pb_cursor value;
+    ProtobufCBinaryData member;
+    struct riak_dt_stream* st;
+    struct mbuf* mbuf;
+    uint32_t result = 0;
+    uint32_t i;
+    bool parts;
+
+    parts = pmsg->type == MSG_REQ_RIAK_SMEMBERS &&
+            values_count > DT_FETCH_PART_MEMBERS && !pmsg->swallow &&
+            pmsg->fill_owner == NULL && TAILQ_EMPTY(&pmsg->miss_waitq);
 
     // sync with frontend
+    backend_set_fill_init(&fill, ctx, c_conn, NULL, 0, 0, 0);
     if(values_count) {
         DtFetchReq *req = NULL;
 
@@ -525,77 +768,105 @@ repack_dt_fetch_resp(struct msg* r, DtFetchResp* dtresp)
         }
         const uint32_t delimiter_count = ((req->type.len > 0) ? 1 : 0)
                                          + ((req->bucket.len > 0) ? 1 : 0);
- 
-        char key[req->type.len + req->bucket.len + req->key.len + delimiter_count + 1];
+        const uint32_t keysize = (uint32_t)(req->type.len + req->bucket.len + req->key.len)
+                                 + delimiter_count + 1;
+        char *key = arena_alloc(keysize);
+        if (key == NULL) {
+            dt_fetch_req__free_unpacked(req, arena_pb_allocator());
+            return NC_ENOMEM;
+        }
         uint32_t keylen = sprintf(key, "%.*s%s%.*s:%.*s",
                                   (uint32_t)req->type.len, req->type.data,
                                   (req->type.len > 0) ? ":" : "",
                                   (uint32_t)req->bucket.len, req->bucket.data,
                                   (uint32_t)req->key.len, req->key.data);
-        ASSERT(keylen == sizeof(key) - 1);
+        ASSERT(keylen == keysize - 1);
         int64_t ttl = server_pool_bucket_ttl(pool,
                                              req->type.data, req->type.len,
                                              req->bucket.data, req->bucket.len);
-        dt_fetch_req__free_unpacked(req, NULL);
+        dt_fetch_req__free_unpacked(req, arena_pb_allocator());
+
+        backend_set_fill_init(&fill, ctx, c_conn, (uint8_t*)key, keylen,
+                              values_count, ttl);
+    }
+
+    if (pmsg->type == MSG_REQ_RIAK_SMEMBERS) {
+        status = msg_prepend_format(r, "*%u\r\n", values_count);
+    }
+
+    value.mbuf = rsp->set_mbuf;
+    value.ptr = rsp->set_ptr;
+    value.left = rsp->set_len;
+
+    for (i = 0; status == NC_OK && i < values_count; i++) {
+        if ((status = dt_value_next_member(&value, &member)) != NC_OK) {
+            break;
+        }
+
+        backend_set_fill_add(&fill, &member);
 
+        /* the reply is repacked from the response kept, in parts */
+        if (parts) {
+            continue;
+        }
+
+        // choose which was a command and response on it
         switch(pmsg->type) {
         case MSG_REQ_RIAK_SMEMBERS:
-        case MSG_REQ_RIAK_SISMEMBER:
-        case MSG_REQ_RIAK_SCARD:
-            add_sadd_msg(ctx, c_conn, (uint8_t*)key, keylen, values, values_count, MSG_REQ_RIAK_SADD);
-            add_pexpire_msg_key(ctx, c_conn, (char *)key, keylen, ttl);
+            status = copy_value_to_msg(&member, r);
             break;
 
-        case MSG_REQ_RIAK_SDIFF:
-        case MSG_REQ_RIAK_SINTER:
-        case MSG_REQ_RIAK_SUNION:
-        case MSG_REQ_RIAK_SDIFFSTORE:
-        case MSG_REQ_RIAK_SINTERSTORE:
-        case MSG_REQ_RIAK_SUNIONSTORE:
-            add_sadd_msg(ctx, c_conn, (uint8_t*)key, keylen, values, values_count, MSG_REQ_HIDDEN);
-            // TODO may be it have to be done after perforing command?
-            add_pexpire_msg_key(ctx, c_conn, (char *)key, keylen, ttl);
+        case MSG_REQ_RIAK_SISMEMBER:
+            if (member.len == pmsg->stored_arg.len &&
+                (member.len == 0 ||
+                 memcmp(member.data, pmsg->stored_arg.data, member.len) == 0)) {
+                result = 1;
+            }
             break;
+
         default:
             break;
         }
+
+        /* the mbufs behind the next member are done with */
+        while ((mbuf = STAILQ_FIRST(src)) != NULL && mbuf != value.mbuf) {
+            mbuf_remove(src, mbuf);
+            mbuf_put(mbuf);
+        }
     }
 
+    backend_set_fill_done(&fill);
 
-    // choose which was a command and response on it
-    switch(pmsg->type) {
+    if (status != NC_OK) {
+        return status;
+    }
 
-    case MSG_REQ_RIAK_SMEMBERS:
-        if ((status = msg_prepend_format(r, "*%u\r\n", values_count))
-            != NC_OK) {
-            return status;
+    if (parts) {
+        st = nc_alloc(sizeof(*st));
+        if (st == NULL) {
+            return NC_ENOMEM;
         }
-        if ((status = copy_values_to_msg(values, values_count, r))
-            != NC_OK) {
+        STAILQ_INIT(&st->mhdr);
+        STAILQ_CONCAT(&st->mhdr, src);
+        st->mbuf = rsp->set_mbuf;
+        st->ptr = rsp->set_ptr;
+        st->len = rsp->set_len;
+        st->left = values_count;
+        r->dt_stream = st;
+
+        if ((status = repack_dt_fetch_part(r)) != NC_OK) {
             return status;
         }
+    }
 
-        break;
+    switch(pmsg->type) {
 
     case MSG_REQ_RIAK_SISMEMBER:
-    {
-        uint32_t result = 0;
-        uint32_t i;
-        for(i = 0; i < values_count; i++) {
-            if(values[i].len == pmsg->stored_arg.len) {
-                if(strncmp((char*)values[i].data, (char*)pmsg->stored_arg.data,
-                           pmsg->stored_arg.len) == 0) {
-                    result = 1;
-                    break;
-                }
-            }
-        }
         msg_free_stored_arg(r);
 
         if ((status = msg_prepend_format(r, ":%d\r\n", result)) != NC_OK) {
             return status;
         }
-    }
         break;
 
     case MSG_REQ_RIAK_SCARD:
@@ -604,112 +875,6 @@ repack_dt_fetch_resp(struct msg* r, DtFetchResp* dtresp)
         }
         break;
 
-    case MSG_REQ_RIAK_SDIFF:
-    case MSG_REQ_RIAK_SINTER:
-    case MSG_REQ_RIAK_SUNION:
-    case MSG_REQ_RIAK_SDIFFSTORE:
-    case MSG_REQ_RIAK_SINTERSTORE:
-    case MSG_REQ_RIAK_SUNIONSTORE:
-        // put something just to mark then me answered
-        if ((status = msg_prepend_format(r, "+OK")) != NC_OK) {
-            return status;
-        }
-        // check if all subcommands were sent
-        struct msg *orgm = pmsg->frag_owner;
-        ASSERT(orgm != NULL);
-        orgm->integer--;
-        if( orgm->integer == 0) {
-            // if so, sent real command to perfrom it on frontend
-            struct keypos *kpos = array_get(orgm->keys, 0);
-            struct conn *s_conn = server_pool_conn_frontend(ctx, c_conn->owner,
-                                                            kpos->start,
-                                                            kpos->end - kpos->start,
-                                                            NULL);
-            // create new message for request, remapping store commands to simple
-            char *ncline = NULL;
-            struct msg *msg = NULL;
-            switch (pmsg->type) {
-            case MSG_REQ_RIAK_SDIFF:
-            case MSG_REQ_RIAK_SINTER:
-            case MSG_REQ_RIAK_SUNION:
-                msg = msg_content_clone(orgm);
-                if (msg == NULL) {
-                    return NC_ENOMEM;
-                }
-                break;
-            case MSG_REQ_RIAK_SDIFFSTORE:
-                ncline = "\r\n$5\r\nsdiff\r\n";
-                break;
-            case MSG_REQ_RIAK_SINTERSTORE:
-                ncline = "\r\n$6\r\nsinter\r\n";
-                break;
-            case MSG_REQ_RIAK_SUNIONSTORE:
-                ncline = "\r\n$6\r\nsunion\r\n";
-                break;
-            default:
-                NOT_REACHED();
-            }
-            if (ncline) {
-                // remap to command without store
-                struct msg_pos keyspos;
-                char store[] = "store\r\n";
-                struct msg_pos stpos;
-                msg_pos_init_start(orgm, &stpos);
-                msg_find_char(orgm, store, sizeof(store) - 1, &stpos, &keyspos);
-                if(keyspos.result == MSG_NOTFOUND) {
-                    return NC_ERROR;
-                }
-                msg_offset_from(&keyspos, sizeof(store) - 1, &keyspos);
-                msg_find_char(orgm, "\r\n$", 3, &keyspos, &keyspos);
-                if(keyspos.result == MSG_NOTFOUND) {
-                    return NC_ERROR;
-                }
-                msg_offset_from(&keyspos, 2, &keyspos);
-
-                msg = msg_get(orgm->owner, true);
-                if (msg == NULL) {
-                    c_conn->err = errno;
-                    return NC_ENOMEM;
-                }
-
-                if ((status = msg_copy_char(msg, "*", 1)) != NC_OK) {
-                    msg_put(msg);
-                    return status;
-                }
-
-                char db[16];
-                uint32_t dbl = sprintf(db, "%u", 1 + orgm->nsubs / 2);
-
-                if ((status = msg_copy_char(msg, db, dbl)) != NC_OK) {
-                    msg_put(msg);
-                    return status;
-                }
-
-                if ((status = msg_copy_char(msg, ncline, strlen(ncline))) != NC_OK) {
-                    msg_put(msg);
-                    return status;
-                }
-
-                uint32_t klen;
-                msg_offset_between(&stpos, &keyspos, &klen);
-                klen = orgm->mlen - klen;
-
-                msg_copy_from_pos(msg, &keyspos, klen);
-            }
-
-            msg->noreply = 0;
-            msg->swallow = 1;
-            msg->type = pmsg->type;
-
-            if (TAILQ_EMPTY(&s_conn->imsg_q)) {
-                event_add_out(ctx->evb, s_conn);
-            }
-
-            s_conn->enqueue_inq(ctx, s_conn, msg);
-            s_conn->need_auth = 0;
-        }
-        break;
-
     default:
         break;
     }
@@ -719,94 +884,29 @@ repack_dt_fetch_resp(struct msg* r, DtFetchResp* dtresp)
     return NC_OK;
 }
 
-
-/*
- * Initiate request for key from backend to store the same key in frontend
- */
-rstatus_t
-riak_sync_key(struct context *ctx, struct msg* r, msg_type_t type, bool skip_first)
-{
-    ASSERT(r != NULL);
-    ASSERT(r->owner != NULL);
-    ASSERT(r->owner->owner != NULL);
-
-    rstatus_t status;
-    struct conn *c_conn = r->owner;
-    struct msg_pos keyname_start_pos = msg_pos_init();
-
-    DtFetchReq req = DT_FETCH_REQ__INIT;
-    r->nsubs = 0;
-
-    while ((status = extract_bucket_key_value(r, &req.type, &req.bucket, &req.key, NULL,
-                                              &keyname_start_pos, true))
-               == NC_OK) {
-        if(skip_first) { // skip first if true
-            skip_first = false;
-            continue;
-        }
-
-        struct conn* s_conn = server_pool_conn_backend(ctx, c_conn->owner,
-                                                       req.bucket.data,
-                                                       req.bucket.len + req.key.len + 1,
-                                                       NULL);
-
-        struct msg* msg = msg_get(c_conn, true);
-        if (msg == NULL) {
-            c_conn->err = errno;
-            return NC_ENOMEM;
-        }
-        struct mbuf* mbuf = mbuf_get();
-        if (mbuf == NULL) {
-            return NC_ENOMEM;
-        }
-        mbuf_insert(&msg->mhdr, mbuf);
-        msg->pos = mbuf->pos;
-
-        fetch_pb_req(&req, msg, s_conn, type);
-
-        msg->swallow = 1;
-        msg->frag_owner = r;
-        r->nsubs++;
-
-        if (TAILQ_EMPTY(&s_conn->imsg_q)) {
-            event_add_out(ctx->evb, s_conn);
-        }
-
-        s_conn->enqueue_inq(ctx, s_conn, msg);
-        s_conn->need_auth = 0;
-
-        nc_free(req.type.data);
-    }
-    r->integer = r->nsubs;
-    r->nsubs = r->nsubs * 2;
-
-    return NC_OK;
-}
-
-/*
- * Store key in frontend and backend simultaneously
+/**.......................................................................
+ * Store the result of a set operation, values, in the destination key of
+ * its STORE request pmsg, adding the members to the set in the frontend
+ * and the backend servers alike
  */
 rstatus_t
-riak_synced_key(struct context *ctx, struct msg* pmsg, struct msg* amsg, uint32_t *keysfound)
+riak_store_set(struct context *ctx, struct msg* pmsg,
+               ProtobufCBinaryData *values, uint32_t nval)
 {
     ASSERT(pmsg != NULL);
-    ASSERT(amsg != NULL);
 
     // if no values present, just exit
-    if(amsg->narg == 0)
+    if(nval == 0)
         return NC_OK;
 
-    // extract data
     DtUpdateReq req = DT_UPDATE_REQ__INIT;
     DtOp op = DT_OP__INIT;
     SetOp setop = SET_OP__INIT;
-    ProtobufCBinaryData values[amsg->narg];
-    uint32_t i;
 
     req.has_key = 1;
     req.op = &op;
     op.set_op = &setop;
-    setop.n_adds = amsg->narg;
+    setop.n_adds = nval;
     setop.adds = values;
 
     rstatus_t status;
@@ -819,71 +919,45 @@ riak_synced_key(struct context *ctx, struct msg* pmsg, struct msg* amsg, uint32_
         return status;
     }
 
-    struct msg_pos *keyname_start = NULL;
+    struct conn *c_conn = pmsg->owner;
+    struct server_pool* pool = c_conn->owner;
 
-    for(i = 0; i < amsg->narg; i++) {
-        if ((status = redis_get_next_string(amsg, keyname_start, &keyname_start_pos,
-                                                    &values[i].len))
-                    != NC_OK) {
-            nc_free(req.type.data);
-            if(i > 0) {
-                uint32_t j;
-                for(j = 0; j < i - 1; j++) {
-                    nc_free(values[j].data);
-                }
-            }
-            return status;
-        }
-        keyname_start = &keyname_start_pos;
-        values[i].data = nc_alloc(values[i].len);
-
-        if ((status = msg_extract_from_pos_char((char*)values[i].data,
-                                                &keyname_start_pos, values[i].len))
-            != NC_OK) {
-            nc_free(req.type.data);
-            if(i > 0) {
-                uint32_t j;
-                for(j = 0; j < i - 1; j++) {
-                    nc_free(values[j].data);
-                }
-            }
-            return status;
-        }
+    // the frontend key is "datatype:bucket:key" or "bucket:key"
+    uint8_t *key = (req.type.len > 0) ? req.type.data : req.bucket.data;
+    uint32_t keylen = (uint32_t)(req.bucket.len + req.key.len + 1);
+    if (req.type.len > 0) {
+        keylen += (uint32_t)req.type.len + 1;
     }
 
-    struct conn *c_conn = pmsg->owner;
-    struct server* server = amsg->owner->owner;
-    struct server_pool* pool = (struct server_pool*)server->owner;
-
     // sync frontend
-    add_sadd_msg(ctx, c_conn, req.bucket.data, req.bucket.len + req.key.len + 1,
-                 values, amsg->narg, MSG_REQ_HIDDEN);
+    struct backend_set_fill fill;
+    uint32_t i;
     int64_t ttl = server_pool_bucket_ttl(pool,
                                          req.type.data, req.type.len,
                                          req.bucket.data, req.bucket.len);
-    if (req.type.len > 0) {
-        add_pexpire_msg_key(ctx, c_conn, (char*)req.type.data,
-                        req.type.len + req.bucket.len + req.key.len + 2, ttl);
-    } else {
-        add_pexpire_msg_key(ctx, c_conn, (char*)req.bucket.data,
-                        req.bucket.len + req.key.len + 1, ttl);
+    backend_set_fill_init(&fill, ctx, c_conn, key, keylen, nval, ttl);
+    for (i = 0; i < nval; i++) {
+        backend_set_fill_add(&fill, &values[i]);
     }
+    backend_set_fill_done(&fill);
 
     // sync backend
-    struct conn* s_conn = server_pool_conn_backend(ctx, c_conn->owner,
+    struct conn* s_conn = server_pool_conn_backend(ctx, pool,
                                                    req.bucket.data,
                                                    req.bucket.len + req.key.len + 1,
                                                    NULL);
+    if (s_conn == NULL) {
+        return NC_ERROR;
+    }
+
     struct msg* msg = msg_get(c_conn, true);
     if (msg) {
         struct mbuf* mbuf = mbuf_get();
         if (mbuf) {
             mbuf_insert(&msg->mhdr, mbuf);
             msg->pos = mbuf->pos;
-            pack_message(msg, MSG_REQ_HIDDEN,
-                         dt_update_req__get_packed_size(&req),
-                         REQ_RIAK_DT_UPDATE, (pb_pack_func)dt_update_req__pack,
-                         &req, req.bucket.len);
+            pack_message(msg, MSG_REQ_HIDDEN, REQ_RIAK_DT_UPDATE,
+                         pb_write_dt_update_req, &req, NULL, req.bucket.len);
             msg->swallow = 1;
             msg->type = MSG_REQ_HIDDEN;
 
@@ -896,11 +970,5 @@ riak_synced_key(struct context *ctx, struct msg* pmsg, struct msg* amsg, uint32_
         }
     }
 
-    // cleanup
-    for(i = 0; i < amsg->narg; i++) {
-        nc_free(values[i].data);
-    }
-    nc_free(req.type.data);
-    *keysfound = amsg->narg;
     return NC_OK;
 }
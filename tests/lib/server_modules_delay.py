@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+#coding: utf-8
+
+import time
+import socket
+import threading
+import Queue
+
+class DelayProxy(object):
+    '''
+    A TCP relay in front of a server, holding each reply of the server back
+    for delay seconds once delay is set, to play a slow server.  The server
+    is anything with host() and port(), looked up as each connection is
+    relayed.
+    '''
+    def __init__(self, host, port, server):
+        self._host = host
+        self._port = port
+        self.server = server
+        self.delay = 0
+
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind((host, port))
+        self.listener.listen(16)
+        self._spawn(self._accept)
+
+    def __str__(self):
+        return 'delay proxy %s:%s' % (self._host, self._port)
+
+    def host(self):
+        return self._host
+
+    def port(self):
+        return self._port
+
+    def _spawn(self, target, *args):
+        t = threading.Thread(target = target, args = args)
+        t.daemon = True
+        t.start()
+
+    def _accept(self):
+        while True:
+            client, _ = self.listener.accept()
+            try:
+                server = socket.create_connection((self.server.host(),
+                                                   self.server.port()))
+            except socket.error:
+                client.close()
+                continue
+            replies = Queue.Queue()
+            self._spawn(self._relay, client, server, None)
+            self._spawn(self._relay, server, client, replies)
+            self._spawn(self._send_replies, client, replies)
+
+    def _relay(self, src, dst, replies):
+        # replies are stamped with the time they are due, and sent by
+        # _send_replies, so that each is held back for delay from its receipt
+        try:
+            while True:
+                data = src.recv(65536)
+                if not data:
+                    break
+                if replies == None:
+                    dst.sendall(data)
+                else:
+                    replies.put((time.time() + self.delay, data))
+        except socket.error:
+            pass
+        if replies != None:
+            replies.put((0, None))
+        else:
+            src.close()
+            dst.close()
+
+    def _send_replies(self, dst, replies):
+        try:
+            while True:
+                (due, data) = replies.get()
+                if data == None:
+                    break
+                wait = due - time.time()
+                if wait > 0:
+                    time.sleep(wait)
+                dst.sendall(data)
+        except socket.error:
+            pass
+        dst.close()
@@ -15,7 +15,8 @@ from server_modules import *
 class NutCracker(ServerBase):
     def __init__(self, host, port, path, cluster_name, masters, mbuf=512,
             verbose=5, is_redis=True, redis_auth=None, riak_cluster=None,
-            auto_eject=False):
+            auto_eject=False, l1_cache_size=0, riak_backends=None,
+            hedge_percentile=0):
         ServerBase.__init__(self, 'nutcracker', host, port, path)
 
         self.masters = masters
@@ -38,6 +39,9 @@ class NutCracker(ServerBase):
         self.args['is_redis']= str(is_redis).lower()
         self.args['riak_cluster']= riak_cluster
         self.args['auto_eject']= str(auto_eject).lower()
+        self.args['l1_cache_size']= l1_cache_size
+        self.args['riak_backends']= riak_backends
+        self.args['hedge_percentile']= hedge_percentile
         # HACK: await successful ping, otherwise getting requests ahead of the
         # service being up and running.
         self._alive()
@@ -60,18 +64,33 @@ class NutCracker(ServerBase):
         template = '''
   backend_type: riak
   backend_max_resend: 2
+  backend_vclock_cache: 1024
+  backend_counter_window: 5
   backends:
 $backends
 '''
-        node_names = riak_cluster.node_names()
-        server_cfg = ''
-        for node_name in node_names: 
-            server_cfg = server_cfg + TT(server_template, {
-                'host': riak_cluster.host(),
-                'port': riak_cluster.port_from_node_name(node_name)
-                })
+        if self.args['hedge_percentile'] > 0:
+            template = template.replace('  backends:',
+                    '  backend_hedge_percentile: $hedge_percentile\n  backends:')
 
-        return TT(template, { 'backends': server_cfg })
+        server_cfg = ''
+        if self.args['riak_backends'] != None:
+            # eg. riak nodes behind a DelayProxy, in place of the cluster's
+            for backend in self.args['riak_backends']:
+                server_cfg = server_cfg + TT(server_template, {
+                    'host': backend.host(),
+                    'port': backend.port()
+                    })
+        else:
+            node_names = riak_cluster.node_names()
+            for node_name in node_names: 
+                server_cfg = server_cfg + TT(server_template, {
+                    'host': riak_cluster.host(),
+                    'port': riak_cluster.port_from_node_name(node_name)
+                    })
+
+        return TT(template, { 'backends': server_cfg,
+                              'hedge_percentile': self.args['hedge_percentile'] })
 
     def _gen_conf(self):
         content = '''
@@ -89,11 +108,28 @@ $cluster_name:
   server_retry_timeout: 20000
   server_failure_limit: 1
   server_ttl: 500ms
+  buckets:
+    - default:test_lww:
+      write_mode: lww
+    - default:test_negative:
+      negative_ttl: 60s
+    - default:test_grace:
+      ttl: 2s
+      grace: 60s
+    - default:test_write_behind:
+      write_behind: 100ms
+    - default:test_siblings:
+      max_siblings: 1
+    - default:test_long_ttl:
+      ttl: 60s
   servers:
 '''
         if self.args['redis_auth']:
             content = content.replace('redis: $is_redis',
                     'redis: $is_redis\r\n  redis_auth: $redis_auth')
+        if self.args['l1_cache_size'] > 0:
+            content = content.replace('redis: $is_redis',
+                    'redis: $is_redis\r\n  l1_cache_size: $l1_cache_size')
         content = TT(content, self.args)
         content = content + self._gen_conf_section()
         if self.args['riak_cluster'] != None:
@@ -233,6 +233,9 @@ class RiakCluster:
         # using 'sets' to reduce bucket type setup
         self._ensure_dt_bucket_type('sets', 'set')
 
+    def ensure_counter_dt(self):
+        self._ensure_dt_bucket_type('counters', 'counter')
+
     def ensure_rra_bucket_props_dt(self):
         self._ensure_dt_bucket_type('rra', '')
         self._ensure_dt_bucket_type('rra_set', 'set')
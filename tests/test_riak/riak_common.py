@@ -17,6 +17,7 @@ from server_modules import *
 from server_modules_redis import *
 from server_modules_riak import *
 from server_modules_nutcracker import *
+from server_modules_delay import *
 from utils import *
 from all_redis import *
 
@@ -60,6 +61,27 @@ nc_for_feature_testing = NutCracker('127.0.0.1', 4210, '/tmp/r/nutcracker-4210',
         auto_eject=True)
 nc = nc_for_feature_testing
 
+# NOTE: the L1 cache of a proxy answers GETs ahead of its frontend, so it is
+# given a proxy of its own, in front of the same servers as the one above.
+l1_cache_size = getenv('T_L1_CACHE_SIZE', 65536, int)
+nc_with_l1_cache_for_feature_testing = NutCracker('127.0.0.1', 4211,
+        '/tmp/r/nutcracker-4211', CLUSTER_NAME, all_redis_for_feature_testing,
+        mbuf=mbuf, verbose=nc_verbose,
+        riak_cluster=riak_cluster_for_feature_testing, auto_eject=True,
+        l1_cache_size=l1_cache_size)
+
+# NOTE: hedged reads are tested on a proxy of their own too, whose first riak
+# backend is the feature testing node behind a relay which can slow it down.
+riak_delay_proxy = DelayProxy('127.0.0.1', 5250,
+        riak_cluster_for_feature_testing)
+hedge_percentile = getenv('T_HEDGE_PERCENTILE', 50, int)
+nc_with_hedge_for_feature_testing = NutCracker('127.0.0.1', 4212,
+        '/tmp/r/nutcracker-4212', CLUSTER_NAME, all_redis_for_feature_testing,
+        mbuf=mbuf, verbose=nc_verbose,
+        riak_cluster=riak_cluster_for_feature_testing, auto_eject=True,
+        riak_backends=[riak_delay_proxy, riak_cluster_for_feature_testing],
+        hedge_percentile=hedge_percentile)
+
 nc_for_partition_testing = NutCracker('127.0.0.1', 4210, '/tmp/r/nutcracker-4410',
         CLUSTER_NAME, all_redis_for_partition_testing, mbuf=mbuf,
         verbose=nc_verbose, riak_cluster=riak_cluster_for_partition_testing,
@@ -67,21 +89,23 @@ nc_for_partition_testing = NutCracker('127.0.0.1', 4210, '/tmp/r/nutcracker-4410
 
 def cluster_setup():
     print 'setup(mbuf=%s, verbose=%s)' %(mbuf, nc_verbose)
-    _cluster_setup(nc_for_feature_testing,
+    _cluster_setup([nc_for_feature_testing,
+            nc_with_l1_cache_for_feature_testing,
+            nc_with_hedge_for_feature_testing],
             riak_cluster_for_feature_testing,
             all_redis_for_feature_testing)
 
 def cluster_setup_for_partition():
     # NOTE: function name must not contain test or it will be discovered as a test
     print 'setup(mbuf=%s, verbose=%s)' %(mbuf, nc_verbose)
-    _cluster_setup(nc_for_partition_testing,
+    _cluster_setup([nc_for_partition_testing],
             riak_cluster_for_partition_testing,
             all_redis_for_partition_testing)
 
-def _cluster_setup(lnc, lriak, lredis):
+def _cluster_setup(lncs, lriak, lredis):
     lriak.deploy()
     lriak.start()
-    for r in lredis + [lriak, lnc]:
+    for r in lredis + [lriak] + lncs:
         r.clean()
         r.deploy()
         r.stop()
@@ -89,25 +113,29 @@ def _cluster_setup(lnc, lriak, lredis):
     lriak.ensure_string_dt()
     lriak.ensure_rra_bucket_props_dt()
     lriak.ensure_set_dt()
+    lriak.ensure_counter_dt()
 
 def cluster_teardown():
-    _cluster_teardown(nc_for_feature_testing,
+    _cluster_teardown([nc_for_feature_testing,
+            nc_with_l1_cache_for_feature_testing,
+            nc_with_hedge_for_feature_testing],
             riak_cluster_for_feature_testing,
             all_redis_for_feature_testing)
 
 def cluster_teardown_for_partition():
     # NOTE: function name must not contain test or it will be discovered as a test
-    _cluster_teardown(nc_for_partition_testing,
+    _cluster_teardown([nc_for_partition_testing],
             riak_cluster_for_partition_testing,
             all_redis_for_partition_testing)
 
-def _cluster_teardown(lnc, lriak, lredis):
-    for r in [lnc, lriak] + lredis:
+def _cluster_teardown(lncs, lriak, lredis):
+    for r in lncs + [lriak] + lredis:
         if not r._alive():
             print('%s was not alive at teardown' % r)
         r.stop()
 
-def getconn(bucket_type = 'default', testing_type = 'feature'):
+def getconn(bucket_type = 'default', testing_type = 'feature',
+            l1_cache = False, hedge = False):
     if testing_type == 'partition':
         lredis = all_redis_for_partition_testing
         lriak = riak_cluster_for_partition_testing
@@ -116,6 +144,10 @@ def getconn(bucket_type = 'default', testing_type = 'feature'):
         lredis = all_redis_for_feature_testing
         lriak = riak_cluster_for_feature_testing
         lnc = nc_for_feature_testing
+        if l1_cache:
+            lnc = nc_with_l1_cache_for_feature_testing
+        if hedge:
+            lnc = nc_with_hedge_for_feature_testing
 
     for r in lredis:
         c = redis.Redis(r.host(), r.port())
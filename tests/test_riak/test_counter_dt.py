@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+#coding: utf-8
+
+from riak_common import *
+import riak
+import redis
+from riak.datatypes import Counter
+
+def test_counter_dt_incr():
+    (riak_client, _, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_counters_key(key)
+
+    value = retry_write(lambda: nutcracker.incr(nc_key))
+    assert_equal(1, value)
+    value = retry_write(lambda: nutcracker.incrby(nc_key, 10))
+    assert_equal(11, value)
+    value = retry_write(lambda: nutcracker.decr(nc_key))
+    assert_equal(10, value)
+    value = retry_write(lambda: nutcracker.decrby(nc_key, 4))
+    assert_equal(6, value)
+
+    assert_equal(6, get_counter_dt_object(riak_client, 'test', key).value)
+
+def test_counter_dt_batched():
+    (riak_client, _, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_counters_key(key)
+    increments = [ 1, 5, -2, 7, 1 ]
+
+    pipe = nutcracker.pipeline(transaction=False)
+    for increment in increments:
+        pipe.incrby(nc_key, increment)
+    values = pipe.execute()
+
+    expected = []
+    total = 0
+    for increment in increments:
+        total += increment
+        expected.append(total)
+    assert_equal(expected, values)
+
+    assert_equal(total, get_counter_dt_object(riak_client, 'test', key).value)
+
+def test_counter_dt_invalidates_cache():
+    (riak_client, _, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_counters_key(key)
+
+    retry_write(lambda: nutcracker.incrby(nc_key, 3))
+    assert_equal(None, redis.get(nc_key))
+    value = retry_write(lambda: nutcracker.incrby(nc_key, 0))
+    assert_equal(3, value)
+
+def get_counter_dt_object(riak_client, bucket, key):
+    counter_dt_bucket = riak_client.bucket_type(bucket_type_name()).bucket(bucket)
+    counter = Counter(counter_dt_bucket, key)
+    counter.reload()
+    return counter
+
+def bucket_type_name():
+    return 'counters'
+
+def nutcracker_counters_key(riak_key):
+    nc_key = nutcracker_key(riak_key)
+    return '%s:%s' % (bucket_type_name(), nc_key)
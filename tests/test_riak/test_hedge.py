@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+#coding: utf-8
+
+from riak_common import *
+import riak
+import time
+import redis
+
+# long enough for a read held back by the delay proxy to be hedged, but far
+# shorter than the proxy's timeout
+hedge_test_delay = 0.5
+
+def hedge_stat(name):
+    time.sleep(1) # wait until statistics ready
+    stat = nc_with_hedge_for_feature_testing._info_dict()
+    return stat[CLUSTER_NAME][name]
+
+def hedge_warm_up(nutcracker):
+    # the hedge delay of each backend is a percentile of its recent read
+    # latencies, known once enough misses have been read from both
+    for i in range(0, 512):
+        nutcracker.get('test_hedge_warm_up:%s' % distinct_key())
+
+def hedge_riak_keys(riak_bucket, n):
+    keys = []
+    for i in range(0, n):
+        key = distinct_key()
+        value = distinct_value()
+        riak_object = retry_read_notfound_ok(lambda: riak_bucket.get(key))
+        riak_object.data = value
+        wrote = retry_write(lambda: riak_object.store())
+        assert_not_exception(wrote)
+        keys.append((key, value))
+    return keys
+
+def test_hedge_wins_over_slow_backend():
+    # the keys of the delay proxy's backend are read before it answers, by
+    # their hedges on the other backend, and its late replies are swallowed
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(hedge = True)
+    riak_delay_proxy.delay = 0
+    hedge_warm_up(nutcracker)
+    keys = hedge_riak_keys(riak_bucket, 16)
+    late_keys = hedge_riak_keys(riak_bucket, 16)
+    wins = hedge_stat('backend_hedge_wins')
+    riak_delay_proxy.delay = hedge_test_delay
+    try:
+        for (key, value) in keys:
+            start = time.time()
+            assert_equal(value, nutcracker.get(nutcracker_key(key)))
+            assert_true(time.time() - start < hedge_test_delay)
+    finally:
+        riak_delay_proxy.delay = 0
+    assert_true(hedge_stat('backend_hedge_wins') > wins)
+    # by now every late reply has reached the proxy, none of which answers
+    # the misses read after them
+    pipe = nutcracker.pipeline(transaction = False)
+    for (key, value) in late_keys:
+        pipe.get(nutcracker_key(key))
+    assert_equal([ value for (key, value) in late_keys ], pipe.execute())
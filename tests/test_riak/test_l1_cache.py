@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+#coding: utf-8
+
+from riak_common import *
+import riak
+import time
+import redis
+
+# the l1 cache caps each of its entries at 1/16th of its budget, the entry
+# taking a little more memory than the value it holds
+l1_cache_max_value = l1_cache_size / 16 - 256
+
+def l1_cache_hits():
+    time.sleep(1) # wait until statistics ready
+    stat = nc_with_l1_cache_for_feature_testing._info_dict()
+    return stat[CLUSTER_NAME]['l1_cache_hits']
+
+def l1_cache_value(length):
+    value = distinct_value()
+    return value + 'x' * (length - len(value))
+
+def test_l1_cache_hit():
+    # the test_long_ttl bucket keeps the values read in the l1 cache for far
+    # longer than the test runs
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    nc_key = 'test_long_ttl:%s' % distinct_key()
+    value = distinct_value()
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    hits = l1_cache_hits()
+    assert_equal(value, nutcracker.get(nc_key))
+    assert_equal(value, nutcracker.get(nc_key))
+    assert_equal(hits + 2, l1_cache_hits())
+
+def test_l1_cache_invalidated_by_set():
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    nc_key = 'test_long_ttl:%s' % distinct_key()
+    value = distinct_value()
+    new_value = distinct_value()
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    assert_equal(value, nutcracker.get(nc_key))
+    wrote = retry_write(lambda: nutcracker.set(nc_key, new_value))
+    assert_not_exception(wrote)
+    assert_equal(new_value, nutcracker.get(nc_key))
+
+def test_l1_cache_invalidated_by_del():
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    nc_key = 'test_long_ttl:%s' % distinct_key()
+    value = distinct_value()
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    assert_equal(value, nutcracker.get(nc_key))
+    assert_equal(1, nutcracker.delete(nc_key))
+    assert_equal(None, nutcracker.get(nc_key))
+
+def test_l1_cache_pipelined_write_then_read():
+    # a get pipelined behind a set of the same client reads the set, even
+    # though the value it replaces is in the l1 cache
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    nc_key = 'test_long_ttl:%s' % distinct_key()
+    value = distinct_value()
+    new_value = distinct_value()
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    assert_equal(value, nutcracker.get(nc_key))
+    pipe = nutcracker.pipeline(transaction = False)
+    pipe.set(nc_key, new_value)
+    pipe.get(nc_key)
+    assert_equal([ True, new_value ], pipe.execute())
+
+def test_l1_cache_ttl_expiry():
+    # values of the default bucket expire with the server_ttl of the pool
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    key = distinct_key()
+    nc_key = nutcracker_key(key)
+    value = distinct_value()
+    new_value = distinct_value()
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    # riak is written behind the proxy's back, the cached value expires
+    riak_object = retry_read(lambda: riak_bucket.get(key))
+    riak_object.data = new_value
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    time.sleep(1)
+    assert_equal(new_value, nutcracker.get(nc_key))
+
+def test_l1_cache_entry_cap():
+    # a value taking more than 1/16th of the budget is not cached
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    nc_key = 'test_long_ttl:%s' % distinct_key()
+    value = l1_cache_value(l1_cache_size / 16 + 1)
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    hits = l1_cache_hits()
+    assert_equal(value, nutcracker.get(nc_key))
+    assert_equal(hits, l1_cache_hits())
+
+def test_l1_cache_budget():
+    # reading values of twice the budget evicts the least recently used
+    (riak_client, riak_bucket, nutcracker, redis) = getconn(l1_cache = True)
+    n = 2 * l1_cache_size / l1_cache_max_value
+    kvs = [ ('test_long_ttl:%s' % distinct_key(),
+             l1_cache_value(l1_cache_max_value)) for i in range(n) ]
+    for (nc_key, value) in kvs:
+        wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+        assert_not_exception(wrote)
+    for (nc_key, value) in kvs:
+        assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    hits = l1_cache_hits()
+    (nc_key, value) = kvs[-1]
+    assert_equal(value, nutcracker.get(nc_key))
+    assert_equal(hits + 1, l1_cache_hits())
+    (nc_key, value) = kvs[0]
+    assert_equal(value, nutcracker.get(nc_key))
+    assert_equal(hits + 1, l1_cache_hits())
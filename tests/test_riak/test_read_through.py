@@ -96,6 +96,301 @@ def test_multi_read_through_miss_miss():
 def test_many_read_through_miss_miss():
     multi_read_through(read_through_miss_miss, riak_many_n)
 
+def test_pipelined_read_through_miss_hit():
+    # responses of a pipeline of misses are released in request order, even
+    # though the backend reads are in flight concurrently
+    kvs = {}
+    while len(kvs) < riak_many_n:
+        kvs[distinct_key()] = distinct_value()
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    for key in kvs:
+        riak_object = retry_read_notfound_ok(lambda: riak_bucket.get(key))
+        riak_object.data = kvs[key]
+        wrote = retry_write(lambda: riak_object.store())
+        assert_not_exception(wrote)
+
+    keys = kvs.keys()
+    pipe = nutcracker.pipeline(transaction = False)
+    for key in keys:
+        pipe.get(nutcracker_key(key, riak_bucket))
+    assert_equal([ kvs[key] for key in keys ], pipe.execute())
+
+def test_concurrent_read_through_fills():
+    # misses of several clients at once are all filled through the one
+    # frontend connection, their hidden writes batched together, and each
+    # client gets its own values
+    nclients = riak_multi_n * 4
+    (riak_client, riak_bucket, nutcracker, redis_frontend) = getconn()
+    client_kvs = []
+    for i in range(nclients):
+        kvs = {}
+        while len(kvs) < riak_multi_n * 4:
+            kvs[distinct_key()] = distinct_value()
+        for key in kvs:
+            riak_object = retry_read_notfound_ok(lambda: riak_bucket.get(key))
+            riak_object.data = kvs[key]
+            wrote = retry_write(lambda: riak_object.store())
+            assert_not_exception(wrote)
+        client_kvs.append(kvs)
+
+    replies = {}
+    def read_func(i):
+        client = redis.Redis(nc.host(), nc.port())
+        keys = client_kvs[i].keys()
+        pipe = client.pipeline(transaction = False)
+        for key in keys:
+            pipe.get(nutcracker_key(key, riak_bucket))
+        replies[i] = (keys, pipe.execute())
+
+    threads = [ threading.Thread(target = read_func, args = (i, ))
+                for i in range(nclients) ]
+    for t in threads:
+        t.daemon = True
+        t.start()
+    for t in threads:
+        t.join(10.0)
+
+    assert_equal(nclients, len(replies))
+    for i in range(nclients):
+        (keys, values) = replies[i]
+        assert_equal([ client_kvs[i][key] for key in keys ], values)
+    for kvs in client_kvs:
+        for key in kvs:
+            nc_key = nutcracker_key(key, riak_bucket)
+            assert_equal(kvs[key], retry_read(lambda: redis_frontend.get(nc_key)))
+
+def test_pipelined_read_through_same_key():
+    # concurrent misses for one key are answered by a single backend read
+    key = distinct_key()
+    value = distinct_value()
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    riak_object = retry_read_notfound_ok(lambda: riak_bucket.get(key))
+    riak_object.data = value
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+
+    nc_key = nutcracker_key(key, riak_bucket)
+    pipe = nutcracker.pipeline(transaction = False)
+    for i in range(riak_many_n):
+        pipe.get(nc_key)
+    assert_equal([ value ] * riak_many_n, pipe.execute())
+
+def test_pipelined_read_after_write():
+    # a read pipelined behind a write to the same key must not overtake it
+    key = distinct_key()
+    value = distinct_value()
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    nc_key = nutcracker_key(key, riak_bucket)
+    pipe = nutcracker.pipeline(transaction = False)
+    pipe.get(nc_key)
+    pipe.set(nc_key, value)
+    pipe.get(nc_key)
+    (_, wrote, value_read) = pipe.execute()
+    assert_equal(True, wrote)
+    assert_equal(value, value_read)
+
+def test_pipelined_mget_after_write():
+    # the fragments of an mget pipelined behind a write must not overtake it
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    nc_keys = [ nutcracker_key(distinct_key(), riak_bucket) for _ in range(2) ]
+    value = distinct_value()
+    pipe = nutcracker.pipeline(transaction = False)
+    pipe.set(nc_keys[0], value)
+    pipe.mget(nc_keys)
+    (wrote, values_read) = pipe.execute()
+    assert_equal(True, wrote)
+    assert_equal([ value, None ], values_read)
+
+def test_mget_read_through_miss_hit():
+    # keys of an mget missing from redis are read from riak, and filled in
+    kvs = {}
+    while len(kvs) < riak_many_n:
+        kvs[distinct_key()] = distinct_value()
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    for key in kvs:
+        riak_object = retry_read_notfound_ok(lambda: riak_bucket.get(key))
+        riak_object.data = kvs[key]
+        wrote = retry_write(lambda: riak_object.store())
+        assert_not_exception(wrote)
+
+    missing_key = distinct_key()
+    keys = kvs.keys()
+    nc_keys = [ nutcracker_key(key, riak_bucket) for key in keys ]
+    nc_missing_key = nutcracker_key(missing_key, riak_bucket)
+    values = nutcracker.mget(nc_keys + [ nc_missing_key ])
+    assert_equal([ kvs[key] for key in keys ] + [ None ], values)
+
+    # the filled keys are read again from the cache
+    assert_equal([ kvs[key] for key in keys ], nutcracker.mget(nc_keys))
+
+def test_read_through_negative_cache():
+    # the test_negative bucket is configured with a negative_ttl, so a key
+    # riak does not have is answered from the cache until it is written
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    negative_bucket = riak_client.bucket('test_negative')
+    key = distinct_key()
+    value = distinct_value()
+    nc_key = 'test_negative:%s' % key
+    read_func = lambda : nutcracker.get(nc_key)
+    assert_equal(None, retry_read_notfound_ok(read_func))
+    # riak is written behind the proxy's back, the miss stays cached
+    riak_object = retry_read_notfound_ok(lambda: negative_bucket.get(key))
+    riak_object.data = value
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    assert_equal(None, retry_read_notfound_ok(read_func))
+    assert_equal([ None ], nutcracker.mget([ nc_key ]))
+    # a write through the proxy replaces the marker
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(value, retry_read_notfound_ok(read_func))
+
+def test_read_through_negative_cache_other_reads():
+    # reads other than GET of a key with a not-found marker answer as for a
+    # missing key, not about the marker
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = 'test_negative:%s' % key
+    assert_equal(None, retry_read_notfound_ok(lambda : nutcracker.get(nc_key)))
+    # the marker is written to the frontend behind the GET's response
+    assert_not_equal(None, retry_read(lambda : redis.get('\0nc_nil:' + nc_key)))
+    assert_equal(0, nutcracker.strlen(nc_key))
+    assert_equal('none', nutcracker.type(nc_key))
+    assert_equal('', nutcracker.getrange(nc_key, 0, -1))
+    assert_equal(None, nutcracker.dump(nc_key))
+    assert_true(nutcracker.ttl(nc_key) in [ None, -2 ])
+    assert_true(nutcracker.pttl(nc_key) in [ None, -2 ])
+
+def test_read_through_negative_cache_exists():
+    # EXISTS of a key with a not-found marker answers 0, from the cache
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    negative_bucket = riak_client.bucket('test_negative')
+    key = distinct_key()
+    value = distinct_value()
+    nc_key = 'test_negative:%s' % key
+    assert_equal(None, retry_read_notfound_ok(lambda : nutcracker.get(nc_key)))
+    assert_not_equal(None, retry_read(lambda : redis.get('\0nc_nil:' + nc_key)))
+    assert_equal(False, nutcracker.exists(nc_key))
+    # riak is written behind the proxy's back, the miss stays cached
+    riak_object = retry_read_notfound_ok(lambda: negative_bucket.get(key))
+    riak_object.data = value
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    assert_equal(False, nutcracker.exists(nc_key))
+    # a write through the proxy replaces the marker
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    assert_equal(True, nutcracker.exists(nc_key))
+
+def test_read_through_negative_cache_writes():
+    # commands writing a key with a not-found marker act on a missing key,
+    # not on the marker, which clients cannot name
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    value = distinct_value()
+    append_key = 'test_negative:%s' % distinct_key()
+    setnx_key = 'test_negative:%s' % distinct_key()
+    for nc_key in [ append_key, setnx_key ]:
+        assert_equal(None, retry_read_notfound_ok(lambda : nutcracker.get(nc_key)))
+        assert_not_equal(None, retry_read(lambda : redis.get('\0nc_nil:' + nc_key)))
+    assert_equal(len(value), nutcracker.append(append_key, value))
+    assert_equal(value, redis.get(append_key))
+    assert_equal(True, nutcracker.setnx(setnx_key, value))
+    assert_equal(value, redis.get(setnx_key))
+    assert_fail('key reserved', nutcracker.get, '\0nc_nil:' + append_key)
+
+def test_read_through_grace_refresh():
+    # the test_grace bucket has a grace far longer than its ttl, so hits on
+    # a cached key refresh it from riak well before the ttl runs out
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    grace_bucket = riak_client.bucket('test_grace')
+    key = distinct_key()
+    value = distinct_value()
+    new_value = distinct_value()
+    nc_key = 'test_grace:%s' % key
+    riak_object = retry_read_notfound_ok(lambda: grace_bucket.get(key))
+    riak_object.data = value
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    read_func = lambda : nutcracker.get(nc_key)
+    assert_equal(value, retry_read(read_func))
+    # riak is written behind the proxy's back, within the key's ttl
+    riak_object = retry_read(lambda: grace_bucket.get(key))
+    riak_object.data = new_value
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    value_read = None
+    for _ in range(10):
+        value_read = retry_read(read_func)
+        if value_read == new_value:
+            break
+        time.sleep(0.1)
+    assert_equal(new_value, value_read)
+
+def test_read_through_collapse_siblings():
+    # the test_siblings bucket has max_siblings 1, so a read of a key with
+    # siblings writes the value returned back to riak, collapsing them
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    siblings_bucket = riak_client.bucket('test_siblings')
+    siblings_bucket.set_property('allow_mult', True)
+    siblings_bucket.set_property('last_write_wins', False)
+    key = distinct_key()
+    nc_key = 'test_siblings:%s' % key
+    riak_read_func = lambda : siblings_bucket.get(key)
+    riak_object = retry_read_notfound_ok(riak_read_func)
+    riak_object2 = retry_read_notfound_ok(riak_read_func)
+    riak_object.data = distinct_value()
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    riak_object2.data = distinct_value()
+    wrote = retry_write(lambda: riak_object2.store())
+    assert_not_exception(wrote)
+    assert_equal(2, len(retry_read(riak_read_func).siblings))
+    value_read = retry_read(lambda: nutcracker.get(nc_key))
+    riak_object_readback = None
+    for _ in range(10):
+        riak_object_readback = retry_read(riak_read_func)
+        if len(riak_object_readback.siblings) == 1:
+            break
+        time.sleep(0.1)
+    assert_equal(1, len(riak_object_readback.siblings))
+    assert_equal(value_read, riak_object_readback.data)
+
+def test_read_through_exists():
+    # a key missing from the cache is checked in riak, with a head-only
+    # fetch which leaves the cache alone
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_key(key, riak_bucket)
+    exists_func = lambda : nutcracker.exists(nc_key)
+    assert_equal(False, retry_read_notfound_ok(exists_func))
+    riak_object = retry_read_notfound_ok(lambda: riak_bucket.get(key))
+    riak_object.data = distinct_value()
+    wrote = retry_write(lambda: riak_object.store())
+    assert_not_exception(wrote)
+    assert_equal(True, retry_read(exists_func))
+    assert_equal(None, redis.get(nc_key))
+
+def test_read_through_cut_through():
+    # a large value of a last-write-wins bucket is streamed to the client
+    # as it is read from riak, and written back to the cache alongside
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    lww_bucket = riak_client.bucket('test_lww')
+    lww_bucket.set_property('last_write_wins', True)
+    lww_bucket.set_property('allow_mult', False)
+    nc_key = 'test_lww:%s' % distinct_key()
+    value = '0123456789ABCdef' * 65536
+    wrote = retry_write(lambda : nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    redis.delete(nc_key)
+    assert_equal(value, retry_read(lambda : nutcracker.get(nc_key)))
+    cached_value = None
+    for _ in range(10):
+        cached_value = redis.get(nc_key)
+        if cached_value is not None:
+            break
+        time.sleep(0.1)
+    assert_equal(value, cached_value)
+
 def multi_read_through(read_func, n, bucket_type = 'default'):
     kvs = {}
     while len(kvs) < n:
@@ -98,6 +98,69 @@ def test_set_dt_add_multi():
         exists = retry_read(lambda: nutcracker.sismember(nc_key, value))
         assert(exists)
 
+def test_set_dt_batched():
+    (riak_client, _, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_sets_key(key)
+    add_values = [ distinct_value(), distinct_value(), distinct_value() ]
+    missing_value = distinct_value()
+
+    # sent together, so that they are batched into a single update; the
+    # removal of a missing member has the batch written one by one
+    for remove_values in [ [ add_values[0] ], [ missing_value ] ]:
+        pipe = nutcracker.pipeline(transaction=False)
+        for value in add_values:
+            pipe.sadd(nc_key, value)
+        for value in remove_values:
+            pipe.srem(nc_key, value)
+        wrote = pipe.execute()
+        assert_equal([ 1 ] * (len(add_values) + len(remove_values)), wrote)
+
+    values = add_values[1:] + [ add_values[0] ]
+    nc_values = retry_read(lambda: nutcracker.smembers(nc_key))
+    assert_equal(set(values), set(nc_values))
+    riak_set = get_set_dt_object(riak_client, 'test', key)
+    riak_set.reload()
+    assert_equal(set(values), set(riak_set.value))
+
+def test_set_dt_algebra():
+    (riak_client, _, nutcracker, redis) = getconn()
+    keys = [ distinct_key(), distinct_key() ]
+    nc_keys = [ nutcracker_sets_key(key) for key in keys ]
+    common = distinct_value()
+    values = [ [ common, distinct_value() ], [ common, distinct_value() ] ]
+
+    # written to riak only, so that the operations miss in the cache and
+    # are computed by the proxy from the sets read from riak
+    for key, key_values in zip(keys, values):
+        riak_set = get_set_dt_object(riak_client, 'test', key)
+        for value in key_values:
+            riak_set.add(value)
+        retry_write(lambda: riak_set.store())
+
+    union = set(values[0]) | set(values[1])
+    nc_values = retry_read(lambda: nutcracker.sunion(*nc_keys))
+    assert_equal(union, set(nc_values))
+    nc_values = retry_read(lambda: nutcracker.sinter(*nc_keys))
+    assert_equal(set([ common ]), set(nc_values))
+    nc_values = retry_read(lambda: nutcracker.sdiff(*nc_keys))
+    assert_equal(set(values[0][1:]), set(nc_values))
+
+    key = distinct_key()
+    nc_key = nutcracker_sets_key(key)
+    wrote = retry_write(lambda: nutcracker.sunionstore(nc_key, *nc_keys))
+    assert_equal(len(union), wrote)
+    nc_values = retry_read(lambda: nutcracker.smembers(nc_key))
+    assert_equal(union, set(nc_values))
+    # the destination is written to riak behind the reply
+    riak_set = get_set_dt_object(riak_client, 'test', key)
+    for i in range(0, 10):
+        riak_set.reload()
+        if union == set(riak_set.value):
+            break
+        sleep(0.1)
+    assert_equal(union, set(riak_set.value))
+
 def test_set_dt_ttl():
     (riak_client, _, nutcracker, redis) = getconn()
     key = distinct_key()
@@ -124,6 +187,48 @@ def test_set_dt_ttl():
         sleep(0.1)
     assert_equal(len(values), len(nc_values))
 
+def test_set_dt_large():
+    (riak_client, _, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_sets_key(key)
+    # more members than the proxy fills into the frontend at a time
+    values = set([ distinct_value() for i in range(0, 2500) ])
+
+    riak_set = get_set_dt_object(riak_client, 'test', key)
+    for value in values:
+        riak_set.add(value)
+    riak_set.store()
+
+    nc_values = retry_read(lambda: nutcracker.smembers(nc_key))
+    assert_equal(values, nc_values)
+    assert_equal(len(values), retry_read(lambda: nutcracker.scard(nc_key)))
+
+    for i in range(0, 10):
+        fe_values = redis.smembers(nc_key)
+        if len(values) == len(fe_values):
+            break
+        sleep(0.1)
+    assert_equal(values, fe_values)
+
+def test_set_dt_large_pipelined():
+    # the reply to a large set read from riak is released in parts, ahead
+    # of the replies pipelined behind it
+    (riak_client, _, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_sets_key(key)
+    values = set([ distinct_value() for i in range(0, 2500) ])
+
+    riak_set = get_set_dt_object(riak_client, 'test', key)
+    for value in values:
+        riak_set.add(value)
+    riak_set.store()
+
+    pipe = nutcracker.pipeline(transaction = False)
+    pipe.smembers(nc_key)
+    pipe.ping()
+    pipe.smembers(nc_key)
+    assert_equal([ values, True, values ], pipe.execute())
+
 def test_set_dt_max_add():
     n_to_adds = range(1, 100)
     for n_to_add in n_to_adds:
@@ -62,6 +62,32 @@ def test_write_through_bucketless_create():
     value_readback = retry_read_notfound_ok(read_func)
     assert_equal(value, value_readback)
 
+def test_write_behind_create():
+    # the test_write_behind bucket acknowledges a SET once it is cached, and
+    # writes it to riak 100ms later
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    wb_bucket = riak_client.bucket('test_write_behind')
+    key = distinct_key()
+    value = distinct_value()
+    nc_key = 'test_write_behind:%s' % key
+    riak_read_func = lambda : wb_bucket.get(key)
+    riak_object = retry_read_notfound_ok(riak_read_func)
+    riak_delete_func = lambda : riak_object.delete()
+    wrote = retry_write(riak_delete_func)
+    assert_not_exception(wrote)
+    wrote = retry_write(lambda: nutcracker.set(nc_key, value))
+    assert_not_exception(wrote)
+    # the write is read back from the cache at once
+    assert_equal(value, retry_read(lambda: nutcracker.get(nc_key)))
+    # and reaches riak soon after
+    riak_value = None
+    for _ in range(10):
+        riak_value = retry_read_notfound_ok(riak_read_func).data
+        if riak_value == value:
+            break
+        time.sleep(0.1)
+    assert_equal(value, riak_value)
+
 def test_write_through_update():
     _test_write_through_update()
 
@@ -88,6 +114,106 @@ def _test_write_through_update(bucket_type = 'default'):
     assert_equal(value, riak_object_readback.data)
     assert_equal(1, len(riak_object_readback.siblings))
 
+def test_write_through_update_cached_vclock():
+    ensure_siblings_bucket_properties()
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_key(key, riak_bucket)
+    write_func = lambda value: lambda : nutcracker.set(nc_key, value)
+    riak_read_func = lambda : riak_bucket.get(key)
+    # after the first SET the vclock returned by the PUT is cached, so
+    # the later SETs skip the read-before-write and must still not
+    # create siblings
+    for _ in range(0, 3):
+        value = distinct_value()
+        wrote = retry_write(write_func(value))
+        assert_not_exception(wrote)
+    riak_object_readback = retry_read_notfound_ok(riak_read_func)
+    assert_equal(value, riak_object_readback.data)
+    assert_equal(1, len(riak_object_readback.siblings))
+
+def test_write_through_lww_update():
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    lww_bucket = riak_client.bucket('test_lww')
+    lww_bucket.set_property('last_write_wins', True)
+    lww_bucket.set_property('allow_mult', False)
+    key = distinct_key()
+    nc_key = 'test_lww:%s' % key
+    write_func = lambda value: lambda : nutcracker.set(nc_key, value)
+    read_func = lambda : nutcracker.get(nc_key)
+    riak_read_func = lambda : lww_bucket.get(key)
+    # the bucket is configured with write_mode lww, so each SET is a
+    # single PUT without a read-before-write
+    for _ in range(0, 3):
+        value = distinct_value()
+        wrote = retry_write(write_func(value))
+        assert_not_exception(wrote)
+    value_readback = retry_read_notfound_ok(read_func)
+    assert_equal(value, value_readback)
+    riak_object_readback = retry_read_notfound_ok(riak_read_func)
+    assert_equal(value, riak_object_readback.data)
+    assert_equal(1, len(riak_object_readback.siblings))
+
+def test_write_through_mset_multi():
+    _test_write_through_mset(riak_multi_n)
+
+def test_write_through_mset_many():
+    _test_write_through_mset(riak_many_n)
+
+def _test_write_through_mset(key_count):
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    keys = [ distinct_key() for i in range(0, key_count)]
+    values = dict([ (nutcracker_key(key, riak_bucket), distinct_value())
+                    for key in keys ])
+    write_func = lambda : nutcracker.mset(values)
+    wrote = retry_write(write_func)
+    assert_not_exception(wrote)
+    # each key was written to riak
+    for key in keys:
+        riak_read_func = lambda : riak_bucket.get(key)
+        riak_object_readback = retry_read_notfound_ok(riak_read_func)
+        assert_equal(values[nutcracker_key(key, riak_bucket)],
+                     riak_object_readback.data)
+    # and reads through to its value
+    for nc_key, value in values.items():
+        read_func = lambda : nutcracker.get(nc_key)
+        assert_equal(value, retry_read_notfound_ok(read_func))
+
+def test_write_through_mset_pipelined_same_key():
+    # writes of a key pipelined by SET and MSET are applied in request order,
+    # one after the other, and a read before them does not see them
+    ensure_siblings_bucket_properties()
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    key = distinct_key()
+    nc_key = nutcracker_key(key, riak_bucket)
+    values = [ distinct_value() for i in range(0, 3) ]
+    pipe = nutcracker.pipeline(transaction = False)
+    pipe.get(nc_key)
+    pipe.set(nc_key, values[0])
+    pipe.mset({ nc_key: values[1] })
+    pipe.mset({ nc_key: values[2] })
+    pipe.get(nc_key)
+    assert_equal([ None, True, True, True, values[2] ], pipe.execute())
+    riak_object_readback = retry_read_notfound_ok(lambda : riak_bucket.get(key))
+    assert_equal(values[2], riak_object_readback.data)
+    assert_equal(1, len(riak_object_readback.siblings))
+
+def test_delete_pipelined_same_key():
+    # a DEL of several keys pipelined between SETs and a GET of them is
+    # applied after the SETs, and before the GET
+    (riak_client, riak_bucket, nutcracker, redis) = getconn()
+    keys = [ distinct_key() for i in range(0, 2) ]
+    nc_keys = [ nutcracker_key(key, riak_bucket) for key in keys ]
+    pipe = nutcracker.pipeline(transaction = False)
+    pipe.get(nc_keys[0])
+    for nc_key in nc_keys:
+        pipe.set(nc_key, distinct_value())
+    pipe.delete(*nc_keys)
+    pipe.get(nc_keys[0])
+    assert_equal([ None, True, True, 2, None ], pipe.execute())
+    riak_object_readback = retry_read_notfound_ok(lambda : riak_bucket.get(keys[0]))
+    assert_equal(None, riak_object_readback.data)
+
 def test_delete_single():
     _delete(1)
 